@@ -23,6 +23,7 @@
 #include <stddef.h>
 #include "acceptor.h"
 #include "services.h"
+#include "discovery.h"
 
 /**
  * accCreateConnection
@@ -154,16 +155,18 @@ int accAcceptConnection(serviceHandler * sh)
 /**
  * accBroadcastService
  *
- * Broadcast the service on the network; the service's type, IP, and
- * port are described by sh.
+ * Make the service described by sh known on the network, until some
+ * connector pairs with it.  This used to broadcast ten times, two
+ * seconds apart, and then give up; see discAnnounceService() in
+ * discovery.c for what it does now.
  * 
- * @param[in] sh the serviceHandler representing the service to be broadcasted. 
- * In order to properly broadcast the following field's of sh must be set: port and bcaddr.
+ * @param[in] sh the serviceHandler representing the service to be
+ * announced.  Its typeOfService, port and ip fields must be set.
  *
  * @returns If sh is NULL the function returns SERV_NULL_SH.  If the
- * port or bcaddr are not set, it returns SERV_BAD_PORT or
- * SERV_BAD_BROADCAST_ADDR respectively.  Otherwise, it returns
- * SERV_SUCCESS.
+ * port is not set, it returns SERV_BAD_PORT.  If the discovery group
+ * cannot be joined, it returns SERV_SOCK_BIND_FAILURE.  Otherwise, it
+ * returns SERV_SUCCESS once the service is connected.
  * 
  */
 int accBroadcastService(serviceHandler * sh)
@@ -172,67 +175,14 @@ int accBroadcastService(serviceHandler * sh)
   // Sanity check the inputs.
   if(sh == NULL) return SERV_NULL_SH;
   if(sh->port[0] == '\0') return SERV_BAD_PORT;
-  if(sh->bcaddr[0] == '\0') return SERV_BAD_BROADCAST_ADDR;
 
-  // The inputs are all set.  Construct a broadcast address
-  // based on the port and bcaddr.
-  char bc_addr[30] = {'\0'};
-
-  // Extract the target port from the incoming service handler.
-  char * port = sh->port;
-
-  // Glue the broadcast address and port together.
-  snprintf(bc_addr, 30, "%s%s%s", sh->bcaddr, ":", port);
-
-  int howManyBroadcasts = 10;
-  int result = -1;  
-  int s;       
-
-  struct sockaddr_in adr_bc;  /* AF_INET */  
-  int len_bc;
-
-  static int so_broadcast = 1;  
-  char * bcbuf = "Broadcasting excellent services since 2013!";
-
-  len_bc = sizeof adr_bc;  
-
-  // Create a broadcast address.  
-  if( mkaddr(&adr_bc, &len_bc, bc_addr, "udp") == -1)
-    {      
-      return -1;
-    }
-
-  // Create a UDP endpoint of communication for broadcasting the
-  // service.  Use the port number extracted from the incoming
-  // service handler.
-  if(servCreateEndpoint(SERV_UDP_BROADCAST_ENDPOINT, port, sh) != SERV_SUCCESS)
+  if(discAnnounceService(sh) != DISC_SUCCESS)
     {
-      printf("acceptor.c: %d. Failed to create endpoint \n", __LINE__);  
-      return -1;
+      printf("acceptor.c: %d. Failed to announce service \n", __LINE__);
+      return SERV_SOCK_BIND_FAILURE;
     }
 
-  while(howManyBroadcasts)
-    {
-      
-      /* 
-       * Broadcast the info
-       */  
-      result = sendto(sh->bh,  
-		      bcbuf,  
-		      strlen(bcbuf),  
-		      0,  
-		      (struct sockaddr *)&adr_bc,  
-		      len_bc);   
-      
-      if ( result == -1 )  
-	{
-	  perror("Cannot send broadcast: ");
-	}
-      
-      sleep(2);
-
-      howManyBroadcasts--;
-    }  
+  return SERV_SUCCESS;
 }
 
 
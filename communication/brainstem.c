@@ -126,6 +126,11 @@ int main(int argc, char* argv[])
   char emptyDataToSupervisor[MAXDATASIZE] = "0000000000 ";
   char rawTimeString[12] = {'\0'};
 
+  // In binary mode (see ssBinary) sensor data is sent to the
+  // supervisor-client as a packed record instead.
+  int binaryMode = 0;
+  unsigned char sensRecord[SENSOR_RECORD_SIZE];
+
   // An array to hold the timestamp.
   char currTime[100];
 
@@ -411,6 +416,14 @@ int main(int argc, char* argv[])
 	      perror("recv");
 	      return -1;
 	    }
+	  // A supervisor-client that wants records rather than strings
+	  // sends ssBinary in place of its first no-op.
+	  if(commandFromSupervisor[0] == ssBinary)
+	    {
+	      binaryMode = 1;
+	      commandFromSupervisor[0] = CMD_NO_OP;
+	    }
+
 	  // Write the read command into shared memory so that the
 	  // parent (nerves) may read and execute it.
 	  //writeCommandToSharedMemory(commandFromSupervisor, cmdArea,mqd_cmd);
@@ -428,14 +441,31 @@ int main(int argc, char* argv[])
 	  if(readSensorDataFromMessageQueue(sensDataToSupervisor, mqd_sns))
 	    {
 	      printf("\nsensDataToSupervisor: %s \n", sensDataToSupervisor);
-	      if(send(clientSock, sensDataToSupervisor, strlen(sensDataToSupervisor)-1 , 0) == -1)
+	      if(binaryMode)
+		{
+		  if(!packSensorString(sensRecord, sensDataToSupervisor))
+		    {
+		      printf("Malformed sensor data; sending it as empty.\n");
+		      packSensorRecord(sensRecord, 0, getRawTime());
+		    }
+		  if(send(clientSock, sensRecord, SENSOR_RECORD_SIZE, 0) == -1)
+		    perror("send");
+		}
+	      else if(send(clientSock, sensDataToSupervisor, strlen(sensDataToSupervisor)-1 , 0) == -1)
 		perror("send");
 	    }
 	  
-	  // Otherwise, assume no sensor was activated.  Send an empty
-	  // sensor message to the supervisor-client.
+	  // Otherwise, assume no sensor was activated.  In binary mode
+	  // the empty record carries only the time.
+	  else if(binaryMode)
+	    {
+	      packSensorRecord(sensRecord, 0, getRawTime());
+	      if(send(clientSock, sensRecord, SENSOR_RECORD_SIZE, 0) == -1)
+		perror("send");
+	    }
 	  else
 	    {
+	      // Send an empty sensor message to the supervisor-client.
 	      itoa(getRawTime(), rawTimeString);
 	      
 	      // Construct an empty sensor data message and send it to
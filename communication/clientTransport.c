@@ -0,0 +1,1170 @@
+/**
+ * clientTransport.c
+ *
+ * The shared connection code for the agent clients.  This replaces
+ * the copies of recvCommand(), catchAlarm() and handshake() that
+ * each client used to carry.  Instead of an alarm() interrupting a
+ * blocking recv(), the socket is non-blocking and each operation
+ * waits in poll() until its deadline passes.
+ *
+ * Messages from the servers are not framed; a sensor string is just
+ * whatever one send() put on the wire.  ctRecv() therefore keeps
+ * reading until the client's isComplete() function finds a whole
+ * message at the front of what has arrived (or, without one, until
+ * nothing more is waiting).  Anything after that message is kept for
+ * the next ctRecv(), since the unit test server sends each sensing
+ * before it is asked for and so may already have sent the next one.
+ *
+ * An in-process environment is treated like a server that answers
+ * instantly: each command sent is handed straight to the environment
+ * and its reply queued until ctRecv() collects it.
+ *
+ * A recording is replayed the same way, except that the replies come
+ * from the recording whatever the commands, and each command is
+ * checked against the one recorded in its place.
+ */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <netinet/tcp.h>
+
+#include "communication.h"
+#include "clientTransport.h"
+
+// ************************************************************************
+// HELPERS
+// ************************************************************************
+
+/**
+ * ctNow
+ *
+ * @param[out] ts filled in with the current monotonic time.
+ */
+static void ctNow(struct timespec * ts)
+{
+  clock_gettime(CLOCK_MONOTONIC, ts);
+}
+
+/**
+ * ctElapsedUsec
+ *
+ * @returns the number of microseconds from start to end.
+ */
+static double ctElapsedUsec(struct timespec * start, struct timespec * end)
+{
+  return (end->tv_sec - start->tv_sec) * 1000000.0
+    + (end->tv_nsec - start->tv_nsec) / 1000.0;
+}
+
+/**
+ * ctRemainingMs
+ *
+ * @returns the number of milliseconds left until deadline, or 0 if
+ * it has passed.
+ */
+static int ctRemainingMs(struct timespec * deadline)
+{
+  struct timespec now;
+  double usec;
+
+  ctNow(&now);
+  usec = ctElapsedUsec(&now, deadline);
+
+  if(usec <= 0) return 0;
+
+  // Round up so that poll() does not wake a hair early and spin.
+  return (int)((usec + 999) / 1000);
+}
+
+/**
+ * ctSetDeadline
+ *
+ * @param[out] deadline set to timeoutMs milliseconds from now.
+ */
+static void ctSetDeadline(struct timespec * deadline, int timeoutMs)
+{
+  ctNow(deadline);
+  deadline->tv_sec += timeoutMs / 1000;
+  deadline->tv_nsec += (timeoutMs % 1000) * 1000000L;
+  if(deadline->tv_nsec >= 1000000000L)
+    {
+      deadline->tv_sec++;
+      deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+/**
+ * ctRecordLatency
+ *
+ * Add a round trip of usec microseconds to the histogram in ct.
+ */
+static void ctRecordLatency(clientTransport * ct, double usec)
+{
+  int bucket = 0;
+  double limit = 2.0;
+
+  while(usec >= limit && bucket < CT_NUM_BUCKETS - 1)
+    {
+      limit *= 2;
+      bucket++;
+    }
+
+  ct->hist[bucket]++;
+  ct->count++;
+  ct->totalUsec += usec;
+  if(usec > ct->maxUsec) ct->maxUsec = usec;
+}
+
+/**
+ * ctPercentile
+ *
+ * @returns an upper bound, in microseconds, on the given fraction
+ * (e.g. 0.99) of the round trips recorded in ct.
+ */
+static double ctPercentile(clientTransport * ct, double fraction)
+{
+  unsigned long seen = 0;
+  double limit = 2.0;
+  int i;
+
+  for(i = 0; i < CT_NUM_BUCKETS; i++, limit *= 2)
+    {
+      seen += ct->hist[i];
+      if(seen >= fraction * ct->count)
+	{
+	  // The histogram only knows the bucket; don't claim more
+	  // than was ever seen.
+	  return (limit < ct->maxUsec ? limit : ct->maxUsec);
+	}
+    }
+
+  return ct->maxUsec;
+}
+
+/**
+ * ctInProcessSend
+ *
+ * Hand cmd to the in-process environment and queue its reply.
+ *
+ * @returns CT_SUCCESS, CT_QUEUE_FULL if the client has let too many
+ * replies go unread, or CT_NO_ENVIRONMENT if the environment gave no
+ * reply.
+ */
+static int ctInProcessSend(clientTransport * ct, int cmd)
+{
+  char * reply;
+
+  if(ct->numPending == CT_QUEUE_SIZE) return CT_QUEUE_FULL;
+
+  if((reply = ct->environment(cmd, 0)) == NULL) return CT_NO_ENVIRONMENT;
+
+  ct->pending[(ct->head + ct->numPending) % CT_QUEUE_SIZE] = reply;
+  ct->numPending++;
+
+  return CT_SUCCESS;
+}
+
+/**
+ * ctInProcessRecv
+ *
+ * Take the oldest reply of the in-process environment.  There is
+ * nothing to wait for; if no reply is queued the environment is
+ * prodded with CMD_NO_OP just as a silent server would be.
+ *
+ * @returns the length of the message copied into buf, or the error
+ * from ctInProcessSend().
+ */
+static int ctInProcessRecv(clientTransport * ct, char * buf, int size)
+{
+  int status;
+  char * reply;
+
+  if(ct->numPending == 0)
+    {
+      printf("timed out, prodding environment...\n");
+      if((status = ctInProcessSend(ct, CMD_NO_OP)) != CT_SUCCESS) return status;
+    }
+
+  reply = ct->pending[ct->head];
+  ct->head = (ct->head + 1) % CT_QUEUE_SIZE;
+  ct->numPending--;
+
+  strncpy(buf, reply, size - 1);
+  buf[size - 1] = '\0';
+  free(reply);
+
+  return strlen(buf);
+}
+
+// ************************************************************************
+// RECORD AND REPLAY
+// ************************************************************************
+
+/**
+ * ctRecordWrite
+ *
+ * Append a record to the recording: its type, the microseconds since
+ * the record before, and the body.
+ */
+static void ctRecordWrite(clientTransport * ct, int type, char * body, int len)
+{
+  unsigned char head[5];
+  struct timespec now;
+  unsigned long usec;
+
+  ctNow(&now);
+  usec = (unsigned long) ctElapsedUsec(&ct->recordedAt, &now);
+  ct->recordedAt = now;
+
+  head[0] = type;
+  head[1] = usec & 0xFF;
+  head[2] = (usec >> 8) & 0xFF;
+  head[3] = (usec >> 16) & 0xFF;
+  head[4] = (usec >> 24) & 0xFF;
+
+  fwrite(head, 1, sizeof(head), ct->record);
+  fwrite(body, 1, len, ct->record);
+}
+
+/**
+ * ctGetNumber
+ *
+ * @returns the little endian number of size bytes at p.
+ */
+static unsigned long ctGetNumber(unsigned char * p, int size)
+{
+  unsigned long n = 0;
+
+  while(size-- > 0)
+    {
+      n = (n << 8) | p[size];
+    }
+
+  return n;
+}
+
+/**
+ * ctReplayDiffer
+ *
+ * Note that the client sent chosen where recorded was sent, either
+ * of which may be -1 for no command at all.  The first difference is
+ * reported as it happens.
+ */
+static void ctReplayDiffer(clientTransport * ct, int recorded, int chosen)
+{
+  if(ct->differences++ > 0) return;
+
+  ct->divergedAt = ct->sensings;
+  ct->recordedCmd = recorded;
+  ct->chosenCmd = chosen;
+
+  printf("replay: diverged after sensing %lu: recorded command %d, chose %d\n",
+	 ct->divergedAt, recorded, chosen);
+}
+
+/**
+ * ctReplayNext
+ *
+ * Step past the record at ct->replayAt, moving the recorded clock on.
+ *
+ * @returns the offset of the body of the record stepped past.
+ */
+static int ctReplayNext(clientTransport * ct)
+{
+  unsigned char * r = ct->replay + ct->replayAt;
+  int body = ct->replayAt + 5;
+
+  ct->replayUsec += ctGetNumber(r + 1, 4);
+  ct->replayAt = body + (r[0] == CT_RECORD_SENSING ? 2 + ctGetNumber(r + 5, 2) : 1);
+
+  return body;
+}
+
+/**
+ * ctReplaySend
+ *
+ * Check cmd against the command recorded next.
+ *
+ * @returns CT_SUCCESS; a replay takes any command.
+ */
+static int ctReplaySend(clientTransport * ct, int cmd)
+{
+  struct timespec now;
+  int recorded = -1;
+
+  if(ct->replayAt < ct->replayLength
+     && ct->replay[ct->replayAt] == CT_RECORD_COMMAND)
+    {
+      recorded = ct->replay[ctReplayNext(ct)];
+    }
+
+  if(recorded != cmd) ctReplayDiffer(ct, recorded, cmd);
+  ct->commands++;
+
+  // Time how long the client took to decide on the first command
+  // after each sensing.
+  if(ct->deciding)
+    {
+      ctNow(&now);
+      ct->decideUsec += ctElapsedUsec(&ct->deliveredAt, &now);
+      ct->decisions++;
+      ct->deciding = 0;
+    }
+
+  return CT_SUCCESS;
+}
+
+/**
+ * ctReplayRecv
+ *
+ * Deliver the next recorded sensing.  Any recorded command the
+ * client didn't send first counts as a difference.  In real time the
+ * sensing isn't delivered until as long after the first as it was
+ * recorded.
+ *
+ * @returns the length of the sensing copied into buf, or CT_CLOSED
+ * once the recording runs out, after printing what the replay found.
+ */
+static int ctReplayRecv(clientTransport * ct, char * buf, int size)
+{
+  struct timespec due;
+  double usec;
+  int body;
+  int len;
+
+  while(ct->replayAt < ct->replayLength
+	&& ct->replay[ct->replayAt] == CT_RECORD_COMMAND)
+    {
+      ctReplayDiffer(ct, ct->replay[ctReplayNext(ct)], -1);
+    }
+
+  if(ct->replayAt >= ct->replayLength)
+    {
+      ctPrintReplay(ct, stdout);
+      return CT_CLOSED;
+    }
+
+  body = ctReplayNext(ct);
+  len = ctGetNumber(ct->replay + body, 2);
+
+  if(ct->sensings == 0)
+    {
+      ctNow(&ct->replayStart);
+      ct->firstUsec = ct->replayUsec;
+    }
+  else if(ct->realTime)
+    {
+      usec = ct->replayUsec - ct->firstUsec;
+      due = ct->replayStart;
+      due.tv_sec += (time_t)(usec / 1000000);
+      due.tv_nsec += (long)((usec - (time_t)(usec / 1000000) * 1000000.0) * 1000);
+      if(due.tv_nsec >= 1000000000L)
+	{
+	  due.tv_sec++;
+	  due.tv_nsec -= 1000000000L;
+	}
+      while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR);
+    }
+
+  if(len > size - 1) len = size - 1;
+  memcpy(buf, ct->replay + body + 2, len);
+  buf[len] = '\0';
+
+  ct->sensings++;
+  ctNow(&ct->deliveredAt);
+  ct->deciding = 1;
+
+  return len;
+}
+
+/**
+ * ctRecord
+ *
+ * Record everything received and sent from now on to the file at
+ * path.  Call it after connecting and before ctHandshake().  The
+ * recording carries ct->seed; if it is 0, e.g. for a live run, a
+ * seed is made from the clock.  The client should seed rand() with
+ * ct->seed afterwards so that the run can be replayed exactly.
+ *
+ * @param[in/out] ct a connected transport.
+ * @param[in] path the file to record to.
+ *
+ * @returns CT_SUCCESS, CT_NULL_CT or CT_CANNOT_RECORD.
+ */
+int ctRecord(clientTransport * ct, char * path)
+{
+  unsigned char header[CT_RECORD_HEADER_SIZE];
+
+  if(ct == NULL) return CT_NULL_CT;
+
+  if((ct->record = fopen(path, "wb")) == NULL)
+    {
+      perror(path);
+      return CT_CANNOT_RECORD;
+    }
+
+  if(ct->seed == 0)
+    {
+      ct->seed = (unsigned int) time(NULL);
+      if(ct->seed == 0) ct->seed = 1;
+    }
+
+  memcpy(header, CT_RECORD_MAGIC, 4);
+  header[4] = CT_RECORD_VERSION;
+  header[5] = ct->seed & 0xFF;
+  header[6] = (ct->seed >> 8) & 0xFF;
+  header[7] = (ct->seed >> 16) & 0xFF;
+  header[8] = (ct->seed >> 24) & 0xFF;
+  fwrite(header, 1, sizeof(header), ct->record);
+
+  ctNow(&ct->recordedAt);
+
+  return CT_SUCCESS;
+}
+
+/**
+ * ctConnectReplay
+ *
+ * "Connect" to a recording made by ctRecord().  The client receives
+ * the recorded sensings in order, as fast as it takes them or, with
+ * realTime, as far apart as they were recorded.  The commands it
+ * sends are compared with the recorded ones, and the first to differ
+ * is reported.  The client should seed rand() with ct->seed.
+ *
+ * The client must be run as it was recorded (e.g. with the same -c
+ * and -m options) for the handshake to line up.
+ *
+ * @param[in/out] ct an initialized transport.
+ * @param[in] path the recording.
+ * @param[in] realTime nonzero to replay in real time.
+ *
+ * @returns CT_SUCCESS, CT_NULL_CT, CT_CANNOT_RECORD if the file can't
+ * be read, or CT_BAD_RECORDING if it isn't a whole recording.
+ */
+int ctConnectReplay(clientTransport * ct, char * path, int realTime)
+{
+  FILE * f;
+  long size;
+  int at;
+
+  if(ct == NULL) return CT_NULL_CT;
+
+  if((f = fopen(path, "rb")) == NULL)
+    {
+      perror(path);
+      return CT_CANNOT_RECORD;
+    }
+
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  rewind(f);
+
+  ct->replay = (unsigned char *) malloc(size > 0 ? size : 1);
+  if(ct->replay == NULL || fread(ct->replay, 1, size, f) != size)
+    {
+      fclose(f);
+      return CT_CANNOT_RECORD;
+    }
+  fclose(f);
+
+  if(size < CT_RECORD_HEADER_SIZE
+     || memcmp(ct->replay, CT_RECORD_MAGIC, 4) != 0
+     || ct->replay[4] != CT_RECORD_VERSION)
+    {
+      return CT_BAD_RECORDING;
+    }
+
+  // Check that every record is whole before starting.
+  for(at = CT_RECORD_HEADER_SIZE; at < size; )
+    {
+      if(at + 6 > size) return CT_BAD_RECORDING;
+      if(ct->replay[at] == CT_RECORD_COMMAND)
+	{
+	  at += 6;
+	}
+      else if(ct->replay[at] == CT_RECORD_SENSING && at + 7 <= size)
+	{
+	  at += 7 + ctGetNumber(ct->replay + at + 5, 2);
+	}
+      else
+	{
+	  return CT_BAD_RECORDING;
+	}
+    }
+  if(at != size) return CT_BAD_RECORDING;
+
+  ct->type = CT_REPLAY;
+  ct->seed = ctGetNumber(ct->replay + 5, 4);
+  ct->replayLength = size;
+  ct->replayAt = CT_RECORD_HEADER_SIZE;
+  ct->realTime = realTime;
+  ct->recordedCmd = ct->chosenCmd = -1;
+
+  printf("client: replaying %s%s\n", path, (realTime ? " in real time" : ""));
+
+  return CT_SUCCESS;
+}
+
+// ************************************************************************
+// CONNECTION
+// ************************************************************************
+
+/**
+ * ctInit
+ *
+ * Set ct to an unconnected transport with the default deadlines and
+ * an empty latency histogram.
+ *
+ * @param[out] ct the transport to initialize.
+ */
+void ctInit(clientTransport * ct)
+{
+  if(ct == NULL) return;
+
+  memset(ct, 0, sizeof(clientTransport));
+  ct->fd = -1;
+  ct->timeoutMs = CT_DEFAULT_TIMEOUT_MS;
+  ct->maxTries = CT_DEFAULT_MAX_TRIES;
+  ct->isComplete = NULL;
+  ct->type = CT_SOCKET;
+}
+
+/**
+ * ctConnect
+ *
+ * Connect to port on host.  Each address getaddrinfo() returns for
+ * host is tried in turn with a non-blocking connect() that may take
+ * no longer than ct->timeoutMs.  The connected socket is left
+ * non-blocking and has TCP_NODELAY set, since every message in this
+ * protocol is small and latency matters more than packing.
+ *
+ * @param[in/out] ct an initialized transport.
+ * @param[in] host the name or IP of the server.
+ * @param[in] port the port of the server, e.g. PORT.
+ *
+ * @returns CT_SUCCESS, CT_NULL_CT, CT_CANNOT_GET_ADDRESS, or
+ * CT_CONNECT_FAILURE if no address could be connected to.
+ */
+int ctConnect(clientTransport * ct, char * host, char * port)
+{
+  struct addrinfo hints, *servinfo, *p;
+  char s[INET6_ADDRSTRLEN];
+  int rv;
+  int sockfd = -1;
+  int yes = 1;
+
+  if(ct == NULL) return CT_NULL_CT;
+
+  memset(&hints, 0, sizeof hints);
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+
+  if ((rv = getaddrinfo(host, port, &hints, &servinfo)) != 0) {
+    fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(rv));
+    return CT_CANNOT_GET_ADDRESS;
+  }
+
+  // loop through all the results and connect to the first we can
+  for(p = servinfo; p != NULL; p = p->ai_next) {
+    if ((sockfd = socket(p->ai_family, p->ai_socktype, p->ai_protocol)) == -1) {
+      perror("client: socket");
+      continue;
+    }
+
+    fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL, 0) | O_NONBLOCK);
+
+    if (connect(sockfd, p->ai_addr, p->ai_addrlen) == -1) {
+      struct pollfd pfd;
+      int err = 0;
+      socklen_t len = sizeof(err);
+
+      if(errno != EINPROGRESS) {
+	perror("client: connect");
+	close(sockfd);
+	continue;
+      }
+
+      // Wait for the connection to complete or fail.
+      pfd.fd = sockfd;
+      pfd.events = POLLOUT;
+      if(poll(&pfd, 1, ct->timeoutMs) != 1
+	 || getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &err, &len) == -1
+	 || err != 0) {
+	fprintf(stderr, "client: connect: %s\n", (err ? strerror(err) : "timed out"));
+	close(sockfd);
+	continue;
+      }
+    }
+
+    break;
+  }
+
+  if (p == NULL) {
+    fprintf(stderr, "client: failed to connect\n");
+    freeaddrinfo(servinfo);
+    return CT_CONNECT_FAILURE;
+  }
+
+  if(setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes)) == -1) {
+    perror("client: TCP_NODELAY");
+  }
+
+  inet_ntop(p->ai_family, get_in_addr((struct sockaddr *)p->ai_addr), s, sizeof s);
+  printf("client: connecting to %s\n", s);
+
+  freeaddrinfo(servinfo); // all done with this structure
+
+  ct->fd = sockfd;
+
+  return CT_SUCCESS;
+}
+
+/**
+ * ctConnectInProcess
+ *
+ * "Connect" to an environment linked into this process.  Like the
+ * unit test and eaters servers, the environment is immediately asked
+ * for a first sensing (as if it had been sent CMD_NO_OP) so that
+ * there is one waiting for the client's first ctRecv().
+ *
+ * The environment must already be initialized (e.g. loadMap() or
+ * initWorld()).
+ *
+ * @param[in/out] ct an initialized transport.
+ * @param[in] environment the environment's entry point.
+ *
+ * @returns CT_SUCCESS, CT_NULL_CT, or CT_NO_ENVIRONMENT if
+ * environment is NULL or doesn't give a first sensing.
+ */
+int ctConnectInProcess(clientTransport * ct, ctEnvironmentFn environment)
+{
+  if(ct == NULL) return CT_NULL_CT;
+  if(environment == NULL) return CT_NO_ENVIRONMENT;
+
+  ct->type = CT_IN_PROCESS;
+  ct->environment = environment;
+
+  if(ctInProcessSend(ct, CMD_NO_OP) != CT_SUCCESS) return CT_NO_ENVIRONMENT;
+
+  printf("client: connecting to in-process environment\n");
+
+  return CT_SUCCESS;
+}
+
+/**
+ * ctHandshake
+ *
+ * Get the server ready for the send/recv loop.  The Roomba greets
+ * the client with a poem and expects a CMD_NO_OP in reply, or
+ * ssBinary if the client wants its sensings as records (see
+ * SENSOR_RECORD_SIZE) rather than strings.  The simulated
+ * environments expect nothing, though some clients send them a first
+ * command (e.g. CMD_BLINK to put the unit test in stats mode).
+ *
+ * @param[in] ct a connected transport.
+ * @param[in] connectToRoomba nonzero if the server is the Roomba.
+ * @param[in] firstCmd the command to send a simulated environment,
+ * or CMD_ILLEGAL to send nothing.  ssBinary asks the Roomba for
+ * records, and from then on a message is complete once a whole record
+ * has arrived.  Otherwise the Roomba's strings are taken as they come.
+ *
+ * @returns CT_SUCCESS, CT_NO_BINARY if ssBinary was asked of a
+ * simulated environment, or the error from ctRecv() or ctSend().
+ */
+int ctHandshake(clientTransport * ct, int connectToRoomba, int firstCmd)
+{
+  char buf[MAXDATASIZE];
+  int numbytes;
+  int status = CT_SUCCESS;
+
+  if(ct == NULL) return CT_NULL_CT;
+
+  if(connectToRoomba)
+    {
+      // Receive initial poem from Roomba upon connection.  Neither it
+      // nor the Roomba's sensor strings, which end in a time of day,
+      // are of a fixed length, so take whatever has arrived.
+      ct->isComplete = NULL;
+      if((numbytes = ctRecv(ct, buf, MAXDATASIZE)) < 0) return numbytes;
+
+      // Print poem and length of poem
+      printf("Poem: %s", buf);
+      printf("numbytes: %d\n", numbytes);
+
+      // Send a first command to finish initializing the send/receive
+      // sequence
+      if(firstCmd == ssBinary)
+	{
+	  ct->isComplete = ctCompleteSensorRecord;
+	  status = ctSend(ct, ssBinary);
+	}
+      else
+	{
+	  status = ctSend(ct, CMD_NO_OP);
+	}
+    }
+  else if(firstCmd == ssBinary)
+    {
+      return CT_NO_BINARY;
+    }
+  else if(firstCmd != CMD_ILLEGAL)
+    {
+      status = ctSend(ct, firstCmd);
+    }
+
+  // Neither of these is a round trip worth timing.
+  ct->awaitingReply = 0;
+
+  return (status < 0 ? status : CT_SUCCESS);
+}
+
+/**
+ * ctClose
+ *
+ * Close the connection, if any.
+ */
+void ctClose(clientTransport * ct)
+{
+  if(ct == NULL) return;
+
+  if(ct->record != NULL)
+    {
+      fclose(ct->record);
+      ct->record = NULL;
+    }
+
+  if(ct->type == CT_REPLAY)
+    {
+      if(!ct->reported) ctPrintReplay(ct, stdout);
+      free(ct->replay);
+      ct->replay = NULL;
+      return;
+    }
+
+  if(ct->type == CT_IN_PROCESS)
+    {
+      // Throw away unread replies and let the environment clean up,
+      // as the servers do when their client goes away.
+      while(ct->numPending > 0)
+	{
+	  free(ct->pending[ct->head]);
+	  ct->head = (ct->head + 1) % CT_QUEUE_SIZE;
+	  ct->numPending--;
+	}
+      if(ct->environment != NULL) ct->environment(CMD_NO_OP, 1);
+      ct->environment = NULL;
+      return;
+    }
+
+  if(ct->fd == -1) return;
+
+  close(ct->fd);
+  ct->fd = -1;
+}
+
+// ************************************************************************
+// SEND AND RECEIVE
+// ************************************************************************
+
+/**
+ * ctSocketSend
+ *
+ * Send a one byte command over the socket.
+ *
+ * @returns CT_SUCCESS, CT_TIMEOUT if the socket could not take the
+ * byte before the deadline, or CT_SEND_FAILURE.
+ */
+static int ctSocketSend(clientTransport * ct, int cmd)
+{
+  unsigned char byte = (unsigned char) cmd;
+  struct pollfd pfd;
+  int result;
+
+  pfd.fd = ct->fd;
+  pfd.events = POLLOUT;
+
+  while((result = send(ct->fd, &byte, 1, MSG_NOSIGNAL)) != 1)
+    {
+      if(result == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+	{
+	  return CT_SEND_FAILURE;
+	}
+
+      // The socket buffer is full.  Wait for room.
+      if(poll(&pfd, 1, ct->timeoutMs) == 0) return CT_TIMEOUT;
+    }
+
+  return CT_SUCCESS;
+}
+
+/**
+ * ctSend
+ *
+ * Send a one byte command to the environment and start timing the
+ * round trip that ends when the resulting sensing has been received.
+ *
+ * @param[in] ct a connected transport.
+ * @param[in] cmd the command to send.
+ *
+ * @returns the number of bytes sent (1), or the error from
+ * ctSocketSend() or ctInProcessSend().
+ */
+int ctSend(clientTransport * ct, int cmd)
+{
+  int status;
+
+  if(ct == NULL) return CT_NULL_CT;
+
+  ctNow(&ct->sentAt);
+
+  switch(ct->type)
+    {
+    case CT_IN_PROCESS:
+      status = ctInProcessSend(ct, cmd);
+      break;
+    case CT_REPLAY:
+      status = ctReplaySend(ct, cmd);
+      break;
+    case CT_SOCKET:
+    default:
+      status = ctSocketSend(ct, cmd);
+      break;
+    }
+
+  if(status != CT_SUCCESS) return status;
+
+  if(ct->record != NULL)
+    {
+      char byte = (char) cmd;
+      ctRecordWrite(ct, CT_RECORD_COMMAND, &byte, 1);
+    }
+
+  ct->awaitingReply = 1;
+
+  return 1;
+}
+
+/**
+ * ctTakeMessage
+ *
+ * If the len bytes in buf begin with a whole message, keep whatever
+ * follows it for the next ctSocketRecv().
+ *
+ * @returns the length of the message, or 0 if it isn't whole yet.
+ */
+static int ctTakeMessage(clientTransport * ct, char * buf, int len)
+{
+  int msgLen = ct->isComplete(buf, len);
+  int extra;
+
+  if(msgLen <= 0) return 0;
+  if(msgLen > len) msgLen = len;
+
+  // Whatever is left from before came after these bytes.
+  extra = len - msgLen;
+  if(extra > CT_SURPLUS_SIZE - ct->surplusLen)
+    {
+      extra = CT_SURPLUS_SIZE - ct->surplusLen;
+    }
+  memmove(ct->surplus + extra, ct->surplus, ct->surplusLen);
+  memcpy(ct->surplus, buf + msgLen, extra);
+  ct->surplusLen += extra;
+
+  return msgLen;
+}
+
+/**
+ * ctSocketRecv
+ *
+ * Receive one message from the socket into buf and null-terminate
+ * it.  If no message arrives before the deadline a CMD_NO_OP is sent
+ * to prod the server and the deadline is reset, up to ct->maxTries
+ * times.  Pieces of a message are reassembled until ct->isComplete
+ * says the message is whole, starting with any bytes left over from
+ * the last message.
+ *
+ * @returns the length of the message, or CT_TIMEOUT, CT_CLOSED,
+ * CT_RECV_FAILURE or CT_POLL_FAILURE.
+ */
+static int ctSocketRecv(clientTransport * ct, char * buf, int size)
+{
+  struct timespec deadline;
+  struct pollfd pfd;
+  int len = 0;
+  int tries = 0;
+  int numbytes;
+  int ready;
+  int msgLen;
+
+  // Start with what arrived after the last message.
+  len = (ct->surplusLen < size - 1 ? ct->surplusLen : size - 1);
+  memcpy(buf, ct->surplus, len);
+  memmove(ct->surplus, ct->surplus + len, ct->surplusLen - len);
+  ct->surplusLen -= len;
+  buf[len] = '\0';
+
+  if(len > 0 && ct->isComplete != NULL
+     && (msgLen = ctTakeMessage(ct, buf, len)) > 0)
+    {
+      buf[msgLen] = '\0';
+      return msgLen;
+    }
+
+  pfd.fd = ct->fd;
+  pfd.events = POLLIN;
+
+  ctSetDeadline(&deadline, ct->timeoutMs);
+
+  while(len < size - 1)
+    {
+      int remaining = ctRemainingMs(&deadline);
+
+      if(remaining == 0)
+	{
+	  // Better part of a message than none at all.
+	  if(len > 0) break;
+
+	  if(++tries > ct->maxTries)
+	    {
+	      fprintf(stderr, "Timed out on receive\n");
+	      return CT_TIMEOUT;
+	    }
+
+	  // Timed out and have more tries.  Prod the server with a
+	  // CMD_NO_OP.
+	  printf("timed out, %d more tries...\n", ct->maxTries - tries + 1);
+	  if(ctSocketSend(ct, CMD_NO_OP) != CT_SUCCESS)
+	    {
+	      perror("Error sending CMD_NO_OP on retry\n");
+	    }
+
+	  ctSetDeadline(&deadline, ct->timeoutMs);
+	  continue;
+	}
+
+      if((ready = poll(&pfd, 1, remaining)) == -1)
+	{
+	  if(errno == EINTR) continue;
+	  return CT_POLL_FAILURE;
+	}
+
+      if(ready == 0) continue;
+
+      numbytes = recv(ct->fd, buf + len, size - 1 - len, 0);
+      if(numbytes == 0)
+	{
+	  return CT_CLOSED;
+	}
+      if(numbytes == -1)
+	{
+	  if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
+	  return CT_RECV_FAILURE;
+	}
+
+      len += numbytes;
+      buf[len] = '\0';
+
+      if(ct->isComplete != NULL)
+	{
+	  if((msgLen = ctTakeMessage(ct, buf, len)) > 0)
+	    {
+	      len = msgLen;
+	      break;
+	    }
+	}
+      else
+	{
+	  // Without a way to recognize the end of a message, take
+	  // whatever else is already waiting and stop there.
+	  while(len < size - 1
+		&& (numbytes = recv(ct->fd, buf + len, size - 1 - len, 0)) > 0)
+	    {
+	      len += numbytes;
+	    }
+	  break;
+	}
+    }
+
+  buf[len] = '\0';
+
+  return len;
+}
+
+/**
+ * ctRecv
+ *
+ * Receive one message (usually a sensor string) from the environment
+ * into buf and null-terminate it.  If a command was sent since the
+ * last message, the round trip is added to the latency histogram.
+ *
+ * @param[in] ct a connected transport.
+ * @param[out] buf where to put the message.
+ * @param[in] size the size of buf.
+ *
+ * @returns the length of the message, or the error from
+ * ctSocketRecv() or ctInProcessRecv().
+ */
+int ctRecv(clientTransport * ct, char * buf, int size)
+{
+  struct timespec now;
+  int len;
+
+  if(ct == NULL) return CT_NULL_CT;
+
+  switch(ct->type)
+    {
+    case CT_IN_PROCESS:
+      len = ctInProcessRecv(ct, buf, size);
+      break;
+    case CT_REPLAY:
+      len = ctReplayRecv(ct, buf, size);
+      break;
+    case CT_SOCKET:
+    default:
+      len = ctSocketRecv(ct, buf, size);
+      break;
+    }
+
+  if(len >= 0 && ct->record != NULL)
+    {
+      char body[2 + MAXDATASIZE];
+      int n = (len < MAXDATASIZE ? len : MAXDATASIZE);
+
+      body[0] = n & 0xFF;
+      body[1] = (n >> 8) & 0xFF;
+      memcpy(body + 2, buf, n);
+      ctRecordWrite(ct, CT_RECORD_SENSING, body, 2 + n);
+    }
+
+  if(len >= 0 && ct->awaitingReply)
+    {
+      ctNow(&now);
+      ctRecordLatency(ct, ctElapsedUsec(&ct->sentAt, &now));
+      ct->awaitingReply = 0;
+    }
+
+  return len;
+}
+
+/**
+ * ctCompleteSensorString
+ *
+ * An isComplete function for the unit test environment.  A sensor
+ * string is complete once everything up to its abort flag has
+ * arrived, so that none of it is left to be read as the next sensing.
+ */
+int ctCompleteSensorString(char * buf, int len)
+{
+  return (len >= SENSOR_STRING_SIZE ? SENSOR_STRING_SIZE : 0);
+}
+
+/**
+ * ctCompleteSensorRecord
+ *
+ * An isComplete function for the Roomba in binary mode.  A record is
+ * complete once all SENSOR_RECORD_SIZE bytes have arrived.
+ */
+int ctCompleteSensorRecord(char * buf, int len)
+{
+  return (len >= SENSOR_RECORD_SIZE ? SENSOR_RECORD_SIZE : 0);
+}
+
+/**
+ * ctCompleteWMEString
+ *
+ * An isComplete function for the eaters environment.  Its state
+ * strings are lists of ":name,type,value" triples that end in a ':'.
+ * The reply to CMD_EATERS_RESET is the one exception.  Nothing marks
+ * where one state string ends and the next begins, so all that has
+ * arrived is taken as one.
+ */
+int ctCompleteWMEString(char * buf, int len)
+{
+  if((buf[len - 1] == ':') || (strcmp(buf, "Reset: Success") == 0))
+    {
+      return len;
+    }
+
+  return 0;
+}
+
+// ************************************************************************
+// STATISTICS
+// ************************************************************************
+
+/**
+ * ctPrintLatency
+ *
+ * Print a summary of the round trip latencies recorded by ct,
+ * including the tail, followed by the non-empty histogram buckets.
+ *
+ * @param[in] ct the transport.
+ * @param[in] out where to print (e.g. stdout or the client's log).
+ */
+void ctPrintLatency(clientTransport * ct, FILE * out)
+{
+  double limit = 1.0;
+  int i;
+
+  if(ct == NULL || out == NULL) return;
+
+  if(ct->count == 0)
+    {
+      fprintf(out, "Round trips: none\n");
+      return;
+    }
+
+  fprintf(out, "Round trips: %lu  mean %.0f us  p50 <%.0f us  p90 <%.0f us  p99 <%.0f us  max %.0f us\n",
+	  ct->count, ct->totalUsec / ct->count,
+	  ctPercentile(ct, 0.50), ctPercentile(ct, 0.90), ctPercentile(ct, 0.99),
+	  ct->maxUsec);
+
+  for(i = 0; i < CT_NUM_BUCKETS; i++, limit *= 2)
+    {
+      if(ct->hist[i] > 0)
+	{
+	  fprintf(out, "  %10.0f us +: %lu\n", (i == 0 ? 0 : limit), ct->hist[i]);
+	}
+    }
+
+  fflush(out);
+}
+
+/**
+ * ctPrintReplay
+ *
+ * Print how fast a replay went and whether the client chose the same
+ * commands as were recorded.  Called when the recording runs out or
+ * the transport is closed, whichever is first.
+ *
+ * @param[in] ct a transport connected with ctConnectReplay().
+ * @param[in] out where to print.
+ */
+void ctPrintReplay(clientTransport * ct, FILE * out)
+{
+  struct timespec now;
+  double secs;
+
+  if(ct == NULL || out == NULL || ct->type != CT_REPLAY) return;
+
+  ct->reported = 1;
+  ctNow(&now);
+  secs = (ct->sensings > 0 ? ctElapsedUsec(&ct->replayStart, &now) / 1000000.0 : 0.0);
+
+  fprintf(out, "Replay: %lu sensings, %lu commands in %.3f s (%.0f sensings/s), %.1f us per decision\n",
+	  ct->sensings, ct->commands, secs,
+	  (secs > 0 ? ct->sensings / secs : 0.0),
+	  (ct->decisions > 0 ? ct->decideUsec / ct->decisions : 0.0));
+
+  if(ct->differences == 0)
+    {
+      fprintf(out, "Replay: every command matches the recording\n");
+    }
+  else
+    {
+      fprintf(out, "Replay: %lu commands differ, the first after sensing %lu (recorded %d, chose %d)\n",
+	      ct->differences, ct->divergedAt, ct->recordedCmd, ct->chosenCmd);
+    }
+
+  fflush(out);
+}
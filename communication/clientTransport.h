@@ -0,0 +1,160 @@
+/**
+ * clientTransport.h
+ *
+ * The connection between an agent client (supervisorClient,
+ * mccallumClient, soarClient) and the server it is driving, be it the
+ * Roomba or one of the simulated environments.  Every send and
+ * receive is bounded by a deadline enforced with poll(), so no
+ * signals are involved, and every command/sensing round trip is
+ * timed and recorded in a latency histogram.
+ *
+ * The environment may instead be linked into the client itself
+ * (e.g. supervisor/unitTest.c or supervisor/eaters.c) and driven by
+ * direct calls.  The clients can't tell the difference; see
+ * ctConnectInProcess().
+ *
+ * A run can be recorded, every message received and command sent
+ * with the time it happened, and replayed later in place of the
+ * environment; see ctRecord() and ctConnectReplay().  Replaying feeds
+ * the agent the same sensings and reports where, if anywhere, it
+ * chooses a different command than it did when recorded.
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+#ifndef _CLIENT_TRANSPORT_H_
+#define _CLIENT_TRANSPORT_H_
+
+/**
+ *  CONSTANT DEFINITIONS.  All constants in this file should begin
+ *  with 'CT' to indicate their membership in clientTransport.h
+ */
+#define CT_SUCCESS (0)
+#define CT_NULL_CT (-1)
+#define CT_CANNOT_GET_ADDRESS (-2)
+#define CT_CONNECT_FAILURE (-3)
+#define CT_TIMEOUT (-4)
+#define CT_CLOSED (-5)
+#define CT_SEND_FAILURE (-6)
+#define CT_RECV_FAILURE (-7)
+#define CT_POLL_FAILURE (-8)
+#define CT_QUEUE_FULL (-9)
+#define CT_NO_ENVIRONMENT (-10)
+#define CT_CANNOT_RECORD (-11)
+#define CT_BAD_RECORDING (-12)
+#define CT_NO_BINARY (-13)
+
+#define CT_DEFAULT_TIMEOUT_MS 5000  // Deadline for each send or recv
+#define CT_DEFAULT_MAX_TRIES 10     // NO_OPs sent before recv gives up
+
+// Bucket i of the latency histogram counts round trips that took
+// between 2^i and 2^(i+1) microseconds.  The last bucket also counts
+// anything longer.
+#define CT_NUM_BUCKETS 24
+
+// The number of messages an in-process environment may get ahead of
+// the client.  The servers send one sensing upon connection and one
+// per command, so they are never more than a message or two ahead.
+#define CT_QUEUE_SIZE 4
+
+// The most bytes of the next message that may arrive along with a
+// message from a server.
+#define CT_SURPLUS_SIZE 256
+
+// A recording is a header, CT_RECORD_MAGIC, CT_RECORD_VERSION and
+// the 4 byte seed for rand(), followed by records.  Each record is a
+// type byte, the 4 byte number of microseconds since the record
+// before, and then for a sensing its 2 byte length and its bytes,
+// or for a command its 1 byte value.  Numbers are little endian.
+#define CT_RECORD_MAGIC "UPRC"
+#define CT_RECORD_VERSION 1
+#define CT_RECORD_HEADER_SIZE 9
+#define CT_RECORD_SENSING 'S'
+#define CT_RECORD_COMMAND 'C'
+
+// Enumerate the different ways of reaching the environment.
+typedef enum transportTypeTag transportType;
+enum transportTypeTag {
+  CT_SOCKET,          // A server at the other end of a TCP connection.
+  CT_IN_PROCESS,      // An environment linked into this process.
+  CT_REPLAY,          // A recording of an earlier run.
+};
+
+// The entry point of an in-process environment.  Both unitTest() in
+// supervisor/unitTest.c and unitTest() in supervisor/eaters.c fit.
+typedef char * (*ctEnvironmentFn)(int command, int needCleanup);
+
+// A function that decides whether the len bytes in buf begin with a
+// whole message.  It returns the length of that message, or 0 if more
+// must arrive first.  Used to reassemble messages that arrive in
+// pieces and to split those that arrive together.
+typedef int (*ctCompleteFn)(char * buf, int len);
+
+typedef struct clientTransportTag clientTransport;
+struct clientTransportTag {
+  transportType type;            /**< How the environment is reached. */
+  int fd;                        /**< Connected socket, or -1. */
+  int timeoutMs;                 /**< Deadline for each operation. */
+  int maxTries;                  /**< Retries before recv gives up. */
+  ctCompleteFn isComplete;       /**< NULL means any data is a message. */
+  char surplus[CT_SURPLUS_SIZE]; /**< Bytes read past the last message. */
+  int surplusLen;                /**< Number of them. */
+
+  ctEnvironmentFn environment;   /**< The in-process environment. */
+  char * pending[CT_QUEUE_SIZE]; /**< Its replies not yet received. */
+  int head;                      /**< Index of the oldest reply. */
+  int numPending;                /**< Number of replies waiting. */
+
+  struct timespec sentAt;        /**< When the last command was sent. */
+  int awaitingReply;             /**< A round trip is being timed. */
+
+  unsigned long hist[CT_NUM_BUCKETS]; /**< Round trip latency histogram. */
+  unsigned long count;           /**< Number of round trips timed. */
+  double totalUsec;              /**< Sum of all round trips. */
+  double maxUsec;                /**< Longest round trip. */
+
+  unsigned int seed;             /**< Seed for rand() recorded or replayed, or 0. */
+  FILE * record;                 /**< Where this run is recorded, or NULL. */
+  struct timespec recordedAt;    /**< When the last record was written. */
+
+  unsigned char * replay;        /**< The recording being replayed. */
+  int replayLength;              /**< Its length in bytes. */
+  int replayAt;                  /**< Offset of the next record. */
+  int realTime;                  /**< Deliver sensings as far apart as recorded. */
+  double replayUsec;             /**< Recorded time of the record at replayAt. */
+  double firstUsec;              /**< Recorded time of the first sensing. */
+  struct timespec replayStart;   /**< When the first sensing was delivered. */
+  struct timespec deliveredAt;   /**< When the last sensing was delivered. */
+  unsigned long sensings;        /**< Sensings delivered. */
+  unsigned long commands;        /**< Commands sent by the client. */
+  unsigned long differences;     /**< Commands that differ from the recording. */
+  unsigned long divergedAt;      /**< Sensing after which the first differed. */
+  int recordedCmd;               /**< What was recorded there, or -1. */
+  int chosenCmd;                 /**< What the client sent there, or -1. */
+  int deciding;                  /**< No command since the last sensing. */
+  unsigned long decisions;       /**< Sensings that got a command. */
+  double decideUsec;             /**< Time from those sensings to commands. */
+  int reported;                  /**< ctPrintReplay() has been called. */
+};
+
+/**
+ * Function prototypes.  See clientTransport.c for details on
+ * this/these functions.
+ */
+void ctInit(clientTransport * ct);
+int ctConnect(clientTransport * ct, char * host, char * port);
+int ctConnectInProcess(clientTransport * ct, ctEnvironmentFn environment);
+int ctConnectReplay(clientTransport * ct, char * path, int realTime);
+int ctRecord(clientTransport * ct, char * path);
+int ctHandshake(clientTransport * ct, int connectToRoomba, int firstCmd);
+int ctSend(clientTransport * ct, int cmd);
+int ctRecv(clientTransport * ct, char * buf, int size);
+void ctClose(clientTransport * ct);
+void ctPrintLatency(clientTransport * ct, FILE * out);
+void ctPrintReplay(clientTransport * ct, FILE * out);
+int ctCompleteSensorString(char * buf, int len);
+int ctCompleteSensorRecord(char * buf, int len);
+int ctCompleteWMEString(char * buf, int len);
+
+#endif
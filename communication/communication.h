@@ -24,6 +24,9 @@ void sigchld_handler(int s);
 void writeCommandToFile(char* cmd, FILE* fp);
 int checkValue(char v);
 int readSensorDataFromFile(char* data, FILE* fp);
+void packSensorRecord(unsigned char* record, int sensorBits, int now);
+int packSensorString(unsigned char* record, char* data);
+void unpackSensorRecord(unsigned char* record, int* sensorBits, int* now);
 int receiveDataAndStore(int newSock, char* cmdBuf, char* sensData, FILE* cmdFile, FILE* sensorFile, int* fd, caddr_t sensArea, caddr_t cmdArea);
 int createSharedMem(char * deviceName, caddr_t* area);
 int createServer(void);
@@ -50,6 +53,7 @@ int checkArgName(int argc, char* argv[], char addresses[3][13]);
 #define ssNoOp 'o'
 #define ssBlinkLED 'l'
 #define ssSong 'y'
+#define ssBinary 'b'   // In place of the first CMD_NO_OP: send sensings as records (see SENSOR_RECORD_SIZE)
 #define NUM_TOTAL_CMDS 23  // The total number of commands issued to the iRobot (i.e. excluding ssQuit)
 
 #define BACKLOG 10
@@ -127,6 +131,19 @@ int checkArgName(int argc, char* argv[], char addresses[3][13]);
 #define SNSR_BUMP_RIGHT		0x9
 #define NUM_SENSORS		0xA	// Always make sure this is at the end
 
+// In binary mode (ssBinary) a sensing is a record of SENSOR_RECORD_SIZE
+// bytes rather than a string: 2 bytes of sensor bits and then the 4 byte
+// time stamp, each least significant byte first.  The first sensor is the
+// most significant of the NUM_SENSORS bits, as it is the first digit of
+// the string.
+#define SENSOR_RECORD_SIZE	6
+
+// From the unit test environment a sensing is a string of
+// SENSOR_STRING_SIZE characters: the sensor bits, the time stamp padded
+// with spaces, and last the abort flag (see setSensorString()).
+#define SENSOR_STRING_SIZE	23
+#define SENSOR_BIT(bits, i)	(((bits) >> (NUM_SENSORS - 1 - (i))) & 1)
+
 // WME defines: types
 #define WME_INT 0x0
 #define WME_CHAR 0x1
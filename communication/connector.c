@@ -23,78 +23,47 @@
 /**
  * conListenForService
  *
- * Listen for broadcasts of a particular service.
+ * Find the acceptor that this connector should pair with, using the
+ * cached endpoint and multicast discovery in discovery.c.  This used
+ * to block until a broadcast was heard; now it gives up after the
+ * discovery timeout of sh (see servHandlerSetDiscoveryTimeout()).
  *
- * @param[in] type the type of service to listen for.  
+ * Note that if the cached endpoint answers first, the connection is
+ * already established when this call returns: the handler field of
+ * sh is set, and only servActivate() remains to be done.  Otherwise
+ * the rip field of sh is set and conInitiateConnection() should be
+ * called.
+ *
+ * @param[in] type the type of this service endpoint, e.g.
+ * SERV_DATA_SERVICE_COLLECTOR.
  *
  * @param[in] sh the serviceHandler that will be populated as a result
  * of this call.
  *
- * @returns an indication of success or failure.
+ * @param[out] how if not NULL, set to the way the acceptor was found.
+ *
+ * @returns DISC_SUCCESS if an acceptor was found, or an error from
+ * discFindService().
  */
-int conListenForService(serviceType type, serviceHandler * sh)
+int conListenForService(serviceType type, serviceHandler * sh, discMethod * how)
 {
-
-#define MAXBUFLEN 100
-
-  int sockfd;
-  struct addrinfo hints, *servinfo, *p;
-  int rv;
-  int numbytes;
-  struct sockaddr_storage their_addr;
-  char buf[MAXBUFLEN];
-  socklen_t addr_len;
-  char s[INET6_ADDRSTRLEN];
-
   if(sh == NULL)
     return -1;  //TODO: Improve error codes for this call.
 
-  // Create a UDP endpoint of communication for listening for
-  // broadcasted services.
-  int status = servCreateEndpoint(SERV_UDP_LISTENER_ENDPOINT, sh->port, sh);
+  servHandlerSetService(sh, type);
+
+  int status = discFindService(sh, how);
 
 #ifdef DEBUG
   servHandlerPrint(sh);  
 #endif
 
-  if(status != SERV_SUCCESS)
+  if(status != DISC_SUCCESS)
     {
-      printf("Failed to make endpoint.\nStatus of endpoint creation: %d\n", status);
-      return -1;
+      printf("listener: no service found.  Status of discovery: %d\n", status);
     }
 
-  // The subsequent code based on tutorial from Beej, listener.c.
-  // For more details, see: http://beej.us/guide/bgnet/examples/listener.c
-  printf("listener: waiting to recvfrom...\n");
-
-  addr_len = sizeof their_addr;
-  if ((numbytes = recvfrom(sh->bh, buf, MAXBUFLEN-1 , 0,
-                           (struct sockaddr *)&their_addr, &addr_len)) == -1) {
-    perror("recvfrom");
-    exit(1);
-  }
-
-  // Copy their address to the remote IP field of this service handler.
-  strncpy(sh->rip, inet_ntop(their_addr.ss_family, servGetInAddr((struct sockaddr *)&their_addr), s, sizeof s), SERV_MAX_IP_LENGTH);
-  
-  // Assure the stringified IP is null-terminated
-  sh->rip[SERV_MAX_IP_LENGTH - 1] = '\0';
-
-
-  // Print some information for sanity checking.
-  printf("listener: got packet from %s\n", sh->rip);
-  printf("listener: packet is %d bytes long\n", numbytes);
-  buf[numbytes] = '\0';
-  printf("listener: packet contains \"%s\"\n", buf);
-
-
-  // I do not need the broadcast endpoint anymore.  Close it and
-  // update the service handler field to indicate the broadcast
-  // endpoint handler is unset.
-  close(sh->bh);
-  servHandlerSetBroadcastHandle(sh, SERV_HANDLER_NOT_SET);
-  
-  return 0; 
+  return status;
 }
 
 
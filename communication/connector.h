@@ -14,13 +14,14 @@
 #define _CONNECTOR_H_
 
 #include "services.h"
+#include "discovery.h"
 
 
 /**
  * Function prototypes.  See connector.c for details on
  * this/these functions.
  */
-int conListenForService(serviceType type, serviceHandler * sh);
+int conListenForService(serviceType type, serviceHandler * sh, discMethod * how);
 int conInitiateConnection(serviceHandler * sh);
 
 #endif
@@ -0,0 +1,504 @@
+/**
+ * discovery.c
+ *
+ * Service discovery for the UPBOT system.  Before this, acceptors
+ * broadcast their availability ten times, two seconds apart, and
+ * connectors blocked until they heard one of those broadcasts.  A
+ * robot started after the broadcasts stopped, or on a network that
+ * drops broadcasts, never found its service.
+ *
+ * Now an acceptor joins a multicast group and announces itself there,
+ * first quickly and then with exponential backoff, until it has a
+ * connection.  It also answers queries sent to the group right away.
+ * A connector queries the group (again with backoff) and, in
+ * parallel, tries to connect to the endpoint it found last time,
+ * which is remembered in DISC_CACHE_FILE.  A warm robot on an
+ * unchanged network is connected as soon as the TCP handshake
+ * completes, without hearing from anyone.
+ */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "discovery.h"
+#include "services.h"
+
+/**
+ * discNowMs
+ *
+ * @returns a monotonic time in milliseconds.
+ */
+static long discNowMs()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000L + now.tv_nsec / 1000000L;
+}
+
+/**
+ * discPeerType
+ *
+ * @param[in] type a type of service endpoint.
+ *
+ * @returns the type of endpoint that type pairs with, e.g.,
+ * SERV_DATA_SERVICE_AGGREGATOR for SERV_DATA_SERVICE_COLLECTOR.
+ */
+serviceType discPeerType(serviceType type)
+{
+  switch(type) {
+  case SERV_DATA_SERVICE_AGGREGATOR:    return SERV_DATA_SERVICE_COLLECTOR;
+  case SERV_DATA_SERVICE_COLLECTOR:     return SERV_DATA_SERVICE_AGGREGATOR;
+  case SERV_EVENT_RESPONDER_PROGRAMMER: return SERV_EVENT_RESPONDER_ROBOT;
+  case SERV_EVENT_RESPONDER_ROBOT:      return SERV_EVENT_RESPONDER_PROGRAMMER;
+  default:                              return SERV_SERVICE_NOT_SET;
+  }
+}
+
+/**
+ * discMethodName
+ *
+ * @returns a printable name for the way a peer was found.
+ */
+char * discMethodName(discMethod m)
+{
+  switch(m) {
+  case DISC_BY_CACHE:     return "cached endpoint";
+  case DISC_BY_MULTICAST: return "multicast";
+  case DISC_BY_MANUAL_IP: return "manual IP";
+  default:                return "nothing";
+  }
+}
+
+// ************************************************************************
+// THE ENDPOINT CACHE
+// ************************************************************************
+
+/**
+ * discCacheLoad
+ *
+ * Look up the endpoint last used by a service of the given type.
+ *
+ * @param[in] type the type of the local service endpoint.
+ *
+ * @param[out] ip a buffer of at least SERV_MAX_IP_LENGTH characters
+ * that receives the remembered remote IP.
+ *
+ * @returns DISC_SUCCESS if an endpoint was remembered, otherwise
+ * DISC_CACHE_MISS.
+ */
+int discCacheLoad(serviceType type, char * ip)
+{
+  FILE * f;
+  int t;
+  char addr[SERV_MAX_IP_LENGTH];
+  int status = DISC_CACHE_MISS;
+
+  if((f = fopen(DISC_CACHE_FILE, "r")) == NULL) return DISC_CACHE_MISS;
+
+  while(fscanf(f, "%d %29s", &t, addr) == 2)
+    {
+      if(t == type)
+	{
+	  strncpy(ip, addr, SERV_MAX_IP_LENGTH);
+	  ip[SERV_MAX_IP_LENGTH - 1] = '\0';
+	  status = DISC_SUCCESS;
+	}
+    }
+
+  fclose(f);
+  return status;
+}
+
+/**
+ * discCacheSave
+ *
+ * Remember the endpoint used by a service of the given type.  The
+ * entries for other services are kept.  The file is rewritten under
+ * a temporary name and renamed into place so that a robot that loses
+ * power halfway through doesn't lose the whole cache.
+ *
+ * @param[in] type the type of the local service endpoint.
+ * @param[in] ip the remote IP to remember.
+ *
+ * @returns DISC_SUCCESS, or DISC_CACHE_FAILURE if the file could not
+ * be written.
+ */
+int discCacheSave(serviceType type, char * ip)
+{
+  char ips[SERV_NUMBER_OF_SERVICES][SERV_MAX_IP_LENGTH];
+  char tmpName[] = DISC_CACHE_FILE ".tmp";
+  int t;
+
+  for(t = 0; t < SERV_NUMBER_OF_SERVICES; t++)
+    {
+      if(t == type || discCacheLoad(t, ips[t]) != DISC_SUCCESS)
+	ips[t][0] = '\0';
+    }
+
+  strncpy(ips[type], ip, SERV_MAX_IP_LENGTH);
+  ips[type][SERV_MAX_IP_LENGTH - 1] = '\0';  // I don't trust strncpy.
+
+  FILE * f = fopen(tmpName, "w");
+  if(f == NULL) return DISC_CACHE_FAILURE;
+
+  for(t = 0; t < SERV_NUMBER_OF_SERVICES; t++)
+    {
+      if(ips[t][0] != '\0') fprintf(f, "%d %s\n", t, ips[t]);
+    }
+
+  if(fclose(f) != 0 || rename(tmpName, DISC_CACHE_FILE) != 0)
+    return DISC_CACHE_FAILURE;
+
+  return DISC_SUCCESS;
+}
+
+// ************************************************************************
+// THE MULTICAST GROUP
+// ************************************************************************
+
+/**
+ * discOpen
+ *
+ * Create a UDP socket bound to DISC_PORT that has joined DISC_GROUP
+ * on the interface whose IP is in the ip field of sh, and that sends
+ * to the group from that interface.  If the ip field is empty, the
+ * system picks the interface.  Several services on one machine may
+ * each have such a socket.
+ *
+ * @param[in/out] sh the serviceHandler whose broadcast handle field
+ * will be set.
+ *
+ * @returns DISC_SUCCESS, or DISC_NULL_SH or DISC_SOCKET_FAILURE to
+ * indicate an error.  Callers may use perror() to learn more about
+ * the latter.
+ */
+int discOpen(serviceHandler * sh)
+{
+  struct sockaddr_in addr;
+  struct ip_mreq mreq;
+  struct in_addr iface;
+  int optval = 1;
+  int s;
+
+  if(sh == NULL) return DISC_NULL_SH;
+
+  iface.s_addr = (sh->ip[0] != '\0') ? inet_addr(sh->ip) : htonl(INADDR_ANY);
+
+  if((s = socket(AF_INET, SOCK_DGRAM, 0)) == -1) return DISC_SOCKET_FAILURE;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(atoi(DISC_PORT));
+
+  mreq.imr_multiaddr.s_addr = inet_addr(DISC_GROUP);
+  mreq.imr_interface = iface;
+
+  if(setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(int)) == -1
+     || bind(s, (struct sockaddr *)&addr, sizeof(addr)) == -1
+     || setsockopt(s, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) == -1
+     || setsockopt(s, IPPROTO_IP, IP_MULTICAST_IF, &iface, sizeof(iface)) == -1)
+    {
+      close(s);
+      return DISC_SOCKET_FAILURE;
+    }
+
+  servHandlerSetBroadcastHandle(sh, s);
+  return DISC_SUCCESS;
+}
+
+/**
+ * discSend
+ *
+ * Send a message to the multicast group on the broadcast handle of
+ * sh.
+ */
+static int discSend(serviceHandler * sh, char * msg)
+{
+  struct sockaddr_in group;
+
+  memset(&group, 0, sizeof(group));
+  group.sin_family = AF_INET;
+  group.sin_addr.s_addr = inet_addr(DISC_GROUP);
+  group.sin_port = htons(atoi(DISC_PORT));
+
+  if(sendto(sh->bh, msg, strlen(msg), 0, (struct sockaddr *)&group, sizeof(group)) == -1)
+    {
+      perror("discovery sendto");
+      return DISC_SOCKET_FAILURE;
+    }
+
+  return DISC_SUCCESS;
+}
+
+/**
+ * discAnnounce
+ *
+ * Tell the multicast group that the service described by sh is
+ * available at this machine's IP, on the port in sh.
+ */
+int discAnnounce(serviceHandler * sh)
+{
+  char msg[DISC_MAX_MESSAGE];
+
+  if(sh == NULL) return DISC_NULL_SH;
+
+  snprintf(msg, DISC_MAX_MESSAGE, "%s %d %s", DISC_ANNOUNCE, sh->typeOfService, sh->port);
+  return discSend(sh, msg);
+}
+
+/**
+ * discQuery
+ *
+ * Ask the multicast group for the service that sh should pair with.
+ */
+int discQuery(serviceHandler * sh)
+{
+  char msg[DISC_MAX_MESSAGE];
+
+  if(sh == NULL) return DISC_NULL_SH;
+
+  snprintf(msg, DISC_MAX_MESSAGE, "%s %d", DISC_QUERY, discPeerType(sh->typeOfService));
+  return discSend(sh, msg);
+}
+
+/**
+ * discAnnounceService
+ *
+ * The acceptor half of discovery.  Announce the service described by
+ * sh, and keep announcing with exponential backoff, until it has a
+ * connection.  Queries for the service are answered at once.  Since
+ * this function doesn't return until the service is connected, it is
+ * meant to be run in its own thread (see servStart()).
+ *
+ * @param[in] sh the serviceHandler of the acceptor.  Its typeOfService,
+ * port and ip fields must be set.
+ *
+ * @returns DISC_SUCCESS once the service is connected, or an error
+ * from discOpen().
+ */
+int discAnnounceService(serviceHandler * sh)
+{
+  struct pollfd pfd;
+  char msg[DISC_MAX_MESSAGE];
+  long backoff = DISC_FIRST_BACKOFF_MS;
+  long next;
+  int status, n, wanted;
+
+  if((status = discOpen(sh)) != DISC_SUCCESS)
+    {
+      perror("Cannot join the discovery group");
+      return status;
+    }
+
+  discAnnounce(sh);
+  next = discNowMs() + backoff;
+
+  pfd.fd = sh->bh;
+  pfd.events = POLLIN;
+
+  while(sh->handler == SERV_HANDLER_NOT_SET)
+    {
+      long wait = next - discNowMs();
+
+      if(wait > 0 && poll(&pfd, 1, (int)wait) > 0)
+	{
+	  if((n = recv(sh->bh, msg, DISC_MAX_MESSAGE - 1, 0)) > 0)
+	    {
+	      msg[n] = '\0';
+	      if(sscanf(msg, DISC_QUERY " %d", &wanted) == 1 && wanted == sh->typeOfService)
+		discAnnounce(sh);
+	    }
+	  continue;
+	}
+
+      if(discNowMs() >= next)
+	{
+	  discAnnounce(sh);
+	  backoff = (backoff * 2 > DISC_MAX_BACKOFF_MS) ? DISC_MAX_BACKOFF_MS : backoff * 2;
+	  next = discNowMs() + backoff;
+	}
+    }
+
+  close(sh->bh);
+  servHandlerSetBroadcastHandle(sh, SERV_HANDLER_NOT_SET);
+
+  return DISC_SUCCESS;
+}
+
+// ************************************************************************
+// FINDING A SERVICE
+// ************************************************************************
+
+/**
+ * discStartConnect
+ *
+ * Begin a non-blocking TCP connection to ip on port.
+ *
+ * @returns the socket, or -1 if the connection could not be started.
+ */
+static int discStartConnect(char * ip, char * port)
+{
+  struct addrinfo hints, * res;
+  int s;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_NUMERICHOST;
+
+  if(getaddrinfo(ip, port, &hints, &res) != 0) return -1;
+
+  if((s = socket(res->ai_family, res->ai_socktype, res->ai_protocol)) != -1)
+    {
+      fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK);
+      if(connect(s, res->ai_addr, res->ai_addrlen) == -1 && errno != EINPROGRESS)
+	{
+	  close(s);
+	  s = -1;
+	}
+    }
+
+  freeaddrinfo(res);
+  return s;
+}
+
+/**
+ * discFindService
+ *
+ * The connector half of discovery.  Find the acceptor that the
+ * service described by sh should pair with.  Two things are tried at
+ * once:
+ *
+ * 1. If DISC_CACHE_FILE remembers an endpoint for this type of
+ * service, a TCP connection to it is started.  If it completes, the
+ * service is connected and the handler field of sh is set.
+ *
+ * 2. The multicast group is queried, with exponential backoff, and
+ * the first announcement of the right service is taken.  The rip
+ * (and port) fields of sh are set; the caller still has to connect.
+ *
+ * @param[in/out] sh the serviceHandler of the connector.  Its
+ * typeOfService, port and ip fields must be set.
+ *
+ * @param[out] how if not NULL, set to the way the peer was found.
+ *
+ * @returns DISC_SUCCESS if a peer was found.  If nothing was found
+ * within the discoveryTimeoutMs of sh, returns DISC_TIMEOUT.  If
+ * there was no cached endpoint and the group cannot be joined,
+ * returns DISC_SOCKET_FAILURE.
+ */
+int discFindService(serviceHandler * sh, discMethod * how)
+{
+  struct pollfd pfds[2];
+  struct sockaddr_in from;
+  socklen_t len;
+  char cached[SERV_MAX_IP_LENGTH];
+  char msg[DISC_MAX_MESSAGE];
+  char port[SERV_MAX_PORT_LENGTH];
+  long backoff = DISC_FIRST_BACKOFF_MS;
+  long start, deadline, next, wait;
+  int tcp = -1;
+  int status = DISC_TIMEOUT;
+  int err, n, type;
+  serviceType peer;
+
+  if(sh == NULL) return DISC_NULL_SH;
+  if(how != NULL) *how = DISC_NOT_FOUND;
+
+  peer = discPeerType(sh->typeOfService);
+  start = discNowMs();
+  deadline = start + sh->discoveryTimeoutMs;
+
+  if(discCacheLoad(sh->typeOfService, cached) == DISC_SUCCESS)
+    {
+      printf("Trying cached endpoint %s\n", cached);
+      tcp = discStartConnect(cached, sh->port);
+    }
+
+  if(discOpen(sh) != DISC_SUCCESS)
+    {
+      perror("Cannot join the discovery group");
+      if(tcp == -1) return DISC_SOCKET_FAILURE;
+    }
+  else
+    {
+      discQuery(sh);
+    }
+  next = start + backoff;
+
+  while(tcp != -1 || sh->bh != SERV_HANDLER_NOT_SET)
+    {
+      long now = discNowMs();
+
+      if(sh->discoveryTimeoutMs > 0 && now >= deadline) break;
+
+      wait = next - now;
+      if(sh->discoveryTimeoutMs > 0 && deadline - now < wait) wait = deadline - now;
+      if(wait < 0) wait = 0;
+
+      pfds[0].fd = tcp;
+      pfds[0].events = POLLOUT;
+      pfds[1].fd = sh->bh;
+      pfds[1].events = POLLIN;
+
+      if(poll(pfds, 2, (int)wait) > 0)
+	{
+	  // The cached endpoint answered, one way or the other.
+	  if(tcp != -1 && (pfds[0].revents & (POLLOUT | POLLERR | POLLHUP)))
+	    {
+	      len = sizeof(err);
+	      if(getsockopt(tcp, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err == 0)
+		{
+		  fcntl(tcp, F_SETFL, fcntl(tcp, F_GETFL) & ~O_NONBLOCK);
+		  sh->handler = tcp;
+		  servHandlerSetRemoteIP(sh, cached);
+		  if(how != NULL) *how = DISC_BY_CACHE;
+		  status = DISC_SUCCESS;
+		  break;
+		}
+
+	      close(tcp);
+	      tcp = -1;
+	    }
+
+	  // Something was said on the group.
+	  if(sh->bh != SERV_HANDLER_NOT_SET && (pfds[1].revents & POLLIN))
+	    {
+	      len = sizeof(from);
+	      if((n = recvfrom(sh->bh, msg, DISC_MAX_MESSAGE - 1, 0, (struct sockaddr *)&from, &len)) > 0)
+		{
+		  msg[n] = '\0';
+		  if(sscanf(msg, DISC_ANNOUNCE " %d %5s", &type, port) == 2 && type == peer)
+		    {
+		      servHandlerSetRemoteIP(sh, inet_ntoa(from.sin_addr));
+		      servHandlerSetPort(sh, port);
+		      if(how != NULL) *how = DISC_BY_MULTICAST;
+		      status = DISC_SUCCESS;
+		      break;
+		    }
+		}
+	    }
+	}
+
+      // Time to ask again.
+      if(sh->bh != SERV_HANDLER_NOT_SET && discNowMs() >= next)
+	{
+	  discQuery(sh);
+	  backoff = (backoff * 2 > DISC_MAX_BACKOFF_MS) ? DISC_MAX_BACKOFF_MS : backoff * 2;
+	  next = discNowMs() + backoff;
+	}
+    }
+
+  // Whatever wasn't used is no longer needed.
+  if(tcp != -1 && sh->handler != tcp) close(tcp);
+  if(sh->bh != SERV_HANDLER_NOT_SET)
+    {
+      close(sh->bh);
+      servHandlerSetBroadcastHandle(sh, SERV_HANDLER_NOT_SET);
+    }
+
+  return status;
+}
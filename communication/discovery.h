@@ -0,0 +1,76 @@
+/**
+ * discovery.h
+ *
+ * Lets connectors find the acceptor endpoint they should pair with.
+ * Acceptors announce themselves on a multicast group, and answer
+ * queries sent to it.  Connectors query the group, and at the same
+ * time try the endpoint they connected to last time, which is kept
+ * in a small file on disk.  Whichever answers first wins.
+ */
+
+#ifndef _DISCOVERY_H_
+#define _DISCOVERY_H_
+
+#include "services.h"
+
+/**
+ *  CONSTANT DEFINITIONS.  All constants in this file should begin
+ *  with 'DISC' to indicate their membership in discovery.h
+ */
+#define DISC_SUCCESS (0)
+#define DISC_NULL_SH (-1)
+#define DISC_SOCKET_FAILURE (-2)
+#define DISC_TIMEOUT (-3)
+#define DISC_CACHE_MISS (-4)
+#define DISC_CACHE_FAILURE (-5)
+
+// The multicast group and port that announcements and queries are
+// sent to.  Every service uses the same group; the messages say which
+// service they are about.
+#define DISC_GROUP "239.255.100.6"
+#define DISC_PORT "10008"
+
+// Connectors re-send their query, and acceptors re-announce, after
+// DISC_FIRST_BACKOFF_MS, then twice that, and so on up to
+// DISC_MAX_BACKOFF_MS.
+#define DISC_FIRST_BACKOFF_MS 100
+#define DISC_MAX_BACKOFF_MS 4000
+
+// How long a connector looks before giving up, unless changed with
+// servHandlerSetDiscoveryTimeout().  Zero means look forever.
+#define DISC_DEFAULT_TIMEOUT_MS 30000
+
+// Where the last endpoint found for each service is remembered.  One
+// line per service: "<serviceType> <ip>".
+#define DISC_CACHE_FILE "/var/tmp/upbot.endpoints"
+
+// The messages.  A query is "UPBOT? <type wanted>".  An announcement
+// is "UPBOT! <type offered> <port>"; its source address is the IP.
+#define DISC_QUERY "UPBOT?"
+#define DISC_ANNOUNCE "UPBOT!"
+#define DISC_MAX_MESSAGE 64
+
+// How a connector found its peer.
+typedef enum discMethodTag discMethod;
+enum discMethodTag {
+  DISC_NOT_FOUND,
+  DISC_BY_CACHE,
+  DISC_BY_MULTICAST,
+  DISC_BY_MANUAL_IP,
+};
+
+/**
+ * Function prototypes.  See discovery.c for details on
+ * this/these functions.
+ */
+serviceType discPeerType(serviceType type);
+char * discMethodName(discMethod m);
+int discCacheLoad(serviceType type, char * ip);
+int discCacheSave(serviceType type, char * ip);
+int discOpen(serviceHandler * sh);
+int discAnnounce(serviceHandler * sh);
+int discQuery(serviceHandler * sh);
+int discAnnounceService(serviceHandler * sh);
+int discFindService(serviceHandler * sh, discMethod * how);
+
+#endif
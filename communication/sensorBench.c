@@ -0,0 +1,228 @@
+/**
+ * sensorBench.c
+ *
+ * Measure what it costs an agent to take in a sensing as a string
+ * (tick()) and as a binary mode record (tickRaw()).  The same random
+ * sensings are fed to each of:
+ *
+ *  - the supervisor's parseEpisode() and, for the records,
+ *    unpackSensorRecord() followed by parseEpisodeRaw(),
+ *  - Soar's roombaSensorsToWME() and roombaBitsToWME(), and
+ *  - packSensorString(), which is what the brainstem does in binary
+ *    mode in place of sending the string.
+ *
+ * The strings are laid out as the unit test environment lays them out
+ * (see unitTest.c): the sensor digits, some padding and the time stamp.
+ * NSM's parseSensors() and parseSensorsRaw() do the same work as the
+ * supervisor's and so are not timed separately.  No sensing sets the
+ * IR bit, so the supervisor never records a goal.
+ *
+ * Usage: sensorBench.out [-n sensings]
+ */
+
+#include <time.h>
+
+#include "communication.h"
+#include "trace.h"
+#include "../supervisor/supervisor.h"
+#include "../wme/wme.h"
+
+#define DEFAULT_SENSINGS 1000000
+
+// Soar's conversions allocate a WME per sensor; time fewer of them.
+#define WME_DIVISOR 10
+
+static char ** strings;
+static unsigned char * records;
+static int numSensings = DEFAULT_SENSINGS;
+
+// Folded into the output so the loops can't be optimized away.
+static long checksum = 0;
+
+
+/**
+ * elapsedNs
+ *
+ * @returns the nanoseconds from start to now.
+ */
+static double elapsedNs(struct timespec * start)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (now.tv_sec - start->tv_sec) * 1e9 + (now.tv_nsec - start->tv_nsec);
+}
+
+/**
+ * makeSensings
+ *
+ * Fill strings and records with the same numSensings random sensings.
+ */
+static void makeSensings()
+{
+  int i, j;
+
+  strings = (char **)malloc(numSensings * sizeof(char *));
+  records = (unsigned char *)malloc(numSensings * SENSOR_RECORD_SIZE);
+
+  for(i = 0; i < numSensings; i++)
+    {
+      // Bit NUM_SENSORS - 1 is the IR sensor; leave it off.
+      int sensorBits = rand() & ((1 << (NUM_SENSORS - 1)) - 1);
+
+      strings[i] = (char *)malloc(MAXDATASIZE);
+      for(j = 0; j < NUM_SENSORS; j++)
+	{
+	  strings[i][j] = '0' + SENSOR_BIT(sensorBits, j);
+	}
+      sprintf(strings[i] + NUM_SENSORS, "     %d      ", i + 1);
+
+      packSensorRecord(records + i * SENSOR_RECORD_SIZE, sensorBits, i + 1);
+    }
+}
+
+/**
+ * report
+ *
+ * Print one line of results.
+ */
+static void report(char * what, double textNs, double rawNs, int n)
+{
+  printf("%-28s %10.1f %10.1f %10.1f\n", what, textNs / n, rawNs / n,
+	 (textNs - rawNs) / n);
+}
+
+/**
+ * benchSupervisor
+ *
+ * Time parseEpisode() against unpackSensorRecord() + parseEpisodeRaw().
+ */
+static void benchSupervisor()
+{
+  struct timespec start;
+  double textNs, rawNs;
+  Episode ep;
+  int sensorBits, now;
+  int i, j;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(i = 0; i < numSensings; i++)
+    {
+      parseEpisode(&ep, strings[i]);
+      for(j = 0; j < NUM_SENSORS; j++) checksum += ep.sensors[j];
+      checksum += ep.now;
+    }
+  textNs = elapsedNs(&start);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(i = 0; i < numSensings; i++)
+    {
+      unpackSensorRecord(records + i * SENSOR_RECORD_SIZE, &sensorBits, &now);
+      parseEpisodeRaw(&ep, sensorBits, now);
+      for(j = 0; j < NUM_SENSORS; j++) checksum -= ep.sensors[j];
+      checksum -= ep.now;
+    }
+  rawNs = elapsedNs(&start);
+
+  report("supervisor parse", textNs, rawNs, numSensings);
+}
+
+/**
+ * freeWMEs
+ *
+ * Free a vector made by roombaSensorsToWME() or roombaBitsToWME().
+ */
+static void freeWMEs(Vector * wmes)
+{
+  int i;
+
+  for(i = 0; i < wmes->size; i++)
+    {
+      WME * wme = (WME *)wmes->array[i];
+      checksum += wme->value.iVal;
+      freeWME(wme);
+    }
+  freeVector(wmes);
+}
+
+/**
+ * benchSoar
+ *
+ * Time roombaSensorsToWME() against roombaBitsToWME().
+ */
+static void benchSoar()
+{
+  struct timespec start;
+  double textNs, rawNs;
+  int n = numSensings / WME_DIVISOR;
+  int sensorBits, now;
+  int i;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(i = 0; i < n; i++)
+    {
+      freeWMEs(roombaSensorsToWME(strings[i]));
+    }
+  textNs = elapsedNs(&start);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(i = 0; i < n; i++)
+    {
+      unpackSensorRecord(records + i * SENSOR_RECORD_SIZE, &sensorBits, &now);
+      freeWMEs(roombaBitsToWME(sensorBits));
+    }
+  rawNs = elapsedNs(&start);
+
+  report("soar sensors to WMEs", textNs, rawNs, n);
+}
+
+/**
+ * benchBrainstem
+ *
+ * Time packSensorString(), the brainstem's extra work in binary mode.
+ */
+static void benchBrainstem()
+{
+  struct timespec start;
+  unsigned char record[SENSOR_RECORD_SIZE];
+  double packNs;
+  int i;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(i = 0; i < numSensings; i++)
+    {
+      packSensorString(record, strings[i]);
+      checksum += record[0];
+    }
+  packNs = elapsedNs(&start);
+
+  printf("%-28s %10.1f\n", "brainstem packing", packNs / numSensings);
+}
+
+int main(int argc, char * argv[])
+{
+  int opt;
+
+  while((opt = getopt(argc, argv, "n:")) != -1)
+    {
+      if(opt == 'n' && atoi(optarg) >= WME_DIVISOR) numSensings = atoi(optarg);
+      else
+	{
+	  fprintf(stderr, "Usage: %s [-n sensings]\n", argv[0]);
+	  return 1;
+	}
+    }
+
+  srand(1);
+  makeSensings();
+
+  printf("%d sensings, ns per sensing\n", numSensings);
+  printf("%-28s %10s %10s %10s\n", "", "string", "record", "saved");
+  benchSupervisor();
+  benchSoar();
+  benchBrainstem();
+  printf("(checksum %ld)\n", checksum);
+
+  return 0;
+}
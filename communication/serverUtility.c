@@ -276,6 +276,81 @@ int readSensorDataFromMessageQueue(char* data, mqd_t qd)
   return 0;
   */
 }
+
+
+/**
+ * packSensorRecord()
+ *
+ * Pack a sensing into a binary mode record of SENSOR_RECORD_SIZE bytes
+ * (see communication.h).
+ *
+ * @arg record where to put the record
+ * @arg sensorBits the sensors, one bit each
+ * @arg now the time stamp
+ */
+void packSensorRecord(unsigned char* record, int sensorBits, int now)
+{
+  record[0] = sensorBits & 0xFF;
+  record[1] = (sensorBits >> 8) & 0xFF;
+  record[2] = now & 0xFF;
+  record[3] = (now >> 8) & 0xFF;
+  record[4] = (now >> 16) & 0xFF;
+  record[5] = (now >> 24) & 0xFF;
+}
+
+/**
+ * packSensorString()
+ *
+ * Pack a sensor string, NUM_SENSORS digits followed by a space and the
+ * time stamp (e.g. "0000000011 1234 ..."), into a binary mode record.
+ * This is the one place the digits are checked when the brainstem
+ * sends records.
+ *
+ * @arg record where to put the record
+ * @arg data the sensor string
+ *
+ * @return int 1 if the string was packed and 0 if it is malformed
+ */
+int packSensorString(unsigned char* record, char* data)
+{
+  int sensorBits = 0;
+  int now = 0;
+  int i;
+
+  for(i = 0; i < NUM_SENSORS; i++)
+    {
+      if(data[i] != '0' && data[i] != '1') return 0;
+
+      sensorBits = (sensorBits << 1) | (data[i] - '0');
+    }
+
+  // Skip the spaces before the time stamp, then read its digits
+  for(; data[i] == ' '; i++);
+  for(; data[i] >= '0' && data[i] <= '9'; i++)
+    {
+      now = now * 10 + (data[i] - '0');
+    }
+
+  packSensorRecord(record, sensorBits, now);
+
+  return 1;
+}
+
+/**
+ * unpackSensorRecord()
+ *
+ * The reverse of packSensorRecord().
+ *
+ * @arg record a record of SENSOR_RECORD_SIZE bytes
+ * @arg sensorBits where to put the sensors, one bit each
+ * @arg now where to put the time stamp
+ */
+void unpackSensorRecord(unsigned char* record, int* sensorBits, int* now)
+{
+  *sensorBits = record[0] | (record[1] << 8);
+  *now = record[2] | (record[3] << 8) | (record[4] << 16)
+    | ((unsigned int)record[5] << 24);
+}
   
 
 /** 
@@ -0,0 +1,853 @@
+/**
+ * serviceLoadTest.c
+ *
+ * A load generator for the data service and the event:responder
+ * service.  It starts a fleet of simulated robots on this machine,
+ * each of which connects over loopback exactly as nerves.c does: a
+ * SERV_DATA_SERVICE_COLLECTOR endpoint to send telemetry and a
+ * SERV_EVENT_RESPONDER_ROBOT endpoint to receive e:r programs.  The
+ * harness itself plays the aggregator and the programmer for every
+ * robot.
+ *
+ * Each robot sends a packageData() package at a fixed rate.  The
+ * programmer sends each robot e:r commands at a fixed rate, and a
+ * robot answers each command it receives with an extra package.  At
+ * the end of the run the harness reports:
+ *
+ *  - the time each robot took to set up both of its connections,
+ *  - the throughput seen by the aggregator,
+ *  - the end-to-end latency of each robot's telemetry,
+ *  - the round trip time of e:r commands, and
+ *  - packages and commands that were dropped along the way.
+ *
+ * The robot side uses services.c and connector.c as is, via
+ * conInitiateConnection() (servStart() would first look for a named
+ * interface; loopback has no broadcast address).  The listening
+ * sockets are made by accCreateConnection() in acceptor.c, but
+ * accAcceptConnection() only ever accepts one connection and its
+ * aggregator prints every package, so the harness accepts and reads
+ * the connections itself, as they arrive.
+ *
+ * Every robot in this process shares the single /qRobot message queue
+ * created by erRobotActivate(), so one dispatcher thread drains it and
+ * hands each command to the robot named in the command.  Commands the
+ * queue refuses (it is non-blocking and small) show up as lost e:r
+ * commands.
+ *
+ * Packages are laid out by packageData() with the fields reused as:
+ *   stateInitial  the robot id
+ *   stateFinal    the telemetry sequence number, or -1 for an answer
+ *   transitionID  the e:r command being answered, or -1
+ *   clockLastSet  the time the package was sent, in usec since start
+ *
+ * Usage: serviceLoadTest.out [-n robots] [-r telemetry Hz]
+ *                            [-e e:r commands Hz] [-c robots per second]
+ *                            [-d seconds] [-v]
+ *
+ * The rates are per robot.  By default every robot connects at once,
+ * which is a good test of the acceptors' listen() backlog; with -c
+ * they connect a few at a time instead.  With -v a line is printed for each robot.
+ * The services print a line or two for every connection and every
+ * e:r command, so it is worth sending stdout to a file; the report is
+ * printed on stderr.
+ */
+
+#include <pthread.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include "services.h"
+#include "acceptor.h"
+#include "connector.h"
+#include "../robot/netDataProtocol.h"
+
+#define LT_MAX_ROBOTS 4096
+#define LT_ER_SIZE 10        // Matches ERSIZE in services.c
+#define LT_ER_WINDOW 64      // e:r commands in flight per robot
+#define LT_NUM_BUCKETS 24    // log2 usec buckets, like clientTransport.h
+#define LT_DRAIN_MS 500
+#define LT_MAX_SECONDS 1800  // clockLastSet holds an int of usecs
+
+// A latency histogram.  Bucket i counts samples that took between 2^i
+// and 2^(i+1) microseconds.
+typedef struct latencyTag latency;
+struct latencyTag {
+  unsigned long hist[LT_NUM_BUCKETS];
+  unsigned long count;
+  double totalUsec;
+  double maxUsec;
+};
+
+typedef struct simRobotTag simRobot;
+struct simRobotTag {
+  int id;
+  int connected;             /**< Both endpoints came up. */
+  double setupUsec;          /**< Time to connect both endpoints. */
+  int erPort;                /**< Local port of the e:r connection. */
+
+  serviceHandler dsh;        /**< The robot's data collector. */
+  serviceHandler ersh;       /**< The robot's e:r robot endpoint. */
+  serviceHandler prog;       /**< The harness's end of ersh. */
+  pthread_t thread;
+  pthread_mutex_t sendLock;  /**< Serializes dsWrite() on dsh. */
+
+  // Written by the robot thread.
+  unsigned long sent;        /**< Telemetry packages sent. */
+  unsigned long skipped;     /**< Ticks missed because sends blocked. */
+
+  // Written by the aggregator.
+  int nextSeq;               /**< Telemetry sequence expected next. */
+  unsigned long received;    /**< Telemetry packages received. */
+  unsigned long gaps;        /**< Telemetry packages never received. */
+  latency telemetry;
+
+  // Shared by the programmer and the aggregator.
+  pthread_mutex_t erLock;
+  int erSeq;
+  int erSentSeq[LT_ER_WINDOW];
+  double erSentAt[LT_ER_WINDOW];
+  unsigned long erSent;
+  unsigned long erAnswered;
+  latency er;
+};
+
+simRobot * g_robots = NULL;
+int g_numRobots = 100;
+double g_telemetryHz = 10.0;
+double g_erHz = 1.0;
+double g_connectRate = 0.0;    // Robots connecting per second; 0 is all at once.
+int g_seconds = 10;
+int g_verbose = 0;
+
+volatile int g_stop = 0;       // Robots and programmer stop sending.
+volatile int g_stopAll = 0;    // Aggregator and dispatcher stop.
+struct timespec g_start;
+
+// E:r connections accepted but not yet matched to their robots.
+pthread_mutex_t g_acceptLock;
+int * g_erFds = NULL;
+int * g_erPorts = NULL;
+int g_erAccepted = 0;
+int g_dataAccepted = 0;
+
+unsigned long g_aggBytes = 0;      // Bytes read by the aggregator.
+unsigned long g_aggPackages = 0;   // Whole packages read.
+unsigned long g_aggReads = 0;      // recv() calls that returned data.
+unsigned long g_misframed = 0;     // Reads that were not whole packages.
+unsigned long g_strays = 0;        // Packages or commands not understood.
+unsigned long g_erRefused = 0;     // erWrite() failures.
+double g_aggFirst = -1.0;          // When the first package arrived.
+double g_aggLast = 0.0;            // When the last package arrived.
+
+// ************************************************************************
+// TIMING AND STATISTICS
+// ************************************************************************
+
+/**
+ * nowUsec
+ *
+ * @return microseconds since the harness started.
+ */
+double nowUsec()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - g_start.tv_sec) * 1000000.0
+    + (now.tv_nsec - g_start.tv_nsec) / 1000.0;
+}//nowUsec
+
+/**
+ * sleepUntil
+ *
+ * Sleep until the given time, in microseconds since the harness
+ * started.
+ */
+void sleepUntil(double usec)
+{
+  struct timespec t = g_start;
+  long long ns = (long long)(usec * 1000.0) + t.tv_nsec;
+
+  t.tv_sec += ns / 1000000000LL;
+  t.tv_nsec = ns % 1000000000LL;
+
+  while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) == EINTR);
+}//sleepUntil
+
+/**
+ * ltRecord
+ *
+ * Add one sample to a latency histogram.
+ */
+void ltRecord(latency * lt, double usec)
+{
+  int bucket = 0;
+  unsigned long whole = (usec < 1.0) ? 1 : (unsigned long)usec;
+
+  while((whole >>= 1) != 0 && bucket < LT_NUM_BUCKETS - 1) bucket++;
+
+  lt->hist[bucket]++;
+  lt->count++;
+  lt->totalUsec += usec;
+  if(usec > lt->maxUsec) lt->maxUsec = usec;
+}//ltRecord
+
+/**
+ * ltMerge
+ *
+ * Add every sample in src to dest.
+ */
+void ltMerge(latency * dest, latency * src)
+{
+  int i;
+  for(i = 0; i < LT_NUM_BUCKETS; i++) dest->hist[i] += src->hist[i];
+  dest->count += src->count;
+  dest->totalUsec += src->totalUsec;
+  if(src->maxUsec > dest->maxUsec) dest->maxUsec = src->maxUsec;
+}//ltMerge
+
+/**
+ * ltPercentile
+ *
+ * @return an upper bound, in microseconds, on the given percentile
+ * of the samples in lt: the top of the bucket it falls in.
+ */
+double ltPercentile(latency * lt, double pct)
+{
+  unsigned long target = (unsigned long)(lt->count * pct / 100.0);
+  unsigned long seen = 0;
+  int i;
+
+  for(i = 0; i < LT_NUM_BUCKETS; i++)
+    {
+      seen += lt->hist[i];
+      if(seen > target)
+	{
+	  double top = (double)(2UL << i);
+	  return (top < lt->maxUsec) ? top : lt->maxUsec;
+	}
+    }
+
+  return lt->maxUsec;
+}//ltPercentile
+
+/**
+ * ltPrint
+ *
+ * Print a one line summary of lt, in milliseconds.
+ */
+void ltPrint(FILE * out, char * label, latency * lt)
+{
+  if(lt->count == 0)
+    {
+      fprintf(out, "%-22s no samples\n", label);
+      return;
+    }
+
+  fprintf(out, "%-22s n=%lu mean=%.3f p50<=%.3f p90<=%.3f p99<=%.3f max=%.3f ms\n",
+	  label, lt->count, lt->totalUsec / lt->count / 1000.0,
+	  ltPercentile(lt, 50) / 1000.0, ltPercentile(lt, 90) / 1000.0,
+	  ltPercentile(lt, 99) / 1000.0, lt->maxUsec / 1000.0);
+}//ltPrint
+
+// ************************************************************************
+// THE SIMULATED ROBOTS
+// ************************************************************************
+
+/**
+ * robotSend
+ *
+ * Package up and send one package on a robot's data collector.
+ *
+ * @param r the robot
+ * @param seq the telemetry sequence number, or -1
+ * @param answering the e:r command being answered, or -1
+ * @return the result of dsWrite()
+ */
+int robotSend(simRobot * r, int seq, int answering)
+{
+  char sns[8] = {'\0'};
+  char package[DATA_PACKAGE_SIZE];
+  int status;
+
+  pthread_mutex_lock(&r->sendLock);
+  packageData(package, sns, r->id, seq, answering, (time_t)(int)nowUsec());
+  status = dsWrite(&r->dsh, package);
+  pthread_mutex_unlock(&r->sendLock);
+
+  return status;
+}//robotSend
+
+/**
+ * connectEndpoint
+ *
+ * Connect one of a robot's endpoints to the harness over loopback.
+ * This is what servStart() does for a connector once it knows the
+ * remote IP.
+ */
+int connectEndpoint(serviceType type, serviceHandler * sh)
+{
+  servHandlerSetDefaults(sh);
+  servHandlerSetService(sh, type);
+  servHandlerSetPort(sh, servToPort(type));
+  servHandlerSetRemoteIP(sh, "127.0.0.1");
+
+  return conInitiateConnection(sh);
+}//connectEndpoint
+
+/**
+ * robotMain
+ *
+ * The thread of execution for one simulated robot.  Connect both
+ * endpoints and then send telemetry at g_telemetryHz until told to
+ * stop.  If the robot falls more than a period behind (because
+ * dsWrite() blocked), the missed ticks are skipped and counted rather
+ * than sent in a burst.  Skipped ticks don't use up a sequence
+ * number, so gaps seen by the aggregator are packages lost after they
+ * were sent.
+ */
+void * robotMain(void * arg)
+{
+  simRobot * r = (simRobot *)arg;
+  struct sockaddr_in local;
+  socklen_t len = sizeof(local);
+  double period = 1000000.0 / g_telemetryHz;
+  double start, next;
+  int seq = 0;
+
+  // With -c, robots come up a few at a time rather than all at once.
+  if(g_connectRate > 0) sleepUntil(1000000.0 * r->id / g_connectRate);
+
+  start = nowUsec();
+  if(connectEndpoint(SERV_DATA_SERVICE_COLLECTOR, &r->dsh) != SERV_SUCCESS
+     || connectEndpoint(SERV_EVENT_RESPONDER_ROBOT, &r->ersh) != SERV_SUCCESS
+     || getsockname(r->ersh.handler, (struct sockaddr *)&local, &len) != 0)
+    {
+      return NULL;
+    }
+  r->setupUsec = nowUsec() - start;
+  r->erPort = ntohs(local.sin_port);
+  r->connected = 1;
+
+  // Stagger the robots across the first period.
+  next = nowUsec() + period * r->id / g_numRobots;
+
+  while(!g_stop)
+    {
+      sleepUntil(next);
+
+      if(robotSend(r, seq, -1) < 0) break;
+      r->sent++;
+      seq++;
+
+      next += period;
+      while(nowUsec() > next + period)
+	{
+	  next += period;
+	  r->skipped++;
+	}
+    }
+
+  return NULL;
+}//robotMain
+
+/**
+ * dispatcherMain
+ *
+ * Every robot's erRobotService() thread writes what it receives to
+ * the same /qRobot queue.  Drain it and have the robot named in each
+ * command answer it, as nerves.c would after its erRead().
+ */
+void * dispatcherMain(void * arg)
+{
+  serviceHandler queue;
+  struct pollfd pfd;
+  char cmd[9000];
+  int id, seq;
+
+  // Open our own handle on the queue; the robots' handles are set by
+  // their activation threads, which may not have run yet.
+  servHandlerSetDefaults(&queue);
+  queue.mqd = mq_open("/qRobot", O_RDWR | O_CREAT | O_NONBLOCK,
+		      S_IRWXU | S_IRWXG | S_IRWXO, NULL);
+  if(queue.mqd == (mqd_t)-1)
+    {
+      perror("mq_open() /qRobot");
+      return NULL;
+    }
+
+  pfd.fd = (int)queue.mqd;
+  pfd.events = POLLIN;
+
+  while(!g_stopAll)
+    {
+      if(poll(&pfd, 1, 100) <= 0) continue;
+
+      while(erRead(&queue, cmd) == SERV_SUCCESS)
+	{
+	  if(sscanf(cmd, "%4d%5d", &id, &seq) != 2
+	     || id < 0 || id >= g_numRobots || !g_robots[id].connected)
+	    {
+	      g_strays++;
+	      continue;
+	    }
+
+	  robotSend(&g_robots[id], -1, seq);
+	}
+    }
+
+  mq_close(queue.mqd);
+  return NULL;
+}//dispatcherMain
+
+// ************************************************************************
+// THE HARNESS: AGGREGATOR AND PROGRAMMER
+// ************************************************************************
+
+/**
+ * aggregatorHandle
+ *
+ * Account for one package read by the aggregator.
+ */
+void aggregatorHandle(char * package, double now)
+{
+  int id = getIntFromPackage(stateInitial, package);
+  int seq = getIntFromPackage(stateFinal, package);
+  int answering = getIntFromPackage(transitionID, package);
+  double sentAt = (double)getIntFromPackage(clockLastSet, package);
+  simRobot * r;
+
+  if(id < 0 || id >= g_numRobots)
+    {
+      g_strays++;
+      return;
+    }
+
+  r = &g_robots[id];
+
+  if(g_aggFirst < 0) g_aggFirst = now;
+  g_aggLast = now;
+  g_aggPackages++;
+
+  // An answer to an e:r command.
+  if(answering >= 0)
+    {
+      int slot = answering % LT_ER_WINDOW;
+
+      pthread_mutex_lock(&r->erLock);
+      if(r->erSentSeq[slot] == answering)
+	{
+	  ltRecord(&r->er, now - r->erSentAt[slot]);
+	  r->erSentSeq[slot] = -1;
+	  r->erAnswered++;
+	}
+      else
+	{
+	  g_strays++;
+	}
+      pthread_mutex_unlock(&r->erLock);
+      return;
+    }
+
+  // Periodic telemetry.
+  ltRecord(&r->telemetry, now - sentAt);
+  r->received++;
+  if(seq > r->nextSeq) r->gaps += seq - r->nextSeq;
+  r->nextSeq = seq + 1;
+}//aggregatorHandle
+
+/**
+ * aggregatorAccept
+ *
+ * Accept a connection on one of the listening sockets.  Data
+ * connections are added to the aggregator's poll set.  E:r
+ * connections are set aside with their peer's port until the
+ * programmer can tell which robot they belong to.
+ *
+ * @return the new data connection, or -1.
+ */
+int aggregatorAccept(int listener, int isData)
+{
+  struct sockaddr_in peer;
+  socklen_t len = sizeof(peer);
+  int fd;
+
+  if((fd = accept(listener, (struct sockaddr *)&peer, &len)) == -1)
+    return -1;
+
+  if(isData)
+    {
+      g_dataAccepted++;
+      return fd;
+    }
+
+  pthread_mutex_lock(&g_acceptLock);
+  g_erFds[g_erAccepted] = fd;
+  g_erPorts[g_erAccepted] = ntohs(peer.sin_port);
+  g_erAccepted++;
+  pthread_mutex_unlock(&g_acceptLock);
+
+  return -1;
+}//aggregatorAccept
+
+/**
+ * aggregatorMain
+ *
+ * Accept the robots' connections as they arrive and read every data
+ * collector connection with poll(), reassembling packages that
+ * arrive split across reads.  dsAggregatorService() assumes each
+ * recv() returns exactly one package, so reads where that isn't so
+ * are counted as misframed.
+ *
+ * The first two entries of the poll set are the listening sockets of
+ * the data service and the e:r service.
+ */
+void * aggregatorMain(void * arg)
+{
+  serviceHandler * listeners = (serviceHandler *)arg;
+  int numFds = 2;
+  struct pollfd * pfds = calloc(g_numRobots + 2, sizeof(struct pollfd));
+  char (* partial)[DATA_PACKAGE_SIZE] = calloc(g_numRobots + 2, DATA_PACKAGE_SIZE);
+  int * have = calloc(g_numRobots + 2, sizeof(int));
+  char buf[DATA_PACKAGE_SIZE * 64];
+  int i, n, used, fd;
+
+  pfds[0].fd = listeners[0].eh;
+  pfds[0].events = POLLIN;
+  pfds[1].fd = listeners[1].eh;
+  pfds[1].events = POLLIN;
+
+  while(!g_stopAll)
+    {
+      if(poll(pfds, numFds, 100) <= 0) continue;
+
+      if((pfds[0].revents & POLLIN) && numFds < g_numRobots + 2
+	 && (fd = aggregatorAccept(pfds[0].fd, 1)) != -1)
+	{
+	  pfds[numFds].fd = fd;
+	  pfds[numFds].events = POLLIN;
+	  pfds[numFds].revents = 0;
+	  numFds++;
+	}
+
+      if((pfds[1].revents & POLLIN) && g_erAccepted < g_numRobots)
+	{
+	  aggregatorAccept(pfds[1].fd, 0);
+	}
+
+      for(i = 2; i < numFds; i++)
+	{
+	  if(!(pfds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+
+	  if((n = recv(pfds[i].fd, buf, sizeof(buf), 0)) <= 0)
+	    {
+	      pfds[i].fd = -1;
+	      continue;
+	    }
+
+	  g_aggReads++;
+	  g_aggBytes += n;
+	  if(n != DATA_PACKAGE_SIZE) g_misframed++;
+
+	  for(used = 0; used < n; )
+	    {
+	      int take = DATA_PACKAGE_SIZE - have[i];
+	      if(take > n - used) take = n - used;
+
+	      memcpy(partial[i] + have[i], buf + used, take);
+	      have[i] += take;
+	      used += take;
+
+	      if(have[i] == DATA_PACKAGE_SIZE)
+		{
+		  aggregatorHandle(partial[i], nowUsec());
+		  have[i] = 0;
+		}
+	    }
+	}
+    }
+
+  free(pfds);
+  free(partial);
+  free(have);
+  return NULL;
+}//aggregatorMain
+
+/**
+ * programmerFind
+ *
+ * Find the harness's end of a robot's e:r connection among those
+ * accepted so far, by matching the robot's local port.
+ *
+ * @return TRUE if r now has a programmer end to write to.
+ */
+int programmerFind(simRobot * r)
+{
+  int i;
+
+  if(r->prog.handler != SERV_HANDLER_NOT_SET) return 1;
+  if(!r->connected) return 0;
+
+  pthread_mutex_lock(&g_acceptLock);
+  for(i = 0; i < g_erAccepted; i++)
+    {
+      if(g_erPorts[i] == r->erPort)
+	{
+	  r->prog.handler = g_erFds[i];
+	  break;
+	}
+    }
+  pthread_mutex_unlock(&g_acceptLock);
+
+  return r->prog.handler != SERV_HANDLER_NOT_SET;
+}//programmerFind
+
+/**
+ * programmerMain
+ *
+ * Send e:r commands round robin so that each robot gets g_erHz of
+ * them.  A command is "<robot id><sequence>" in ERSIZE bytes.
+ */
+void * programmerMain(void * arg)
+{
+  double period = 1000000.0 / (g_erHz * g_numRobots);
+  double next = nowUsec();
+  char cmd[LT_ER_SIZE];
+  int k = 0;
+  int seq, slot;
+  simRobot * r;
+
+  while(!g_stop)
+    {
+      sleepUntil(next);
+      next += period;
+
+      r = &g_robots[k];
+      k = (k + 1) % g_numRobots;
+      if(!programmerFind(r)) continue;
+
+      pthread_mutex_lock(&r->erLock);
+      seq = r->erSeq++ % 100000;
+      slot = seq % LT_ER_WINDOW;
+      r->erSentSeq[slot] = seq;
+      r->erSentAt[slot] = nowUsec();
+      r->erSent++;
+      pthread_mutex_unlock(&r->erLock);
+
+      // Four digits of id and five of seq fill the message
+      snprintf(cmd, LT_ER_SIZE, "%04u%05u", (unsigned)r->id % 10000,
+	       (unsigned)seq % 100000);
+      if(erWrite(&r->prog, cmd) != LT_ER_SIZE) g_erRefused++;
+    }
+
+  return NULL;
+}//programmerMain
+
+/**
+ * report
+ *
+ * Print the results of the run.
+ */
+void report(FILE * out, double runUsec)
+{
+  latency setup, telemetry, er;
+  unsigned long sent = 0, skipped = 0, received = 0, gaps = 0;
+  unsigned long erSent = 0, erAnswered = 0;
+  int connected = 0, programmed = 0;
+  int i;
+  double secs = (g_aggLast - g_aggFirst) / 1000000.0;
+
+  memset(&setup, 0, sizeof(latency));
+  memset(&telemetry, 0, sizeof(latency));
+  memset(&er, 0, sizeof(latency));
+
+  if(g_verbose)
+    {
+      fprintf(out, "robot  setup(ms)     sent  recv  lost  skip  mean(ms) p99(ms)  max(ms)  er  er_ok  er_p99(ms)\n");
+    }
+
+  for(i = 0; i < g_numRobots; i++)
+    {
+      simRobot * r = &g_robots[i];
+      if(!r->connected) continue;
+
+      connected++;
+      if(r->prog.handler != SERV_HANDLER_NOT_SET) programmed++;
+      ltRecord(&setup, r->setupUsec);
+      ltMerge(&telemetry, &r->telemetry);
+      ltMerge(&er, &r->er);
+      sent += r->sent;
+      skipped += r->skipped;
+      received += r->received;
+      gaps += r->gaps + (r->sent - r->nextSeq);
+      erSent += r->erSent;
+      erAnswered += r->erAnswered;
+
+      if(g_verbose)
+	{
+	  fprintf(out, "%5d %10.3f %8lu %5lu %5lu %5lu %9.3f %7.3f %8.3f %4lu %5lu %10.3f\n",
+		  r->id, r->setupUsec / 1000.0, r->sent, r->received,
+		  r->gaps + (r->sent - r->nextSeq), r->skipped,
+		  r->telemetry.count ? r->telemetry.totalUsec / r->telemetry.count / 1000.0 : 0.0,
+		  ltPercentile(&r->telemetry, 99) / 1000.0, r->telemetry.maxUsec / 1000.0,
+		  r->erSent, r->erAnswered, ltPercentile(&r->er, 99) / 1000.0);
+	}
+    }
+
+  fprintf(out, "\n%d of %d robots connected; %.0f Hz telemetry and %.1f Hz e:r commands each for %.1f s\n",
+	  connected, g_numRobots, g_telemetryHz, g_erHz, runUsec / 1000000.0);
+  fprintf(out, "accepted:  %d data and %d e:r connections; %d robots could be programmed\n",
+	  g_dataAccepted, g_erAccepted, programmed);
+
+  ltPrint(out, "connection setup", &setup);
+  ltPrint(out, "telemetry end-to-end", &telemetry);
+  ltPrint(out, "e:r round trip", &er);
+
+  fprintf(out, "aggregator: %lu packages, %lu bytes in %lu reads",
+	  g_aggPackages, g_aggBytes, g_aggReads);
+  if(secs > 0)
+    {
+      fprintf(out, " (%.0f packages/s, %.1f KB/s)",
+	      g_aggPackages / secs, g_aggBytes / secs / 1024.0);
+    }
+  fprintf(out, "\n            %lu reads were not exactly one package\n", g_misframed);
+
+  fprintf(out, "telemetry: %lu sent, %lu received, %lu lost, %lu ticks skipped by blocked robots\n",
+	  sent, received, gaps, skipped);
+  fprintf(out, "e:r:       %lu sent, %lu answered, %lu lost, %lu refused by erWrite()\n",
+	  erSent, erAnswered, erSent - erAnswered, g_erRefused);
+  fprintf(out, "strays:    %lu\n", g_strays);
+}//report
+
+/**
+ * parseArguments
+ */
+void parseArguments(int argc, char * argv[])
+{
+  int i;
+
+  for(i = 1; i < argc; i++)
+    {
+      if(strcmp(argv[i], "-v") == 0)
+	{
+	  g_verbose = 1;
+	}
+      else if(i + 1 < argc && strcmp(argv[i], "-n") == 0)
+	{
+	  g_numRobots = atoi(argv[++i]);
+	}
+      else if(i + 1 < argc && strcmp(argv[i], "-r") == 0)
+	{
+	  g_telemetryHz = atof(argv[++i]);
+	}
+      else if(i + 1 < argc && strcmp(argv[i], "-e") == 0)
+	{
+	  g_erHz = atof(argv[++i]);
+	}
+      else if(i + 1 < argc && strcmp(argv[i], "-c") == 0)
+	{
+	  g_connectRate = atof(argv[++i]);
+	}
+      else if(i + 1 < argc && strcmp(argv[i], "-d") == 0)
+	{
+	  g_seconds = atoi(argv[++i]);
+	}
+      else
+	{
+	  fprintf(stderr, "Usage: %s [-n robots] [-r telemetry Hz] [-e e:r commands Hz]\n"
+		  "          [-c robots connecting per second] [-d seconds] [-v]\n", argv[0]);
+	  exit(1);
+	}
+    }
+
+  if(g_numRobots < 1 || g_numRobots > LT_MAX_ROBOTS
+     || g_telemetryHz <= 0 || g_erHz <= 0 || g_connectRate < 0
+     || g_seconds < 1 || g_seconds > LT_MAX_SECONDS)
+    {
+      fprintf(stderr, "Need 1-%d robots, positive rates and 1-%d seconds.\n",
+	      LT_MAX_ROBOTS, LT_MAX_SECONDS);
+      exit(1);
+    }
+}//parseArguments
+
+int main(int argc, char * argv[])
+{
+  serviceHandler listeners[2];   // The data service and the e:r service.
+  pthread_t aggregator, dispatcher, programmer;
+  struct rlimit rl;
+  int i, j, status;
+
+  parseArguments(argc, argv);
+  clock_gettime(CLOCK_MONOTONIC, &g_start);
+
+  // Each robot uses five descriptors: two sockets and a queue on the
+  // robot side, and two sockets on the harness side.
+  if(getrlimit(RLIMIT_NOFILE, &rl) == 0)
+    {
+      rl.rlim_cur = rl.rlim_max;
+      setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+  // A robot whose connection was never accepted gets EPIPE from
+  // dsWrite() and stops; don't let it take the harness down.
+  signal(SIGPIPE, SIG_IGN);
+
+  // Start with an empty e:r queue; it outlives the process.
+  mq_unlink("/qRobot");
+
+  // The listening halves of the data service and the e:r service.
+  servHandlerSetDefaults(&listeners[0]);
+  servHandlerSetDefaults(&listeners[1]);
+  if((status = accCreateConnection(SERV_DATA_SERVICE_PORT, SERV_DATA_SERVICE_AGGREGATOR, &listeners[0])) != ACC_SUCCESS
+     || (status = accCreateConnection(SERV_EVENT_RESPONDER_SERVICE_PORT, SERV_EVENT_RESPONDER_PROGRAMMER, &listeners[1])) != ACC_SUCCESS)
+    {
+      fprintf(stderr, "Cannot listen on the service ports: %d\n", status);
+      return 1;
+    }
+
+  g_robots = calloc(g_numRobots, sizeof(simRobot));
+  g_erFds = calloc(g_numRobots, sizeof(int));
+  g_erPorts = calloc(g_numRobots, sizeof(int));
+  pthread_mutex_init(&g_acceptLock, NULL);
+
+  pthread_create(&aggregator, NULL, aggregatorMain, listeners);
+  pthread_create(&dispatcher, NULL, dispatcherMain, NULL);
+
+  // Launch the fleet.
+  for(i = 0; i < g_numRobots; i++)
+    {
+      simRobot * r = &g_robots[i];
+      r->id = i;
+      pthread_mutex_init(&r->sendLock, NULL);
+      pthread_mutex_init(&r->erLock, NULL);
+      servHandlerSetDefaults(&r->prog);
+      for(j = 0; j < LT_ER_WINDOW; j++) r->erSentSeq[j] = -1;
+
+      if(pthread_create(&r->thread, NULL, robotMain, r) != 0)
+	{
+	  perror("pthread_create() failed: ");
+	  return 1;
+	}
+    }
+
+  pthread_create(&programmer, NULL, programmerMain, NULL);
+
+  sleep(g_seconds);
+
+  // Stop sending, let what's in flight arrive, and then stop reading.
+  g_stop = 1;
+  for(i = 0; i < g_numRobots; i++) pthread_join(g_robots[i].thread, NULL);
+  pthread_join(programmer, NULL);
+  usleep(LT_DRAIN_MS * 1000);
+  g_stopAll = 1;
+  pthread_join(aggregator, NULL);
+  pthread_join(dispatcher, NULL);
+
+  report(stderr, nowUsec());
+
+  // The robots' erRobotService() threads are still blocked in recv();
+  // leave them be and let exit() take them.
+  mq_unlink("/qRobot");
+  exit(0);
+}
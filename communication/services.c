@@ -16,6 +16,7 @@
  *
  */
 #include <fcntl.h>
+#include <time.h>
 
 #include <mqueue.h>
 
@@ -27,9 +28,10 @@
 #include "services.h"
 #include "acceptor.h"
 #include "connector.h"
+#include "discovery.h"
 #include "../robot/netDataProtocol.h"
 
-#define ERSIZE 10
+#define ERSIZE SERV_ER_MESSAGE_SIZE
 
 // ************************************************************************
 // FUNCTIONS GENERIC TO ALL SERVICE HANDLERS
@@ -170,7 +172,9 @@ int servStop(serviceHandler * sh)
  * TODO: Who is responsible for cleaning up these threads?
  *
  * For a connector service, the call blocks until a full connection
- * has been established.  
+ * has been established, or until discovery gives up (see
+ * servHandlerSetDiscoveryTimeout()).  The time it took is reported
+ * and left in sh->connectMs.  
  *
  * @param[in] type the type of service endpoint to start up, e.g.,
  * SERV_DATA_SERVICE_AGGREGATOR or SERV_EVENT_RESPONDER_ROBOT.
@@ -198,9 +202,13 @@ int servStop(serviceHandler * sh)
 int servStart(serviceType type, char * name, broadcastType b, serviceHandler * sh)
 {
   int status = 0;
+  discMethod how = DISC_BY_MANUAL_IP;
+  struct timespec started, now;
 
   if(sh == NULL) return SERV_NULL_SH;
 
+  clock_gettime(CLOCK_MONOTONIC, &started);
+
 #ifdef DONOTCOMPILE
   // TODO: I think this needs to be here, but I need to confirm this.
   // --TLC
@@ -299,7 +307,6 @@ int servStart(serviceType type, char * name, broadcastType b, serviceHandler * s
 	}
 
       // Just to mark progress, print the resulting service handler
-      sleep(1);
       printf("Waiting for connections on the following service handler:");
       servHandlerPrint(sh);  
     }
@@ -311,32 +318,31 @@ int servStart(serviceType type, char * name, broadcastType b, serviceHandler * s
       servHandlerSetService(sh, type);  // Set the type of service.
 
       if(b == SERV_BROADCAST_ON) {
-	// Currently the UP network is not allowing broadcast packets.  For now, 
-	// the UPBOT robotics system cannot block until this call is successful.
-	
-	// Listen for a service to connect with.
-	printf("Listening for a service...\n");
-	
-        // Note: Since aggregators always broadcast on a particular port and
-        // collectors always listen on a particular port, it's enough for
-	// now to simply listen for any broadcasts on the data service port.
-	// This call blocks until something is heard.
-	conListenForService(type, sh);
+	// Look for a service to connect with: query the multicast
+	// group and, at the same time, try the endpoint we connected to
+	// last time.  This gives up after sh->discoveryTimeoutMs.
+	printf("Looking for a service...\n");
+	conListenForService(type, sh, &how);
       }
 
-      // Check that the remote ip, rip field, in the service handler
-      // has been set to *something*, either by the earlier call to
+      // If the cached endpoint answered, we are already connected and
+      // only need to activate the service.  Otherwise, check that the
+      // remote ip, rip field, in the service handler has been set to
+      // *something*, either by the earlier call to
       // conListenForService() or by some other means before this
       // servStart() function was called.  If so, try to initiate a
       // connection, otherwise, return with a failure.
-      if(sh->rip[0] != '\0')
+      if(sh->handler != SERV_HANDLER_NOT_SET)
+	{
+	  status = servActivate(sh);
+	}
+      else if(sh->rip[0] != '\0')
 	{	  
-	  // The broadcast has been heard or we have a manually-set IP
+	  // The service has been found or we have a manually-set IP
 	  // address.  Now, establish a connection with the other
 	  // endpoint of the service.
 	  status = conInitiateConnection(sh);
 	  printf("Initiate connection status: %d\n", status);
-	  return status;
 	}
       else
 	{
@@ -345,7 +351,23 @@ int servStart(serviceType type, char * name, broadcastType b, serviceHandler * s
 	  printf("Cannot connect to remote IP\n");
 	  return SERV_NO_REMOTE_IP;
 	}
+
+      // Report how long it took, so that cold and warm starts can be
+      // compared, and remember the endpoint for next time.
+      if(status == SERV_SUCCESS)
+	{
+	  clock_gettime(CLOCK_MONOTONIC, &now);
+	  sh->connectMs = (now.tv_sec - started.tv_sec) * 1000
+	    + (now.tv_nsec - started.tv_nsec) / 1000000;
+	  printf("%s connected to %s via %s in %d ms\n", serviceNames[type],
+		 sh->rip, discMethodName(how), sh->connectMs);
+	  discCacheSave(type, sh->rip);
+	}
+
+      return status;
     }
+
+  return SERV_SUCCESS;
 }
 
 /**
@@ -573,6 +595,9 @@ int servHandlerSetDefaults(serviceHandler * sh)
   // This service is not active.
   sh->ready = 0;
 
+  sh->discoveryTimeoutMs = DISC_DEFAULT_TIMEOUT_MS;
+  sh->connectMs = -1;
+
   return SERV_SUCCESS;
 }
 
@@ -638,6 +663,29 @@ int servHandlerSetRemoteIP(serviceHandler * sh, char * rip)
   return SERV_SUCCESS;
 }
 
+/**
+ * servHandlerSetDiscoveryTimeout
+ *
+ * Given a serviceHandler, sh, set how long servStart() may spend
+ * looking for the acceptor to pair with before giving up.
+ *
+ * @param[in] sh the serviceHandler whose discoveryTimeoutMs field is
+ * to be set.
+ *
+ * @param[in] ms the timeout in milliseconds, or 0 to look forever.
+ *
+ * @returns If sh is NULL, return SERV_NULL_SH to indicate an error.
+ * Otherwise, return SERV_SUCCESS.
+ */
+int servHandlerSetDiscoveryTimeout(serviceHandler * sh, int ms)
+{
+  if(sh == NULL) return SERV_NULL_SH;
+
+  sh->discoveryTimeoutMs = (ms < 0) ? 0 : ms;
+
+  return SERV_SUCCESS;
+}
+
 /**
  * servHandlerSetPort
  *
@@ -753,6 +801,9 @@ int servHandlerPrint(serviceHandler * sh)
   printf("   Remote IP:          %s.\n", sh->rip);
   printf("   Port number:        %s.\n", sh->port);    
   printf("   Interface:          %s.\n", sh->interface);
+  printf("   Discovery timeout:  %d ms.\n", sh->discoveryTimeoutMs);
+  if(sh->connectMs >= 0)
+    printf("   Time to connect:    %d ms.\n", sh->connectMs);
 
   printf("   Activated?:         ");
   if(sh->ready == 0)
@@ -820,7 +871,9 @@ int servQueryIP(serviceHandler * sh)
 	      // We have the IP address of the interface that we want.  Also get the
 	      // broadcast address in case we need it later to broadcast the availability of 
 	      // the service associated with this serviceHandler.
-	      strncpy(sh->bcaddr, inet_ntoa(((struct sockaddr_in*)current->ifa_dstaddr)->sin_addr), SERV_MAX_IP_LENGTH);
+	      // Note that some interfaces, e.g. loopback, have none.
+	      if(current->ifa_dstaddr != NULL)
+		strncpy(sh->bcaddr, inet_ntoa(((struct sockaddr_in*)current->ifa_dstaddr)->sin_addr), SERV_MAX_IP_LENGTH);
 	      sh->bcaddr[SERV_MAX_IP_LENGTH - 1] = '\0';  // I don't trust strncpy.
 	      
 
@@ -1179,6 +1232,71 @@ int erRobotActivate(serviceHandler * sh)
 
 }
 
+/**
+ * erRobotReceiveProgram
+ *
+ * Finish receiving an event:responder program whose header, and
+ * perhaps some of the program, has already been received, then
+ * queue the header and program as one message.
+ *
+ * This function is local to services.c and should not be made
+ * available to other source.
+ *
+ * @param[in] sh the serviceHandler associated with this
+ * event:responder robot endpoint.
+ *
+ * @param[in] got the bytes received so far, starting with the header.
+ *
+ * @param[in] numGot how many bytes are in got.
+ *
+ * @param[in] length the length of the program, from the header.
+ *
+ * @returns an indication of success or failure.  If the program is
+ * larger than SERV_ER_PROGRAM_MAX, the rest of it is read and thrown
+ * away and SERV_PROGRAM_TOO_LARGE is returned.
+ */
+static int erRobotReceiveProgram(serviceHandler * sh, char * got, int numGot, int length)
+{
+  char message[ERSIZE + SERV_ER_PROGRAM_MAX];
+  int total = ERSIZE + length;
+  int have = 0;
+  int n = 0;
+
+  if(numGot > total) numGot = total;
+  if(length <= SERV_ER_PROGRAM_MAX) memcpy(message, got, numGot);
+  have = numGot;
+
+  // Read the rest of the program.  An over-long program is read into
+  // the same buffer and thrown away so that the connection stays in
+  // step with the programmer.
+  while(have < total)
+    {
+      n = total - have;
+      if(length > SERV_ER_PROGRAM_MAX)
+	{
+	  if(n > sizeof(message)) n = sizeof(message);
+	  n = recv(sh->handler, message, n, 0);
+	}
+      else
+	{
+	  n = recv(sh->handler, message + have, n, 0);
+	}
+
+      if(n <= 0) return SERV_NO_CONNECTION;
+      have += n;
+    }
+
+  if(length > SERV_ER_PROGRAM_MAX) return SERV_PROGRAM_TOO_LARGE;
+
+  if(mq_send(sh->mqd, message, total, 0) != 0)
+    {
+      perror("msgsend() erRobotReceiveProgram\n");
+      return SERV_LOCAL_FAILURE;
+    }
+
+  return SERV_SUCCESS;
+}
+
 /**
  * erRobotService
  *
@@ -1206,10 +1324,14 @@ int erRobotService(serviceHandler * sh)
 			    // this function, we presume its open.
 
   char data[DATA_PACKAGE_SIZE] = {'\0'};
+  int length = 0;           // The length of a program being received.
 
   while(connectionAlive) 
     {
-      if ((numBytes = recv(sh->handler, data, DATA_PACKAGE_SIZE, 0)) == -1) {
+      // Read one message at a time.  Messages are always ERSIZE bytes,
+      // and a program follows its header directly, so reading more
+      // could take in the start of the next message.
+      if ((numBytes = recv(sh->handler, data, ERSIZE, MSG_WAITALL)) == -1) {
 	  perror("recv");
 
 	  close(sh->handler);
@@ -1238,7 +1360,16 @@ int erRobotService(serviceHandler * sh)
 		//data = "stop";
 	}
 	*/
-	if(mq_send(sh->mqd, data, ERSIZE, 0) != 0)
+	if(erProgramBody(data, &length) != NULL)
+	  {
+	    // A program.  Gather the whole of it before queueing it, so
+	    // that erRead() hands it over in one piece.
+	    if(erRobotReceiveProgram(sh, data, numBytes, length) != SERV_SUCCESS)
+	      {
+		printf("Dropped an event:responder program of %d bytes\n", length);
+	      }
+	  }
+	else if(mq_send(sh->mqd, data, ERSIZE, 0) != 0)
 	  {
 	    perror("msgsend() erRobotService\n");
 	  }
@@ -1318,6 +1449,85 @@ int erWrite(serviceHandler * sh, char * src) {
   return send(sh->handler, src, ERSIZE, 0);
 }
 
+/**
+ * erWriteProgram
+ *
+ * For a given serviceHandler for an event:responder programmer
+ * service endpoint, send an event:responder program to its paired
+ * robot service endpoint.  The program is sent after a header that
+ * gives its length; see services.h.
+ *
+ * @param[in] sh the serviceHandler associated with this
+ * event:responder programmer service endpoint.
+ *
+ * @param[in] program the program, as built by erProgramEncode().
+ *
+ * @param[in] length the length of the program in bytes.
+ *
+ * @returns SERV_SUCCESS, SERV_NO_DATA if the program is empty,
+ * SERV_PROGRAM_TOO_LARGE if it is over SERV_ER_PROGRAM_MAX bytes, or
+ * another indication of failure.
+ */
+int erWriteProgram(serviceHandler * sh, char * program, int length)
+{
+  char header[ERSIZE + 1] = {'\0'};
+  int sent = 0;
+  int n = 0;
+
+  if(sh == NULL) return SERV_NULL_SH;
+  if(program == NULL) return SERV_NULL_DATA;
+  if(sh->handler == SERV_HANDLER_NOT_SET) return SERV_NO_HANDLER;
+  if(length <= 0) return SERV_NO_DATA;
+  if(length > SERV_ER_PROGRAM_MAX) return SERV_PROGRAM_TOO_LARGE;
+
+  // The header must fit in one message.
+  if(snprintf(header, sizeof(header), "%s%d", SERV_ER_PROGRAM_TAG, length)
+     >= (int)sizeof(header))
+    {
+      return SERV_PROGRAM_TOO_LARGE;
+    }
+  if(send(sh->handler, header, ERSIZE, 0) != ERSIZE) return SERV_NO_CONNECTION;
+
+  while(sent < length)
+    {
+      if((n = send(sh->handler, program + sent, length - sent, 0)) <= 0)
+	{
+	  return SERV_NO_CONNECTION;
+	}
+      sent += n;
+    }
+
+  return SERV_SUCCESS;
+}
+
+/**
+ * erProgramBody
+ *
+ * Check whether a message read with erRead() is an event:responder
+ * program rather than a command.
+ *
+ * @param[in] rb the message.
+ *
+ * @param[out] length the length of the program, if it is one.
+ *
+ * @returns a pointer to the program within rb, or NULL if the message
+ * is not a program.
+ */
+char * erProgramBody(char * rb, int * length)
+{
+  int tagLength = strlen(SERV_ER_PROGRAM_TAG);
+
+  if(rb == NULL || strncmp(rb, SERV_ER_PROGRAM_TAG, tagLength) != 0)
+    {
+      return NULL;
+    }
+
+  *length = atoi(rb + tagLength);
+  if(*length < 0) return NULL;
+
+  return rb + ERSIZE;
+}
+
 // ************************************************************************
 //
 // DATA SERVICE.  The data service accepts sensor data collected by
@@ -1430,7 +1640,9 @@ int dsAggregatorService(serviceHandler * sh)
 
   while(connectionAlive) 
     {
-      if ((numBytes = recv(sh->handler, data, DATA_PACKAGE_SIZE, 0)) == -1) {
+      // Read one package at a time; collectors may send several in
+      // one write.
+      if ((numBytes = recv(sh->handler, data, DATA_PACKAGE_SIZE, MSG_WAITALL)) == -1) {
 	  perror("recv");
 
 	  close(sh->handler);
@@ -1537,6 +1749,48 @@ int dsWrite(serviceHandler * sh, char * src)
    
 }
 
+/**
+ * dsWriteMany()
+ *
+ * Write several data packages to a data service in one go.  Unlike
+ * dsWrite(), this keeps writing until all of them are sent, and a
+ * closed connection is reported rather than raising SIGPIPE.
+ *
+ * @param[in] sh the serviceHandler for the service to which data will
+ * be written.
+ *
+ * @param[in] src count packages of DATA_PACKAGE_SIZE bytes, one after
+ * the other.
+ *
+ * @param[in] count how many packages there are.
+ *
+ * @returns SERV_SUCCESS if all were sent.  If sh or src are NULL, the
+ * function returns SERV_NULL_SH or SERV_NULL_DATA respectively.  If
+ * the handler field of sh is not set it returns SERV_NO_HANDLER, and
+ * if the connection fails part way, SERV_NO_CONNECTION.
+ */
+int dsWriteMany(serviceHandler * sh, char * src, int count)
+{
+  int length = count * DATA_PACKAGE_SIZE;
+  int sent = 0;
+  int n = 0;
+
+  if(sh == NULL) return SERV_NULL_SH;
+  if(src == NULL) return SERV_NULL_DATA;
+  if(sh->handler == SERV_HANDLER_NOT_SET) return SERV_NO_HANDLER;
+
+  while(sent < length)
+    {
+      if((n = send(sh->handler, src + sent, length - sent, MSG_NOSIGNAL)) <= 0)
+	{
+	  return SERV_NO_CONNECTION;
+	}
+      sent += n;
+    }
+
+  return SERV_SUCCESS;
+}
+
 /** 
  * dsRead
  *
@@ -68,12 +68,22 @@
 #define SERV_BAD_BROADCAST_ADDR (-18)
 #define SERV_CANNOT_CREATE_QUEUE (-19)
 #define SERV_NO_DATA (-20)
+#define SERV_PROGRAM_TOO_LARGE (-21)
 
 #define SERV_SUCCESS (0)
 
 #define SERV_CONNECT_REMOTE (1)
 #define SERV_NO_CONNECT (0)
 
+// Event:responder messages are SERV_ER_MESSAGE_SIZE bytes, e.g.,
+// "go" or "stop".  A message that starts with SERV_ER_PROGRAM_TAG
+// is the header of a program: the tag is followed by the length of
+// the program in decimal, and the program itself follows the header.
+// See robot/erProgram.h for the program format.
+#define SERV_ER_MESSAGE_SIZE 10
+#define SERV_ER_PROGRAM_TAG "#ERP"
+#define SERV_ER_PROGRAM_MAX 4096
+
 #define SERV_NO_REMOTE_CONTINUE (1)
 #define SERV_NO_REMOTE_FAIL (0)
 
@@ -193,6 +203,13 @@ typedef struct serviceHandler {
 				       for whether or not the service
 				       has been activated */
 
+  int discoveryTimeoutMs;           /**< How long a connector looks for
+				       its acceptor before giving up;
+				       0 means forever */
+
+  int connectMs;                    /**< How long servStart() took to
+				       connect this endpoint, or -1 */
+
 } serviceHandler;
 
 
@@ -215,6 +232,7 @@ int servHandlerSetService(serviceHandler * sh, serviceType type);
 int servHandlerSetEndpointHandle(serviceHandler * sh, int eh);
 int servHandlerSetBroadcastHandle(serviceHandler * sh, int bh);
 int servHandlerSetRemoteIP(serviceHandler * sh, char * rip);
+int servHandlerSetDiscoveryTimeout(serviceHandler * sh, int ms);
 
 int servHandlerPrint(serviceHandler * sh);
 int servQueryIP(serviceHandler * sh);
@@ -239,6 +257,7 @@ int erRobotActivate(serviceHandler * sh);
 int dsAggregatorService(serviceHandler * sh);
 int dsRead(serviceHandler * sh, char * rb);
 int dsWrite(serviceHandler * sh, char * src);
+int dsWriteMany(serviceHandler * sh, char * src, int count);
 
 
 /**
@@ -248,5 +267,7 @@ int dsWrite(serviceHandler * sh, char * src);
 int erRobotService(serviceHandler * sh);
 int erRead(serviceHandler * sh, char * rb);
 int erWrite(serviceHandler * sh, char * src);
+int erWriteProgram(serviceHandler * sh, char * program, int length);
+char * erProgramBody(char * rb, int * length);
 
 #endif
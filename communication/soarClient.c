@@ -9,19 +9,57 @@
 *   derived from: Dr. Crenshaw, Dr. Nuxoll, Steve Beyer and Z.F.
 * Last edit: June 7, 2011
 *
-* Usage: soarClient.out <ip_addr> -c <roomba/test> -m <stats/visual>
+* Usage: soarClient.out <ip_addr> -c <roomba/test> -m <stats/visual> [-s seed]
+*
+* If built with IN_PROCESS defined (see the soarLocal target in the makefile)
+* the environment in supervisor/eaters.c is linked into the client and called
+* directly rather than over a socket.  In that case <ip_addr> is replaced by
+* the wall type (see eaters.h), or any other placeholder (e.g. "local") for
+* random walls.
+*
+* With -r <file> the run is recorded; with -R <file> a recording is replayed
+* in place of the server, as fast as possible or with -t in real time, and the
+* first command that differs from the recording is reported.  See ctRecord().
+*
+* With -T <file> the agent records a trace of each tick (see trace.h) that is
+* written to <file> when the run ends.  Read it with traceDump.out.
+*
+* With -S <ticks> a line giving the size of the agent's episodic memory and
+* how long each phase of a tick has taken is added to soar.log every <ticks>
+* ticks.  Sending the client SIGUSR1 writes a full snapshot to the log after
+* the current tick, including a histogram of the time taken by each phase
+* (see trTimePhases()).
+*
+* With -s <seed> rand() is seeded with <seed> rather than from the clock, and
+* a recording made with -r carries it.  The in-process environment lays out
+* its walls with the same seed.  When the run ends a line starting "Result:"
+* sums it up for sweep.out (see sweep.c) to read.
 */
 
 #include "../soar/soar.h"
+#include "clientTransport.h"
+#include "trace.h"
+
+#include <signal.h>
+
+#ifdef IN_PROCESS
+#include "../supervisor/eaters.h"
+#endif
 
 #define CMD_COUNT       5  //5=eaters, >5 is roomba
 
-#define TIMEOUT_SECS	5	// Num seconds in timeout on recv
-#define MAX_TRIES		10	// Num tries to reconnect on lost connection
 
-int g_tries;	// Number of tries to reconnect
 int g_goalsFound = 0;				// Number of times we found the goal
 int g_goalsTimeStamp[NUM_GOALS_TO_FIND];	// Timestamps of found goals
+char* g_recordFile = NULL;	// Record the run here (-r)
+char* g_replayFile = NULL;	// Replay this recording (-R)
+int g_replayRealTime = 0;	// Replay at the recorded pace (-t)
+char* g_traceFile = NULL;	// Write the agent's trace here (-T)
+int g_ticks = 0;	// Number of ticks processed
+int g_scores[NUM_EATERS_RUNS];	// Final score of each Eaters run
+int g_numScores = 0;	// Number of Eaters runs finished
+int g_statsEvery = 0;	// Log a line of stats every this many ticks (-S)
+volatile sig_atomic_t g_snapshot = 0;	// Set by SIGUSR1
 
 /**
  * exitError
@@ -75,6 +113,36 @@ void parseArguments(int argc, char *argv[])
 			{
 				g_statsMode = 0;
 			}
+		}
+		// -r : record the run to a file
+		else if(strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+		{
+			g_recordFile = argv[i+1];
+		}
+		// -R : replay a recorded run instead of connecting
+		else if(strcmp(argv[i], "-R") == 0 && i + 1 < argc)
+		{
+			g_replayFile = argv[i+1];
+		}
+		// -t : replay in real time rather than as fast as possible
+		else if(strcmp(argv[i], "-t") == 0)
+		{
+			g_replayRealTime = 1;
+		}
+		// -T : trace the agent and write the trace to a file
+		else if(strcmp(argv[i], "-T") == 0 && i + 1 < argc)
+		{
+			g_traceFile = argv[i+1];
+		}
+		// -S : log a line of stats every so many ticks
+		else if(strcmp(argv[i], "-S") == 0 && i + 1 < argc)
+		{
+			g_statsEvery = atoi(argv[i+1]);
+		}
+		// -s : seed rand() with this rather than the clock
+		else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+		{
+			g_randSeed = (unsigned int)atoi(argv[i+1]);
 		}// if
 	}// for
 }// parseArguments
@@ -82,18 +150,18 @@ void parseArguments(int argc, char *argv[])
 /**
  * sendCommand
  *
- * Send a command (int) through socket (sockfd)
+ * Send a command (int) to the server
  *
- * @arg sockfd A socket identifier
+ * @arg ct The connection to the server
  * @arg cmd An integer representing the command to be sent
  * @return int A success code
  */
-int sendCommand(int sockfd, int cmd)
+int sendCommand(clientTransport* ct, int cmd)
 {
 	// Attempt to send command and catch error code
-	int retVal = send(sockfd, &cmd, 1, 0);
+	int retVal = ctSend(ct, cmd);
 	// Else send command to Roomba server and exit if unsuccessful
-	if(retVal != -1)
+	if(retVal >= 0)
 	{
 		// Print command sent to Roomba on stdout
 		if(!g_statsMode) printf("The command value sent was: %s (%i)\n", interpretCommand(cmd), cmd);
@@ -104,21 +172,16 @@ int sendCommand(int sockfd, int cmd)
 /**
  * recvCommand
  *
- * Derived from exmaple code in "TCP/IP Sockets in C: Practical Guide for Programmers"
- * written by Michael J. Donahoo and Kennet L. Calvert
+ * This function waits to receive sensor data from the server.  If none arrives
+ * in time the transport prods the server with CMD_NO_OP and tries again (see
+ * ctRecv()).  The client exits if contact can't be made.
  *
- * This function takes a socket id and a char buffer and waits to receive sensor data
- * from the Roomba. If a command is not received directly, it drops into a loop that
- * queries for the Roomba until contact is made succesfully.
- *
- * @arg sockfd A socket identifier
+ * @arg ct The connection to the server
  * @arg buf A char buffer to read data into
  * @return int A success code
  */
-int recvCommand(int sockfd, char* buf)
+int recvCommand(clientTransport* ct, char* buf)
 {
-	// reset the number of tries
-	g_tries = 0;
 	if(!g_statsMode)
 	{
 		// Receive sensor data from socket and store in 'buf'
@@ -126,41 +189,12 @@ int recvCommand(int sockfd, char* buf)
 	}
 
 	// Number of bytes written to char buffer
-	int numbytes;
-	// Insert null terminating character at end of sensor string
-    buf[0] = '\0';
-
-	alarm(TIMEOUT_SECS);        /* Set the timeout */
-	while ((numbytes = recv(sockfd, buf, MAXDATASIZE-1, 0)) < 0)
+	int numbytes = ctRecv(ct, buf, MAXDATASIZE);
+	if(numbytes < 0)
 	{
-		if (errno == EINTR)     /* Alarm went off  */
-		{
-			if (g_tries < MAX_TRIES)      /* incremented by signal handler */
-			{
-				// Timed out and have mroe tries
-				printf("timed out, %d more tries...\n", MAX_TRIES-g_tries);
-				// Attempt to send a CMD_NO_OP
-				int cmd = CMD_NO_OP;
-				if (sendCommand(sockfd, cmd))
-				{
-					perror("Error sending CMD_NO_OP on retry\n");
-				}
-				// Reset alarm
-				alarm(TIMEOUT_SECS);
-			} 
-			else		/* have used up all of out tries  */
-			{
-				perror("Timed out on send command\n");
-			}
-		} 
-		else			/* error was not caused by alarm  */
-		{
-			perror("Error on receive\n");
-		}
-	}// while
-
-	// Insert null terminating character at end of sensor string
-	buf[numbytes] = '\0';
+		fprintf(stderr, "Error on receive: %d\n", numbytes);
+		exitError(numbytes);
+	}
 
 	// Print out the contents of buf
 	if(!g_statsMode)
@@ -168,129 +202,72 @@ int recvCommand(int sockfd, char* buf)
 		printf("client: sensor data: '%s'\n", buf);	   
 		printf("numbytes: %d\n", numbytes);
 	}
-	// Cancel alarm
-	alarm(0);
 
 	return 0;
 }// recvCommand
 
-/**
-* catchAlarm
-*
-* Registered function for catching the recv timeout alarm
-*
-* @arg ignored Unsure
-*/
-void catchAlarm(int ignored)
-{
-	g_tries +=1;
-}// catchAlarm
-
 /**
  * handshake
  *
- * This is becoming a catchall function used for initializing the connection
- * between the Supervisor and the Roomba.
+ * Connect to the server and get it ready for the send/recv loop
  *
- * @arg ipAddr This is the IP address of the Roomba we are connecting to
- * @return int Socket ID
+ * @arg ct The connection to set up
+ * @arg ipAddr This is the IP address of the Roomba we are connecting to (or
+ *             the wall type or any placeholder (e.g. "local") if IN_PROCESS)
  */
-int handshake(char* ipAddr)
+void handshake(clientTransport* ct, char* ipAddr)
 {
-	int sockfd, numbytes;
-	struct addrinfo hints, *servinfo, *p;
-	int rv;
-	char s[INET6_ADDRSTRLEN];
-	char* buf = (char*) malloc(sizeof(char) * MAXDATASIZE);
-	struct sigaction myAction;
+	int status;
 
-	memset(&hints, 0, sizeof hints);
-	hints.ai_family = AF_UNSPEC;
-	hints.ai_socktype = SOCK_STREAM;
+	ctInit(ct);
+	ct->isComplete = ctCompleteWMEString;
 
-	// Set up the alarm for recv timeouts
-	myAction.sa_handler = catchAlarm;
-	if(sigfillset(&myAction.sa_mask) < 0)
+	if(g_replayFile != NULL)
 	{
-		perror("sigfillset failed\n");
+		// Take the sensings from a recording instead
+		status = ctConnectReplay(ct, g_replayFile, g_replayRealTime);
 	}
-	myAction.sa_flags = 0;
-
-	if(sigaction(SIGALRM, &myAction, 0) < 0)
+	else
 	{
-		perror("sigaction failed for SIGALRM");
+#ifdef IN_PROCESS
+		// initWorld() seeds rand() from g_randSeed to lay out the walls
+		if(ipAddr[0] >= '0' && ipAddr[0] <= '9')
+		{
+			g_wallsConfig = atoi(ipAddr);
+		}
+		initWorld(TRUE);
+		status = ctConnectInProcess(ct, unitTest);
+#else
+		status = ctConnect(ct, ipAddr, PORT);
+#endif
 	}
-	//---------------------------------------
-
-	if ((rv = getaddrinfo(ipAddr, PORT, &hints, &servinfo)) != 0) {
-		fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(rv));
-		return 1;
+	if(status != CT_SUCCESS)
+	{
+		exitError(status);
 	}
 
-	// loop through all the results and connect to the first we can
-	for(p = servinfo; p != NULL; p = p->ai_next) {
-		if ((sockfd = socket(p->ai_family, p->ai_socktype,
-						p->ai_protocol)) == -1) {
-			perror("client: socket");
-			continue;
-		}
-
-		if (connect(sockfd, p->ai_addr, p->ai_addrlen) == -1) {
-			close(sockfd);
-			perror("client: connect");
-			continue;
-		}
-
-		break;
+	// A seed given with -s is used, and recorded, in place of the clock
+	if(g_replayFile == NULL && g_randSeed != 0)
+	{
+		ct->seed = g_randSeed;
 	}
 
-	if (p == NULL) {
-		fprintf(stderr, "client: failed to connect\n");
-		free(buf);
-		return 2;
+	if(g_recordFile != NULL && (status = ctRecord(ct, g_recordFile)) != CT_SUCCESS)
+	{
+		exitError(status);
 	}
 
-	inet_ntop(p->ai_family, get_in_addr((struct sockaddr *)p->ai_addr),
-			s, sizeof s);
-	printf("client: connecting to %s\n", s);
-
-	freeaddrinfo(servinfo); // all done with this structure
-
-	/*---------------------------------------------*/
-	// ABOVE: Creating connection
-	// BELOW: Conducting handshake
-	/*---------------------------------------------*/
-
-	if(g_connectToRoomba == 1)
+	// Seed rand() as recorded so that the run can be repeated
+	if(ct->seed != 0)
 	{
-		// Receive initial poem from Roomba upon connection
-		numbytes = recv(sockfd, buf, MAXDATASIZE-1, 0);
-		buf[numbytes] = '\0';
-		// Print poem and length of poem
-		printf("Poem: %s", buf);	   
-		printf("numbytes: %d\n", numbytes);
-
-		int cmd = CMD_NO_OP;
-		// Send a first command to finish initializing the send/receive sequence
-		if(send(sockfd, &cmd, 1, 0) == -1)
-		{
-		}
+		g_randSeed = ct->seed;
+		srand(g_randSeed);
 	}
-	else if(g_statsMode)
-	{
-        /*
-		// For the unit test this will toggle its copy of g_statsMode
-		int cmd = CMD_NO_OP;
-		if(send(sockfd, &cmd, 1, 0) == -1)
-		{
-		}
-        */
-	}// if
-	
-    // Free the space allocated for recv buffer
-	free(buf);
 
-	return sockfd;
+	if((status = ctHandshake(ct, g_connectToRoomba, CMD_ILLEGAL)) != CT_SUCCESS)
+	{
+		exitError(status);
+	}
 }// handshake
 
 /**
@@ -308,6 +285,10 @@ void printStats(FILE* log)
         int found;
         EpisodeWME *finalEp = (EpisodeWME*)g_epMem->array[g_epMem->size - 1];
         int score = getINTValWME(finalEp, "score", &found);
+        if(g_numScores < NUM_EATERS_RUNS)
+        {
+            g_scores[g_numScores++] = score;
+        }
         if(!g_statsMode)
         {
             /*
@@ -379,15 +360,88 @@ void printStats(FILE* log)
     }//if
 }//printStats
 
+/**
+ * printResult
+ *
+ * Print one line summing up the run for sweep.out to read: the number of
+ * ticks, the goals found and the steps taken to find each (as in the log),
+ * and the final score of each Eaters run.
+ */
+void printResult()
+{
+    int i;
+    printf("Result: ticks %d goals %d steps ", g_ticks, g_goalsFound);
+    for(i = 0; i < g_goalsFound; i++)
+    {
+        printf("%s%i", (i > 0 ? ":" : ""),
+               (i < 1 ? g_goalsTimeStamp[i] : g_goalsTimeStamp[i]-g_goalsTimeStamp[i-1]));
+    }
+    printf("%s score ", (g_goalsFound > 0 ? "" : "-"));
+    for(i = 0; i < g_numScores; i++)
+    {
+        printf("%s%d", (i > 0 ? ":" : ""), g_scores[i]);
+    }
+    printf("%s\n", (g_numScores > 0 ? "" : "-"));
+}// printResult
+
+/**
+ * requestSnapshot
+ *
+ * The SIGUSR1 handler.  The snapshot is written by the main loop, between
+ * ticks, since episodic memory may be changing when the signal arrives.
+ *
+ * @arg sig The signal
+ */
+void requestSnapshot(int sig)
+{
+    g_snapshot = 1;
+}//requestSnapshot
+
+/**
+ * logStats
+ *
+ * Write one line to the log giving the size of episodic memory and how long
+ * the phases of the agent's ticks have taken so far.
+ *
+ * @arg log A file handle for IO
+ */
+void logStats(FILE* log)
+{
+    fprintf(log, "tick %d: ", g_ticks);
+    displayMemoryStatsShort(log);
+    fprintf(log, "; ");
+    trPrintPhasesShort(log);
+    fprintf(log, "\n");
+    fflush(log);
+}//logStats
+
+/**
+ * logSnapshot
+ *
+ * Write everything known about the agent's memory use and timing to the
+ * log.  Called after a SIGUSR1.
+ *
+ * @arg ct The connection to the server
+ * @arg log A file handle for IO
+ */
+void logSnapshot(clientTransport* ct, FILE* log)
+{
+    fprintf(log, "---- Snapshot at tick %d ----\n", g_ticks);
+    displayMemoryStats(log);
+    trPrintPhases(log);
+    ctPrintLatency(ct, log);
+    fflush(log);
+}//logSnapshot
+
 /**
  * reportGoalFound
  *
  * Print that a goal as found to console
  *
- * @arg sockfd A socket identifier
+ * @arg ct The connection to the server
  * @arg log A file handle for IO
  */
-void reportGoalFound(int sockfd, FILE* log)
+void reportGoalFound(clientTransport* ct, FILE* log)
 {
     // Return if we are in the Eaters environment
     if(CMD_COUNT == 5)
@@ -400,7 +454,7 @@ void reportGoalFound(int sockfd, FILE* log)
                     getINTValWME(ep, "score", &found));
         // Send a success command
         int cmd = CMD_SONG;
-        sendCommand(sockfd, cmd);
+        sendCommand(ct, cmd);
         return;
     }//if
 
@@ -427,7 +481,7 @@ void reportGoalFound(int sockfd, FILE* log)
 
     // Send a success command
     int cmd = CMD_SONG;
-    sendCommand(sockfd, cmd);
+    sendCommand(ct, cmd);
 
     // If connected to Roomba 
     //pause to allow time to return Roomba to Init
@@ -485,7 +539,7 @@ int main(int argc, char *argv[])
 {
 	// User did not pass in minimum number of arguments
 	if (argc < 2) {
-		fprintf(stderr,"\nUSAGE: %s <hostname> [-m stats|visual] [-c roomba|test]\n\n",
+		fprintf(stderr,"\nUSAGE: %s <hostname> [-m stats|visual] [-c roomba|test] [-r file] [-R file [-t]] [-T file] [-S ticks] [-s seed]\n\n",
                 argv[0]);
 		exit(1);
 	}
@@ -504,8 +558,19 @@ int main(int argc, char *argv[])
 	initSoar(CMD_COUNT);					// Initialize the Supervisor
 	parseArguments(argc, argv);		// Parse the arguments and set up global monitoring vars
 
+	if(g_traceFile != NULL && trStart("soar", TR_DEFAULT_EVENTS) != TR_SUCCESS)
+	{
+		fprintf(stderr, "Cannot start the trace\n");
+		exit(1);
+	}
+
+	// Phase timing is cheap enough to leave on for the snapshots
+	trTimePhases(1);
+	signal(SIGUSR1, requestSnapshot);
+
 	// Socket stuff
-	int sockfd = handshake(argv[1]);
+	clientTransport transport;
+	handshake(&transport, argv[1]);
 	int cmd = CMD_NO_OP;				// This is the reset command, used to ensure init
 										// state of the virtual environment
     static int numRuns = 0;
@@ -514,10 +579,11 @@ int main(int argc, char *argv[])
 	while(1)
 	{	       
         // receive the sensor data
-        recvCommand(sockfd, buf);
+        recvCommand(&transport, buf);
 
         // determine the next command to send
         processCommand(&cmd, buf, log);
+        g_ticks++;
 
         // If goal is found increase goal count and store the index it was found at
         EpisodeWME *ep = (EpisodeWME*)getEntry(g_epMem, g_epMem->size - 1);
@@ -541,11 +607,11 @@ int main(int argc, char *argv[])
             {
                 printStats(log);
                 printf("Max steps reached: %i. Sending RESET command.\n\n", EATERS_MAX_STEPS);
-                if(sendCommand(sockfd, CMD_EATERS_RESET) < 0)
+                if(sendCommand(&transport, CMD_EATERS_RESET) < 0)
                 {
                     perror("Error sending to socket");
                 }
-                recvCommand(sockfd, buf);
+                recvCommand(&transport, buf);
                 if(strcmp(buf, "Reset: Success") == 0)
                 {
                     if(!g_statsMode) printf("Eaters reset successful\n");
@@ -568,22 +634,47 @@ int main(int argc, char *argv[])
 
         if (episodeContainsReward(ep))
         {
-            reportGoalFound(sockfd, log);
+            reportGoalFound(&transport, log);
         }//if
         else
         {
-            if(sendCommand(sockfd, cmd) < 0)
+            if(sendCommand(&transport, cmd) < 0)
             {
                 perror("Error sending to socket");
             }//if
         }//else
+
+        // Report on memory and timing if asked
+        if(g_snapshot)
+        {
+            g_snapshot = 0;
+            logSnapshot(&transport, log);
+        }
+        if(g_statsEvery > 0 && g_ticks % g_statsEvery == 0)
+        {
+            logStats(log);
+        }
     }// while
+    printResult();
 
     // End Soar agent to free memory
     endSoar();
 
+    // Write out the trace, if there is one
+    if(g_traceFile != NULL)
+    {
+        trPrintStats(stdout);
+        if(trDump(g_traceFile) != TR_SUCCESS)
+        {
+            fprintf(stderr, "Cannot write the trace to %s\n", g_traceFile);
+        }
+        trStop();
+    }
+
     // close the connection to Roomba server
-    close(sockfd);
+    ctPrintLatency(&transport, stdout);
+    ctPrintLatency(&transport, log);
+    ctClose(&transport);
     fclose(log);
 
     return 0;
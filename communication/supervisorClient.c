@@ -8,7 +8,39 @@
 * Author: Dr. Crenshaw, Dr. Nuxoll, Zachary Faltersack, Steve Beyer
 * Last edit: July 5, 2010
 *
-* Usage: supervisorClient.out <ip_addr> -c <roomba/test> -m <stats/visual>
+* Usage: supervisorClient.out <ip_addr> -c <roomba/test> -m <stats/visual> [-p] [-b] [-S ticks] [-s seed]
+*
+* If built with IN_PROCESS defined (see the supLocal target in the makefile)
+* the environment in supervisor/unitTest.c is linked into the client and called
+* directly rather than over a socket.  In that case <ip_addr> is replaced by
+* the map number.
+*
+* With -p the Supervisor runs pipelined: the command for the current plan
+* step is sent right away and learning/planning continue while the robot
+* moves.  See tickPipelined() in supervisor.c.
+*
+* With -r <file> the run is recorded; with -R <file> a recording is replayed
+* in place of the server, as fast as possible or with -t in real time, and the
+* first command that differs from the recording is reported.  See ctRecord().
+*
+* With -T <file> the agent records a trace of each tick (see trace.h) that is
+* written to <file> when the run ends.  Read it with traceDump.out.
+*
+* With -b (and -c roomba) the brainstem is asked to send each sensing as a
+* packed record rather than a string, and it goes to tickRaw() with nothing
+* left to parse.  The KNN and saccade filters need strings, so with either of
+* them -b is ignored.  A recording made with -b must be replayed with -b.
+*
+* With -S <ticks> a line giving the size of each of the Supervisor's
+* structures by level and how long each phase of a tick has taken is added
+* to supClient.log every <ticks> ticks.  Sending the client SIGUSR1 writes a
+* full snapshot to the log after the current tick: the memory held by each
+* structure at each level (see countMemory()) and a histogram of the time
+* taken by each phase (see trTimePhases()).
+*
+* With -s <seed> rand() is seeded with <seed> rather than from the clock, and
+* a recording made with -r carries it.  When the run ends a line starting
+* "Result:" sums it up for sweep.out (see sweep.c) to read.
 */
 
 // //if RANDOMIZE is defined then the hallucinogen filter is applied
@@ -30,23 +62,40 @@
 
 
 #include "communication.h"
+#include "clientTransport.h"
+#include "trace.h"
+
+#ifdef IN_PROCESS
+#include "../supervisor/unitTest.h"
+#endif
+#include <sys/time.h>
+#include <signal.h>
 #include "../supervisor/supervisor.h"
 
 #if KNN_FILTER
 #include "../supervisor/filter_KNN.h"
 #include "../supervisor/hallucinogen.h"
+#elif defined(RANDOMIZE)
+#include "../supervisor/hallucinogen.h"
 #endif
 
 #if SACC_FILTER
 #include "../supervisor/saccFilt.h"
 #endif
 
-#define TIMEOUT_SECS	5	// Num seconds in timeout on recv
-#define MAX_TRIES		10	// Num tries to reconnect on lost connection
 
 int g_goalsFound = 0;				// Number of times we found the goal
 int g_goalsTimeStamp[NUM_GOALS_TO_FIND];	// Timestamps of found goals
-int g_tries;	// Number of tries to reconnect
+char* g_recordFile = NULL;	// Record the run here (-r)
+char* g_replayFile = NULL;	// Replay this recording (-R)
+int g_replayRealTime = 0;	// Replay at the recorded pace (-t)
+char* g_traceFile = NULL;	// Write the agent's trace here (-T)
+int g_binary = 0;	// Ask the brainstem for sensings as records (-b)
+int g_pipelined = 0;	// Use tickPipelined() rather than tick()
+int g_ticks = 0;	// Number of ticks processed
+double g_tickSecs = 0.0;	// Total time spent deciding on commands
+int g_statsEvery = 0;	// Log a line of stats every this many ticks (-S)
+volatile sig_atomic_t g_snapshot = 0;	// Set by SIGUSR1
 
 /**
  * exitError
@@ -100,25 +149,80 @@ void parseArguments(int argc, char *argv[])
 			{
 				g_statsMode = 0;
 			}
+		}
+		// -p : pipelined
+		else if(strcmp(argv[i], "-p") == 0)
+		{
+			g_pipelined = 1;
+		}
+		// -r : record the run to a file
+		else if(strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+		{
+			g_recordFile = argv[i+1];
+		}
+		// -R : replay a recorded run instead of connecting
+		else if(strcmp(argv[i], "-R") == 0 && i + 1 < argc)
+		{
+			g_replayFile = argv[i+1];
+		}
+		// -t : replay in real time rather than as fast as possible
+		else if(strcmp(argv[i], "-t") == 0)
+		{
+			g_replayRealTime = 1;
+		}
+		// -T : trace the agent and write the trace to a file
+		else if(strcmp(argv[i], "-T") == 0 && i + 1 < argc)
+		{
+			g_traceFile = argv[i+1];
+		}
+		// -b : binary sensings from the brainstem
+		else if(strcmp(argv[i], "-b") == 0)
+		{
+			g_binary = 1;
+		}
+		// -S : log a line of stats every so many ticks
+		else if(strcmp(argv[i], "-S") == 0 && i + 1 < argc)
+		{
+			g_statsEvery = atoi(argv[i+1]);
+		}
+		// -s : seed rand() with this rather than the clock
+		else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+		{
+			g_randSeed = (unsigned int)atoi(argv[i+1]);
 		}// if
 	}// for
+
+	// Only the brainstem knows how to send records, and the KNN and
+	// saccade filters only work on strings
+	if(g_binary && g_connectToRoomba == 0)
+	{
+		printf("Binary sensings need -c roomba; using strings\n");
+		g_binary = 0;
+	}
+#if defined(KNN_FILTER) || SACC_FILTER
+	if(g_binary)
+	{
+		printf("Binary sensings can't be filtered; using strings\n");
+		g_binary = 0;
+	}
+#endif
 }// parseArguments
 
 /**
  * sendCommand
  *
- * Send a command (int) through socket (sockfd)
+ * Send a command (int) to the server
  *
- * @arg sockfd A socket identifier
+ * @arg ct The connection to the server
  * @arg cmd An integer representing the command to be sent
  * @return int A success code
  */
-int sendCommand(int sockfd, int cmd)
+int sendCommand(clientTransport* ct, int cmd)
 {
 	// Attempt to send command and catch error code
-	int retVal = send(sockfd, &cmd, 1, 0);
+	int retVal = ctSend(ct, cmd);
 	// Else send command to Roomba server and exit if unsuccessful
-	if(retVal != -1 && g_statsMode == 0)
+	if(retVal >= 0 && g_statsMode == 0)
 	{
 		// Print command sent to Roomba on stdout
 		printf("The command value sent was: %s (%i)\n", interpretCommand(cmd), cmd);
@@ -129,21 +233,16 @@ int sendCommand(int sockfd, int cmd)
 /**
  * recvCommand
  *
- * Derived from exmaple code in "TCP/IP Sockets in C: Practical Guide for Programmers"
- * written by Michael J. Donahoo and Kennet L. Calvert
- *
- * This function takes a socket id and a char buffer and waits to receive sensor data
- * from the Roomba. If a command is not received directly, it drops into a loop that
- * queries for the Roomba until contact is made succesfully.
+ * This function waits to receive sensor data from the server.  If none arrives
+ * in time the transport prods the server with CMD_NO_OP and tries again (see
+ * ctRecv()).  The client exits if contact can't be made.
  *
- * @arg sockfd A socket identifier
+ * @arg ct The connection to the server
  * @arg buf A char buffer to read data into
  * @return int A success code
  */
-int recvCommand(int sockfd, char* buf)
+int recvCommand(clientTransport* ct, char* buf)
 {
-	// reset the number of tries
-	g_tries = 0;
 	if(g_statsMode == 0)
 	{
 		// Receive sensor data from socket and store in 'buf'
@@ -151,169 +250,98 @@ int recvCommand(int sockfd, char* buf)
 	}
 
 	// Number of bytes written to char buffer
-	int numbytes;
-	// Insert null terminating character at end of sensor string
-    buf[0] = '\0';
-
-	alarm(TIMEOUT_SECS);        /* Set the timeout */
-	while ((numbytes = recv(sockfd, buf, MAXDATASIZE-1, 0)) < 0)
+	int numbytes = ctRecv(ct, buf, MAXDATASIZE);
+	if(numbytes < 0)
 	{
-		if (errno == EINTR)     /* Alarm went off  */
-		{
-			if (g_tries < MAX_TRIES)      /* incremented by signal handler */
-			{
-				// Timed out and have mroe tries
-				printf("timed out, %d more tries...\n", MAX_TRIES-g_tries);
-				// Attempt to send a CMD_NO_OP
-				int cmd = CMD_NO_OP;
-				if (sendCommand(sockfd, cmd))
-				{
-					perror("Error sending CMD_NO_OP on retry\n");
-				}
-				// Reset alarm
-				alarm(TIMEOUT_SECS);
-			} 
-			else		/* have used up all of out tries  */
-			{
-				perror("Timed out on send command\n");
-			}
-		} 
-		else			/* error was not caused by alarm  */
-		{
-		  perror("Error on receive\n");
-		}
-	}// while
-
-	// Insert null terminating character at end of sensor string
-    buf[numbytes] = '\0';
+		fprintf(stderr, "Error on receive: %d\n", numbytes);
+		exitError(numbytes);
+	}
 
 	// Print out the contents of buf
 	if(g_statsMode == 0)
 	{
-		printf("client: sensor data: '%s'\n", buf);	   
+		if(g_binary)
+		{
+			int sensorBits, now;
+			unpackSensorRecord((unsigned char*)buf, &sensorBits, &now);
+			printf("client: sensor record: 0x%03x at %d\n", sensorBits, now);
+		}
+		else
+		{
+			printf("client: sensor data: '%s'\n", buf);
+		}
 		printf("numbytes: %d\n", numbytes);
 	}
-	// Cancel alarm
-	alarm(0);
 
 	return 0;
 }// recvCommand
 
-/**
-* catchAlarm
-*
-* Registered function for catching the recv timeout alarm
-*
-* @arg ignored Unsure
-*/
-void catchAlarm(int ignored)
-{
-	g_tries +=1;
-}// catchAlarm
-
 /**
  * handshake
  *
- * This is becoming a catchall function used for initializing the connection
- * between the Supervisor and the Roomba.
+ * Connect to the server and get it ready for the send/recv loop
  *
- * @arg ipAddr This is the IP address of the Roomba we are connecting to
- * @return int Socket ID
+ * @arg ct The connection to set up
+ * @arg ipAddr This is the IP address of the Roomba we are connecting to (or
+ *             the map number if IN_PROCESS)
  */
-int handshake(char* ipAddr)
+void handshake(clientTransport* ct, char* ipAddr)
 {
-	int sockfd, numbytes;
-	struct addrinfo hints, *servinfo, *p;
-	int rv;
-	char s[INET6_ADDRSTRLEN];
-	char* buf = (char*) malloc(sizeof(char) * MAXDATASIZE);
-	struct sigaction myAction;
+	int status;
 
-	memset(&hints, 0, sizeof hints);
-	hints.ai_family = AF_UNSPEC;
-	hints.ai_socktype = SOCK_STREAM;
+	ctInit(ct);
+	ct->isComplete = ctCompleteSensorString;
 
-	// Set up the alarm for recv timeouts
-	myAction.sa_handler = catchAlarm;
-	if(sigfillset(&myAction.sa_mask) < 0)
+	if(g_replayFile != NULL)
 	{
-		perror("sigfillset failed\n");
+		// Take the sensings from a recording instead
+		status = ctConnectReplay(ct, g_replayFile, g_replayRealTime);
 	}
-	myAction.sa_flags = 0;
-
-	if(sigaction(SIGALRM, &myAction, 0) < 0)
+	else
 	{
-		perror("sigaction failed for SIGALRM");
+#ifdef IN_PROCESS
+		// ipAddr is the map number the unit test server would have been given.
+		// loadMap() assumes it has the process to itself and turns on stats mode.
+		int statsMode = g_statsMode;
+		loadMap(atoi(ipAddr));
+		g_statsMode = statsMode;
+		status = ctConnectInProcess(ct, unitTest);
+#else
+		status = ctConnect(ct, ipAddr, PORT);
+#endif
 	}
-	//---------------------------------------
-
-	if ((rv = getaddrinfo(ipAddr, PORT, &hints, &servinfo)) != 0) {
-		fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(rv));
-		return 1;
+	if(status != CT_SUCCESS)
+	{
+		exitError(status);
 	}
 
-	// loop through all the results and connect to the first we can
-	for(p = servinfo; p != NULL; p = p->ai_next) {
-		if ((sockfd = socket(p->ai_family, p->ai_socktype,
-						p->ai_protocol)) == -1) {
-			perror("client: socket");
-			continue;
-		}
-
-		if (connect(sockfd, p->ai_addr, p->ai_addrlen) == -1) {
-			close(sockfd);
-			perror("client: connect");
-			continue;
-		}
-
-		break;
+	// A seed given with -s is used, and recorded, in place of the clock
+	if(g_replayFile == NULL && g_randSeed != 0)
+	{
+		ct->seed = g_randSeed;
 	}
 
-	if (p == NULL) {
-		fprintf(stderr, "client: failed to connect\n");
-		free(buf);
-		return 2;
+	if(g_recordFile != NULL && (status = ctRecord(ct, g_recordFile)) != CT_SUCCESS)
+	{
+		exitError(status);
 	}
 
-	inet_ntop(p->ai_family, get_in_addr((struct sockaddr *)p->ai_addr),
-			s, sizeof s);
-	printf("client: connecting to %s\n", s);
-
-	freeaddrinfo(servinfo); // all done with this structure
-
-	/*---------------------------------------------*/
-	// ABOVE: Creating connection
-	// BELOW: Conducting handshake
-	/*---------------------------------------------*/
-
-	if(g_connectToRoomba == 1)
+	// Seed rand() as recorded so that the run can be repeated
+	if(ct->seed != 0)
 	{
-		// Receive initial poem from Roomba upon connection
-		numbytes = recv(sockfd, buf, MAXDATASIZE-1, 0);
-		buf[numbytes] = '\0';
-		// Print poem and length of poem
-		printf("Poem: %s", buf);	   
-		printf("numbytes: %d\n", numbytes);
+		g_randSeed = ct->seed;
+		srand(g_randSeed);
+	}
 
-		int cmd = CMD_NO_OP;
-		// Send a first command to finish initializing the send/receive sequence
-		if(send(sockfd, &cmd, 1, 0) == -1)
-		{
-		}
+	int firstCmd = (g_statsMode ? CMD_BLINK : CMD_ILLEGAL);
+	if(g_binary)
+	{
+		firstCmd = ssBinary;
 	}
-	else if(g_statsMode == 1)
+	if((status = ctHandshake(ct, g_connectToRoomba, firstCmd)) != CT_SUCCESS)
 	{
-		// For the unit test this will toggle its copy of g_statsMode
-		int cmd = CMD_BLINK;
-		if(send(sockfd, &cmd, 1, 0) == -1)
-		{
-		}
-	}// if
-
-	// Free the space allocated for recv buffer
-	free(buf);
-
-	return sockfd;
+		exitError(status);
+	}
 }// handshake
 
 /**
@@ -326,6 +354,9 @@ int handshake(char* ipAddr)
  */
 void printStats(FILE* log)
 {
+	// A pipelined tick may still be changing the Supervisor's memory
+	finishPipelinedTick();
+
 	// == 0 means print to console
 	Vector* episodeList = g_epMem->array[0];
 	if(g_statsMode == 0)
@@ -360,21 +391,103 @@ void printStats(FILE* log)
 		fprintf(log, "\n");
 		fflush(log);
 	}// if
+
+	// Report how long the robot waited on the Supervisor each tick
+	printf("Average time to choose a command: %g sec over %d ticks\n",
+				(g_ticks > 0 ? g_tickSecs / g_ticks : 0.0), g_ticks);
+	displayPlanCacheStats(stdout);
+	if(g_pipelined)
+	{
+		displayPipelineStats(stdout);
+	}
 }// printStats
 
+/**
+ * printResult
+ *
+ * Print one line summing up the run for sweep.out to read: the number of
+ * ticks, the goals found and the steps taken to find each (as in the log).
+ */
+void printResult()
+{
+	int i;
+	printf("Result: ticks %d goals %d steps ", g_ticks, g_goalsFound);
+	for(i = 0; i < g_goalsFound; i++)
+	{
+		printf("%s%i", (i > 0 ? ":" : ""),
+			   (i < 1 ? g_goalsTimeStamp[i] : g_goalsTimeStamp[i]-g_goalsTimeStamp[i-1]));
+	}
+	printf("%s score -\n", (g_goalsFound > 0 ? "" : "-"));
+}// printResult
+
+/**
+ * requestSnapshot
+ *
+ * The SIGUSR1 handler.  The snapshot is written by the main loop, between
+ * ticks, since the Supervisor's memory may be changing when the signal
+ * arrives.
+ *
+ * @arg sig The signal
+ */
+void requestSnapshot(int sig)
+{
+	g_snapshot = 1;
+}// requestSnapshot
+
+/**
+ * logStats
+ *
+ * Write one line to the log giving the Supervisor's memory use and how long
+ * the phases of its ticks have taken so far.
+ *
+ * @arg log A file handle for IO
+ */
+void logStats(FILE* log)
+{
+	fprintf(log, "tick %d: ", g_ticks);
+	displayMemoryStatsShort(log);
+	fprintf(log, "; ");
+	trPrintPhasesShort(log);
+	fprintf(log, "\n");
+	fflush(log);
+}// logStats
+
+/**
+ * logSnapshot
+ *
+ * Write everything known about the Supervisor's memory use and timing to
+ * the log.  Called after a SIGUSR1.
+ *
+ * @arg ct The connection to the server
+ * @arg log A file handle for IO
+ */
+void logSnapshot(clientTransport* ct, FILE* log)
+{
+	fprintf(log, "---- Snapshot at tick %d ----\n", g_ticks);
+	displayMemoryStats(log);
+	trPrintPhases(log);
+	displayPlanCacheStats(log);
+	if(g_pipelined)
+	{
+		displayPipelineStats(log);
+	}
+	ctPrintLatency(ct, log);
+	fflush(log);
+}// logSnapshot
+
 /**
  * reportGoalFound
  *
  * Print that a goal as found to console
  *
- * @arg sockfd A socket identifier
+ * @arg ct The connection to the server
  * @arg log A file handle for IO
  */
-void reportGoalFound(int sockfd, FILE* log)
+void reportGoalFound(clientTransport* ct, FILE* log)
 {
 	// Store the new goal timestamp and increment count
 	Vector* episodeList = g_epMem->array[0];
-	g_goalsTimeStamp[g_goalsFound] = ((Episode*)episodeList->array[episodeList->size - 1])->now;
+	g_goalsTimeStamp[g_goalsFound] = episodeLast(episodeList)->now;
 	g_goalsFound++;
 
 	// Only print if not in stats mode
@@ -394,7 +507,7 @@ void reportGoalFound(int sockfd, FILE* log)
 
 	// Send a success command
 	int cmd = CMD_SONG;
-	sendCommand(sockfd, cmd);
+	sendCommand(ct, cmd);
 
 	// If connected to Roomba 
     //pause to allow time to return Roomba to Init
@@ -417,6 +530,23 @@ void reportGoalFound(int sockfd, FILE* log)
  */
 void processCommand(int* cmd, char* buf, FILE* log)
 {
+	struct timeval start, end;
+	int sensorBits, now;
+	gettimeofday(&start, NULL);
+
+	// A record from the brainstem needs no parsing.  Only the
+	// RANDOMIZE filter also works on records; see parseArguments().
+	if(g_binary)
+	{
+		unpackSensorRecord((unsigned char*)buf, &sensorBits, &now);
+#ifdef RANDOMIZE
+		insertConfusionBits(&sensorBits);
+#endif
+		*cmd = (g_pipelined ? tickPipelinedRaw(sensorBits, now)
+		                    : tickRaw(sensorBits, now));
+	}
+	else
+	{
 	// Call Supervisor tick to process recently added episode.
     // The incoming sensing may be filtered depending upon
     // RANDOMIZE and KNN_FILTER
@@ -442,13 +572,27 @@ void processCommand(int* cmd, char* buf, FILE* log)
     }
     buf = temp;
 #else
-    *cmd = tick(buf);
+    *cmd = (g_pipelined ? tickPipelined(buf) : tick(buf));
 #endif
+	}
+
+	// Keep track of how long the robot had to wait for this command
+	gettimeofday(&end, NULL);
+	g_tickSecs += (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+	g_ticks++;
 
 	if(g_statsMode == 0)
 	{
 		// Print sensor data to log file and force write
-		fprintf(log, "Sensor data: [%s] Command received: %s\n", buf, interpretCommand(*cmd));
+		if(g_binary)
+		{
+			fprintf(log, "Sensor record: [0x%03x %d] Command received: %s\n",
+					sensorBits, now, interpretCommand(*cmd));
+		}
+		else
+		{
+			fprintf(log, "Sensor data: [%s] Command received: %s\n", buf, interpretCommand(*cmd));
+		}
 		fflush(log);
 	}
 
@@ -476,7 +620,7 @@ int main(int argc, char *argv[])
 {
 	// User did not pass in minimum number of arguments
 	if (argc < 2) {
-		fprintf(stderr,"\nUSAGE: %s <hostname> [-m stats|visual] [-c roomba|test]\n\n",
+		fprintf(stderr,"\nUSAGE: %s <hostname> [-m stats|visual] [-c roomba|test] [-p] [-b] [-r file] [-R file [-t]] [-T file] [-S ticks] [-s seed]\n\n",
                 argv[0]);
 		exit(1);
 	}
@@ -506,8 +650,19 @@ int main(int argc, char *argv[])
 
 	parseArguments(argc, argv);		// Parse the arguments and set up global monitoring vars
 
+	if(g_traceFile != NULL && trStart("supervisor", TR_DEFAULT_EVENTS) != TR_SUCCESS)
+	{
+		fprintf(stderr, "Cannot start the trace\n");
+		exit(1);
+	}
+
+	// Phase timing is cheap enough to leave on for the snapshots
+	trTimePhases(1);
+	signal(SIGUSR1, requestSnapshot);
+
 	// Socket stuff
-	int sockfd = handshake(argv[1]);
+	clientTransport transport;
+	handshake(&transport, argv[1]);
 	int cmd = CMD_LEFT;				// command to send to Roomba
 
 	Vector* episodeList = g_epMem->array[0];
@@ -515,24 +670,35 @@ int main(int argc, char *argv[])
 	while(1)
 	{	       
 		// receive the sensor data
-		recvCommand(sockfd, buf);
+		recvCommand(&transport, buf);
 		// determine the next command to send
 		processCommand(&cmd, buf, log);
 
 		// If goal is found increase goal count and store the index it was found at
 //		if(((Episode*)getEntry(episodeList, episodeList->size - 1))->sensors[SNSR_IR] == 1)
-		if(((Episode*)episodeList->array[episodeList->size - 1])->sensors[SNSR_IR] == 1)
+		if(episodeLast(episodeList)->sensors[SNSR_IR] == 1)
 		{
-			reportGoalFound(sockfd, log);
+			reportGoalFound(&transport, log);
 		}
 		else
 		{
-			if(sendCommand(sockfd, cmd) < 0)
+			if(sendCommand(&transport, cmd) < 0)
 			{
 				perror("Error sending to socket");
 			}
 		}
 
+		// Report on memory and timing if asked
+		if(g_snapshot)
+		{
+			g_snapshot = 0;
+			logSnapshot(&transport, log);
+		}
+		if(g_statsEvery > 0 && g_ticks % g_statsEvery == 0)
+		{
+			logStats(log);
+		}
+
 		// Once we've found all the goals, print out some data about the search
 		if(g_goalsFound >= NUM_GOALS_TO_FIND)
 		{
@@ -543,12 +709,26 @@ int main(int argc, char *argv[])
 		}
 
 	}// while
+	printResult();
 
 	// End Supervisor, call frees memory associated with Supervisor vectors
 	endSupervisor();
 
+	// Write out the trace, if there is one
+	if(g_traceFile != NULL)
+	{
+		trPrintStats(stdout);
+		if(trDump(g_traceFile) != TR_SUCCESS)
+		{
+			fprintf(stderr, "Cannot write the trace to %s\n", g_traceFile);
+		}
+		trStop();
+	}
+
 	// close the connection to Roomba server
-	close(sockfd);
+	ctPrintLatency(&transport, stdout);
+	ctPrintLatency(&transport, log);
+	ctClose(&transport);
 	fclose(log);
 
 	return 0;
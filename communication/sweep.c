@@ -0,0 +1,632 @@
+/**
+ * sweep.c
+ *
+ * Run an agent over every combination of a set of parameters, as many
+ * runs at a time as there are cores, and collect what each run did into
+ * one file with a row per run and a column per parameter or result.
+ * This takes the place of starting a server and a client by hand for
+ * each run (as gatherData.sh does) and collating their logs.
+ *
+ * The sweep is described by a spec file with one parameter per line,
+ * its name followed by the values to try.  For example
+ *
+ *   # K_NEAREST against the discount for NSM on two maps
+ *   agent            mccallum
+ *   map              1 3
+ *   seed             1-10
+ *   K_NEAREST        4 8 16
+ *   DISCOUNT         0.8 0.9
+ *   timeout          600
+ *
+ * is 120 runs.  The parameters are
+ *
+ *   agent    supervisor, mccallum and/or soar (default supervisor)
+ *   map      the map number in world.maps or, for soar, the Eaters wall
+ *            type (see eaters.h) (default 1)
+ *   seed     the seed for rand(), given to the client with -s (default 1)
+ *   timeout  the seconds after which a run is killed (default none)
+ *   cflags   the compiler options for the agents: the rest of the line
+ *            (default -O2)
+ *
+ * map and seed also take ranges, e.g. 1-10.  Any other name in capitals
+ * is a #define of the agent, such as K_NEAREST or DISCOUNT in nsm.h, and
+ * is given to the compiler with -D.  Only the defines inside #ifndef in
+ * the agent's header can be set this way, and not every agent uses every
+ * one of them.
+ *
+ * Each agent is built once for each combination of #defines, before any
+ * run starts, by its in-process target in the makefile (supLocal,
+ * mccLocal or soarLocal), so sweep.out must be run from communication/.
+ * Note that this moves the usual binary (e.g. supervisorLocal.out) into
+ * the output directory.  The runs are then handed out to a pool of
+ * worker processes.  Each is a client run in stats mode with its
+ * environment linked in, in a directory of its own under the output
+ * directory that keeps its output and log.  As each run ends its row is
+ * added to results.csv in the output directory, so a long sweep can be
+ * watched, or cut short, as it goes.  The columns are
+ *
+ *   run, agent, map, seed, one per #define, status (ok, timeout, exit N
+ *   or signal N), secs (of wall clock), ticks, us_per_tick, goals, steps
+ *   (to find each goal, as in the client's log) and score (of each
+ *   Eaters run)
+ *
+ * Usage: sweep.out [-j workers] [-o dir] <spec file>
+ *
+ * -j defaults to the number of cores and -o to "sweep".
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "../vector/vector.h"
+
+#define DEFAULT_DIR "sweep"
+#define DEFAULT_CFLAGS "-O2"
+#define MAX_LINE 1024
+#define MAX_PATH 1024
+#define MAX_DEFINES 16
+
+typedef struct AgentStruct
+{
+  char * name;		// as given in the spec
+  char * target;	// the makefile target that builds it
+  char * binary;	// what the target builds
+} Agent;
+
+static Agent agents[] = {
+  { "supervisor", "supLocal", "supervisorLocal.out" },
+  { "mccallum", "mccLocal", "mccallumLocal.out" },
+  { "soar", "soarLocal", "soarLocal.out" },
+};
+#define NUM_AGENTS (sizeof(agents) / sizeof(Agent))
+
+// A parameter and the values to try, each a char *
+typedef struct ParamStruct
+{
+  char name[MAX_LINE];
+  Vector * values;
+} Param;
+
+// A run in progress
+typedef struct WorkerStruct
+{
+  pid_t pid;		// 0 if the worker is idle
+  int run;
+  struct timespec start;
+} Worker;
+
+static Param agentParam, mapParam, seedParam;
+static Param defines[MAX_DEFINES];
+static int numDefines = 0;
+static char cflags[MAX_LINE] = DEFAULT_CFLAGS;
+static int timeout = 0;
+
+static char * outDir = DEFAULT_DIR;
+static char cwd[MAX_PATH];
+static char absOutDir[MAX_PATH];	// outDir from anywhere
+static int numBuilds, numRuns;
+static FILE * results;
+
+
+/**
+ * fail
+ *
+ * Print a message and exit.
+ */
+static void fail(char * what, char * detail)
+{
+  fprintf(stderr, "sweep: %s%s%s\n", what, detail ? ": " : "",
+	  detail ? detail : "");
+  exit(1);
+}
+
+/**
+ * appendf
+ *
+ * Add to the end of the string in buf, which has room for size bytes,
+ * as snprintf() would, but fail rather than cut it short.
+ */
+static void appendf(char * buf, size_t size, const char * format, ...)
+{
+  size_t n = strlen(buf);
+  va_list args;
+  int len;
+
+  va_start(args, format);
+  len = vsnprintf(buf + n, size - n, format, args);
+  va_end(args);
+
+  if(len < 0 || (size_t)len >= size - n) fail("too long", buf);
+}
+
+/**
+ * isValue
+ *
+ * @returns nonzero if s is safe to put on a command line and in a
+ * column, e.g. 8, 0.75 or (20).
+ */
+static int isValue(char * s)
+{
+  if(*s == '\0') return 0;
+
+  for(; *s != '\0'; s++)
+    {
+      if(!(*s >= '0' && *s <= '9') && !(*s >= 'a' && *s <= 'z')
+	 && !(*s >= 'A' && *s <= 'Z') && strchr("._-+()", *s) == NULL)
+	return 0;
+    }
+
+  return 1;
+}
+
+/**
+ * isDefineName
+ *
+ * @returns nonzero if s looks like the name of a #define, e.g. K_NEAREST.
+ */
+static int isDefineName(char * s)
+{
+  if(!(*s >= 'A' && *s <= 'Z')) return 0;
+
+  for(; *s != '\0'; s++)
+    {
+      if(!(*s >= 'A' && *s <= 'Z') && !(*s >= '0' && *s <= '9') && *s != '_')
+	return 0;
+    }
+
+  return 1;
+}
+
+/**
+ * addValues
+ *
+ * Add the values in the rest of a line, split by strtok(), to a
+ * parameter.  If ranges is set a value like 1-10 stands for each number
+ * from 1 to 10.
+ */
+static void addValues(Param * param, int ranges)
+{
+  char * value;
+  char number[32];
+  int first, last, i;
+
+  if(param->values->size > 0) fail("parameter given twice", param->name);
+
+  while((value = strtok(NULL, " \t\r\n")) != NULL)
+    {
+      if(!isValue(value)) fail("bad value", value);
+
+      if(ranges && sscanf(value, "%d-%d", &first, &last) == 2)
+	{
+	  if(last < first) fail("bad range", value);
+	  for(i = first; i <= last; i++)
+	    {
+	      sprintf(number, "%d", i);
+	      addEntry(param->values, strdup(number));
+	    }
+	}
+      else addEntry(param->values, strdup(value));
+    }
+
+  if(param->values->size == 0) fail("no values given for", param->name);
+}
+
+/**
+ * initParam
+ *
+ * Name a parameter and give it no values yet.
+ */
+static void initParam(Param * param, char * name)
+{
+  strncpy(param->name, name, MAX_LINE - 1);
+  param->name[MAX_LINE - 1] = '\0';
+  param->values = newVector();
+}
+
+/**
+ * readSpec
+ *
+ * Read the parameters of the sweep from a spec file (see the top of
+ * this file) and fill in the defaults.
+ */
+static void readSpec(char * fileName)
+{
+  char line[MAX_LINE];
+  char * name, * rest;
+  FILE * spec;
+  int i;
+
+  initParam(&agentParam, "agent");
+  initParam(&mapParam, "map");
+  initParam(&seedParam, "seed");
+
+  if((spec = fopen(fileName, "r")) == NULL) fail("cannot read", fileName);
+
+  while(fgets(line, MAX_LINE, spec) != NULL)
+    {
+      if((rest = strchr(line, '#')) != NULL) *rest = '\0';
+      if((name = strtok(line, " \t\r\n")) == NULL) continue;
+
+      if(strcmp(name, "agent") == 0) addValues(&agentParam, 0);
+      else if(strcmp(name, "map") == 0) addValues(&mapParam, 1);
+      else if(strcmp(name, "seed") == 0) addValues(&seedParam, 1);
+      else if(strcmp(name, "timeout") == 0)
+	{
+	  if((rest = strtok(NULL, " \t\r\n")) == NULL || atoi(rest) < 0)
+	    fail("bad timeout", rest);
+	  timeout = atoi(rest);
+	}
+      else if(strcmp(name, "cflags") == 0)
+	{
+	  if((rest = strtok(NULL, "\r\n")) == NULL) rest = "";
+	  if(strchr(rest, '\'') != NULL) fail("bad cflags", rest);
+	  strcpy(cflags, rest);
+	}
+      else if(isDefineName(name))
+	{
+	  if(numDefines == MAX_DEFINES) fail("too many #defines", name);
+	  for(i = 0; i < numDefines; i++)
+	    {
+	      if(strcmp(defines[i].name, name) == 0)
+		fail("parameter given twice", name);
+	    }
+	  initParam(&defines[numDefines], name);
+	  addValues(&defines[numDefines], 0);
+	  numDefines++;
+	}
+      else fail("unknown parameter", name);
+    }
+  fclose(spec);
+
+  if(agentParam.values->size == 0) addEntry(agentParam.values, "supervisor");
+  if(mapParam.values->size == 0) addEntry(mapParam.values, "1");
+  if(seedParam.values->size == 0) addEntry(seedParam.values, "1");
+
+  for(i = 0; i < agentParam.values->size; i++)
+    {
+      int a;
+      for(a = 0; a < (int)NUM_AGENTS; a++)
+	{
+	  if(strcmp(agentParam.values->array[i], agents[a].name) == 0) break;
+	}
+      if(a == (int)NUM_AGENTS) fail("unknown agent", agentParam.values->array[i]);
+    }
+
+  // The #defines vary slowest, then the map and then the seed
+  numBuilds = agentParam.values->size;
+  for(i = 0; i < numDefines; i++) numBuilds *= defines[i].values->size;
+  numRuns = numBuilds * mapParam.values->size * seedParam.values->size;
+}
+
+/**
+ * buildAgent, buildDefine
+ *
+ * @returns the agent, or the value of the ith #define, that build b is
+ * built with.  The builds are numbered with the agent varying slowest
+ * and the last #define fastest.
+ */
+static Agent * buildAgent(int b)
+{
+  char * name;
+  int i, a;
+
+  for(i = 0; i < numDefines; i++) b /= defines[i].values->size;
+  name = agentParam.values->array[b];
+
+  for(a = 0; strcmp(agents[a].name, name) != 0; a++);
+
+  return &agents[a];
+}
+
+static char * buildDefine(int b, int i)
+{
+  int j;
+
+  for(j = numDefines - 1; j > i; j--) b /= defines[j].values->size;
+
+  return defines[i].values->array[b % defines[i].values->size];
+}
+
+/**
+ * buildPath
+ *
+ * Fill path with where build b of the agent is kept.
+ */
+static void buildPath(char * path, int b)
+{
+  path[0] = '\0';
+  appendf(path, MAX_PATH, "%s/%s-%d.out", absOutDir, buildAgent(b)->name,
+	  b + 1);
+}
+
+/**
+ * buildAll
+ *
+ * Build the agent once for each combination of #defines with the
+ * makefile, and move each binary into the output directory.
+ */
+static void buildAll()
+{
+  char command[4 * MAX_LINE];
+  char path[MAX_PATH];
+  int b, i;
+
+  for(b = 0; b < numBuilds; b++)
+    {
+      Agent * agent = buildAgent(b);
+
+      command[0] = '\0';
+      appendf(command, sizeof(command), "make -B %s DEBUG_OPT='%s",
+	      agent->target, cflags);
+      for(i = 0; i < numDefines; i++)
+	{
+	  appendf(command, sizeof(command), " -D%s=%s", defines[i].name,
+		  buildDefine(b, i));
+	}
+      appendf(command, sizeof(command), "' > %s/build-%d.log 2>&1", outDir,
+	      b + 1);
+
+      printf("Building %s (%d of %d)\n", agent->name, b + 1, numBuilds);
+      fflush(stdout);
+      if(system(command) != 0)
+	{
+	  path[0] = '\0';
+	  appendf(path, MAX_PATH, "%s/build-%d.log", outDir, b + 1);
+	  fail("the build failed; see", path);
+	}
+
+      buildPath(path, b);
+      if(rename(agent->binary, path) != 0) fail("cannot move", agent->binary);
+    }
+}
+
+/**
+ * runParams
+ *
+ * Find the build, map and seed of run r.  The seed varies fastest.
+ */
+static void runParams(int r, int * build, char ** map, char ** seed)
+{
+  int numSeeds = seedParam.values->size;
+  int numMaps = mapParam.values->size;
+
+  *seed = seedParam.values->array[r % numSeeds];
+  *map = mapParam.values->array[(r / numSeeds) % numMaps];
+  *build = r / (numSeeds * numMaps);
+}
+
+/**
+ * startRun
+ *
+ * Start run r in a worker process, in a directory of its own so that
+ * its log doesn't mix with the others'.
+ *
+ * @returns the worker's pid.
+ */
+static pid_t startRun(int r)
+{
+  char dir[MAX_PATH], path[MAX_PATH], maps[MAX_PATH];
+  char * map, * seed;
+  int build, fd;
+  pid_t pid;
+
+  runParams(r, &build, &map, &seed);
+  buildPath(path, build);
+  dir[0] = maps[0] = '\0';
+  appendf(dir, MAX_PATH, "%s/%04d", outDir, r + 1);
+  appendf(maps, MAX_PATH, "%s/world.maps", cwd);
+
+  if(mkdir(dir, 0777) != 0 && errno != EEXIST) fail("cannot make", dir);
+
+  if((pid = fork()) < 0) fail("cannot fork", NULL);
+  if(pid > 0) return pid;
+
+  // The worker: its environment wants world.maps in the current directory
+  if(chdir(dir) != 0) _exit(127);
+  symlink(maps, "world.maps");
+
+  fd = open("output.txt", O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if(fd < 0) _exit(127);
+  dup2(fd, STDOUT_FILENO);
+  dup2(fd, STDERR_FILENO);
+  close(fd);
+  fd = open("/dev/null", O_RDONLY);
+  dup2(fd, STDIN_FILENO);
+  close(fd);
+
+  // The alarm outlives the exec and kills the run if it goes on too long
+  alarm(timeout);
+  execl(path, path, map, "-m", "stats", "-s", seed, (char *)NULL);
+  _exit(127);
+}
+
+/**
+ * printHeader
+ *
+ * Start results.csv with the name of each column.
+ */
+static void printHeader()
+{
+  int i;
+
+  fprintf(results, "run,agent,map,seed");
+  for(i = 0; i < numDefines; i++) fprintf(results, ",%s", defines[i].name);
+  fprintf(results, ",status,secs,ticks,us_per_tick,goals,steps,score\n");
+  fflush(results);
+}
+
+/**
+ * finishRun
+ *
+ * Add the row for a run that has ended to results.csv, taking its
+ * results from the "Result:" line the client prints last.  A run that
+ * was killed has no such line, so its goals and steps are taken from the
+ * line the client printed as it found each goal.
+ */
+static void finishRun(Worker * w, int status)
+{
+  char line[MAX_LINE], steps[MAX_LINE] = "", score[MAX_LINE] = "";
+  char path[MAX_PATH], how[32];
+  struct timespec now;
+  char * map, * seed;
+  int build, ticks = 0, goals = 0, found = 0;
+  int goalsSoFar = 0, n = 0, goal, step;
+  double secs;
+  FILE * output;
+  int i;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  secs = (now.tv_sec - w->start.tv_sec) + (now.tv_nsec - w->start.tv_nsec) / 1e9;
+  runParams(w->run, &build, &map, &seed);
+
+  if(WIFEXITED(status) && WEXITSTATUS(status) == 0) strcpy(how, "ok");
+  else if(WIFEXITED(status)) sprintf(how, "exit %d", WEXITSTATUS(status));
+  else if(WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM)
+    strcpy(how, "timeout");
+  else sprintf(how, "signal %d", WTERMSIG(status));
+
+  path[0] = '\0';
+  appendf(path, MAX_PATH, "%s/%04d/output.txt", outDir, w->run + 1);
+  if((output = fopen(path, "r")) != NULL)
+    {
+      while(fgets(line, MAX_LINE, output) != NULL)
+	{
+	  if(sscanf(line, "Result: ticks %d goals %d steps %1023s score %1023s",
+		    &ticks, &goals, steps, score) == 4)
+	    found = 1;
+	  else if(!found && n < MAX_LINE - 16
+		  && (sscanf(line, "Goal %d found after %d", &goal, &step) == 2
+		      || sscanf(line, "Goal %d found at timestamp %d", &goal,
+				&step) == 2))
+	    {
+	      n += sprintf(steps + n, "%s%d", (goalsSoFar > 0 ? ":" : ""), step);
+	      goalsSoFar++;
+	    }
+	}
+      fclose(output);
+    }
+  if(strcmp(steps, "-") == 0) steps[0] = '\0';
+  if(strcmp(score, "-") == 0) score[0] = '\0';
+
+  fprintf(results, "%d,%s,%s,%s", w->run + 1, buildAgent(build)->name, map,
+	  seed);
+  for(i = 0; i < numDefines; i++)
+    {
+      fprintf(results, ",%s", buildDefine(build, i));
+    }
+  fprintf(results, ",%s,%.3f", how, secs);
+  if(found)
+    {
+      fprintf(results, ",%d,%.1f,%d,%s,%s\n", ticks,
+	      (ticks > 0 ? secs * 1e6 / ticks : 0.0), goals, steps, score);
+    }
+  else if(goalsSoFar > 0) fprintf(results, ",,,%d,%s,\n", goalsSoFar, steps);
+  else fprintf(results, ",,,,,\n");
+  fflush(results);
+
+  printf("Run %d: %s after %.1f s\n", w->run + 1, how, secs);
+  fflush(stdout);
+}
+
+/**
+ * runAll
+ *
+ * Keep every worker busy until all the runs are done.
+ */
+static void runAll(int numWorkers)
+{
+  Worker * workers = (Worker *)calloc(numWorkers, sizeof(Worker));
+  int next = 0, running = 0;
+  int status, i;
+  pid_t pid;
+
+  while(next < numRuns || running > 0)
+    {
+      // Hand out runs to the idle workers
+      for(i = 0; i < numWorkers && next < numRuns; i++)
+	{
+	  if(workers[i].pid != 0) continue;
+	  workers[i].run = next;
+	  clock_gettime(CLOCK_MONOTONIC, &workers[i].start);
+	  workers[i].pid = startRun(next);
+	  next++;
+	  running++;
+	}
+
+      if((pid = wait(&status)) < 0)
+	{
+	  if(errno == EINTR) continue;
+	  fail("wait failed", strerror(errno));
+	}
+
+      for(i = 0; i < numWorkers; i++)
+	{
+	  if(workers[i].pid != pid) continue;
+	  finishRun(&workers[i], status);
+	  workers[i].pid = 0;
+	  running--;
+	  break;
+	}
+    }
+
+  free(workers);
+}
+
+int main(int argc, char * argv[])
+{
+  char path[MAX_PATH];
+  int numWorkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  int opt;
+
+  while((opt = getopt(argc, argv, "j:o:")) != -1)
+    {
+      if(opt == 'j' && atoi(optarg) > 0) numWorkers = atoi(optarg);
+      else if(opt == 'o') outDir = optarg;
+      else
+	{
+	  fprintf(stderr, "Usage: %s [-j workers] [-o dir] <spec file>\n",
+		  argv[0]);
+	  return 1;
+	}
+    }
+  if(optind != argc - 1)
+    {
+      fprintf(stderr, "Usage: %s [-j workers] [-o dir] <spec file>\n", argv[0]);
+      return 1;
+    }
+  if(numWorkers < 1) numWorkers = 1;
+
+  readSpec(argv[optind]);
+
+  // The builds and world.maps are found from here
+  if(access("makefile", R_OK) != 0 || access("world.maps", R_OK) != 0)
+    fail("run sweep.out from the communication directory", NULL);
+  if(getcwd(cwd, MAX_PATH) == NULL) fail("cannot find the current directory", NULL);
+  if(outDir[0] != '/') appendf(absOutDir, MAX_PATH, "%s/", cwd);
+  appendf(absOutDir, MAX_PATH, "%s", outDir);
+  if(mkdir(outDir, 0777) != 0) fail("cannot make (or already made)", outDir);
+
+  path[0] = '\0';
+  appendf(path, MAX_PATH, "%s/results.csv", outDir);
+  if((results = fopen(path, "w")) == NULL) fail("cannot write", path);
+
+  printf("%d runs of %d builds on %d workers\n", numRuns, numBuilds,
+	 numWorkers);
+  buildAll();
+  printHeader();
+  runAll(numWorkers);
+  fclose(results);
+
+  printf("Results are in %s\n", path);
+
+  return 0;
+}
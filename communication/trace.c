@@ -0,0 +1,401 @@
+/**
+ * trace.c
+ *
+ * The ring of trace events and the code that writes it to a file.
+ * See trace.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "trace.h"
+
+// The ring.  Event number n goes in slot n & mask.  ring is NULL
+// while tracing is off.
+static trEvent * ring = NULL;
+static uint32_t mask = 0;
+
+// The number of events claimed so far, including any overwritten.
+static volatile uint32_t next = 0;
+
+// The tick number stamped on each event, set by TR_TICK.
+static volatile uint32_t currTick = 0;
+
+static uint64_t started = 0;
+static char agentName[TR_AGENT_NAME_SIZE];
+
+// The phase histograms (see trTimePhases()).  began is per thread so
+// that the pipelined worker's phases don't end the main thread's.
+static volatile int timing = 0;
+static __thread uint64_t began[TR_NUM_PHASES];
+static volatile uint32_t phaseHist[TR_NUM_PHASES][TR_NUM_BUCKETS];
+static volatile uint64_t phaseCount[TR_NUM_PHASES];
+static volatile uint64_t phaseTotalNs[TR_NUM_PHASES];
+static volatile uint64_t phaseMaxNs[TR_NUM_PHASES];
+
+static char * phaseNames[TR_NUM_PHASES] = {
+  "tick", "update", "start", "plan", "replace", "choose",
+};
+
+
+/**
+ * trNow
+ *
+ * @returns the monotonic clock in nanoseconds.
+ */
+static uint64_t trNow()
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/**
+ * trTimePhase
+ *
+ * Note the beginning of a phase, or add the time since it began to its
+ * histogram.
+ *
+ * @param[in] type TR_BEGIN or TR_END.
+ * @param[in] phase a trPhase.
+ * @param[in] now when, from trNow().
+ */
+static void trTimePhase(int type, int phase, uint64_t now)
+{
+  uint64_t ns, max;
+  uint64_t limit = 2000;
+  int bucket = 0;
+
+  if(phase < 0 || phase >= TR_NUM_PHASES) return;
+
+  if(type == TR_BEGIN)
+    {
+      began[phase] = now;
+      return;
+    }
+
+  // A phase that was under way when timing was turned on
+  if(began[phase] == 0) return;
+
+  ns = now - began[phase];
+  began[phase] = 0;
+
+  while(ns >= limit && bucket < TR_NUM_BUCKETS - 1)
+    {
+      limit *= 2;
+      bucket++;
+    }
+
+  __sync_fetch_and_add(&phaseHist[phase][bucket], 1);
+  __sync_fetch_and_add(&phaseCount[phase], 1);
+  __sync_fetch_and_add(&phaseTotalNs[phase], ns);
+
+  max = phaseMaxNs[phase];
+  while(ns > max && !__sync_bool_compare_and_swap(&phaseMaxNs[phase], max, ns))
+    {
+      max = phaseMaxNs[phase];
+    }
+}
+
+/**
+ * trStart
+ *
+ * Turn tracing on, discarding any earlier trace.
+ *
+ * @param[in] agent the name of the agent being traced, e.g.
+ * "supervisor".  traceDump uses it to name the commands.
+ * @param[in] numEvents how many events to keep, at most TR_MAX_EVENTS.
+ * It is rounded up to a power of two.
+ *
+ * @returns TR_SUCCESS, TR_BAD_SIZE or TR_NO_MEMORY.
+ */
+int trStart(char * agent, int numEvents)
+{
+  uint32_t size = 1;
+
+  if(numEvents < 1 || numEvents > TR_MAX_EVENTS) return TR_BAD_SIZE;
+
+  while(size < (uint32_t)numEvents) size <<= 1;
+
+  trStop();
+
+  // calloc() so that every slot starts out unwritten (seq 0).
+  ring = (trEvent *)calloc(size, sizeof(trEvent));
+  if(ring == NULL) return TR_NO_MEMORY;
+
+  mask = size - 1;
+  next = 0;
+  currTick = 0;
+  strncpy(agentName, agent, TR_AGENT_NAME_SIZE - 1);
+  agentName[TR_AGENT_NAME_SIZE - 1] = '\0';
+  started = trNow();
+
+  return TR_SUCCESS;
+}
+
+/**
+ * trRecord
+ *
+ * Record an event, overwriting the oldest if the ring is full, and
+ * time the phase it begins or ends.  Does nothing unless tracing or
+ * timing is on.
+ *
+ * @param[in] type a trType.
+ * @param[in] arg, a, b, c what the event says; see trType.
+ */
+void trRecord(int type, int arg, int a, int b, int c)
+{
+  uint64_t now;
+  uint32_t n;
+  trEvent * e;
+
+  if(ring == NULL && !timing) return;
+
+  now = trNow();
+
+  if(timing && (type == TR_BEGIN || type == TR_END))
+    {
+      trTimePhase(type, arg, now);
+    }
+
+  if(ring == NULL) return;
+
+  n = __sync_fetch_and_add(&next, 1);
+  e = &ring[n & mask];
+
+  e->seq = 0;
+  __sync_synchronize();
+
+  if(type == TR_TICK) currTick = a;
+
+  e->when = now - started;
+  e->tick = currTick;
+  e->type = type;
+  e->arg = arg;
+  e->a = a;
+  e->b = b;
+  e->c = c;
+
+  __sync_synchronize();
+  e->seq = n + 1;
+}
+
+/**
+ * trBits
+ *
+ * Pack an array of 0s and 1s, such as a sensing, into one int for
+ * TR_SENSING.  The first value is the most significant bit.
+ *
+ * @param[in] values the values.
+ * @param[in] n how many there are, at most 31.
+ *
+ * @returns the packed bits.
+ */
+int trBits(int * values, int n)
+{
+  int bits = 0;
+  int i = 0;
+
+  for(i = 0; i < n; i++)
+    {
+      bits = (bits << 1) | (values[i] != 0);
+    }
+
+  return bits;
+}
+
+/**
+ * trDump
+ *
+ * Write the events in the ring to a file, oldest first, for
+ * traceDump.  Events may go on being recorded while this runs; any
+ * slot overwritten before it is copied is left out.
+ *
+ * @param[in] path where to write the trace.
+ *
+ * @returns TR_SUCCESS, TR_NOT_STARTED or TR_CANNOT_OPEN.
+ */
+int trDump(char * path)
+{
+  uint32_t header[3];
+  uint32_t end = next;
+  uint32_t first = 0;
+  uint32_t n = 0;
+  trEvent e;
+  FILE * out;
+
+  if(ring == NULL) return TR_NOT_STARTED;
+
+  out = fopen(path, "wb");
+  if(out == NULL) return TR_CANNOT_OPEN;
+
+  header[0] = TR_VERSION;
+  header[1] = sizeof(trEvent);
+  header[2] = end;
+  fwrite(TR_MAGIC, 1, strlen(TR_MAGIC), out);
+  fwrite(header, sizeof(uint32_t), 3, out);
+  fwrite(agentName, 1, TR_AGENT_NAME_SIZE, out);
+
+  if(end > mask + 1) first = end - (mask + 1);
+
+  for(n = first; n != end; n++)
+    {
+      e = ring[n & mask];
+      if(e.seq != n + 1) continue;
+
+      fwrite(&e, sizeof(trEvent), 1, out);
+    }
+
+  fclose(out);
+
+  return TR_SUCCESS;
+}
+
+/**
+ * trPrintStats
+ *
+ * Print how many events were recorded and how many of those the ring
+ * still holds.
+ *
+ * @param[in] out where to print it (e.g., stdout or a log file).
+ */
+void trPrintStats(FILE * out)
+{
+  uint32_t end = next;
+
+  if(ring == NULL) return;
+
+  fprintf(out, "Trace: %u events recorded, the last %u kept\n",
+	  end, end > mask + 1 ? mask + 1 : end);
+  fflush(out);
+}
+
+/**
+ * trStop
+ *
+ * Turn tracing off and free the ring.
+ */
+void trStop()
+{
+  trEvent * old = ring;
+
+  ring = NULL;
+  free(old);
+}
+
+/**
+ * trTimePhases
+ *
+ * Turn the phase histograms on, discarding any earlier times, or off.
+ *
+ * @param[in] on 1 to turn them on, 0 to turn them off.
+ */
+void trTimePhases(int on)
+{
+  int p = 0;
+
+  timing = 0;
+  if(!on) return;
+
+  memset((void *)phaseHist, 0, sizeof(phaseHist));
+  for(p = 0; p < TR_NUM_PHASES; p++)
+    {
+      phaseCount[p] = 0;
+      phaseTotalNs[p] = 0;
+      phaseMaxNs[p] = 0;
+    }
+
+  timing = 1;
+}
+
+/**
+ * trPercentile
+ *
+ * @returns an upper bound, in microseconds, on the given fraction
+ * (e.g. 0.99) of the times phase p was timed.
+ */
+static double trPercentile(int p, double fraction)
+{
+  double maxUs = phaseMaxNs[p] / 1000.0;
+  double limit = 2.0;
+  uint64_t seen = 0;
+  int i;
+
+  for(i = 0; i < TR_NUM_BUCKETS; i++, limit *= 2)
+    {
+      seen += phaseHist[p][i];
+      if(seen >= fraction * phaseCount[p])
+	{
+	  return (limit < maxUs ? limit : maxUs);
+	}
+    }
+
+  return maxUs;
+}
+
+/**
+ * trPrintPhases
+ *
+ * Print how many times each phase was timed, how long it took and its
+ * histogram.  The histograms may go on changing while this runs, so
+ * the numbers printed may disagree slightly.
+ *
+ * @param[in] out where to print it (e.g., stdout or a log file).
+ */
+void trPrintPhases(FILE * out)
+{
+  double limit = 1.0;
+  int p, i;
+
+  if(out == NULL) return;
+
+  fprintf(out, "%-8s %10s %12s %10s %10s %10s %10s\n", "phase", "count",
+	  "total ms", "mean us", "p50 us <", "p99 us <", "max us");
+  for(p = 0; p < TR_NUM_PHASES; p++)
+    {
+      if(phaseCount[p] == 0) continue;
+
+      fprintf(out, "%-8s %10llu %12.1f %10.1f %10.0f %10.0f %10.1f\n",
+	      phaseNames[p], (unsigned long long)phaseCount[p],
+	      phaseTotalNs[p] / 1e6, phaseTotalNs[p] / 1000.0 / phaseCount[p],
+	      trPercentile(p, 0.50), trPercentile(p, 0.99),
+	      phaseMaxNs[p] / 1000.0);
+
+      fprintf(out, "   ");
+      for(i = 0, limit = 1.0; i < TR_NUM_BUCKETS; i++, limit *= 2)
+	{
+	  if(phaseHist[p][i] == 0) continue;
+	  fprintf(out, " %.0fus+:%u", (i == 0 ? 0 : limit), phaseHist[p][i]);
+	}
+      fprintf(out, "\n");
+    }
+
+  fflush(out);
+}
+
+/**
+ * trPrintPhasesShort
+ *
+ * Print the mean and 99th percentile of each phase timed, on one line
+ * and without a newline, for the clients' periodic log line.
+ *
+ * @param[in] out where to print it.
+ */
+void trPrintPhasesShort(FILE * out)
+{
+  int p = 0;
+
+  if(out == NULL) return;
+
+  fprintf(out, "us mean/p99");
+  for(p = 0; p < TR_NUM_PHASES; p++)
+    {
+      if(phaseCount[p] == 0) continue;
+
+      fprintf(out, " %s %.1f/%.0f", phaseNames[p],
+	      phaseTotalNs[p] / 1000.0 / phaseCount[p], trPercentile(p, 0.99));
+    }
+}
@@ -0,0 +1,145 @@
+/**
+ * trace.h
+ *
+ * A flight recorder for the agents (supervisor.c, nsm.c, soar.c).
+ * Rather than printing from inside their hot loops, the agents record
+ * small fixed-size binary events -- tick boundaries, the start and
+ * end of each phase of a tick, sensings, commands, matches, plans and
+ * replacements -- in a ring in memory.  Recording an event takes a
+ * clock read and a few stores; nothing is formatted and nothing goes
+ * to stdout.  When the ring is full the oldest events are overwritten.
+ *
+ * The clients write the ring to a file when the run ends (-T <file>)
+ * and traceDump.c turns the file back into readable output, along
+ * with a summary of how long each phase took.
+ *
+ * Tracing is off until trStart() is called, and then trRecord()
+ * returns at once.  Events may be recorded from more than one thread
+ * (e.g. tickPipelined()'s worker): each claims its slot with an
+ * atomic increment, so no lock is taken.
+ *
+ * Separately from the ring, trTimePhases() keeps a histogram of how
+ * long each phase takes.  It costs no memory as the run goes on, so
+ * the clients leave it on for the whole run and print it with
+ * trPrintPhases() when asked (see the clients' -S option and SIGUSR1).
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+/**
+ *  CONSTANT DEFINITIONS.  All constants in this file should begin
+ *  with 'TR' to indicate their membership in trace.h
+ */
+#define TR_SUCCESS (0)
+#define TR_BAD_SIZE (-1)
+#define TR_NO_MEMORY (-2)
+#define TR_NOT_STARTED (-3)
+#define TR_CANNOT_OPEN (-4)
+#define TR_BAD_TRACE (-5)
+
+// The number of events the ring holds.  It is rounded up to a power
+// of two.  At 32 bytes each the default is 2MB, a few thousand ticks.
+#define TR_DEFAULT_EVENTS (1 << 16)
+#define TR_MAX_EVENTS (1 << 24)
+
+// Bucket i of a phase's histogram counts the times the phase took
+// between 2^i and 2^(i+1) microseconds.  Bucket 0 also counts anything
+// shorter and the last bucket anything longer.
+#define TR_NUM_BUCKETS 24
+
+// A trace file is a header -- TR_MAGIC, the 4 byte TR_VERSION, the 4
+// byte size of an event, the 4 byte number of events recorded in all
+// and the TR_AGENT_NAME_SIZE byte name of the agent -- followed by the
+// events still in the ring, oldest first.  Numbers are in the byte
+// order of the machine that wrote the trace.
+#define TR_MAGIC "UPTR"
+#define TR_VERSION 1
+#define TR_AGENT_NAME_SIZE 16
+
+// The kinds of event.  What arg, a, b and c hold depends on the kind.
+typedef enum trTypeTag trType;
+enum trTypeTag {
+  TR_TICK,        // A tick began.  a = the tick number.
+  TR_BEGIN,       // A phase began.  arg = the phase.
+  TR_END,         // A phase ended.  arg = the phase.
+  TR_SENSING,     // a = the sensors, one bit each, b = the time stamp.
+  TR_COMMAND,     // a = the command chosen, arg = how (trChoice).
+  TR_GOAL,        // A goal was found.  a = the number found so far.
+  TR_MATCH,       // arg = the level, a = the match length, b = where.
+  TR_PLAN,        // arg = the outcome (trPlanOutcome), a = the level
+                  // of the plan, b = its length.
+  TR_REPL,        // A replacement was considered.  arg = the level,
+                  // a = its index, b = 1 if it matched, c = its
+                  // confidence in thousandths.
+  TR_NUM_TYPES
+};
+
+// The phases of a tick that are timed with TR_BEGIN and TR_END.  Not
+// every agent has every phase.
+typedef enum trPhaseTag trPhase;
+enum trPhaseTag {
+  TR_PH_TICK,     // The whole of tick()
+  TR_PH_UPDATE,   // Learning from the latest sensing
+  TR_PH_START,    // Finding where in memory the agent is
+  TR_PH_PLAN,     // Making a plan
+  TR_PH_REPLACE,  // Finding and applying replacements
+  TR_PH_CHOOSE,   // Choosing the command
+  TR_NUM_PHASES
+};
+
+// How a command was chosen.
+typedef enum trChoiceTag trChoice;
+enum trChoiceTag {
+  TR_BY_PLAN,
+  TR_BY_RANDOM,
+  TR_BY_GOAL,
+  TR_BY_VALUE,     // The command with the best learned value
+};
+
+// What came of an attempt to make a plan.
+typedef enum trPlanOutcomeTag trPlanOutcome;
+enum trPlanOutcomeTag {
+  TR_PLAN_NO_START,   // The agent couldn't tell where it was
+  TR_PLAN_NONE,       // No route to a goal from where it was
+  TR_PLAN_CACHED,     // An earlier plan was handed out again
+  TR_PLAN_MADE,       // A new plan
+};
+
+// An event.  seq is 1 more than the event's position in the trace; it
+// is 0 while the event is being written, and is written last, so a
+// slot that was overwritten part way through a dump can be told from
+// a whole event.
+typedef struct trEventTag {
+  uint64_t when;      // Nanoseconds since trStart()
+  uint32_t seq;
+  uint32_t tick;      // The most recent TR_TICK's tick number
+  uint16_t type;      // A trType
+  uint16_t arg;
+  int32_t a;
+  int32_t b;
+  int32_t c;
+} trEvent;
+
+/**
+ * Function prototypes.  See trace.c for details on
+ * this/these functions.
+ */
+int trStart(char * agent, int numEvents);
+void trRecord(int type, int arg, int a, int b, int c);
+int trBits(int * values, int n);
+int trDump(char * path);
+void trPrintStats(FILE * out);
+void trStop();
+void trTimePhases(int on);
+void trPrintPhases(FILE * out);
+void trPrintPhasesShort(FILE * out);
+
+// Shorthand for the most common events.
+#define trBegin(phase) trRecord(TR_BEGIN, (phase), 0, 0, 0)
+#define trEnd(phase) trRecord(TR_END, (phase), 0, 0, 0)
+
+#endif
@@ -0,0 +1,256 @@
+/**
+ * traceDump.c
+ *
+ * Turn a trace written by trDump() (see trace.h) back into readable
+ * output, one line per event, followed by how long each phase of a
+ * tick took.
+ *
+ * Usage: traceDump.out [-s] <trace file>
+ *
+ * With -s only the summary of the phases is printed.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "communication.h"
+#include "trace.h"
+
+static char * phaseNames[TR_NUM_PHASES] = {
+  "tick", "update", "start", "plan", "replace", "choose",
+};
+
+static char * choiceNames[] = {
+  "from plan", "random", "goal", "by value",
+};
+
+// The commands of the Roomba agents, by number.  See communication.h.
+static char * roombaCommands[] = {
+  "illegal", "no operation", "forward", "left", "right", "adjust left",
+  "adjust right", "song", "blink",
+};
+
+// The commands of the Eaters agent (soar.c).
+static char * eatersCommands[] = {
+  "illegal", "no operation", "north", "south", "east", "west", "reset",
+};
+
+static char ** commands = roombaCommands;
+static int numCommands = sizeof(roombaCommands) / sizeof(char *);
+
+// When each phase last began, and the totals for the summary.
+static uint64_t began[TR_NUM_PHASES];
+static int inPhase[TR_NUM_PHASES];
+static unsigned long count[TR_NUM_PHASES];
+static double totalUs[TR_NUM_PHASES];
+static double maxUs[TR_NUM_PHASES];
+
+
+/**
+ * commandName
+ *
+ * @returns the name of command cmd for the agent traced.
+ */
+static char * commandName(int cmd)
+{
+  if(cmd < 0 || cmd >= numCommands) return "unknown";
+
+  return commands[cmd];
+}
+
+/**
+ * phaseName
+ *
+ * @returns the name of phase p.
+ */
+static char * phaseName(int p)
+{
+  if(p < 0 || p >= TR_NUM_PHASES) return "unknown";
+
+  return phaseNames[p];
+}
+
+/**
+ * printSensing
+ *
+ * Print a sensing the way the supervisor's parseEpisode() did, one
+ * digit per sensor followed by the time stamp.
+ */
+static void printSensing(trEvent * e)
+{
+  int i = 0;
+
+  printf("dataArr=");
+  for(i = NUM_SENSORS - 1; i >= 0; i--)
+    {
+      putchar((e->a >> i) & 1 ? '1' : '0');
+    }
+  printf(" %d\n", e->b);
+}
+
+/**
+ * printEvent
+ *
+ * Print one event, and time the phase it begins or ends.
+ */
+static void printEvent(trEvent * e, int quiet)
+{
+  double us = 0.0;
+  int p = e->arg;
+
+  switch(e->type)
+    {
+    case TR_BEGIN:
+      if(p < TR_NUM_PHASES)
+	{
+	  began[p] = e->when;
+	  inPhase[p] = 1;
+	}
+      return;
+
+    case TR_END:
+      if(p >= TR_NUM_PHASES || !inPhase[p]) return;
+      inPhase[p] = 0;
+      us = (e->when - began[p]) / 1000.0;
+      count[p]++;
+      totalUs[p] += us;
+      if(us > maxUs[p]) maxUs[p] = us;
+      if(!quiet) printf("\t%s took %.1f us\n", phaseName(p), us);
+      return;
+    }
+
+  if(quiet) return;
+
+  switch(e->type)
+    {
+    case TR_TICK:
+      printf("---- tick %d at %.3f ms ----\n", e->a, e->when / 1e6);
+      break;
+
+    case TR_SENSING:
+      printSensing(e);
+      break;
+
+    case TR_COMMAND:
+      printf("Command: %s (%s)\n", commandName(e->a),
+	     e->arg < sizeof(choiceNames) / sizeof(char *)
+	     ? choiceNames[e->arg] : "unknown");
+      break;
+
+    case TR_GOAL:
+      printf("GOAL %d FOUND!\n", e->a);
+      break;
+
+    case TR_MATCH:
+      printf("\tmatch of length %d at index %d in level %d\n",
+	     e->a, e->b, e->arg);
+      break;
+
+    case TR_PLAN:
+      if(e->arg == TR_PLAN_NO_START)
+	printf("\tno plan: start not found\n");
+      else if(e->arg == TR_PLAN_NONE)
+	printf("\tno plan: no route to a goal\n");
+      else
+	printf("\t%s plan at level %d of %d steps\n",
+	       e->arg == TR_PLAN_CACHED ? "cached" : "new", e->a, e->b);
+      break;
+
+    case TR_REPL:
+      printf("\tconsidering replacement %d on level %d (confidence %g)...%s\n",
+	     e->a, e->arg, e->c / 1000.0, e->b ? "match!" : "no match.");
+      break;
+
+    default:
+      printf("\tunknown event %d\n", e->type);
+      break;
+    }
+}
+
+/**
+ * printSummary
+ *
+ * Print the number of times each phase ran and how long it took.
+ */
+static void printSummary()
+{
+  int p = 0;
+
+  printf("%-8s %10s %12s %12s %12s\n", "phase", "count",
+	 "total ms", "mean us", "max us");
+  for(p = 0; p < TR_NUM_PHASES; p++)
+    {
+      if(count[p] == 0) continue;
+
+      printf("%-8s %10lu %12.1f %12.1f %12.1f\n", phaseNames[p], count[p],
+	     totalUs[p] / 1000.0, totalUs[p] / count[p], maxUs[p]);
+    }
+}
+
+int main(int argc, char * argv[])
+{
+  char magic[sizeof(TR_MAGIC)];
+  char agent[TR_AGENT_NAME_SIZE];
+  uint32_t header[3];
+  unsigned long numRead = 0;
+  int quiet = 0;
+  int opt = 0;
+  trEvent e;
+  FILE * in;
+
+  while((opt = getopt(argc, argv, "s")) != -1)
+    {
+      if(opt == 's') quiet = 1;
+      else
+	{
+	  fprintf(stderr, "Usage: %s [-s] <trace file>\n", argv[0]);
+	  return 1;
+	}
+    }
+
+  if(optind >= argc)
+    {
+      fprintf(stderr, "Usage: %s [-s] <trace file>\n", argv[0]);
+      return 1;
+    }
+
+  in = fopen(argv[optind], "rb");
+  if(in == NULL)
+    {
+      perror(argv[optind]);
+      return 1;
+    }
+
+  if(fread(magic, 1, strlen(TR_MAGIC), in) != strlen(TR_MAGIC)
+     || memcmp(magic, TR_MAGIC, strlen(TR_MAGIC)) != 0
+     || fread(header, sizeof(uint32_t), 3, in) != 3
+     || header[0] != TR_VERSION
+     || header[1] != sizeof(trEvent)
+     || fread(agent, 1, TR_AGENT_NAME_SIZE, in) != TR_AGENT_NAME_SIZE)
+    {
+      fprintf(stderr, "%s: not a version %d trace\n", argv[optind],
+	      TR_VERSION);
+      return 1;
+    }
+  agent[TR_AGENT_NAME_SIZE - 1] = '\0';
+
+  if(strcmp(agent, "soar") == 0)
+    {
+      commands = eatersCommands;
+      numCommands = sizeof(eatersCommands) / sizeof(char *);
+    }
+
+  while(fread(&e, sizeof(trEvent), 1, in) == 1)
+    {
+      printEvent(&e, quiet);
+      numRead++;
+    }
+  fclose(in);
+
+  printf("Trace of %s: %u events recorded, the last %lu kept\n",
+	 agent, header[2], numRead);
+  printSummary();
+
+  return 0;
+}
@@ -1,4 +1,5 @@
 #include "nsm.h"
+#include "../communication/trace.h"
 
 /*
  * nsm.c
@@ -62,31 +63,73 @@ int g_CMD_COUNT = 0;
  * @return int a command for the Roomba (negative is error)
  */
 int tick(char* sensorInput)
+{
+    return tickSensing(sensorInput, 0);
+}//tick
+
+/**
+ * tickRaw
+ *
+ * A tick() for sensings that arrive already packed (see SENSOR_BIT) so
+ * that there is no string to parse.
+ *
+ * @param sensorBits the sensors, one bit each
+ * @param now        the time stamp of the sensing (unused: as with the
+ *                   string, episodes are stamped with their place in the
+ *                   history)
+ * @return int a command for the Roomba (negative is error)
+ */
+int tickRaw(int sensorBits, int now)
+{
+    return tickSensing(NULL, sensorBits);
+}//tickRaw
+
+/**
+ * tickSensing
+ *
+ * The body of tick() and tickRaw().  The sensing is taken from
+ * sensorInput unless it is NULL, in which case it is taken from
+ * sensorBits.
+ *
+ * @param sensorInput a char string wth sensor data or NULL
+ * @param sensorBits  the sensors, one bit each, if sensorInput is NULL
+ * @return int a command for the Roomba (negative is error)
+ */
+int tickSensing(char* sensorInput, int sensorBits)
 {
     //%%%Temporarily hard-code stats mode
     g_statsMode = TRUE;
     
+    trRecord(TR_TICK, 0, g_epMem->size, 0, 0);
+    trBegin(TR_PH_TICK);
+
     // Update the history to add new sensor data to the corresponding episode.
     // This also will populate neighborhoods and update q values for voting
     // states when necessary.
     if(!g_statsMode) printf("Updating history\n");
-    Episode* ep = updateHistory(sensorInput);
+    trBegin(TR_PH_UPDATE);
+    Episode* ep = updateHistory(sensorInput, sensorBits);
+    trEnd(TR_PH_UPDATE);
     if(!g_statsMode) printf("History updated\n\n");
-    fflush(stdout);
+    if(!g_statsMode) fflush(stdout);
 
     if(!g_statsMode) printf("++++++++++++++++++++++++++++++++++++++++++\n");
 	if(!g_statsMode) printf("Number of goals found: %i\n", g_goalCount);
     if(!g_statsMode) printf("++++++++++++++++++++++++++++++++++++++++++\n");
-    fflush(stdout);
+    if(!g_statsMode) fflush(stdout);
     
     // Select the next command to be sent to the roomba
     if(!g_statsMode) printf("Choosing next command\n");
+    trBegin(TR_PH_CHOOSE);
     chooseCommand(ep);
+    trEnd(TR_PH_CHOOSE);
     if(!g_statsMode) printf("Command selected\n");
     if(!g_statsMode) fflush(stdout);
+
+    trEnd(TR_PH_TICK);
     
     return ep->action;
-}//tick
+}//tickSensing
 
 /**
  * updateHistory
@@ -96,10 +139,12 @@ int tick(char* sensorInput)
  * command. Then it creates a new episode and adds it to the end
  * of our history.
  *
- * @arg sensorData char* filled with sensor information
+ * @arg sensorData char* filled with sensor information, or NULL if
+ *                 the sensing is in sensorBits
+ * @arg sensorBits the sensors, one bit each, if sensorData is NULL
  * @return Episode* a pointer to the newly added episode
  */
-Episode* updateHistory(char* sensorData)
+Episode* updateHistory(char* sensorData, int sensorBits)
 {
     Episode* ep;
     // If we have not experienced a single episode, we must
@@ -121,7 +166,15 @@ Episode* updateHistory(char* sensorData)
 
 	int retVal;     
     // If error in parsing print appropriate error message and exit
-    if((retVal = parseSensors(ep, sensorData)) != 0)
+    if(sensorData == NULL)
+    {
+        if((retVal = parseSensorsRaw(ep, sensorBits)) != 0)
+        {
+            fprintf(stderr, "Error in parsing: sensor bits 0x%x\n", sensorBits);
+            exit(retVal);
+        }
+    }
+    else if((retVal = parseSensors(ep, sensorData)) != 0)
     {
         char errBuf[1024];
         sprintf(errBuf, "Error in parsing: %s\n", sensorData);
@@ -165,7 +218,6 @@ Episode* updateHistory(char* sensorData)
  */
 int parseSensors(Episode * parsedData, char* dataArr)
 {
-    static int timeStamp = 0;   // temporary timestamp
     int i;                      // index
 
     // Catch an empty buffer
@@ -192,9 +244,60 @@ int parseSensors(Episode * parsedData, char* dataArr)
         parsedData->sensors[i] = bit;
     }
 
+    stampEpisode(parsedData);
+
+    return 0;
+}//parseSensors
+
+/**
+ * parseSensorsRaw
+ *
+ * parseSensors() for a sensing that is already packed: each sensor is
+ * one bit of sensorBits (see SENSOR_BIT).
+ *
+ * @arg parsedData A pointer to an Episode to be populated
+ * @arg sensorBits the sensors, one bit each
+ * @return int an error code
+ */
+int parseSensorsRaw(Episode * parsedData, int sensorBits)
+{
+    int i;                      // index
+
+    // Only the low NUM_SENSORS bits may be set
+    if((sensorBits & ~((1 << NUM_SENSORS) - 1)) != 0)
+    {
+        return -1;
+    }
+
+    for(i = 0; i < NUM_SENSORS; i++)
+    {
+        parsedData->sensors[i] = SENSOR_BIT(sensorBits, i);
+    }
+
+    stampEpisode(parsedData);
+
+    return 0;
+}//parseSensorsRaw
+
+/**
+ * stampEpisode
+ *
+ * Finish an episode whose sensors have just been parsed: give it its
+ * timestamp and its reward.  Shared by parseSensors() and
+ * parseSensorsRaw().
+ *
+ * @arg parsedData the episode
+ */
+void stampEpisode(Episode * parsedData)
+{
+    static int timeStamp = 0;   // temporary timestamp
+
     // Set the episode's timestamp equal to it's location in the history array
     parsedData->now = timeStamp++;
 
+    trRecord(TR_SENSING, 0, trBits(parsedData->sensors, NUM_SENSORS),
+             parsedData->now, 0);
+
     // Found a goal so decrease chance of random move and save location of goal
     if(parsedData->sensors[SNSR_IR] == 1)
     {
@@ -202,6 +305,7 @@ int parseSensors(Episode * parsedData, char* dataArr)
         if(!g_statsMode) printf("new g_randChance=%g\n", g_randChance);
         g_goalIdx[g_goalCount] = parsedData->now;
         g_goalCount++;
+        trRecord(TR_GOAL, 0, g_goalCount, 0, 0);
         // Assign reward for success
         parsedData->reward = parsedData->qValue = REWARD_SUCCESS;
     }
@@ -210,9 +314,7 @@ int parseSensors(Episode * parsedData, char* dataArr)
         // Assign reward for failure
         parsedData->reward = parsedData->qValue = REWARD_FAIL;
     }
-
-    return 0;
-}//parseSensors
+}//stampEpisode
 
 /**
  * addEpisode
@@ -315,7 +417,7 @@ void updateAllLittleQ(Episode* ep)
     
 	if(!g_statsMode) printf("\n=================================================================\n");
     if(!g_statsMode) printf("Updating expected future discounted rewards for voting states in the following neighborhood\n\n");
-    fflush(stdout);
+    if(!g_statsMode) fflush(stdout);
     // Set a pointer to the neighborhood related to the most recently executed action
     // remember to offset for the relative action base
     Neighborhood* nbHd = g_neighborhoods->array[ep->action - CMD_NO_OP];
@@ -325,11 +427,11 @@ void updateAllLittleQ(Episode* ep)
 	if(!g_statsMode) printf("===================================================================\n\n");
 
 	if(!g_statsMode) printf("Calculating utility\n");
-    fflush(stdout);
+    if(!g_statsMode) fflush(stdout);
 	// Recalculate the Q value to be used as the utility for updating expected rewards
 	double utility = calculateQValue(nbHd);
 	if(!g_statsMode) printf("Utility calculated: %f\n", utility);
-    fflush(stdout);
+    if(!g_statsMode) fflush(stdout);
 
     // Update the q values for each of the voting episodes for the most recent
     // action
@@ -360,10 +462,10 @@ void updateAllLittleQ(Episode* ep)
     
     // Print out the updated neighborhood
 	if(!g_statsMode) printf("Updated neighborhood\n");
-    fflush(stdout);
+    if(!g_statsMode) fflush(stdout);
 	displayNeighborhood(nbHd);
 	if(!g_statsMode) printf("<==================================================================\n\n");
-    fflush(stdout);
+    if(!g_statsMode) fflush(stdout);
 }//updateAllLittleQ
 
 /**
@@ -397,7 +499,7 @@ int populateNeighborhoods()
 {
     // We want to make sure the neighborhood vector was created correctly.
     // These two values should be equal if that is the case
-  printf("Size: %d\n", g_neighborhoods->size);
+    if(!g_statsMode) printf("Size: %d\n", g_neighborhoods->size);
     assert(g_neighborhoods->size == LAST_MOBILE_CMD);
 
     // Iterate through each neighborhood and recalculate the data
@@ -408,11 +510,18 @@ int populateNeighborhoods()
         destroyNeighborhood(g_neighborhoods->array[i]);
         // must offset i with CMD_NO_OP because that is the relative base to our actions
 		if(!g_statsMode) printf("==========>> Populating neighborhood for action: %s\n",interpretCommand(i + CMD_NO_OP));
-        fflush(stdout);
-        g_neighborhoods->array[i] = locateKNearestNeighbors(i + CMD_NO_OP);
+        if(!g_statsMode) fflush(stdout);
+        Neighborhood* nbHd = locateKNearestNeighbors(i + CMD_NO_OP);
+        g_neighborhoods->array[i] = nbHd;
+
+        // The neighbors are sorted, so the first is the longest match
+        if(nbHd->numNeighbors > 0)
+        {
+            trRecord(TR_MATCH, 0, nbHd->nValues[0], nbHd->episodes[0]->now, 0);
+        }
     }
 	if(!g_statsMode) printf("\n==================end of populateNeighborhoods===================================\n\n");
-    fflush(stdout);
+    if(!g_statsMode) fflush(stdout);
     return SUCCESS;
 }//populateNeighborhoods
 
@@ -439,7 +548,7 @@ Neighborhood* locateKNearestNeighbors(int action)
     Neighborhood* nbHd = initNeighborhood(action, K_NEAREST);
     // Set current episode action temporarily to the current testing action
     if(!g_statsMode) printf("Setting neighborhood action\n");
-    fflush(stdout);
+    if(!g_statsMode) fflush(stdout);
     ((Episode*)getEntryFM(g_epMem,g_epMem->size - 1))->action = action;
 
     int i,n;
@@ -843,7 +952,7 @@ int chooseCommand(Episode* ep)
 	if(needSeed == TRUE)
 	{
 		needSeed = FALSE;
-		srand(time(NULL));
+		srand(g_randSeed != 0 ? g_randSeed : time(NULL));
 	}
 
 	// Once we have found the first goal we want to start creating neighborhoods
@@ -856,17 +965,19 @@ int chooseCommand(Episode* ep)
 				g_goalCount <= 0)                    // Only do no random after first goal
 	{
         if(!g_statsMode) printf(" selecting random command \n");
-        fflush(stdout);
+        if(!g_statsMode) fflush(stdout);
 		ep->action = (rand() % (g_CMD_COUNT)) + CMD_NO_OP;
+        trRecord(TR_COMMAND, TR_BY_RANDOM, ep->action, 0, 0);
 	}
 	else
 	{
 		// loop on setCommand until a route is chosen 
 		// that will lead to a successful action
         if(!g_statsMode) printf(" selecting command from NSM \n");
-        fflush(stdout);
+        if(!g_statsMode) fflush(stdout);
 		while(setCommand(ep)) if(!g_statsMode) printf("Failed to set a command\n");
-        fflush(stdout);
+        if(!g_statsMode) fflush(stdout);
+        trRecord(TR_COMMAND, TR_BY_VALUE, ep->action, 0, 0);
 	}
 
 	return ep->action;
@@ -977,6 +1088,63 @@ void endNSM()
 	freeVector(g_neighborhoods);
 }//endNSM
 
+/**
+ * displayMemoryStats
+ *
+ * Print the entries, allocations and bytes held by the episode history
+ * (g_epMem) and the neighborhoods.  The history's array is allocated in
+ * full by initNSM() so it only grows by its Episodes, up to
+ * FORGETTING_THRESHOLD of them.  The neighborhoods hold pointers to
+ * episodes in the history; those are counted once, with the history.
+ *
+ * @arg out  where to print it (e.g., stdout or a log file)
+ */
+void displayMemoryStats(FILE* out)
+{
+	long epAllocs = 2 + g_epMem->size;
+	long epBytes  = sizeof(ForgetfulMem) + g_epMem->capacity * sizeof(void*)
+	                + g_epMem->size * sizeof(Episode);
+	long nbAllocs = 2;
+	long nbBytes  = sizeof(Vector) + g_neighborhoods->capacity * sizeof(void*);
+	int i;
+
+	for(i = 0; i < g_neighborhoods->size; i++)
+	{
+		Neighborhood* nbHd = (Neighborhood*)g_neighborhoods->array[i];
+		nbAllocs += 3;
+		nbBytes  += sizeof(Neighborhood)
+		            + nbHd->kValue * (sizeof(Episode*) + sizeof(int));
+	}
+
+	fprintf(out, "%-13s %10s %10s %12s\n", "structure", "entries", "allocs",
+	        "bytes");
+	fprintf(out, "%-13s %10ld %10ld %12ld\n", "epMem", (long)g_epMem->size,
+	        epAllocs, epBytes);
+	fprintf(out, "%-13s %10ld %10ld %12ld\n", "neighborhoods",
+	        (long)g_neighborhoods->size, nbAllocs, nbBytes);
+	fprintf(out, "%-13s %10s %10ld %12ld\n", "total", "",
+	        epAllocs + nbAllocs, epBytes + nbBytes);
+	fflush(out);
+}//displayMemoryStats
+
+/**
+ * displayMemoryStatsShort
+ *
+ * Print the number of episodes in the history and the kilobytes it holds on
+ * one line, with no newline.  The neighborhoods don't grow so they are left
+ * out.
+ *
+ * @arg out  where to print it (e.g., stdout or a log file)
+ */
+void displayMemoryStatsShort(FILE* out)
+{
+	long bytes = sizeof(ForgetfulMem) + g_epMem->capacity * sizeof(void*)
+	             + g_epMem->size * sizeof(Episode);
+
+	fprintf(out, "epMem %ld of %d %ldKB", (long)g_epMem->size,
+	        g_epMem->capacity, bytes / 1024);
+}//displayMemoryStatsShort
+
 /**
  * interpretCommand
  *
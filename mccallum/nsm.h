@@ -18,7 +18,7 @@
 #include <time.h>
 #include <string.h>
 
-#include "vector.h"
+#include "../vector/vector.h"
 #include "forgetfulmem.h"
 #include "../communication/communication.h"
 
@@ -30,14 +30,19 @@
 // Matching defines
 #define NUM_GOALS_TO_FIND   50
 
-// Defines for Q-Learning algorithm
+// Defines for Q-Learning algorithm.  Those inside #ifndef may be given with
+// -D instead, e.g. by a parameter sweep (see communication/sweep.c).
+#ifndef DISCOUNT
 #define DISCOUNT            0.8
+#endif
 #define LEARNING_RATE       0.85
 #define REWARD_SUCCESS      1.0
 #define REWARD_FAIL         -0.1
 
 // Defines for NSM
+#ifndef K_NEAREST
 #define K_NEAREST           	8
+#endif
 #define MIN_HISTORY_LEN			5
 #define FORGETTING_THRESHOLD	250000
 #define DO_NSM					1
@@ -68,6 +73,7 @@ typedef struct NeighborhoodStruct
 // Global variables for monitoring and connecting
 int g_connectToRoomba;
 int g_statsMode;
+unsigned int g_randSeed;	// Seed for rand(), or 0 to seed it from the clock
 
 // This vector will contain all episodes received from Roomba
 //Vector* g_epMem;
@@ -77,8 +83,12 @@ ForgetfulMem* g_epMem;
 
 // Function declarations
 extern int   tick(char* sensorInput);
-Episode* updateHistory(char* sensorData);
+extern int   tickRaw(int sensorBits, int now);
+int      tickSensing(char* sensorInput, int sensorBits);
+Episode* updateHistory(char* sensorData, int sensorBits);
 int      parseSensors(Episode* parsedData, char* dataArr);
+int      parseSensorsRaw(Episode* parsedData, int sensorBits);
+void     stampEpisode(Episode* parsedData);
 int      addEpisode(ForgetfulMem* episodes, Episode* item);
 void     displayEpisode(Episode* ep);
 void     displayEpisodeShort(Episode* ep);
@@ -106,6 +116,8 @@ int      setCommand(Episode* ep);
 int      equalEpisodes(Episode* ep1, Episode* ep2);
 void     initNSM(int numCommands);
 void     endNSM();
+void     displayMemoryStats(FILE* out);
+void     displayMemoryStatsShort(FILE* out);
 extern char* interpretCommand(int cmd);
 char*    interpretCommandShort(int cmd);
 int      interpretSensorsShort(int *sensors);
@@ -3,17 +3,73 @@
  * to implement timed automata
  */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
 #include "clock.h"
 
-static volatile sig_atomic_t gotAlarm = 0;   
+#define NSEC_PER_SEC 1000000000LL
+
+/*
+ * A timer.  deadline is in nanoseconds on the monotonic clock.  A
+ * timer is armed until its deadline passes, then fired until it is
+ * cleared or set again.
+ */
+typedef struct clockTimerTag {
+	int armed;
+	int fired;
+	long long deadline;
+} clockTimer;
+
+static clockTimer timers[CLOCK_MAX_TIMERS];
+
+// The timerfd, armed for the earliest deadline of all armed timers.
+static int tfd = -1;
+
+// How late timers were seen to fire, for measuring jitter.
+static unsigned int expiries = 0;
+static long long totalLateNs = 0;
+static long long maxLateNs = 0;
+
+
+/*
+ * The monotonic clock, in nanoseconds.
+ */
+static long long nowNs(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * NSEC_PER_SEC + now.tv_nsec;
+}
 
 /*
-	 simple singal handler to set set the gotAlarm variable
-	 so to notify the user about alarms
+ * Arm the timerfd for the earliest deadline of all armed timers, or
+ * disarm it if there are none.
  */
-static void signalrmHandler(int sig)
+static int rearm(void)
 {
-	gotAlarm = 1;
+	struct itimerspec its = {{0, 0}, {0, 0}};
+	long long earliest = 0;
+	int i;
+
+	for (i = 0; i < CLOCK_MAX_TIMERS; i++) {
+		if (timers[i].armed && (earliest == 0 || timers[i].deadline < earliest)) {
+			earliest = timers[i].deadline;
+		}
+	}
+
+	its.it_value.tv_sec = earliest / NSEC_PER_SEC;
+	its.it_value.tv_nsec = earliest % NSEC_PER_SEC;
+
+	if (timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL) == -1) {
+		return CLOCK_CANNOT_ARM;
+	}
+
+	return CLOCK_SUCCESS;
 }
 
 /*
@@ -22,58 +78,137 @@ static void signalrmHandler(int sig)
  * the program execution
  */
 int setupClock(void) {
-	struct sigaction sa;        // Signal sets
-	struct sigaction toggledsa;   
-
-	//gotAlarm = 0;
+	int i;
 
 	// Initialize a random number generator to help with the
 	// generation of random data.
-	srand(time(NULL));  
-
-	// Initialize and empty a signal set
-	sigemptyset(&sa.sa_mask);
+	srand(time(NULL));
 
-	// Set the signal set.
-	sa.sa_flags = 0;
-	sa.sa_handler = signalrmHandler;
+	for (i = 0; i < CLOCK_MAX_TIMERS; i++) {
+		timers[i].armed = 0;
+		timers[i].fired = 0;
+	}
 
-	// Update the signal set with the new flags and handler.
-	if (sigaction(SIGALRM, &sa, NULL) == -1)
-	{
-		return -1;
+	tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+	if (tfd == -1) {
+		perror("timerfd_create");
+		return CLOCK_CANNOT_CREATE;
 	}
+
+	return CLOCK_SUCCESS;
 }
 
 /*
- * Function will set the clock so that it will go off in
- * the amount of time indicated by its paramaters
+ * Function will set the state clock so that it will go off in
+ * the amount of time indicated by its paramaters.  An alarm
+ * that hasn't gone off yet is replaced.
  */
 int setClock(int sec, int usec) {
+	return clockTimerSet(CLOCK_STATE_TIMER, sec, usec);
+}
 
-	//TODO: figure out how to cancel old alarms
+/*
+ * Has the state clock gone off since it was last reset?
+ */
+int checkClock(void) {
+	clockPoll();
+	return timers[CLOCK_STATE_TIMER].fired;
+}
 
-	struct itimerval itv;       // Specify when a timer should expire 
+void resetClock(void) {
+	clockClear(CLOCK_STATE_TIMER);
+}
+
+/*
+ * The timerfd, which becomes readable when a timer's deadline
+ * passes.  Call clockPoll() when it does.
+ */
+int clockFd(void) {
+	return tfd;
+}
+
+/*
+ * Set a timer to go off sec seconds and usec microseconds from now,
+ * replacing any deadline it had.  Its fired flag is cleared.
+ */
+int clockTimerSet(int timer, long sec, long usec) {
+	if (timer < 0 || timer >= CLOCK_MAX_TIMERS) return CLOCK_BAD_TIMER;
 
-	// Initialize timer start time and period:
-	// First, the period between now and the first timer interrupt 
-	itv.it_value.tv_sec = sec; //seconds
-	itv.it_value.tv_usec = usec; // microseconds
+	timers[timer].deadline = nowNs() + sec * NSEC_PER_SEC + usec * 1000LL;
+	timers[timer].armed = 1;
+	timers[timer].fired = 0;
+
+	return rearm();
+}
+
+/*
+ * Stop a timer from going off, and clear its fired flag.
+ */
+int clockTimerCancel(int timer) {
+	if (timer < 0 || timer >= CLOCK_MAX_TIMERS) return CLOCK_BAD_TIMER;
 
-	// Second, the intervals between successive timer interrupts 
-	itv.it_interval.tv_sec = 0; // seconds
-	itv.it_interval.tv_usec = 0; // microseconds
+	timers[timer].armed = 0;
+	timers[timer].fired = 0;
 
-	if (setitimer(ITIMER_REAL, &itv, NULL) == -1) {
-		return -1;
+	return rearm();
+}
+
+/*
+ * Mark every timer whose deadline has passed as fired, note how late
+ * it was seen, and rearm the timerfd for the next deadline.
+ *
+ * Returns the number of timers that fired.
+ */
+int clockPoll(void) {
+	uint64_t expirations;
+	long long now = nowNs();
+	long long late = 0;
+	int count = 0;
+	int i;
+
+	// Empty the timerfd so that it stops being readable.  Whether or
+	// not it had anything to say, the deadlines are checked against
+	// the clock.
+	read(tfd, &expirations, sizeof(expirations));
+
+	for (i = 0; i < CLOCK_MAX_TIMERS; i++) {
+		if (timers[i].armed && timers[i].deadline <= now) {
+			timers[i].armed = 0;
+			timers[i].fired = 1;
+			count++;
+
+			late = now - timers[i].deadline;
+			expiries++;
+			totalLateNs += late;
+			if (late > maxLateNs) maxLateNs = late;
+		}
 	}
 
+	if (count > 0) rearm();
+
+	return count;
 }
 
-int checkClock(void) {
-	return gotAlarm;
+int clockFired(int timer) {
+	if (timer < 0 || timer >= CLOCK_MAX_TIMERS) return 0;
+	return timers[timer].fired;
 }
 
-void resetClock(void) {
-	gotAlarm = 0;
+void clockClear(int timer) {
+	if (timer < 0 || timer >= CLOCK_MAX_TIMERS) return;
+	timers[timer].fired = 0;
+}
+
+/*
+ * Print how late, on average and at worst, timers were seen to fire
+ * by clockPoll().
+ */
+void clockPrintStats(void) {
+	if (expiries == 0) {
+		printf("Timers: none fired\n");
+		return;
+	}
+
+	printf("Timers: %u fired, %.3f ms late on average, %.3f ms at worst\n",
+	       expiries, totalLateNs / 1e6 / expiries, maxLateNs / 1e6);
 }
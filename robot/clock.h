@@ -1,6 +1,17 @@
 /*
  * File contains functions needed for our robot
  * to implement timed automata
+ *
+ * Timers run on the monotonic clock and are kept by a timerfd that
+ * is always armed for the earliest deadline, so no signals are
+ * involved.  Nothing happens asynchronously: a timer is only seen
+ * to have fired once the main loop calls clockPoll(), or
+ * checkClock().  clockFd() becomes readable when a deadline passes,
+ * for a main loop that waits with poll() or epoll.
+ *
+ * There are CLOCK_MAX_TIMERS timers, named by the CLOCK_ constants
+ * below.  CLOCK_STATE_TIMER is the one driven by state.clockTime
+ * and tested by eventAlarm().
  */
 
 #include <signal.h>
@@ -8,22 +19,37 @@
 #include <time.h>
 
 
-#ifdef CLOCK_H
+#ifndef CLOCK_H
 #define CLOCK_H
+
+/**
+ *  CONSTANT DEFINITIONS.  All constants in this file should begin
+ *  with 'CLOCK' to indicate their membership in clock.h
+ */
+#define CLOCK_MAX_TIMERS 4
+#define CLOCK_STATE_TIMER 0    // state.clockTime, seen by eventAlarm()
+#define CLOCK_USER_TIMER_1 1
+#define CLOCK_USER_TIMER_2 2
+#define CLOCK_USER_TIMER_3 3
+
+#define CLOCK_SUCCESS (0)
+#define CLOCK_CANNOT_CREATE (-1)
+#define CLOCK_BAD_TIMER (-2)
+#define CLOCK_CANNOT_ARM (-3)
+
 //file includes the following functions
-static void signalrmHandler(int sig);
-void setupClock(void);
-void setClock(int sec, int usec);
+int setupClock(void);
+int setClock(int sec, int usec);
 
 int checkClock(void);
 void resetClock(void);
 
-//lookup extern
-//or define global variable 
-
-// Global value to keep track of the alarm occurrence 
-// Set nonzero on receipt of SIGALRM 
-// TODO: Global?  Really?  Can this be better?
-//static volatile sig_atomic_t gotAlarm; 
+int clockFd(void);
+int clockTimerSet(int timer, long sec, long usec);
+int clockTimerCancel(int timer);
+int clockPoll(void);
+int clockFired(int timer);
+void clockClear(int timer);
+void clockPrintStats(void);
 
 #endif
@@ -18,10 +18,13 @@ void setEventResponder(char * erName, eventResponder* myER) {
 	cleanupER(myER);
 
 	selectNextER(erName, myER);
+	erCompile(myER);
 
 	//now set the clock for the next event responder if needed
 	if (myER->states[myER->curState].clockTime > 0) {
 		setClock(myER->states[myER->curState].clockTime,0);
+	} else {
+		clockTimerCancel(CLOCK_STATE_TIMER);
 	}
 }
 
@@ -35,6 +38,7 @@ void cleanupER(eventResponder* myER) {
 	int i;
 	for (i=0;i<myER->stateCount;++i) {
 		free(myER->states[i].transitions);
+		free(myER->states[i].dispatch);
 	}
 	free(myER->states);
 
@@ -52,6 +56,8 @@ void initalizeStopER(eventResponder* myER) {
 
 	myER->states[0].count = 1;  
 	myER->states[0].clockTime = 0; 
+	myER->states[0].dispatch = NULL;
+	myER->states[0].compiled = 0;
 	myER->states[0].transitions = malloc(sizeof(transition)); 
 
 	myER->states[0].transitions[0].e = eventTrue; 
@@ -1,5 +1,7 @@
 #include "eventresponder.h"
 #include "myEventResponders.h"
+#include "erDispatch.h"
+#include "clock.h"
 
 #ifndef _ER_CONTROL_C_
 #define _ER_CONTROL_C_
@@ -0,0 +1,201 @@
+/**
+ * erDispatch.c
+ *
+ * Builds and uses the first-match tables for an event:responder's
+ * states.  See erDispatch.h.
+ */
+
+#include <stdlib.h>
+
+#include "erDispatch.h"
+#include "events.h"
+
+/**
+ * The eventPredicates that can be compiled.  Each is true when any
+ * of the input bits in mask is set, or always true if mask is 0.
+ */
+typedef struct compiledEventTag {
+	eventPredicate * e;
+	unsigned int mask;
+} compiledEvent;
+
+static compiledEvent compiledEvents[] = {
+	{eventTrue, 0},
+	{eventBump, SENSOR_BUMP_RIGHT | SENSOR_BUMP_LEFT},
+	{eventBumpRight, SENSOR_BUMP_RIGHT},
+	{eventBumpLeft, SENSOR_BUMP_LEFT},
+	{eventAlarm, ER_INPUT_ALARM},
+	{eventVWall, ER_INPUT_VIRTUAL_WALL},
+	{eventCliffLeft, ER_INPUT_CLIFF_LEFT},
+	{eventCliffFrontLeft, ER_INPUT_CLIFF_FRONT_LEFT},
+	{eventCliffFrontRight, ER_INPUT_CLIFF_FRONT_RIGHT},
+	{eventCliffRight, ER_INPUT_CLIFF_RIGHT},
+};
+
+#define NUM_COMPILED_EVENTS (sizeof(compiledEvents) / sizeof(compiledEvent))
+
+
+/**
+ * erPackSensors
+ *
+ * Pack the inputs the eventPredicates in events.c look at into one
+ * vector.
+ *
+ * @param[in] data the sensor data, as handed to an eventPredicate.
+ *
+ * @returns the packed vector, less than ER_INPUT_COMBINATIONS.
+ */
+unsigned int erPackSensors(char * data)
+{
+	unsigned int v = data[SP_G1_BUMPS_WHEELDROPS] & SENSOR_BUMPS_WHEELDROPS;
+
+	if (data[SP_G1_CLIFF_LEFT]) v |= ER_INPUT_CLIFF_LEFT;
+	if (data[SP_G1_CLIFF_FRONT_LEFT]) v |= ER_INPUT_CLIFF_FRONT_LEFT;
+	if (data[SP_G1_CLIFF_FRONT_RIGHT]) v |= ER_INPUT_CLIFF_FRONT_RIGHT;
+	if (data[SP_G1_CLIFF_RIGHT]) v |= ER_INPUT_CLIFF_RIGHT;
+	if (data[SP_G1_VIRTUAL_WALL]) v |= ER_INPUT_VIRTUAL_WALL;
+	if (data[ER_ALARM_INDEX] != '0') v |= ER_INPUT_ALARM;
+
+	return v;
+}
+
+
+/**
+ * lookupEvent
+ *
+ * Find an eventPredicate among the ones that can be compiled.
+ *
+ * @param[in] e the eventPredicate.
+ *
+ * @returns its entry, or NULL if it can't be compiled.
+ */
+static compiledEvent * lookupEvent(eventPredicate * e)
+{
+	int i = 0;
+
+	for (i = 0; i < NUM_COMPILED_EVENTS; i++) {
+		if (compiledEvents[i].e == e) {
+			return &compiledEvents[i];
+		}
+	}
+
+	return NULL;
+}
+
+
+/**
+ * erCompileState
+ *
+ * Build the first-match table for one state in a table the caller
+ * provides.  The table covers the transitions up to the first one
+ * whose predicate can't be compiled.
+ *
+ * @param[in,out] s the state.  Its dispatch and compiled fields are
+ * set; dispatch is left NULL if none of its transitions could be
+ * compiled.
+ *
+ * @param[out] table ER_INPUT_COMBINATIONS entries.
+ */
+void erCompileState(state * s, signed char * table)
+{
+	compiledEvent * events[ER_DISPATCH_MAX];
+	unsigned int v = 0;
+	int i = 0;
+
+	s->dispatch = NULL;
+	s->compiled = 0;
+
+	if (s->count > ER_DISPATCH_MAX) return;
+
+	while (s->compiled < s->count &&
+	       (events[s->compiled] = lookupEvent(s->transitions[s->compiled].e)) != NULL) {
+		s->compiled++;
+	}
+
+	if (s->compiled == 0) return;
+
+	for (v = 0; v < ER_INPUT_COMBINATIONS; v++) {
+		table[v] = ER_NO_TRANSITION;
+		for (i = 0; i < s->compiled; i++) {
+			if (events[i]->mask == 0 || (v & events[i]->mask)) {
+				table[v] = i;
+				break;
+			}
+		}
+	}
+
+	s->dispatch = table;
+}
+
+
+/**
+ * compileState
+ *
+ * Build the first-match table for one state in a table of its own.
+ *
+ * @param[in,out] s the state.  Its dispatch field is left NULL if
+ * there was nothing to compile or the table could not be allocated.
+ */
+static void compileState(state * s)
+{
+	signed char * table = malloc(ER_INPUT_COMBINATIONS);
+
+	s->dispatch = NULL;
+	s->compiled = 0;
+
+	if (table == NULL) return;
+
+	erCompileState(s, table);
+	if (s->dispatch == NULL) free(table);
+}
+
+
+/**
+ * erCompile
+ *
+ * Build the first-match table for every state of an
+ * event:responder.  Call this once the event:responder has been
+ * filled in; cleanupER() frees the tables.  erProgram.c uses
+ * erCompileState() instead, with tables of its own.
+ *
+ * @param[in,out] myER the event:responder.
+ */
+void erCompile(eventResponder * myER)
+{
+	int i = 0;
+
+	for (i = 0; i < myER->stateCount; i++) {
+		compileState(&myER->states[i]);
+	}
+}
+
+
+/**
+ * erSelectTransition
+ *
+ * Find the first transition of a state whose eventPredicate is true.
+ *
+ * @param[in] s the state.
+ * @param[in] data the sensor data.
+ *
+ * @returns the index of the transition, or ER_NO_TRANSITION if none
+ * fire.
+ */
+int erSelectTransition(state * s, char * data)
+{
+	int i = 0;
+
+	if (s->dispatch != NULL) {
+		i = s->dispatch[erPackSensors(data)];
+		if (i != ER_NO_TRANSITION) return i;
+		i = s->compiled;
+	}
+
+	for (; i < s->count; i++) {
+		if ((s->transitions[i].e)(data)) {
+			return i;
+		}
+	}
+
+	return ER_NO_TRANSITION;
+}
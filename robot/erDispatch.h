@@ -0,0 +1,55 @@
+/**
+ * erDispatch.h
+ *
+ * Compiles the transitions of each state of an event:responder into
+ * a table, so that picking the transition to take is one lookup
+ * rather than a call to every eventPredicate in turn.
+ *
+ * Every eventPredicate in events.c looks at one or more of eleven
+ * inputs: the five bump and wheel drop bits, the four cliff sensors,
+ * the virtual wall and the alarm.  erPackSensors() packs those into
+ * an ER_INPUT_BITS-bit vector.  For each state, erCompile() works out
+ * ahead of time which transition fires first for every possible
+ * vector.
+ *
+ * A predicate that isn't from events.c can't be compiled.  The table
+ * then covers only the transitions before it, and when none of those
+ * match, the remaining transitions are checked by calling their
+ * predicates as before.
+ */
+
+#include "eventresponder.h"
+
+#ifndef _ER_DISPATCH_H_
+#define _ER_DISPATCH_H_
+
+// Bits of the packed input vector.  The low five are the bump and
+// wheel drop bits of the sensor data, as is.
+#define ER_INPUT_CLIFF_LEFT        0x0020
+#define ER_INPUT_CLIFF_FRONT_LEFT  0x0040
+#define ER_INPUT_CLIFF_FRONT_RIGHT 0x0080
+#define ER_INPUT_CLIFF_RIGHT       0x0100
+#define ER_INPUT_VIRTUAL_WALL      0x0200
+#define ER_INPUT_ALARM             0x0400
+#define ER_INPUT_BITS 11
+#define ER_INPUT_COMBINATIONS (1 << ER_INPUT_BITS)
+
+// Where the alarm flag sits in the sensor data.
+#define ER_ALARM_INDEX 15
+
+// A table entry when none of the compiled transitions fire.  Table
+// entries are signed chars, so a state with more transitions than
+// ER_DISPATCH_MAX is not compiled.
+#define ER_NO_TRANSITION (-1)
+#define ER_DISPATCH_MAX 127
+
+/**
+ * Function prototypes.  See erDispatch.c for details on
+ * this/these functions.
+ */
+unsigned int erPackSensors(char * data);
+void erCompileState(state * s, signed char * table);
+void erCompile(eventResponder * myER);
+int erSelectTransition(state * s, char * data);
+
+#endif
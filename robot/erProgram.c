@@ -0,0 +1,278 @@
+/**
+ * erProgram.c
+ *
+ * Checks, loads and encodes event:responder programs.  See
+ * erProgram.h for the format.
+ */
+
+#include "erProgram.h"
+#include "events.h"
+#include "responders.h"
+
+// The events and responders a program may name, by id.  Only add to
+// the end of these lists; programs already written depend on the
+// order.
+static eventPredicate * programEvents[] = {
+	eventTrue,
+	eventFalse,
+	eventBump,
+	eventBumpRight,
+	eventBumpLeft,
+	eventAlarm,
+	eventVWall,
+	eventCliffLeft,
+	eventCliffFrontLeft,
+	eventCliffFrontRight,
+	eventCliffRight,
+};
+
+static responder * programResponders[] = {
+	respondStop,
+	respondDriveLow,
+	respondDriveMed,
+	respondDriveHigh,
+	respondTurn,
+	respondLedBlink,
+	respondLedRed,
+	respondLedGreen,
+};
+
+#define NUM_PROGRAM_EVENTS (sizeof(programEvents) / sizeof(eventPredicate *))
+#define NUM_PROGRAM_RESPONDERS (sizeof(programResponders) / sizeof(responder *))
+
+/**
+ * A place to load a program into.  Everything a loaded program needs
+ * is here, so loading one doesn't allocate anything.
+ */
+typedef struct programSlotTag {
+	eventResponder er;
+	state states[ER_PROG_MAX_STATES];
+	transition transitions[ER_PROG_MAX_STATES][ER_PROG_MAX_TRANSITIONS];
+	signed char dispatch[ER_PROG_MAX_STATES][ER_INPUT_COMBINATIONS];
+} programSlot;
+
+static programSlot slots[2];
+
+// The slot the main loop is running, or -1 if it isn't running a
+// loaded program.  Only erProgramTake() changes it.
+static int running = -1;
+
+// A loaded program waiting to be taken by the main loop, or NULL.
+static eventResponder * pending = NULL;
+
+
+/**
+ * erProgramCheck
+ *
+ * Check that a program is well formed: the magic bytes and version
+ * are right, the counts are in range, every event, responder and
+ * next state exists, the length matches the counts, and the checksum
+ * is right.
+ *
+ * @param[in] prog the program.
+ * @param[in] length its length in bytes.
+ *
+ * @returns ER_PROG_SUCCESS, or an ER_PROG_ error saying what is wrong.
+ */
+int erProgramCheck(unsigned char * prog, int length)
+{
+	unsigned char sum = 0;
+	int numStates = 0;
+	int numTransitions = 0;
+	int at = ER_PROG_HEADER_SIZE;
+	int i = 0;
+	int j = 0;
+
+	if (length > ER_PROG_MAX_SIZE) return ER_PROG_TOO_LARGE;
+	if (length < ER_PROG_HEADER_SIZE + 1) return ER_PROG_TOO_SHORT;
+	if (prog[0] != 'E' || prog[1] != 'R') return ER_PROG_BAD_MAGIC;
+	if (prog[2] != ER_PROG_VERSION) return ER_PROG_BAD_VERSION;
+
+	numStates = prog[3];
+	if (numStates < 1 || numStates > ER_PROG_MAX_STATES) return ER_PROG_BAD_COUNT;
+
+	for (i = 0; i < numStates; i++) {
+		if (at + ER_PROG_STATE_SIZE > length) return ER_PROG_TOO_SHORT;
+		numTransitions = prog[at + 2];
+		at += ER_PROG_STATE_SIZE;
+
+		if (numTransitions < 1 || numTransitions > ER_PROG_MAX_TRANSITIONS) {
+			return ER_PROG_BAD_COUNT;
+		}
+
+		for (j = 0; j < numTransitions; j++) {
+			if (at + ER_PROG_TRANSITION_SIZE > length) return ER_PROG_TOO_SHORT;
+			if (prog[at] >= NUM_PROGRAM_EVENTS) return ER_PROG_BAD_EVENT;
+			if (prog[at + 1] >= NUM_PROGRAM_RESPONDERS) return ER_PROG_BAD_RESPONDER;
+			if (prog[at + 2] >= numStates) return ER_PROG_BAD_STATE;
+			at += ER_PROG_TRANSITION_SIZE;
+		}
+	}
+
+	// All that should be left is the checksum.
+	if (at + 1 != length) return ER_PROG_BAD_LENGTH;
+
+	for (i = 0; i < length; i++) {
+		sum += prog[i];
+	}
+	if (sum != 0) return ER_PROG_BAD_CHECKSUM;
+
+	return ER_PROG_SUCCESS;
+}
+
+
+/**
+ * erProgramLoad
+ *
+ * Check a program and, if it is good, load it into the slot the main
+ * loop isn't running and compile its dispatch tables.  The main loop
+ * picks it up with erProgramTake().
+ *
+ * Loads and takes must come from the same thread: a second load
+ * before the first is taken replaces it in the same slot.
+ *
+ * @param[in] prog the program.
+ * @param[in] length its length in bytes.
+ *
+ * @returns ER_PROG_SUCCESS, or the error from erProgramCheck(), in
+ * which case nothing changes.
+ */
+int erProgramLoad(unsigned char * prog, int length)
+{
+	programSlot * slot = NULL;
+	int status = ER_PROG_SUCCESS;
+	int at = ER_PROG_HEADER_SIZE;
+	int i = 0;
+	int j = 0;
+
+	if ((status = erProgramCheck(prog, length)) != ER_PROG_SUCCESS) {
+		return status;
+	}
+
+	slot = &slots[running == 0 ? 1 : 0];
+
+	slot->er.states = slot->states;
+	slot->er.stateCount = prog[3];
+	slot->er.curState = 0;
+
+	for (i = 0; i < slot->er.stateCount; i++) {
+		state * s = &slot->states[i];
+
+		s->clockTime = (prog[at] << 8) | prog[at + 1];
+		s->count = prog[at + 2];
+		s->transitions = slot->transitions[i];
+		at += ER_PROG_STATE_SIZE;
+
+		for (j = 0; j < s->count; j++) {
+			s->transitions[j].e = programEvents[prog[at]];
+			s->transitions[j].r = programResponders[prog[at + 1]];
+			s->transitions[j].n = prog[at + 2];
+			at += ER_PROG_TRANSITION_SIZE;
+		}
+
+		erCompileState(s, slot->dispatch[i]);
+	}
+
+	__sync_synchronize();
+	pending = &slot->er;
+
+	return ER_PROG_SUCCESS;
+}
+
+
+/**
+ * erProgramTake
+ *
+ * Called by the main loop between trips around it.  If a program has
+ * been loaded since the last call, hand it over; the main loop should
+ * then switch to it, in state 0.  The slot the main loop was
+ * running, if any, is free to be loaded into again.  A program that
+ * has been superseded, e.g. by a named event:responder sent after
+ * it, is dropped by calling this and ignoring the result.
+ *
+ * @returns the newly loaded event:responder, or NULL if there isn't
+ * one.
+ */
+eventResponder * erProgramTake()
+{
+	eventResponder * er = __sync_lock_test_and_set(&pending, NULL);
+
+	if (er != NULL) {
+		running = (er == &slots[0].er) ? 0 : 1;
+	}
+
+	return er;
+}
+
+
+/**
+ * erProgramEncode
+ *
+ * Encode an event:responder as a program, e.g., one built by the
+ * functions in myEventResponders.c, so that it can be sent with
+ * erWriteProgram().
+ *
+ * @param[in] myER the event:responder.  Every event and responder in
+ * it must be in the tables at the top of this file.
+ * @param[out] prog where to write the program.
+ * @param[in] size how many bytes prog can hold.
+ *
+ * @returns the length of the program, or an ER_PROG_ error.
+ */
+int erProgramEncode(eventResponder * myER, unsigned char * prog, int size)
+{
+	unsigned char sum = 0;
+	int at = 0;
+	int i = 0;
+	int j = 0;
+	int k = 0;
+
+	if (myER->stateCount < 1 || myER->stateCount > ER_PROG_MAX_STATES) {
+		return ER_PROG_BAD_COUNT;
+	}
+	if (size < ER_PROG_HEADER_SIZE + 1) return ER_PROG_TOO_LARGE;
+
+	prog[at++] = 'E';
+	prog[at++] = 'R';
+	prog[at++] = ER_PROG_VERSION;
+	prog[at++] = myER->stateCount;
+
+	for (i = 0; i < myER->stateCount; i++) {
+		state * s = &myER->states[i];
+
+		if (s->count < 1 || s->count > ER_PROG_MAX_TRANSITIONS) return ER_PROG_BAD_COUNT;
+		if (at + ER_PROG_STATE_SIZE + s->count * ER_PROG_TRANSITION_SIZE + 1 > size) {
+			return ER_PROG_TOO_LARGE;
+		}
+
+		prog[at++] = (s->clockTime >> 8) & 0xFF;
+		prog[at++] = s->clockTime & 0xFF;
+		prog[at++] = s->count;
+
+		for (j = 0; j < s->count; j++) {
+			for (k = 0; k < NUM_PROGRAM_EVENTS; k++) {
+				if (programEvents[k] == s->transitions[j].e) break;
+			}
+			if (k == NUM_PROGRAM_EVENTS) return ER_PROG_BAD_EVENT;
+			prog[at++] = k;
+
+			for (k = 0; k < NUM_PROGRAM_RESPONDERS; k++) {
+				if (programResponders[k] == s->transitions[j].r) break;
+			}
+			if (k == NUM_PROGRAM_RESPONDERS) return ER_PROG_BAD_RESPONDER;
+			prog[at++] = k;
+
+			if (s->transitions[j].n < 0 || s->transitions[j].n >= myER->stateCount) {
+				return ER_PROG_BAD_STATE;
+			}
+			prog[at++] = s->transitions[j].n;
+		}
+	}
+
+	for (i = 0; i < at; i++) {
+		sum += prog[i];
+	}
+	prog[at++] = (unsigned char)(0 - sum);
+
+	return at;
+}
@@ -0,0 +1,68 @@
+/**
+ * erProgram.h
+ *
+ * Event:responder programs that are sent to the robot over the
+ * event:responder service, rather than compiled into it like the
+ * ones in myEventResponders.c.
+ *
+ * A program is a string of bytes:
+ *
+ *   'E' 'R' <version> <number of states>
+ *   for each state:
+ *     <clock time, high byte> <clock time, low byte> <number of transitions>
+ *     for each transition:
+ *       <event id> <responder id> <next state>
+ *   <checksum>
+ *
+ * Event and responder ids index the tables in erProgram.c.  The
+ * checksum makes the sum of all the bytes 0, as in the iRobot's
+ * sensor stream.  The program starts in state 0.
+ *
+ * A program is checked once, when it arrives, and copied into
+ * whichever of two preallocated slots isn't running.  Nothing is
+ * allocated or freed.  The main loop picks the new program up with
+ * erProgramTake() between trips around the loop.
+ */
+
+#include "eventresponder.h"
+#include "erDispatch.h"
+
+#ifndef _ER_PROGRAM_H_
+#define _ER_PROGRAM_H_
+
+/**
+ *  CONSTANT DEFINITIONS.  All constants in this file should begin
+ *  with 'ER' to indicate their membership in the event:responder.
+ */
+#define ER_PROG_VERSION 1
+#define ER_PROG_MAX_STATES 16
+#define ER_PROG_MAX_TRANSITIONS 16
+
+#define ER_PROG_HEADER_SIZE 4
+#define ER_PROG_STATE_SIZE 3
+#define ER_PROG_TRANSITION_SIZE 3
+#define ER_PROG_MAX_SIZE (ER_PROG_HEADER_SIZE + 1 + ER_PROG_MAX_STATES * \
+	(ER_PROG_STATE_SIZE + ER_PROG_MAX_TRANSITIONS * ER_PROG_TRANSITION_SIZE))
+
+#define ER_PROG_SUCCESS (0)
+#define ER_PROG_TOO_SHORT (-1)
+#define ER_PROG_BAD_MAGIC (-2)
+#define ER_PROG_BAD_VERSION (-3)
+#define ER_PROG_BAD_COUNT (-4)
+#define ER_PROG_BAD_EVENT (-5)
+#define ER_PROG_BAD_RESPONDER (-6)
+#define ER_PROG_BAD_STATE (-7)
+#define ER_PROG_BAD_LENGTH (-8)
+#define ER_PROG_BAD_CHECKSUM (-9)
+#define ER_PROG_TOO_LARGE (-10)
+
+/**
+ * Function prototypes.  See erProgram.c for details on
+ * this/these functions.
+ */
+int erProgramCheck(unsigned char * prog, int length);
+int erProgramLoad(unsigned char * prog, int length);
+eventResponder * erProgramTake();
+int erProgramEncode(eventResponder * myER, unsigned char * prog, int size);
+
+#endif
@@ -97,6 +97,8 @@ typedef struct stateTag {
 	int clockTime;            /**< Time for the clock to go off */ 
 	transition * transitions; /**< List of transitions from the state*/
 	int count;                /**< The number of transitions from state */
+	signed char * dispatch;   /**< First-match table built by erCompile(), or NULL */
+	int compiled;             /**< How many leading transitions the table covers */
 } state;
 
 
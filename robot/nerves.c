@@ -3,6 +3,16 @@
 
 static eventResponder myER;
 
+//the event:responder being run: myER, or a program loaded
+//over the event:responder service.  See erProgram.h.
+static eventResponder * er = &myER;
+
+//contains when the last state change occured
+static time_t lastStateChange;
+
+static serviceHandler dsh;
+static serviceHandler ersh;
+
 int main(int argc, char* argv[])
 {
 
@@ -17,17 +27,24 @@ int main(int argc, char* argv[])
 
 	//start the program with an event responder to tell it to stop
 	initalizeStopER(&myER);
+	erCompile(&myER);
 
 	setupRoomba();
-	setupClock();
+	if (setupClock() != CLOCK_SUCCESS) {
+		printf("Could not set up the clock\n");
+		return EXIT_FAILURE;
+	}
+#ifndef SENSORS_POLLED
+	if (streamStart() != STREAM_SUCCESS) {
+		printf("Could not start the sensor stream\n");
+		return EXIT_FAILURE;
+	}
+#endif
 	//mqd_t mqd_cmd = setupCommandQueue();	
 
 	int bcast = SERV_BROADCAST_ON;
 	int status = -1;
 
-	serviceHandler dsh;
-	serviceHandler ersh;
-
 	servHandlerSetDefaults(&dsh);
 	servHandlerSetDefaults(&ersh);
 
@@ -56,109 +73,360 @@ int main(int argc, char* argv[])
 		servStart(SERV_DATA_SERVICE_COLLECTOR, argv[1], SERV_BROADCAST_ON, &dsh);
 	}
 
-	//contains when the last state change occured
-	time_t lastStateChange;
+	//send telemetry from a thread of its own, so that a slow link
+	//to the aggregator never holds up a responder
+	if (telemStart(&dsh, TELEM_DEFAULT_CAPACITY, TELEM_DROP_OLDEST) != TELEM_SUCCESS) {
+		printf("Could not start the telemetry sender\n");
+		return EXIT_FAILURE;
+	}
 
-	char cmd_buffer[CMD_BUFFER_SIZE]; 
+	int epfd = setupEvents();
+	if (epfd == -1) {
+		return EXIT_FAILURE;
+	}
 
-	transition * transitions= myER.states[myER.curState].transitions;
-	int transitionsCount = myER.states[myER.curState].count;
+	struct epoll_event events[NERVES_MAX_EVENTS];
+	int waitMs = -1;
+	int quit = 0;
+	int i = 0;
+
+#ifdef SENSORS_POLLED
+	//the sensors are queried every time around, so don't wait
+	waitMs = 0;
+#endif
+
+	//sleep until something happens, then hand each thing that
+	//happened to its handler
+	while (!quit) {
+		int n = epoll_wait(epfd, events, NERVES_MAX_EVENTS, waitMs);
+		int evaluate = 0;
+
+		if (n == -1) {
+			if (errno == EINTR) continue;
+			perror("epoll_wait");
+			break;
+		}
+
+		for (i = 0; i < n; i++) {
+			switch (events[i].data.u32) {
+			case NERVES_SRC_COMMAND:
+				quit = handleCommands();
+				break;
+			case NERVES_SRC_TIMER:
+				clockPoll();
+				evaluate |= clockFired(CLOCK_STATE_TIMER);
+				break;
+			case NERVES_SRC_SENSORS:
+				evaluate |= streamAck() > 0;
+				break;
+			case NERVES_SRC_DATA:
+				handleDataService(epfd);
+				break;
+			}
+		}
+
+		if (quit) break;
+
+#ifdef SENSORS_POLLED
+		evaluate = 1;
+#endif
+		if (evaluate) {
+			runTransition();
+		}
+
+		//switch to a newly loaded program between trips around the
+		//loop, never part way through one
+		takeProgram();
+
+	} //forever loop
+
+	printf("Main exiting\n");
+
+	/* Cleanup */
+	close(epfd);
+	telemStop();	//send what telemetry is left
+#ifndef SENSORS_POLLED
+	streamStop();	//stop the sensor stream reader
+#endif
+	respondStop();	//stop the robot
+	cleanupER(&myER);	//cleanup er data on heap
+	closePort();	//close connection to roomba
+	//mq_close(mqd_cmd); //close our command queue
+
+	return 0;
+}
+
+
+/**
+ * watch
+ *
+ * Add a file descriptor to the main loop's epoll set.
+ *
+ * @param[in] epfd the epoll set.
+ * @param[in] fd the file descriptor to wait on.
+ * @param[in] source which handler it is for, a NERVES_SRC_ value.
+ * @param[in] what the epoll events to wait for.
+ *
+ * @returns 0, or -1 if it could not be added.
+ */
+static int watch(int epfd, int fd, int source, unsigned int what) {
+	struct epoll_event ev;
+
+	ev.events = what;
+	ev.data.u32 = source;
+
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+		perror("epoll_ctl");
+		return -1;
+	}
+
+	return 0;
+}
 
-	char dataPackage[DATA_PACKAGE_SIZE]; 
 
-	while (1) {
-		if (erRead(&ersh, cmd_buffer) == SERV_SUCCESS) {
+/**
+ * setupEvents
+ *
+ * Make the epoll set the main loop waits on: the event:responder
+ * message queue, the clock's timerfd, the sensor stream's eventfd
+ * and the data service socket.  The serial port itself belongs to
+ * the sensor stream's reader thread.
+ *
+ * @returns the epoll set, or -1 if it could not be made.
+ */
+int setupEvents() {
+	int epfd = epoll_create(NERVES_MAX_EVENTS);
+
+	if (epfd == -1) {
+		perror("epoll_create");
+		return -1;
+	}
+
+	if (watch(epfd, ersh.mqd, NERVES_SRC_COMMAND, EPOLLIN) == -1 ||
+	    watch(epfd, clockFd(), NERVES_SRC_TIMER, EPOLLIN) == -1) {
+		close(epfd);
+		return -1;
+	}
+
+#ifndef SENSORS_POLLED
+	if (watch(epfd, streamFd(), NERVES_SRC_SENSORS, EPOLLIN) == -1) {
+		close(epfd);
+		return -1;
+	}
+#endif
+
+	//nothing is expected from the aggregator, but it hanging up
+	//should be noticed before the telemetry sender writes to it again
+	if (dsh.handler != SERV_HANDLER_NOT_SET) {
+		watch(epfd, dsh.handler, NERVES_SRC_DATA, EPOLLIN | EPOLLRDHUP);
+	}
+
+	return epfd;
+}
+
+
+/**
+ * handleCommands
+ *
+ * Read every message waiting on the event:responder service.  A
+ * program is loaded, to be switched to by takeProgram(); a name
+ * switches to one of the event:responders in myEventResponders.c.
+ * The last message read wins: a name throws away any program loaded
+ * before it.
+ *
+ * Returns 1 if told to quit, 0 otherwise.
+ */
+int handleCommands() {
+	char cmd_buffer[CMD_BUFFER_SIZE]; 
+	char * program = NULL;
+	int programLength = 0;
+	int status = 0;
+
+	while (erRead(&ersh, cmd_buffer) == SERV_SUCCESS) {
 		//if (cmdQ_hasMsg(mqd_cmd) > 0) {
 
-			//cmdQ_getMsg(mqd_cmd, cmd_buffer);
-			printf("Got Message: .%s.\n",cmd_buffer);
+		//cmdQ_getMsg(mqd_cmd, cmd_buffer);
 
-			//check if this command is telling us to stop
-			if (strcmp(cmd_buffer, QUIT_MESSAGE) == 0) {
-				//okay, break out of the loop so we can clean things up
-				break;
+		if ((program = erProgramBody(cmd_buffer, &programLength)) != NULL) {
+			printf("Got a program of %d bytes\n", programLength);
+			if ((status = erProgramLoad((unsigned char *)program, programLength)) != ER_PROG_SUCCESS) {
+				printf("Rejected the program: %d\n", status);
 			}
+			continue;
+		}
 
-			setEventResponder(cmd_buffer,&myER);
-			time(&lastStateChange);
-
+		printf("Got Message: .%s.\n",cmd_buffer);
 
-			int state = myER.curState;
-			transitions = myER.states[state].transitions;
-			transitionsCount = myER.states[state].count;
+		//check if this command is telling us to stop
+		if (strcmp(cmd_buffer, QUIT_MESSAGE) == 0) {
+			//okay, break out of the loop so we can clean things up
+			return 1;
 		}
 
-		//read sensor data
-		char sensDataFromRobot[ER_SENS_BUFFER_SIZE] = {'\0'};
-		getSensorData(sensDataFromRobot);
-		//printf("test");
-		//printf("sens: %i\n",*(sensDataFromRobot+1));
-		//printf("sens: %i\n",*(sensDataFromRobot+2));
-		//printf("sens: %i\n",*(sensDataFromRobot+3));
-		//printf("sens: %i\n",*(sensDataFromRobot+4));
-		//printf("sens: %i\n",*(sensDataFromRobot+5));
+		//a program loaded earlier in this batch must not replace
+		//this one when takeProgram() runs
+		erProgramTake();
+
+		setEventResponder(cmd_buffer,&myER);
+		time(&lastStateChange);
+		er = &myER;
+	}
+
+	return 0;
+}
+
 
-		int eventOccured = 0;	
+/**
+ * handleDataService
+ *
+ * The data service socket is readable.  Nothing is expected from the
+ * aggregator, so this means it has hung up; stop the telemetry
+ * sender and close the socket.
+ */
+void handleDataService(int epfd) {
+	char discard[DATA_PACKAGE_SIZE];
+	int n = recv(dsh.handler, discard, sizeof(discard), MSG_DONTWAIT);
 
-		// Loop over all of the eventPredicate/responders in current state
-		int i = 0;
-		for(i = 0; i < transitionsCount; i++) {
+	if (n > 0 || (n == -1 && errno == EAGAIN)) {
+		return;
+	}
 
-			if (eventOccured == 0) {
+	printf("The data service has closed\n");
+	epoll_ctl(epfd, EPOLL_CTL_DEL, dsh.handler, NULL);
+	telemStop();	//the sender must be done with the socket first
+	close(dsh.handler);
+	dsh.handler = SERV_HANDLER_NOT_SET;
+}
 
-				eventPredicate* e = transitions[i].e; //event to check against
 
-				if((e)(sensDataFromRobot)) {
+/**
+ * takeProgram
+ *
+ * If a program has been loaded, switch to it, in its first state.
+ */
+void takeProgram() {
+	eventResponder * loaded = erProgramTake();
 
-					responder* r = transitions[i].r; //the responder to execute
-					nextState n = transitions[i].n; //the next state to go to
+	if (loaded == NULL) return;
 
-					packageData(dataPackage,sensDataFromRobot,myER.curState, n, i,lastStateChange);
-					//packageEventData(dataPackage,n);
-					//dsWrite(&sh,"abcdefghjklmnopqrstuvwxyz");
-					dsWrite(&dsh,dataPackage);
+	printf("Running the loaded program\n");
+	er = loaded;
+	if (er->states[er->curState].clockTime > 0) {
+		setClock(er->states[er->curState].clockTime,0);
+	} else {
+		clockTimerCancel(CLOCK_STATE_TIMER);
+	}
+	time(&lastStateChange);
+}
 
-					printPackage(dataPackage);
 
-					r();
-					if (myER.curState != n) {
-						printf("State changing from %d to %d\n",myER.curState,n);
+/**
+ * runTransition
+ *
+ * Check the events of the current state against the latest sensor
+ * data and the clock, and take the first transition whose event has
+ * occurred.
+ */
+void runTransition() {
+	char sensDataFromRobot[ER_SENS_BUFFER_SIZE] = {'\0'};
+	char dataPackage[DATA_PACKAGE_SIZE]; 
 
-						myER.curState = n;
-						transitions = myER.states[n].transitions;
-						transitionsCount = myER.states[n].count;
+	//read sensor data
+	if (!getSensorData(sensDataFromRobot)) {
+		//nothing new since the last time around
+		return;
+	}
+	countSensorPoll();
+	//printf("sens: %i\n",*(sensDataFromRobot+1));
+	//printf("sens: %i\n",*(sensDataFromRobot+2));
 
-						int nextAlarm = myER.states[myER.curState].clockTime;
-						if (nextAlarm > 0) {
-							//TODO: reset the alarm somewhere
-							setClock(nextAlarm,0);
-						}
-						time(&lastStateChange);
-					}
+	// Find the first transition in the current state whose
+	// event has occurred.  See erDispatch.c.
+	int i = erSelectTransition(&er->states[er->curState], sensDataFromRobot);
 
-					//event occured, we don't want to check anymore
-					eventOccured = 1;
+	if (i == ER_NO_TRANSITION) return;
 
-				} //if event passes
-			} //if event hasn'toccured
-		} //transitions loop	
+	transition * transitions = er->states[er->curState].transitions;
+	responder* r = transitions[i].r; //the responder to execute
+	nextState n = transitions[i].n; //the next state to go to
 
-	} //forever loop
+	packageData(dataPackage,sensDataFromRobot,er->curState, n, i,lastStateChange);
+	//packageEventData(dataPackage,n);
+	telemSend(dataPackage);	//sent and printed by the telemetry sender
 
-	printf("Main exiting\n");
+	r();
+	if (er->curState != n) {
+		printf("State changing from %d to %d\n",er->curState,n);
 
-	/* Cleanup */
-	respondStop();	//stop the robot
-	cleanupER(&myER);	//cleanup er data on heap
-	closePort();	//close connection to roomba
-	//mq_close(mqd_cmd); //close our command queue
+		er->curState = n;
 
-	return 0;
+		int nextAlarm = er->states[er->curState].clockTime;
+		if (nextAlarm > 0) {
+			setClock(nextAlarm,0);
+		} else {
+			//an alarm left over from the old state
+			//mustn't go off in this one
+			clockTimerCancel(CLOCK_STATE_TIMER);
+		}
+		time(&lastStateChange);
+	}
 }
 
 
-void getSensorData(char* sensDataFromRobot) {
+/**
+ * countSensorPoll
+ *
+ * Count a trip around the main loop, and every SENSOR_RATE_SECS
+ * print how many sensor polls per second the loop is managing.
+ */
+void countSensorPoll() {
+	static struct timespec start = {0, 0};
+	static int polls = 0;
+	struct timespec now;
+	double secs;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (start.tv_sec == 0) start = now;
+	polls++;
+
+	secs = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+	if (secs >= SENSOR_RATE_SECS) {
+		printf("Sensor polls: %.1f per second\n", polls / secs);
+		clockPrintStats();
+		telemPrintStats();
+#ifndef SENSORS_POLLED
+		streamPrintStats();
+#endif
+		start = now;
+		polls = 0;
+	}
+}
+
+/**
+ * getSensorData
+ *
+ * Fill the sensor buffer for the event predicates.  By default the
+ * sensors come from the latest sample of the sensor stream, which
+ * doesn't touch the serial port.  Define SENSORS_POLLED to query the
+ * iRobot each time instead.
+ *
+ * Returns 1 if there is something new to check: a new sample or an
+ * alarm.  Returns 0 if the stream has nothing newer than the last
+ * call, in which case the buffer holds the old sample.
+ */
+int getSensorData(char* sensDataFromRobot) {
+#ifdef SENSORS_POLLED
 	receiveGroupOneSensorData(sensDataFromRobot);
+#else
+	static unsigned int lastFrame = 0;
+	unsigned int frame = 0;
+
+	streamLatest(sensDataFromRobot, &frame, NULL);
+	if (frame == lastFrame && !checkClock()) {
+		return 0;
+	}
+	lastFrame = frame;
+#endif
 	//gotAlarm contained within clock.c
 	sensDataFromRobot[15] = '0'+checkClock();//+gotAlarm; 
 	resetClock();
@@ -172,5 +440,6 @@ void getSensorData(char* sensDataFromRobot) {
 	printf("wheeldrops:%d\n",(sensDataFromRobot[0] & SENSOR_WHEELDROP_BOTH));
 	printf("vwall:%d\n",sensDataFromRobot[0]);
 	 */
+	return 1;
 }
 
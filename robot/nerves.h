@@ -4,6 +4,9 @@
 
 #include <fcntl.h>
 #include <mqueue.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
 
 #include <sys/types.h>
 #include <sys/ipc.h>
@@ -19,9 +22,12 @@
 #include "clock.h"
 #include "erQueue.h"
 #include "erControl.h"
+#include "erProgram.h"
 #include "myEventResponders.h"
 
 #include "netDataProtocol.h"
+#include "sensorStream.h"
+#include "telemetry.h"
 
 #include "../communication/connector.h"
 
@@ -31,6 +37,22 @@
 #ifndef _NERVES_H_
 #define _NERVES_H_
 
-void getSensorData(char* sensDataFromRobot);
+// How often the main loop reports its sensor polling rate.
+#define SENSOR_RATE_SECS 10
+
+// The things the main loop waits on, as tagged in its epoll set.
+#define NERVES_SRC_COMMAND 1   // the event:responder message queue
+#define NERVES_SRC_TIMER 2     // the clock's timerfd
+#define NERVES_SRC_SENSORS 3   // the sensor stream's eventfd
+#define NERVES_SRC_DATA 4      // the data service socket
+#define NERVES_MAX_EVENTS 8
+
+int setupEvents();
+int handleCommands();
+void handleDataService(int epfd);
+void takeProgram();
+void runTransition();
+int getSensorData(char* sensDataFromRobot);
+void countSensorPoll();
 
 #endif
@@ -1,7 +1,7 @@
 #include <stdio.h>
 #include <time.h>
 #include <stdlib.h>
-#include "../roomba/roomba.h"
+#include "roomba/roomba.h"
 
 #ifndef _NET_DATA_PROTOCOL_H_
 #define _NET_DATA_PROTOCOL_H_
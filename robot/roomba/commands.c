@@ -8,6 +8,20 @@
 
 #include "roomba.h"
 
+/**
+ * driveCommand()
+ *
+ * Issue a drive command to the iRobot as a single write: the opcode,
+ * then the velocity and turn radius, each high byte first.
+ */
+static void driveCommand(int velocity, int radius)
+{
+  byteQueue(RCMD_DRIVE);
+  wordQueue(velocity);
+  wordQueue(radius);
+  byteFlush();
+}
+
 
 void setupRoomba() {
   //Start up robotly things
@@ -113,20 +127,9 @@ void driveStraight(int velocity)
       velocityWord = LOW_SPEED;
     }
 
-  // Send the 5-byte drive command to the iRobot:
-
-  // Begin by issuing a drive command to the iRobot.
-  byteTx(RCMD_DRIVE);
-
-  // Send the high byte, then the low byte of
-  // the desired velocity value.
-  byteTx(velocityWord >> 8);
-  byteTx(velocityWord & 0x00FF);
-
-  // Send the high byte, then the low byte of
-  // the desired turn-radius value.
-  byteTx(STRAIGHT >> 8);
-  byteTx(STRAIGHT & 0x00FF);
+  // Send the 5-byte drive command to the iRobot: the desired
+  // velocity, then the desired turn-radius value.
+  driveCommand(velocityWord, STRAIGHT);
 }
 
 /**
@@ -138,11 +141,8 @@ void driveStraight(int velocity)
  */
 void turnCounterClockwise(int degrees)
 {
-  byteTx(RCMD_DRIVE);
-  byteTx(0);
-  byteTx(200);
-  byteTx(0);
-  byteTx(1);
+  // 200 mm/s, turning in place counter clockwise.
+  driveCommand(200, 0x0001);
   usleep(degrees);
   stop();
 }
@@ -154,11 +154,8 @@ void turnCounterClockwise(int degrees)
  */
 void turnClockwise(int degrees)
 {
-  byteTx(RCMD_DRIVE);
-  byteTx(0);
-  byteTx(200);
-  byteTx(255);
-  byteTx(255);
+  // 200 mm/s, turning in place clockwise.
+  driveCommand(200, 0xFFFF);
   usleep(degrees);
   stop();
 }
@@ -214,7 +211,6 @@ void driveBackwardsUntil(int usec, int speed)
 void driveBackwards(int velocity)
 {
   unsigned int velocityWord = 0;
-  byteTx(RCMD_DRIVE);
   if (velocity == HIGH)
     {
       velocityWord = HIGH_SPEED_BACK;
@@ -229,20 +225,12 @@ void driveBackwards(int velocity)
       velocityWord = LOW_SPEED_BACK;
     }
 
-  byteTx(velocityWord >> 8);
-  byteTx(velocityWord & 0x00FF);
-
-  byteTx(STRAIGHT >> 8);
-  byteTx(STRAIGHT & 0x00FF);
+  driveCommand(velocityWord, STRAIGHT);
 }
 
 void stop()
 {
-  byteTx(RCMD_DRIVE);
-  byteTx(0x00);
-  byteTx(0x00);
-  byteTx(STRAIGHT & 0x00FF);
-  byteTx(STRAIGHT & 0x0FF);
+  driveCommand(0x0000, 0x0000);
 }
 
 /** 
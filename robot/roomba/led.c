@@ -17,50 +17,72 @@
 //		advanceSetting: if 0 advance is off; if 1 advance is on
 void setLED(int powerSetting, int playSetting, int advanceSetting)
 {
-  byteTx(CmdLeds);
+  byteQueue(CmdLeds);
   if(playSetting == PLAY_ON && advanceSetting == ADVANCE_ON)
-    byteTx(SET_ALL);
+    byteQueue(SET_ALL);
   else if(playSetting == PLAY_OFF && advanceSetting == ADVANCE_ON)
-    byteTx(SET_ADVANCE);
+    byteQueue(SET_ADVANCE);
   else if(playSetting == PLAY_ON && advanceSetting == ADVANCE_OFF)
-    byteTx(SET_PLAY);
+    byteQueue(SET_PLAY);
   else
-    byteTx(OFF);
+    byteQueue(OFF);
   if (powerSetting == RED)	
-    byteTx(PWR_RED);
+    byteQueue(PWR_RED);
   else
-    byteTx(PWR_GREEN);
+    byteQueue(PWR_GREEN);
   if (powerSetting == OFF)
-    byteTx(OFF);
+    byteQueue(OFF);
   else
-    byteTx(FULL_INTENSITY);
+    byteQueue(FULL_INTENSITY);
+  byteFlush();
 }
 
+//nextHalfSecond
+//Description:
+//		moves a time on by HALF_SECOND microseconds
+static void nextHalfSecond(struct timespec * when)
+{
+  when->tv_nsec += HALF_SECOND * 1000L;
+  while(when->tv_nsec >= 1000000000L)
+    {
+      when->tv_nsec -= 1000000000L;
+      when->tv_sec++;
+    }
+}
+
+//blinkLED
+//Description:
+//		blinks the LEDs twice, half a second on and half a second
+//		off.  Each step is queued and written on a schedule, so the
+//		steps don't drift by the time it takes to write them.
 void blinkLED()
 {
+  struct timespec when;
   int i = 0;
 
+  clock_gettime(CLOCK_MONOTONIC, &when);
+
   for(i = 0; i < 2; i++)
     {
 
-      byteTx(CmdLeds);
-      byteTx(OFF);
-      byteTx(PWR_GREEN);
-      byteTx(OFF);
-
-      usleep(HALF_SECOND);
+      byteQueue(CmdLeds);
+      byteQueue(OFF);
+      byteQueue(PWR_GREEN);
+      byteQueue(OFF);
+      byteFlushAt(&when);
+      nextHalfSecond(&when);
 
-      byteTx(CmdLeds);
-      byteTx(SET_ALL);
-      byteTx(PWR_RED);
-      byteTx(FULL_INTENSITY);
-
-      usleep(HALF_SECOND);
+      byteQueue(CmdLeds);
+      byteQueue(SET_ALL);
+      byteQueue(PWR_RED);
+      byteQueue(FULL_INTENSITY);
+      byteFlushAt(&when);
+      nextHalfSecond(&when);
       
     }
-  byteTx(CmdLeds);
-  byteTx(OFF);
-  byteTx(PWR_GREEN);
-  byteTx(OFF);
+  byteQueue(CmdLeds);
+  byteQueue(OFF);
+  byteQueue(PWR_GREEN);
+  byteQueue(OFF);
+  byteFlushAt(&when);
 }
-
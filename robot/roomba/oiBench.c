@@ -0,0 +1,201 @@
+/**
+ * oiBench.c
+ *
+ * A micro-benchmark for the commands sent to the iRobot over the Open
+ * Interface.  The serial port is replaced by a pseudo-terminal whose
+ * other end is drained by a thread, so no robot is needed.  For each
+ * command the benchmark reports:
+ *
+ *  - how many bytes the command is,
+ *  - how many write() calls it takes now that commands are queued
+ *    and flushed whole, against the one per byte it used to take,
+ *  - how long, in microseconds of host time, each way takes, and
+ *  - how long the bytes spend on the wire at 57600 baud, which is
+ *    the same either way.
+ *
+ * Usage: oiBench.out [-n iterations]
+ */
+
+#include <pthread.h>
+#include <pty.h>
+
+#include "roomba.h"
+
+// The serial port, in utility.c.
+extern int fd;
+
+#define BENCH_ITERATIONS 2000
+#define BENCH_BAUD 57600
+
+// Bits on the wire per byte: a start bit, 8 data bits and a stop bit.
+#define BENCH_BITS_PER_BYTE 10
+
+// The other end of the pseudo-terminal.
+static int master = -1;
+
+// The bytes the last command wrote, captured for the per-byte replay.
+static char captured[TX_BUFFER_SIZE * 4];
+static int capturedLength = 0;
+
+
+/**
+ * drain
+ *
+ * Read and discard everything written to the pseudo-terminal, so that
+ * writes never block on a full buffer.
+ */
+static void * drain(void * arg)
+{
+  char buffer[256];
+
+  while(read(master, buffer, sizeof(buffer)) > 0);
+
+  return NULL;
+}
+
+
+/**
+ * Commands to measure.  Each sends one command, or for the script,
+ * several held and written together.
+ */
+static void benchDriveStraight() { driveStraight(MED); }
+static void benchDriveBackwards() { driveBackwards(MED); }
+static void benchStop() { stop(); }
+static void benchSetLED() { setLED(RED, PLAY_ON, ADVANCE_ON); }
+static void benchStream() { streamSensorData(); }
+static void benchScript()
+{
+  byteHold();
+  setLED(GREEN, PLAY_OFF, ADVANCE_ON);
+  driveStraight(LOW);
+  byteRelease();
+}
+
+typedef struct benchTag {
+  char * name;
+  void (*command)();
+} bench;
+
+static bench benches[] = {
+  {"driveStraight", benchDriveStraight},
+  {"driveBackwards", benchDriveBackwards},
+  {"stop", benchStop},
+  {"setLED", benchSetLED},
+  {"streamSensorData", benchStream},
+  {"setLED+drive script", benchScript},
+};
+
+#define NUM_BENCHES (sizeof(benches) / sizeof(bench))
+
+
+static double microseconds(struct timespec * start, struct timespec * end)
+{
+  return (end->tv_sec - start->tv_sec) * 1e6
+    + (end->tv_nsec - start->tv_nsec) / 1e3;
+}
+
+
+/**
+ * capture
+ *
+ * Run a command once with a pipe in place of the port, to find the
+ * bytes it sends.
+ */
+static void capture(void (*command)())
+{
+  int port = fd;
+  int p[2];
+
+  pipe(p);
+  fd = p[1];
+  command();
+  fd = port;
+  close(p[1]);
+
+  capturedLength = read(p[0], captured, sizeof(captured));
+  close(p[0]);
+}
+
+
+int main(int argc, char * argv[])
+{
+  struct timespec start, end;
+  pthread_t drainer;
+  unsigned int writesBefore, writesAfter, bytes;
+  double batchedUs, perByteUs, wireUs;
+  int iterations = BENCH_ITERATIONS;
+  int slave = -1;
+  int opt = 0;
+  int b = 0;
+  int i = 0;
+  int j = 0;
+
+  while((opt = getopt(argc, argv, "n:")) != -1)
+    {
+      if(opt == 'n') iterations = atoi(optarg);
+      else
+	{
+	  fprintf(stderr, "Usage: %s [-n iterations]\n", argv[0]);
+	  return 1;
+	}
+    }
+
+  if(openpty(&master, &slave, NULL, NULL, NULL) == -1)
+    {
+      perror("openpty");
+      return 1;
+    }
+
+  // Raw, so that the terminal doesn't translate or echo anything.
+  {
+    struct termios t;
+    tcgetattr(slave, &t);
+    cfmakeraw(&t);
+    tcsetattr(slave, TCSANOW, &t);
+  }
+
+  fd = slave;
+  pthread_create(&drainer, NULL, drain, NULL);
+
+  printf("%-20s %5s %8s %8s %10s %10s %9s\n", "command", "bytes",
+	 "writes", "was", "us/cmd", "was us", "wire us");
+
+  for(b = 0; b < NUM_BENCHES; b++)
+    {
+      capture(benches[b].command);
+
+      // Now: queued and flushed whole.
+      byteTxStats(&writesBefore, &bytes);
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      for(i = 0; i < iterations; i++)
+	{
+	  benches[b].command();
+	}
+      clock_gettime(CLOCK_MONOTONIC, &end);
+      byteTxStats(&writesAfter, &bytes);
+      batchedUs = microseconds(&start, &end) / iterations;
+
+      // Before: the same bytes, one write() each.
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      for(i = 0; i < iterations; i++)
+	{
+	  for(j = 0; j < capturedLength; j++)
+	    {
+	      write(fd, &captured[j], 1);
+	    }
+	}
+      clock_gettime(CLOCK_MONOTONIC, &end);
+      perByteUs = microseconds(&start, &end) / iterations;
+
+      wireUs = capturedLength * BENCH_BITS_PER_BYTE * 1e6 / BENCH_BAUD;
+
+      printf("%-20s %5d %8.2f %8d %10.2f %10.2f %9.0f\n", benches[b].name,
+	     capturedLength, (double)(writesAfter - writesBefore) / iterations,
+	     capturedLength, batchedUs, perByteUs, wireUs);
+    }
+
+  close(slave);
+  close(master);
+
+  return 0;
+}
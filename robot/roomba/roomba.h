@@ -47,6 +47,7 @@
 #define RCMD_PLAY    141
 #define RCMD_SENSORS 142
 #define CmdStream   148
+#define CmdQueryList 149
 #define CmdToggleStream    150
 
 
@@ -131,6 +132,29 @@
 #define SP_CLIFF_F_RIGHT_SIGNAL 30
 #define SP_CLIFF_RIGHT_SIGNAL 31
 
+// The number of sensor packets in group 1 that are queried; the wall
+// sensor (packet 8) is skipped.
+#define SP_G1_NUM_QUERIED 6
+
+// A stream frame of the queried group 1 sensors: header, byte
+// count, an ID and data byte per packet, and a checksum.
+#define SP_STREAM_HEADER 19
+#define SP_STREAM_FRAME_SIZE (3 + 2 * SP_G1_NUM_QUERIED)
+
+// The serial port openPort() opens.  Set ROOMBA_PORT in the
+// environment to open another, e.g. the pseudo-terminal served by
+// roombaSim.out.
+#define ROOMBA_PORT_DEFAULT "/dev/ttyS2"
+#define ROOMBA_PORT_ENV "ROOMBA_PORT"
+
+// The most bytes byteQueue() holds before it has to write some.
+// The longest command, a full song, is 35 bytes.
+#define TX_BUFFER_SIZE 64
+
+// How long byteRx() waits for a whole reply from the iRobot.  The
+// Create answers a query within a few milliseconds at 57600 baud.
+#define RX_TIMEOUT_MS 50
+
 #ifdef CONNEX
   // Turning radius timing values for the gumstix connex
   #define HALF_SECOND 500000
@@ -150,9 +174,9 @@
 #endif
 
 
-#define STOP_MACRO {byteTx(RCMD_DRIVE); byteTx(0x00); byteTx(0x00); byteTx(STRAIGHT >> 8); byteTx(STRAIGHT & 0x00FF);}
-#define PAUSE_STREAM_MACRO {byteTx(CmdToggleStream); byteTx(0);}
-#define RESUME_STREAM_MACRO {byteTx(CmdToggleStream); byteTx(1);}
+#define STOP_MACRO {byteQueue(RCMD_DRIVE); wordQueue(0x0000); wordQueue(STRAIGHT); byteFlush();}
+#define PAUSE_STREAM_MACRO {byteQueue(CmdToggleStream); byteQueue(0); byteFlush();}
+#define RESUME_STREAM_MACRO {byteQueue(CmdToggleStream); byteQueue(1); byteFlush();}
 
 
 #define SIZE 40
@@ -162,7 +186,16 @@
 int openPort();
 int closePort();
 void byteTx(char value);
-void byteRx(char* buffer, int nbytes, int iter);
+void byteQueue(char value);
+void wordQueue(int value);
+int byteFlush();
+void byteHold();
+int byteRelease();
+int byteFlushAt(struct timespec * when);
+int byteFlushNow();
+void byteTxStats(unsigned int * writes, unsigned int * bytes);
+int byteRx(char* buffer, int nbytes, int iter);
+int byteRxPending();
 void initialize();
 
 //commands.c
@@ -186,7 +219,8 @@ void blinkLED();
 
 
 //Sensors.c
-void receiveSensorData(int packet, char* x, int numBytes, int numIter);
-void receiveGroupOneSensorData(char * x);
+int receiveSensorData(int packet, char* x, int numBytes, int numIter);
+int receiveGroupOneSensorData(char * x);
+void streamSensorData();
 int checkSensorData(char *x);
 #endif
@@ -0,0 +1,1120 @@
+/**
+ * roombaSim.c
+ *
+ * A simulated iRobot Create, served on a pseudo-terminal, so that
+ * the robot code can be run and timed without a robot.  The
+ * simulator speaks the Open Interface: it answers sensor queries,
+ * streams sensor frames, and follows drive and LED commands.  The
+ * robot drives around a 2-D world with walls and boxes to bump into,
+ * cliffs to find with its cliff sensors, and virtual wall beams.
+ *
+ * Start the simulator, then point openPort() at it:
+ *
+ *   ./roombaSim.out -p /tmp/roomba &
+ *   ROOMBA_PORT=/tmp/roomba ./nerves.out eth0
+ *
+ * Options:
+ *
+ *   -p path   also make path a link to the pseudo-terminal.
+ *   -w file   load the world from file, described below, rather than
+ *             use the built-in one.
+ *   -l ms     how long the robot takes to start answering, on top of
+ *             the time the reply spends on the wire.  Default 0.
+ *   -b baud   the serial rate replies are paced at, or 0 to send them
+ *             as soon as they are due.  Default 57600.
+ *   -v        print each command and sensor event.
+ *
+ * On SIGINT or SIGTERM the simulator prints what it has seen,
+ * including the reaction time: how long after a bump, cliff, wheel
+ * drop or virtual wall first appears the robot code sends its next
+ * drive command.  That is the end-to-end time from the world changing
+ * to the robot responding, through the serial link, the sensor
+ * stream and the event:responder.
+ *
+ * A world file has one item per line, in millimetres and degrees,
+ * with '#' starting a comment:
+ *
+ *   room <width> <height>         walls around (0, 0)-(width, height)
+ *   start <x> <y> <heading>       where the robot starts
+ *   box <x0> <y0> <x1> <y1>       an obstacle to bump into
+ *   cliff <x0> <y0> <x1> <y1>     a drop; driving into it is a fall
+ *   vwall <x0> <y0> <x1> <y1>     a virtual wall beam
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <pty.h>
+#include <string.h>
+
+#include "roomba.h"
+
+/**
+ *  CONSTANT DEFINITIONS.  All constants in this file should begin
+ *  with 'SIM' to indicate their membership in roombaSim.c
+ */
+#define SIM_NSEC_PER_SEC 1000000000LL
+#define SIM_NSEC_PER_MSEC 1000000LL
+
+// How often the robot is moved, and how often the Open Interface
+// sends a stream frame.
+#define SIM_TICK_NS (5 * SIM_NSEC_PER_MSEC)
+#define SIM_STREAM_NS (15 * SIM_NSEC_PER_MSEC)
+
+#define SIM_DEFAULT_BAUD 57600
+#define SIM_BITS_PER_BYTE 10
+
+// The Create: its radius and the distance between its wheels, in mm,
+// and where its cliff sensors look, in mm from the centre and degrees
+// to the left of straight ahead.
+#define SIM_RADIUS 165.0
+#define SIM_WHEELBASE 258.0
+#define SIM_CLIFF_REACH 140.0
+#define SIM_MAX_VELOCITY 500
+#define SIM_MAX_RADIUS 2000
+
+// How close a virtual wall beam has to be to be seen, and how far
+// round from straight ahead the bumper reaches before a bump is felt
+// on one side only.
+#define SIM_VWALL_RANGE 150.0
+#define SIM_BUMP_CENTRE (15.0 * M_PI / 180.0)
+
+// Open Interface modes, as reported in packet 35.
+#define SIM_MODE_OFF 0
+#define SIM_MODE_PASSIVE 1
+#define SIM_MODE_SAFE 2
+#define SIM_MODE_FULL 3
+
+// Special drive radii.
+#define SIM_STRAIGHT 0x7FFF
+#define SIM_TURN_CW (-1)
+#define SIM_TURN_CCW 1
+
+// Sensor packets, singly and in groups.
+#define SIM_FIRST_PACKET 7
+#define SIM_LAST_PACKET 42
+#define SIM_MAX_GROUP 6
+
+#define SIM_MAX_ITEMS 32
+#define SIM_MAX_STREAM 43
+#define SIM_INPUT_SIZE 512
+#define SIM_REPLY_SIZE 256
+#define SIM_MAX_REPLIES 64
+
+// The most data bytes one packet can take: group 6, every packet.
+#define SIM_MAX_PACKET_SIZE 52
+
+typedef struct simRectTag {
+  double x0, y0, x1, y1;
+} simRect;
+
+// The world.  boxes includes the walls of the room.
+static simRect boxes[SIM_MAX_ITEMS];
+static simRect cliffs[SIM_MAX_ITEMS];
+static simRect vwalls[SIM_MAX_ITEMS];
+static int numBoxes = 0;
+static int numCliffs = 0;
+static int numVWalls = 0;
+
+// The robot.  The heading is in radians anticlockwise from the x
+// axis; v and w are the speed and turn rate it was told to drive at.
+static struct {
+  double x, y, heading;
+  double v, w;
+  double distance, angle;
+  int mode;
+  int velocity, radius;
+  int rightVelocity, leftVelocity;
+  int fallen;
+  unsigned char bumps;
+  unsigned char cliff[4];
+  unsigned char vwall;
+  unsigned char leds, powerColour, powerIntensity;
+} robot;
+
+// What is being streamed.
+static unsigned char stream[SIM_MAX_STREAM];
+static int numStream = 0;
+static int streaming = 0;
+
+// Replies waiting to be written, each at the time its last byte would
+// have arrived over the serial link.
+typedef struct simReplyTag {
+  long long due;
+  int length;
+  unsigned char data[SIM_REPLY_SIZE];
+} simReply;
+
+static simReply replies[SIM_MAX_REPLIES];
+static int replyHead = 0;
+static int replyCount = 0;
+static long long lastDue = 0;
+
+static long long latencyNs = 0;
+static int baud = SIM_DEFAULT_BAUD;
+static int verbose = 0;
+
+static int master = -1;
+static volatile sig_atomic_t done = 0;
+
+// When a sensor event appeared that the robot code hasn't yet
+// responded to with a drive command, or 0.
+static long long eventAt = 0;
+
+static struct {
+  unsigned int bytesIn, commands, drives, leds, queries, unknown;
+  unsigned int bytesOut, frames, dropped;
+  unsigned int reactions;
+  long long totalReactionNs, maxReactionNs;
+} stats;
+
+
+static long long nowNs()
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * SIM_NSEC_PER_SEC + now.tv_nsec;
+}
+
+static void onSignal(int sig)
+{
+  done = 1;
+}
+
+
+/**
+ * World
+ */
+
+static int addRect(simRect * list, int * count, double x0, double y0,
+		   double x1, double y1)
+{
+  if(*count == SIM_MAX_ITEMS)
+    {
+      return -1;
+    }
+
+  list[*count].x0 = fmin(x0, x1);
+  list[*count].y0 = fmin(y0, y1);
+  list[*count].x1 = fmax(x0, x1);
+  list[*count].y1 = fmax(y0, y1);
+  (*count)++;
+
+  return 0;
+}
+
+static void addRoom(double width, double height)
+{
+  addRect(boxes, &numBoxes, -1000, -1000, 0, height + 1000);
+  addRect(boxes, &numBoxes, width, -1000, width + 1000, height + 1000);
+  addRect(boxes, &numBoxes, 0, -1000, width, 0);
+  addRect(boxes, &numBoxes, 0, height, width, height + 1000);
+}
+
+/**
+ * defaultWorld()
+ *
+ * A 3 m by 2 m room with a box in the middle, a stairwell in one
+ * corner and a virtual wall across the other end.
+ */
+static void defaultWorld()
+{
+  addRoom(3000, 2000);
+  addRect(boxes, &numBoxes, 1800, 800, 2200, 1200);
+  addRect(cliffs, &numCliffs, 2500, 0, 3000, 600);
+  addRect(vwalls, &numVWalls, 600, 1400, 600, 2000);
+
+  robot.x = 300;
+  robot.y = 1000;
+  robot.heading = 0;
+}
+
+/**
+ * loadWorld()
+ *
+ * Read a world file, described at the top of this file.
+ *
+ * @return 0 if successful, -1 if the file can't be read or a line
+ *         doesn't make sense.
+ */
+static int loadWorld(char * path)
+{
+  FILE * f = fopen(path, "r");
+  char line[256];
+  char item[16];
+  double a, b, c, d;
+  int n = 0;
+  int lineNumber = 0;
+  int status = 0;
+
+  if(f == NULL)
+    {
+      perror(path);
+      return -1;
+    }
+
+  while(status == 0 && fgets(line, sizeof(line), f) != NULL)
+    {
+      lineNumber++;
+      if(strchr(line, '#') != NULL)
+	{
+	  *strchr(line, '#') = '\0';
+	}
+
+      n = sscanf(line, "%15s %lf %lf %lf %lf", item, &a, &b, &c, &d);
+      if(n <= 0)
+	{
+	  continue;
+	}
+
+      if(strcmp(item, "room") == 0 && n == 3)
+	{
+	  addRoom(a, b);
+	}
+      else if(strcmp(item, "start") == 0 && n == 4)
+	{
+	  robot.x = a;
+	  robot.y = b;
+	  robot.heading = c * M_PI / 180.0;
+	}
+      else if(strcmp(item, "box") == 0 && n == 5)
+	{
+	  status = addRect(boxes, &numBoxes, a, b, c, d);
+	}
+      else if(strcmp(item, "cliff") == 0 && n == 5)
+	{
+	  status = addRect(cliffs, &numCliffs, a, b, c, d);
+	}
+      else if(strcmp(item, "vwall") == 0 && n == 5)
+	{
+	  status = addRect(vwalls, &numVWalls, a, b, c, d);
+	}
+      else
+	{
+	  status = -1;
+	}
+
+      if(status != 0)
+	{
+	  fprintf(stderr, "%s:%d: can't make sense of this\n", path, lineNumber);
+	}
+    }
+
+  fclose(f);
+  return status;
+}
+
+static int inside(simRect * r, double x, double y)
+{
+  return x >= r->x0 && x <= r->x1 && y >= r->y0 && y <= r->y1;
+}
+
+/**
+ * nearest()
+ *
+ * The distance from (x, y) to the nearest point of a box, and that
+ * point.  0 if (x, y) is inside it.
+ */
+static double nearest(simRect * r, double x, double y, double * px, double * py)
+{
+  *px = fmax(r->x0, fmin(x, r->x1));
+  *py = fmax(r->y0, fmin(y, r->y1));
+
+  return hypot(x - *px, y - *py);
+}
+
+/**
+ * toSegment()
+ *
+ * The distance from (x, y) to a virtual wall beam, which runs
+ * corner to corner.
+ */
+static double toSegment(simRect * r, double x, double y)
+{
+  double dx = r->x1 - r->x0;
+  double dy = r->y1 - r->y0;
+  double t = 0;
+  double length = dx * dx + dy * dy;
+
+  if(length > 0)
+    {
+      t = ((x - r->x0) * dx + (y - r->y0) * dy) / length;
+      t = fmax(0, fmin(1, t));
+    }
+
+  return hypot(x - (r->x0 + t * dx), y - (r->y0 + t * dy));
+}
+
+static int collides(double x, double y)
+{
+  double px, py;
+  int i = 0;
+
+  for(i = 0; i < numBoxes; i++)
+    {
+      if(nearest(&boxes[i], x, y, &px, &py) < SIM_RADIUS)
+	{
+	  return 1;
+	}
+    }
+
+  return 0;
+}
+
+/**
+ * sense()
+ *
+ * Work out what the sensors see from where the robot is.
+ */
+static void sense()
+{
+  static const double cliffAngles[4] = {65.0, 20.0, -20.0, -65.0};
+  double px, py, a, sx, sy;
+  int i = 0;
+  int j = 0;
+
+  robot.bumps &= ~SENSOR_BUMP_BOTH;
+  for(i = 0; i < numBoxes; i++)
+    {
+      if(nearest(&boxes[i], robot.x, robot.y, &px, &py) > SIM_RADIUS + 1.0)
+	{
+	  continue;
+	}
+
+      a = remainder(atan2(py - robot.y, px - robot.x) - robot.heading, 2 * M_PI);
+      if(fabs(a) > M_PI / 2)
+	{
+	  continue;
+	}
+
+      if(a > SIM_BUMP_CENTRE)
+	{
+	  robot.bumps |= SENSOR_BUMP_LEFT;
+	}
+      else if(a < -SIM_BUMP_CENTRE)
+	{
+	  robot.bumps |= SENSOR_BUMP_RIGHT;
+	}
+      else
+	{
+	  robot.bumps |= SENSOR_BUMP_BOTH;
+	}
+    }
+
+  for(i = 0; i < 4; i++)
+    {
+      a = robot.heading + cliffAngles[i] * M_PI / 180.0;
+      sx = robot.x + SIM_CLIFF_REACH * cos(a);
+      sy = robot.y + SIM_CLIFF_REACH * sin(a);
+
+      robot.cliff[i] = 0;
+      for(j = 0; j < numCliffs; j++)
+	{
+	  if(inside(&cliffs[j], sx, sy))
+	    {
+	      robot.cliff[i] = 1;
+	    }
+	}
+    }
+
+  robot.vwall = 0;
+  for(i = 0; i < numVWalls; i++)
+    {
+      if(toSegment(&vwalls[i], robot.x, robot.y) < SIM_RADIUS + SIM_VWALL_RANGE)
+	{
+	  robot.vwall = 1;
+	}
+    }
+
+  for(i = 0; i < numCliffs; i++)
+    {
+      if(inside(&cliffs[i], robot.x, robot.y))
+	{
+	  robot.fallen = 1;
+	  robot.bumps |= SENSOR_WHEELDROP_BOTH | SENSOR_WHEELDROP_CASTER;
+	}
+    }
+}
+
+static int sensorEvent()
+{
+  return robot.bumps != 0 || robot.vwall
+    || robot.cliff[0] || robot.cliff[1] || robot.cliff[2] || robot.cliff[3];
+}
+
+/**
+ * stopDriving()
+ */
+static void stopDriving()
+{
+  robot.v = robot.w = 0;
+  robot.velocity = robot.radius = 0;
+  robot.rightVelocity = robot.leftVelocity = 0;
+}
+
+/**
+ * step()
+ *
+ * Move the robot on by dt seconds.  It stops short of anything it
+ * would drive into, and turns on the spot regardless.
+ */
+static void step(double dt, long long now)
+{
+  int before = sensorEvent();
+  double th, dx, dy, lo, hi, t;
+  int i = 0;
+
+  if(robot.fallen)
+    {
+      stopDriving();
+    }
+
+  th = robot.heading + robot.w * dt / 2;
+  dx = robot.v * dt * cos(th);
+  dy = robot.v * dt * sin(th);
+
+  // Go as far along the step as the robot can.
+  lo = 0;
+  hi = 1;
+  if(!collides(robot.x + dx, robot.y + dy))
+    {
+      lo = 1;
+    }
+  else
+    {
+      for(i = 0; i < 12; i++)
+	{
+	  t = (lo + hi) / 2;
+	  if(collides(robot.x + t * dx, robot.y + t * dy)) hi = t;
+	  else lo = t;
+	}
+    }
+
+  robot.x += lo * dx;
+  robot.y += lo * dy;
+  robot.distance += lo * robot.v * dt;
+  robot.heading = remainder(robot.heading + robot.w * dt, 2 * M_PI);
+  robot.angle += robot.w * dt;
+
+  sense();
+
+  // Safe mode stops the robot at a cliff or wheel drop and drops back
+  // to passive.
+  if(robot.mode == SIM_MODE_SAFE
+     && (robot.cliff[0] || robot.cliff[1] || robot.cliff[2] || robot.cliff[3]
+	 || (robot.bumps & SENSOR_WHEELDROP_BOTH)))
+    {
+      stopDriving();
+      robot.mode = SIM_MODE_PASSIVE;
+    }
+
+  if(!before && sensorEvent())
+    {
+      eventAt = now;
+      if(verbose)
+	{
+	  printf("roombaSim: at (%.0f, %.0f): bumps 0x%02x cliffs %d%d%d%d vwall %d\n",
+		 robot.x, robot.y, robot.bumps, robot.cliff[0], robot.cliff[1],
+		 robot.cliff[2], robot.cliff[3], robot.vwall);
+	}
+    }
+}
+
+
+/**
+ * Replies
+ */
+
+/**
+ * reply()
+ *
+ * Queue bytes to go back to the robot code after the configured
+ * latency and the time they take on the wire.
+ */
+static void reply(unsigned char * data, int length, long long now)
+{
+  simReply * r = NULL;
+  long long due = now + latencyNs;
+
+  if(replyCount == SIM_MAX_REPLIES || length > SIM_REPLY_SIZE)
+    {
+      stats.dropped++;
+      return;
+    }
+
+  if(due < lastDue)
+    {
+      due = lastDue;
+    }
+  if(baud > 0)
+    {
+      due += (long long)length * SIM_BITS_PER_BYTE * SIM_NSEC_PER_SEC / baud;
+    }
+  lastDue = due;
+
+  r = &replies[(replyHead + replyCount) % SIM_MAX_REPLIES];
+  r->due = due;
+  r->length = length;
+  memcpy(r->data, data, length);
+  replyCount++;
+}
+
+/**
+ * sendReplies()
+ *
+ * Write the replies that are due.  One the robot code isn't reading
+ * fast enough to fit in the pseudo-terminal is dropped.
+ */
+static void sendReplies(long long now)
+{
+  simReply * r = NULL;
+  int n = 0;
+
+  while(replyCount > 0 && replies[replyHead].due <= now)
+    {
+      r = &replies[replyHead];
+      n = write(master, r->data, r->length);
+      if(n == r->length)
+	{
+	  stats.bytesOut += n;
+	}
+      else
+	{
+	  stats.dropped++;
+	}
+
+      replyHead = (replyHead + 1) % SIM_MAX_REPLIES;
+      replyCount--;
+    }
+}
+
+
+/**
+ * Sensor packets
+ */
+
+static const unsigned char packetSizes[SIM_LAST_PACKET - SIM_FIRST_PACKET + 1] = {
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1,      // 7 - 16
+  1, 1, 2, 2, 1, 2, 2, 1, 2, 2,      // 17 - 26
+  2, 2, 2, 2, 2, 1, 2, 1, 1, 1,      // 27 - 36
+  1, 1, 2, 2, 2, 2,                  // 37 - 42
+};
+
+// The first and last packet in each group packet, 0 to 6.
+static const unsigned char groups[SIM_MAX_GROUP + 1][2] = {
+  {7, 26}, {7, 16}, {17, 20}, {21, 26}, {27, 34}, {35, 42}, {7, 42},
+};
+
+static int putWord(unsigned char * out, int value)
+{
+  out[0] = (value >> 8) & 0xFF;
+  out[1] = value & 0xFF;
+  return 2;
+}
+
+/**
+ * putPacket()
+ *
+ * Write the data of a sensor packet, single or group, as the Open
+ * Interface would send it.  Reading the distance or angle resets it.
+ *
+ * @return the number of bytes written, or 0 for an unknown packet.
+ */
+static int putPacket(int id, unsigned char * out)
+{
+  int value = 0;
+  int n = 0;
+  int i = 0;
+
+  if(id <= SIM_MAX_GROUP)
+    {
+      for(i = groups[id][0]; i <= groups[id][1]; i++)
+	{
+	  n += putPacket(i, out + n);
+	}
+      return n;
+    }
+
+  if(id < SIM_FIRST_PACKET || id > SIM_LAST_PACKET)
+    {
+      return 0;
+    }
+
+  switch(id)
+    {
+    case SP_BUMPS_WHEELDROPS: value = robot.bumps; break;
+    case SP_CLIFF_LEFT: value = robot.cliff[0]; break;
+    case SP_CLIFF_FRONT_LEFT: value = robot.cliff[1]; break;
+    case SP_CLIFF_FRONT_RIGHT: value = robot.cliff[2]; break;
+    case SP_CLIFF_RIGHT: value = robot.cliff[3]; break;
+    case SP_VIRTUAL_WALL: value = robot.vwall; break;
+    case 17: value = 255; break;                    // no IR byte
+    case 19:
+      value = (int)robot.distance;
+      robot.distance -= value;
+      break;
+    case 20:
+      value = (int)(robot.angle * 180.0 / M_PI);
+      robot.angle -= value * M_PI / 180.0;
+      break;
+    case 22: value = 16000; break;                  // mV
+    case 23: value = (robot.v != 0 || robot.w != 0) ? -600 : -150; break;
+    case 24: value = 25; break;                     // degrees C
+    case 25: value = 2500; break;                   // mAh
+    case 26: value = 2700; break;
+    case SP_CLIFF_LEFT_SIGNAL: value = robot.cliff[0] ? 10 : 1500; break;
+    case SP_CLIFF_F_LEFT_SIGNAL: value = robot.cliff[1] ? 10 : 1500; break;
+    case SP_CLIFF_F_RIGHT_SIGNAL: value = robot.cliff[2] ? 10 : 1500; break;
+    case SP_CLIFF_RIGHT_SIGNAL: value = robot.cliff[3] ? 10 : 1500; break;
+    case 35: value = robot.mode; break;
+    case 38: value = numStream; break;
+    case SP_REQUESTED_VELOCITY: value = robot.velocity; break;
+    case 40: value = robot.radius; break;
+    case 41: value = robot.rightVelocity; break;
+    case 42: value = robot.leftVelocity; break;
+    default: value = 0; break;
+    }
+
+  if(packetSizes[id - SIM_FIRST_PACKET] == 2)
+    {
+      return putWord(out, value);
+    }
+
+  out[0] = value & 0xFF;
+  return 1;
+}
+
+/**
+ * sendFrame()
+ *
+ * Send a stream frame: the header, the number of bytes that follow,
+ * an ID and the data for each packet streamed, and a checksum that
+ * makes all the bytes add up to 0.
+ */
+static void sendFrame(long long now)
+{
+  unsigned char frame[SIM_REPLY_SIZE];
+  unsigned char sum = 0;
+  int n = 2;
+  int i = 0;
+
+  frame[0] = SP_STREAM_HEADER;
+  for(i = 0; i < numStream && n + 2 + SIM_MAX_PACKET_SIZE < SIM_REPLY_SIZE; i++)
+    {
+      frame[n++] = stream[i];
+      n += putPacket(stream[i], frame + n);
+    }
+  frame[1] = n - 2;
+
+  for(i = 0; i < n; i++)
+    {
+      sum += frame[i];
+    }
+  frame[n++] = (unsigned char)(0 - sum);
+
+  reply(frame, n, now);
+  stats.frames++;
+}
+
+
+/**
+ * Commands
+ */
+
+/**
+ * commandLength()
+ *
+ * How many bytes, opcode and data, the command at the start of buf
+ * takes.
+ *
+ * @return the length, or 0 if more bytes are needed to tell.
+ */
+static int commandLength(unsigned char * buf, int have)
+{
+  switch(buf[0])
+    {
+    case CmdBaud: case CmdMotors: case RCMD_PLAY: case RCMD_SENSORS:
+    case 147: case CmdToggleStream: case 151: case 155: case 158:
+      return 2;
+    case RCMD_DRIVE: case 145:
+      return 5;
+    case CmdLeds: case 144:
+      return 4;
+    case 156: case 157:
+      return 3;
+    case RCMD_SONG:
+      return have < 3 ? 0 : 3 + 2 * buf[2];
+    case CmdStream: case CmdQueryList: case 152:
+      return have < 2 ? 0 : 2 + buf[1];
+    default:
+      return 1;
+    }
+}
+
+static int toSigned(unsigned char hi, unsigned char lo)
+{
+  return (short)((hi << 8) | lo);
+}
+
+/**
+ * drive()
+ *
+ * Follow a Drive command: a velocity in mm/s and a turn radius in
+ * mm, left positive, or one of the special radii.
+ */
+static void drive(int velocity, int radius)
+{
+  velocity = fmax(-SIM_MAX_VELOCITY, fmin(SIM_MAX_VELOCITY, velocity));
+
+  robot.velocity = velocity;
+  robot.radius = radius;
+  robot.v = velocity;
+
+  // A radius of 0, as stop() sends, is taken as straight.
+  if(radius == SIM_STRAIGHT || radius == (short)STRAIGHT || radius == 0)
+    {
+      robot.w = 0;
+    }
+  else if(radius == SIM_TURN_CCW || radius == SIM_TURN_CW)
+    {
+      robot.v = 0;
+      robot.w = radius * velocity / (SIM_WHEELBASE / 2);
+    }
+  else
+    {
+      radius = fmax(-SIM_MAX_RADIUS, fmin(SIM_MAX_RADIUS, radius));
+      robot.w = velocity / (double)radius;
+    }
+}
+
+/**
+ * driveDirect()
+ *
+ * Follow a Drive Direct command: the speed of each wheel in mm/s.
+ */
+static void driveDirect(int right, int left)
+{
+  right = fmax(-SIM_MAX_VELOCITY, fmin(SIM_MAX_VELOCITY, right));
+  left = fmax(-SIM_MAX_VELOCITY, fmin(SIM_MAX_VELOCITY, left));
+
+  robot.rightVelocity = right;
+  robot.leftVelocity = left;
+  robot.v = (right + left) / 2.0;
+  robot.w = (right - left) / SIM_WHEELBASE;
+}
+
+/**
+ * execute()
+ *
+ * Carry out one whole command.  As on the Create, nothing but Start
+ * is obeyed until the Open Interface is started, and the robot only
+ * moves in safe or full mode.
+ */
+static void execute(unsigned char * cmd, int length, long long now)
+{
+  unsigned char out[SIM_REPLY_SIZE];
+  int n = 0;
+  int i = 0;
+
+  stats.commands++;
+
+  if(robot.mode == SIM_MODE_OFF && cmd[0] != CmdStart)
+    {
+      return;
+    }
+
+  switch(cmd[0])
+    {
+    case CmdStart:
+      if(robot.mode == SIM_MODE_OFF) robot.mode = SIM_MODE_PASSIVE;
+      break;
+    case CmdControl:
+    case CmdSafe:
+      robot.mode = SIM_MODE_SAFE;
+      break;
+    case CmdFull:
+      robot.mode = SIM_MODE_FULL;
+      break;
+    case CmdPower:
+      stopDriving();
+      robot.mode = SIM_MODE_PASSIVE;
+      break;
+
+    case RCMD_DRIVE:
+    case 145:
+      stats.drives++;
+      if(eventAt != 0)
+	{
+	  stats.reactions++;
+	  stats.totalReactionNs += now - eventAt;
+	  if(now - eventAt > stats.maxReactionNs) stats.maxReactionNs = now - eventAt;
+	  eventAt = 0;
+	}
+      if(robot.mode != SIM_MODE_SAFE && robot.mode != SIM_MODE_FULL)
+	{
+	  break;
+	}
+      if(cmd[0] == RCMD_DRIVE)
+	{
+	  drive(toSigned(cmd[1], cmd[2]), toSigned(cmd[3], cmd[4]));
+	}
+      else
+	{
+	  driveDirect(toSigned(cmd[1], cmd[2]), toSigned(cmd[3], cmd[4]));
+	}
+      if(verbose)
+	{
+	  printf("roombaSim: drive v %.0f mm/s w %.2f rad/s\n", robot.v, robot.w);
+	}
+      break;
+
+    case CmdLeds:
+      stats.leds++;
+      robot.leds = cmd[1];
+      robot.powerColour = cmd[2];
+      robot.powerIntensity = cmd[3];
+      if(verbose)
+	{
+	  printf("roombaSim: leds 0x%02x power %d at %d\n", cmd[1], cmd[2], cmd[3]);
+	}
+      break;
+
+    case RCMD_SENSORS:
+      stats.queries++;
+      n = putPacket(cmd[1], out);
+      reply(out, n, now);
+      break;
+
+    case CmdQueryList:
+      stats.queries++;
+      for(i = 0; i < cmd[1] && n + SIM_MAX_PACKET_SIZE <= SIM_REPLY_SIZE; i++)
+	{
+	  n += putPacket(cmd[2 + i], out + n);
+	}
+      reply(out, n, now);
+      break;
+
+    case CmdStream:
+      numStream = cmd[1] < SIM_MAX_STREAM ? cmd[1] : SIM_MAX_STREAM;
+      memcpy(stream, cmd + 2, numStream);
+      streaming = numStream > 0;
+      break;
+
+    case CmdToggleStream:
+      streaming = cmd[1] && numStream > 0;
+      break;
+
+    case CmdBaud: case CmdSpot: case CmdClean: case CmdMax:
+    case CmdMotors: case RCMD_SONG: case RCMD_PLAY:
+      // Accepted, but nothing to simulate.
+      break;
+
+    default:
+      stats.unknown++;
+      break;
+    }
+}
+
+/**
+ * receive()
+ *
+ * Read what the robot code has written and carry out each command
+ * that has arrived whole.  A byte that can't start a command is
+ * skipped.
+ */
+static void receive(long long now)
+{
+  static unsigned char input[SIM_INPUT_SIZE];
+  static int have = 0;
+  int length = 0;
+  int n = 0;
+
+  n = read(master, input + have, SIM_INPUT_SIZE - have);
+  if(n <= 0)
+    {
+      return;
+    }
+  have += n;
+  stats.bytesIn += n;
+
+  while(have > 0)
+    {
+      if(input[0] < CmdStart)
+	{
+	  stats.unknown++;
+	  length = 1;
+	}
+      else
+	{
+	  length = commandLength(input, have);
+	  if(length == 0 || length > have)
+	    {
+	      break;
+	    }
+	  execute(input, length, now);
+	}
+
+      have -= length;
+      memmove(input, input + length, have);
+    }
+
+  // A command too long to ever fit is thrown away.
+  if(have == SIM_INPUT_SIZE)
+    {
+      stats.unknown += have;
+      have = 0;
+    }
+}
+
+
+static void printStats()
+{
+  printf("roombaSim: %u bytes in, %u commands (%u drive, %u LED, %u queries), %u unknown\n",
+	 stats.bytesIn, stats.commands, stats.drives, stats.leds, stats.queries,
+	 stats.unknown);
+  printf("roombaSim: %u bytes out, %u stream frames, %u replies dropped\n",
+	 stats.bytesOut, stats.frames, stats.dropped);
+  if(stats.reactions > 0)
+    {
+      printf("roombaSim: reaction to sensor events: %u, %.3f ms on average, %.3f ms at worst\n",
+	     stats.reactions, stats.totalReactionNs / 1e6 / stats.reactions,
+	     stats.maxReactionNs / 1e6);
+    }
+  printf("roombaSim: robot at (%.0f, %.0f) heading %.0f degrees%s\n",
+	 robot.x, robot.y, robot.heading * 180.0 / M_PI,
+	 robot.fallen ? ", fallen down a cliff" : "");
+}
+
+
+int main(int argc, char * argv[])
+{
+  struct termios t;
+  struct timespec wait;
+  struct pollfd pfd;
+  long long now, nextTick, nextFrame, until;
+  char * link = NULL;
+  char * world = NULL;
+  int slave = -1;
+  int opt = 0;
+
+  while((opt = getopt(argc, argv, "p:w:l:b:v")) != -1)
+    {
+      switch(opt)
+	{
+	case 'p': link = optarg; break;
+	case 'w': world = optarg; break;
+	case 'l': latencyNs = atof(optarg) * SIM_NSEC_PER_MSEC; break;
+	case 'b': baud = atoi(optarg); break;
+	case 'v': verbose = 1; break;
+	default:
+	  fprintf(stderr, "Usage: %s [-p link] [-w world] [-l latency ms] [-b baud] [-v]\n",
+		  argv[0]);
+	  return 1;
+	}
+    }
+
+  if(world == NULL)
+    {
+      defaultWorld();
+    }
+  else if(loadWorld(world) != 0)
+    {
+      return 1;
+    }
+
+  if(collides(robot.x, robot.y))
+    {
+      fprintf(stderr, "The robot starts inside something.\n");
+      return 1;
+    }
+
+  if(openpty(&master, &slave, NULL, NULL, NULL) == -1)
+    {
+      perror("openpty");
+      return 1;
+    }
+
+  // A serial port passes bytes through as they are; so must this.
+  // The slave end stays open here so that the robot code can close
+  // and reopen it.
+  tcgetattr(slave, &t);
+  cfmakeraw(&t);
+  tcsetattr(slave, TCSANOW, &t);
+  fcntl(master, F_SETFL, O_NONBLOCK);
+
+  if(link != NULL)
+    {
+      unlink(link);
+      if(symlink(ptsname(master), link) == -1)
+	{
+	  perror(link);
+	  return 1;
+	}
+    }
+
+  printf("roombaSim: serving %s\n", link != NULL ? link : ptsname(master));
+  fflush(stdout);
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+
+  sense();
+
+  pfd.fd = master;
+  pfd.events = POLLIN;
+  nextTick = nextFrame = nowNs();
+
+  while(!done)
+    {
+      now = nowNs();
+
+      while(nextTick <= now)
+	{
+	  step(SIM_TICK_NS / (double)SIM_NSEC_PER_SEC, now);
+	  nextTick += SIM_TICK_NS;
+	}
+
+      if(streaming)
+	{
+	  if(nextFrame <= now)
+	    {
+	      sendFrame(now);
+	      nextFrame += SIM_STREAM_NS;
+	      if(nextFrame <= now) nextFrame = now + SIM_STREAM_NS;
+	    }
+	}
+      else
+	{
+	  nextFrame = now + SIM_STREAM_NS;
+	}
+
+      sendReplies(now);
+
+      until = nextTick;
+      if(streaming && nextFrame < until) until = nextFrame;
+      if(replyCount > 0 && replies[replyHead].due < until) until = replies[replyHead].due;
+      if(until < now) until = now;
+
+      wait.tv_sec = (until - now) / SIM_NSEC_PER_SEC;
+      wait.tv_nsec = (until - now) % SIM_NSEC_PER_SEC;
+
+      if(ppoll(&pfd, 1, &wait, NULL) > 0 && (pfd.revents & POLLIN))
+	{
+	  receive(nowNs());
+	}
+    }
+
+  printStats();
+
+  if(link != NULL)
+    {
+      unlink(link);
+    }
+  close(slave);
+  close(master);
+
+  return 0;
+}
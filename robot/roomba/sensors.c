@@ -3,20 +3,42 @@
  * This file contains functions pertaining to roomba sensors
  */
 
+/**
+ * txGroupOnePacketList()
+ *
+ * Queue the count and packet IDs of the group 1 sensors that are
+ * queried or streamed: bump, cliff and virtual wall.  The wall
+ * sensor is skipped.  Used after a Query List or Stream opcode.
+ *
+ * @return void
+ */
+static void txGroupOnePacketList()
+{
+  int i = 0;
+
+  byteQueue(SP_G1_NUM_QUERIED);
+  byteQueue(SP_BUMPS_WHEELDROPS);
+  for(i = SP_CLIFF_LEFT; i <= SP_VIRTUAL_WALL; i++)
+    {
+      byteQueue(i);
+    }
+}
+
 /**
  * receiveSensorData()
  * 
  * Query for and receive the specified sensor data packet from the
  * iRobot.
  *
- * @return void
+ * @return the number of bytes received.
  */
-void receiveSensorData(int packet, char* x, int numBytes, int numIter)
+int receiveSensorData(int packet, char* x, int numBytes, int numIter)
 {
   
-  byteTx(RCMD_SENSORS);
-  byteTx(packet);
-  byteRx(x, numBytes, numIter);
+  byteQueue(RCMD_SENSORS);
+  byteQueue(packet);
+  byteFlushNow();
+  return byteRx(x, numBytes, numIter);
 }
 
 /**
@@ -25,13 +47,24 @@ void receiveSensorData(int packet, char* x, int numBytes, int numIter)
  * Query for and receive the follow sensor packets from the group
  * packet 1: bump, cliff, virtual wall.
  *
- * @return void
+ * All six packets are requested with a single Query List command and
+ * arrive as one 6-byte reply.  Asking for each packet separately
+ * took six round trips per sense cycle.  Define SENSORS_ONE_AT_A_TIME
+ * to get the old behaviour back, e.g. to compare polling rates.
+ *
+ * The data is laid out as in group packet 1, with the wall sensor
+ * byte, x[1], left untouched.
+ *
+ * @return the number of bytes received, SP_G1_NUM_QUERIED if all
+ *         went well.
  */
-void receiveGroupOneSensorData(char * x)
+int receiveGroupOneSensorData(char * x)
 {
+#ifdef SENSORS_ONE_AT_A_TIME
   int i = 0;
+  int got = 0;
 
-  receiveSensorData(SP_BUMPS_WHEELDROPS, x, 1, 1);
+  got += receiveSensorData(SP_BUMPS_WHEELDROPS, x, 1, 1);
 
   //skip wall sensor data
   x++;
@@ -39,8 +72,54 @@ void receiveGroupOneSensorData(char * x)
   for(i = SP_CLIFF_LEFT; i <= SP_VIRTUAL_WALL; i++)
     {
       x++;
-      receiveSensorData(i, x, 1, 1);
+      got += receiveSensorData(i, x, 1, 1);
+    }
+
+  return got;
+#else
+  char reply[SP_G1_NUM_QUERIED] = {0};
+  int got = 0;
+  int i = 0;
+
+  byteQueue(CmdQueryList);
+  txGroupOnePacketList();
+  byteFlushNow();
+
+  if((got = byteRx(reply, SP_G1_NUM_QUERIED, 1)) != SP_G1_NUM_QUERIED)
+    {
+      // Leave x as it was rather than fill it with half a reply.
+      return got;
     }
+
+  x[SP_G1_BUMPS_WHEELDROPS] = reply[0];
+  for(i = 1; i < SP_G1_NUM_QUERIED; i++)
+    {
+      x[SP_G1_CLIFF_LEFT + i - 1] = reply[i];
+    }
+
+  return got;
+#endif
+}
+
+/**
+ * streamSensorData()
+ *
+ * Ask the iRobot to send the group 1 sensors, as queried by
+ * receiveGroupOneSensorData(), every 15 ms until told to stop.  Each
+ * frame is SP_STREAM_FRAME_SIZE bytes: the SP_STREAM_HEADER byte, the
+ * number of bytes that follow, a packet ID and data byte for each
+ * sensor, and a checksum.  All the bytes of a frame add up to 0.
+ *
+ * Nothing else may read from the iRobot while it is streaming; use
+ * PAUSE_STREAM_MACRO first.
+ *
+ * @return void
+ */
+void streamSensorData()
+{
+  byteQueue(CmdStream);
+  txGroupOnePacketList();
+  byteFlush();
 }
 
 /**
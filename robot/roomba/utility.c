@@ -2,6 +2,9 @@
  * This file contains low level commands to the roomba
  */
 #include "roomba.h"
+#include <poll.h>
+#include <errno.h>
+#include <sys/ioctl.h>
 
 /*
 #include <strings.h>
@@ -23,15 +26,24 @@ int fd = -1;
 /**
  * openPort()
  *
- * Opens ttyS2 port to write to iRobot.
+ * Opens the serial port to write to iRobot: ttyS2, or the port named
+ * by the ROOMBA_PORT environment variable, e.g. a simulator's
+ * pseudo-terminal.
  * 
- * @return -1 if port failed to open and 0 if port successfuly opens
+ * @return 0 if port failed to open, the file descriptor if it opens
  */
 int openPort()
 {
-  fd = open("/dev/ttyS2", O_RDWR | O_NOCTTY);
+  char * port = getenv(ROOMBA_PORT_ENV);
 
-  if (!fd)
+  if(port == NULL)
+    {
+      port = ROOMBA_PORT_DEFAULT;
+    }
+
+  fd = open(port, O_RDWR | O_NOCTTY);
+
+  if (fd == -1)
     {
 #ifdef DEBUG
       printf("File failed to open \n");
@@ -67,10 +79,188 @@ int closePort()
     return -1;
 }
 
+// Bytes queued for the iRobot by byteQueue() and not yet written,
+// and how many byteHold() calls are outstanding.
+static char txBuffer[TX_BUFFER_SIZE];
+static int txLength = 0;
+static int txHeld = 0;
+
+// How many write() calls and bytes have gone to the iRobot.
+static unsigned int txWrites = 0;
+static unsigned int txBytes = 0;
+
+/**
+ * txWrite()
+ *
+ * Write everything queued to the iRobot, in as few write() calls as
+ * the port allows; usually one.
+ *
+ * @return 0 if everything was written, -1 if a write failed, in which
+ *         case the rest is discarded.
+ */
+static int txWrite()
+{
+  int sent = 0;
+  int n = 0;
+
+  while(sent < txLength)
+    {
+      n = write(fd, txBuffer + sent, txLength - sent);
+      txWrites++;
+      if(n <= 0)
+	{
+	  txLength = 0;
+	  return -1;
+	}
+      sent += n;
+      txBytes += n;
+    }
+
+  txLength = 0;
+  return 0;
+}
+
+/**
+ * byteQueue()
+ *
+ * Adds a byte to the next write to the iRobot.  A command is built by
+ * queueing its opcode and data bytes and then calling byteFlush(), so
+ * that the whole command goes out in one write().
+ *
+ * @arg value the 8-bit value to be queued.
+ *
+ * @return void
+ */
+void byteQueue(char value)
+{
+  if(txLength == TX_BUFFER_SIZE)
+    {
+      txWrite();
+    }
+
+  txBuffer[txLength++] = value;
+}
+
+/**
+ * wordQueue()
+ *
+ * Adds a 16-bit value to the next write to the iRobot, high byte
+ * first, as the Open Interface expects.
+ *
+ * @arg value the 16-bit value to be queued.
+ *
+ * @return void
+ */
+void wordQueue(int value)
+{
+  byteQueue((value >> 8) & 0x00FF);
+  byteQueue(value & 0x00FF);
+}
+
+/**
+ * byteFlush()
+ *
+ * Writes the queued bytes to the iRobot, unless byteHold() has been
+ * called, in which case they wait for byteRelease().
+ *
+ * @return 0 if successful, -1 if a write failed.
+ */
+int byteFlush()
+{
+  if(txHeld > 0)
+    {
+      return 0;
+    }
+
+  return txWrite();
+}
+
+/**
+ * byteHold()
+ *
+ * Holds back byteFlush() so that several commands, e.g. an LED change
+ * and a drive, go to the iRobot in a single write.  Calls nest; each
+ * needs a byteRelease().
+ *
+ * @return void
+ */
+void byteHold()
+{
+  txHeld++;
+}
+
+/**
+ * byteRelease()
+ *
+ * Undoes a byteHold() and, if it was the last, writes everything
+ * queued since.
+ *
+ * @return 0 if successful, -1 if a write failed.
+ */
+int byteRelease()
+{
+  if(txHeld > 0)
+    {
+      txHeld--;
+    }
+
+  return byteFlush();
+}
+
+/**
+ * byteFlushNow()
+ *
+ * Writes the queued bytes to the iRobot now, whether or not
+ * byteHold() is in effect.  A query must go out this way before its
+ * reply is read with byteRx(), or it would never be answered.
+ *
+ * @return 0 if successful, -1 if a write failed.
+ */
+int byteFlushNow()
+{
+  return txWrite();
+}
+
+/**
+ * byteFlushAt()
+ *
+ * Writes the queued bytes to the iRobot at a given time on the
+ * monotonic clock, whether or not byteHold() is in effect.  A script
+ * of timed commands, like blinkLED(), can then queue each step and
+ * flush it at start + n * period without the steps drifting.
+ *
+ * @arg when the time to write, from clock_gettime(CLOCK_MONOTONIC).
+ *
+ * @return 0 if successful, -1 if a write failed.
+ */
+int byteFlushAt(struct timespec * when)
+{
+  while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, when, NULL) == EINTR);
+
+  return txWrite();
+}
+
+/**
+ * byteTxStats()
+ *
+ * Reports how many write() calls and bytes have gone to the iRobot.
+ *
+ * @arg writes where to store the number of write() calls.
+ * @arg bytes where to store the number of bytes.
+ *
+ * @return void
+ */
+void byteTxStats(unsigned int * writes, unsigned int * bytes)
+{
+  *writes = txWrites;
+  *bytes = txBytes;
+}
+
 /**
  * byteTx()
  * 
- * Transmits a byte to the iRobot over the serial interface.
+ * Transmits a byte to the iRobot over the serial interface, after
+ * anything already queued.
  *
  * @arg value the 8-bit value to be transmitted.
  * 
@@ -79,16 +269,24 @@ int closePort()
  */
 void byteTx(char value)
 {
-	char* buffer;
-	buffer = &value;
-	write(fd, buffer, 1);
-    //usleep(50);
+  byteQueue(value);
+  byteFlush();
 }
 
 /**
  * byteRx()
  *
- * Reads a byte from the iRobot over the serial interface.
+ * Reads a reply from the iRobot over the serial interface.  The
+ * call returns as soon as all nbytes have arrived, or after
+ * RX_TIMEOUT_MS if they haven't.  A reply that is cut short leaves
+ * the rest of it in the serial buffer, where it would be mistaken
+ * for the start of the next reply, so on a timeout any pending input
+ * is discarded.
+ *
+ * byteRx() only reads; the query, if any, must already have been
+ * written with byteFlushNow().  The sensor stream's reader thread
+ * calls it while the main thread may be queueing a command, and the
+ * queue belongs to the main thread.
  *
  * @arg buffer a character pointer to the buffer which will
  *      store the received data.
@@ -96,25 +294,70 @@ void byteTx(char value)
  * @arg iter an int expressing the number of times to receive
  *      nbytes.
  *
- * @return void
+ * @return the number of bytes read, which is nbytes unless the reply
+ *         timed out or the read failed.
  */
-void byteRx(char* buffer, int nbytes, int iter)
+int byteRx(char* buffer, int nbytes, int iter)
 {
+  struct pollfd pfd;
+  struct timespec start, now;
+  int got = 0;
   int data = 0;
+  int waited = 0;
 
+  if(iter != 1)
+    {
+      printf("Error, can only read one byte.\n");
+      return 0;
+    }
 
-  if(iter == 1)
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  while(got < nbytes && waited < RX_TIMEOUT_MS)
     {
-      data = read(fd, buffer, nbytes);
-      usleep(10000);
-      return;
+      if(poll(&pfd, 1, RX_TIMEOUT_MS - waited) > 0)
+	{
+	  data = read(fd, buffer + got, nbytes - got);
+	  if(data <= 0) break;
+	  got += data;
+	}
+
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      waited = (now.tv_sec - start.tv_sec) * 1000
+	+ (now.tv_nsec - start.tv_nsec) / 1000000;
     }
-  else
+
+  if(got < nbytes)
     {
-      printf("Error, can only read one byte.\n");
+#ifdef DEBUG
+      printf("byteRx: got %d of %d bytes\n", got, nbytes);
+#endif
+      tcflush(fd, TCIFLUSH);
+    }
+
+  return got;
+}
+
+/**
+ * byteRxPending()
+ *
+ * Reports how many bytes from the iRobot are waiting to be read.
+ *
+ * @return the number of bytes in the serial input buffer, or -1 if
+ *         the port could not be asked.
+ */
+int byteRxPending()
+{
+  int pending = 0;
+
+  if(ioctl(fd, FIONREAD, &pending) < 0)
+    {
+      return -1;
     }
- 
-  return;
+
+  return pending;
 }
 
 /**
@@ -128,13 +371,14 @@ void byteRx(char* buffer, int nbytes, int iter)
 void initialize()
 {
   //Start the SCI
-  byteTx(CmdStart);
+  byteQueue(CmdStart);
   
   //Give user control and put in safe mode
 
   // Note: Using the CmdSafe command rather than 
   // the deprecated CmdControl command.
-  byteTx(CmdFull);
+  byteQueue(CmdFull);
+  byteFlush();
 
   sleep(1);
 }
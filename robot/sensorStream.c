@@ -0,0 +1,328 @@
+/**
+ * sensorStream.c
+ *
+ * The reader thread for the iRobot's sensor stream, and the latest
+ * sample it publishes.  See sensorStream.h.
+ */
+
+#include <pthread.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+
+#include "roomba/roomba.h"
+#include "sensorStream.h"
+
+// The latest sample.  seq is odd while the reader is writing it.
+typedef struct sampleTag {
+	unsigned int seq;
+	unsigned int frame;
+	struct timespec stamp;
+	char data[SP_G1_NUM_QUERIED];
+} sample;
+
+static sample latest;
+static streamStats stats;
+static unsigned int lastFrameRead = 0;
+
+static pthread_t reader;
+static volatile int running = 0;
+
+// Counts the frames published since the main loop last read it, so
+// that the loop can wait for one.
+static int efd = -1;
+
+
+/**
+ * frameIsValid
+ *
+ * Check that a frame has the right length, the packet IDs that were
+ * asked for in the right order, and a checksum that brings the sum
+ * of its bytes to 0.
+ *
+ * @param[in] f the SP_STREAM_FRAME_SIZE bytes of a frame, starting
+ * with the header.
+ *
+ * @returns 1 if the frame is good, 0 otherwise.
+ */
+static int frameIsValid(unsigned char * f)
+{
+	unsigned char sum = 0;
+	int i = 0;
+
+	if (f[0] != SP_STREAM_HEADER || f[1] != 2 * SP_G1_NUM_QUERIED) {
+		return 0;
+	}
+
+	if (f[2] != SP_BUMPS_WHEELDROPS) {
+		return 0;
+	}
+
+	for (i = 1; i < SP_G1_NUM_QUERIED; i++) {
+		if (f[2 + 2 * i] != SP_CLIFF_LEFT + i - 1) {
+			return 0;
+		}
+	}
+
+	for (i = 0; i < SP_STREAM_FRAME_SIZE; i++) {
+		sum += f[i];
+	}
+
+	return sum == 0;
+}
+
+
+/**
+ * publish
+ *
+ * Make a good frame the latest sample.  The sequence counter is made
+ * odd before the sample is written and even again after, so that a
+ * reader that overlaps the write knows to try again.
+ *
+ * @param[in] f the bytes of a frame that passed frameIsValid().
+ */
+static void publish(unsigned char * f)
+{
+	uint64_t one = 0;
+	int i = 0;
+
+	__sync_fetch_and_add(&latest.seq, 1);
+
+	latest.frame++;
+	stats.frames++;
+	clock_gettime(CLOCK_MONOTONIC, &latest.stamp);
+	for (i = 0; i < SP_G1_NUM_QUERIED; i++) {
+		latest.data[i] = f[3 + 2 * i];
+	}
+
+	__sync_fetch_and_add(&latest.seq, 1);
+
+	one = 1;
+	write(efd, &one, sizeof(one));
+}
+
+
+/**
+ * streamReader
+ *
+ * The reader thread.  Fill a frame's worth of bytes from the serial
+ * port and publish it if it is good.  If it isn't, drop bytes up to
+ * the next header byte and fill again; a data byte can look like a
+ * header, so the frame is only trusted once its checksum agrees.
+ *
+ * @param[in] arg unused.
+ *
+ * @returns NULL when streamStop() is called.
+ */
+static void * streamReader(void * arg)
+{
+	unsigned char f[SP_STREAM_FRAME_SIZE];
+	int have = 0;
+	int skip = 0;
+
+	while (running) {
+		have += byteRx((char *)f + have, SP_STREAM_FRAME_SIZE - have, 1);
+		if (have < SP_STREAM_FRAME_SIZE) {
+			// The stream went quiet; byteRx() has thrown away
+			// whatever part of a frame was pending.
+			have = 0;
+			continue;
+		}
+
+		if (frameIsValid(f)) {
+			publish(f);
+			have = 0;
+
+			// If a whole frame is already waiting, this thread
+			// is falling behind the iRobot.
+			if (byteRxPending() >= SP_STREAM_FRAME_SIZE) {
+				stats.overruns++;
+			}
+			continue;
+		}
+
+		if (f[0] == SP_STREAM_HEADER) {
+			stats.badFrames++;
+		}
+
+		for (skip = 1; skip < SP_STREAM_FRAME_SIZE; skip++) {
+			if (f[skip] == SP_STREAM_HEADER) break;
+		}
+		stats.resyncBytes += skip;
+		have = SP_STREAM_FRAME_SIZE - skip;
+		memmove(f, f + skip, have);
+	}
+
+	return NULL;
+}
+
+
+/**
+ * streamStart
+ *
+ * Ask the iRobot to start streaming the group 1 sensors and start
+ * the thread that reads them.  The port must already be open.
+ *
+ * @returns STREAM_SUCCESS, or STREAM_THREAD_FAILURE if the reader
+ * thread or its eventfd could not be created.
+ */
+int streamStart()
+{
+	memset(&latest, 0, sizeof(latest));
+	memset(&stats, 0, sizeof(stats));
+	lastFrameRead = 0;
+
+	if ((efd = eventfd(0, EFD_NONBLOCK)) == -1) {
+		return STREAM_THREAD_FAILURE;
+	}
+
+	streamSensorData();
+
+	running = 1;
+	if (pthread_create(&reader, NULL, streamReader, NULL) != 0) {
+		running = 0;
+		PAUSE_STREAM_MACRO;
+		return STREAM_THREAD_FAILURE;
+	}
+
+	return STREAM_SUCCESS;
+}
+
+
+/**
+ * streamStop
+ *
+ * Stop the reader thread, then ask the iRobot to stop streaming so
+ * that the serial port can be used for queries again.
+ */
+void streamStop()
+{
+	if (!running) return;
+
+	running = 0;
+	pthread_join(reader, NULL);
+	PAUSE_STREAM_MACRO;
+
+	close(efd);
+	efd = -1;
+}
+
+
+/**
+ * streamFd
+ *
+ * An eventfd that becomes readable when a frame is published.  Read
+ * it, with streamAck(), before waiting on it again.
+ *
+ * @returns the eventfd, or -1 if the stream isn't started.
+ */
+int streamFd()
+{
+	return efd;
+}
+
+
+/**
+ * streamAck
+ *
+ * Empty the eventfd returned by streamFd().
+ *
+ * @returns how many frames were published since the last call.
+ */
+int streamAck()
+{
+	uint64_t count = 0;
+
+	if (read(efd, &count, sizeof(count)) != sizeof(count)) {
+		return 0;
+	}
+
+	return (int)count;
+}
+
+
+/**
+ * streamLatest
+ *
+ * Copy out the latest sample, laid out as by
+ * receiveGroupOneSensorData(): x[0] holds the bumps and wheel drops
+ * and x[2] to x[6] the cliff and virtual wall sensors.  x[1] is left
+ * alone.
+ *
+ * @param[out] x the sensor buffer to fill.
+ * @param[out] frame the number of the frame copied, counting from
+ * 1, so the caller can tell a new sample from one it has seen.  May
+ * be NULL.
+ * @param[out] ageMs how long ago the frame arrived.  May be NULL.
+ *
+ * @returns STREAM_SUCCESS, or STREAM_NO_SAMPLE if no frame has
+ * arrived yet, in which case x is untouched.
+ */
+int streamLatest(char * x, unsigned int * frame, int * ageMs)
+{
+	sample s;
+	struct timespec now;
+	unsigned int seq = 0;
+	int age = 0;
+	int i = 0;
+
+	do {
+		seq = __sync_fetch_and_add(&latest.seq, 0);
+		if (seq & 1) continue;
+		s = latest;
+		__sync_synchronize();
+	} while (seq & 1 || seq != latest.seq);
+
+	if (s.frame == 0) {
+		return STREAM_NO_SAMPLE;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	age = (now.tv_sec - s.stamp.tv_sec) * 1000
+		+ (now.tv_nsec - s.stamp.tv_nsec) / 1000000;
+
+	stats.reads++;
+	if (age > STREAM_STALE_MS) stats.staleReads++;
+	if (age > stats.maxAgeMs) stats.maxAgeMs = age;
+	if (s.frame > lastFrameRead + 1) {
+		stats.skipped += s.frame - lastFrameRead - 1;
+	}
+	if (s.frame > lastFrameRead) lastFrameRead = s.frame;
+
+	x[SP_G1_BUMPS_WHEELDROPS] = s.data[0];
+	for (i = 1; i < SP_G1_NUM_QUERIED; i++) {
+		x[SP_G1_CLIFF_LEFT + i - 1] = s.data[i];
+	}
+
+	if (frame != NULL) *frame = s.frame;
+	if (ageMs != NULL) *ageMs = age;
+
+	return STREAM_SUCCESS;
+}
+
+
+/**
+ * streamGetStats
+ *
+ * Copy the counts kept since streamStart().
+ *
+ * @param[out] out where to copy them.
+ */
+void streamGetStats(streamStats * out)
+{
+	*out = stats;
+}
+
+
+/**
+ * streamPrintStats
+ *
+ * Print the counts kept since streamStart().
+ */
+void streamPrintStats()
+{
+	printf("Sensor stream: %u frames, %u bad, %u bytes resynced, %u overruns\n",
+	       stats.frames, stats.badFrames, stats.resyncBytes, stats.overruns);
+	printf("               %u reads, %u stale, %u frames skipped, oldest %d ms\n",
+	       stats.reads, stats.staleReads, stats.skipped, stats.maxAgeMs);
+}
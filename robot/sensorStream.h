@@ -0,0 +1,62 @@
+/**
+ * sensorStream.h
+ *
+ * A reader thread that consumes the iRobot's sensor stream, so that
+ * the event:responder loop never has to wait on the serial port.
+ * The thread checks each frame's checksum and publishes it, with the
+ * time it arrived, as the latest sample.  The loop copies out the
+ * latest sample whenever it likes, and can wait on streamFd() to
+ * hear of a new one.
+ *
+ * The latest sample is guarded by a sequence counter rather than a
+ * lock: the reader never waits on the loop, and the loop simply
+ * copies again if the reader was part way through a write.
+ */
+
+#include <time.h>
+
+#ifndef _SENSOR_STREAM_H_
+#define _SENSOR_STREAM_H_
+
+/**
+ *  CONSTANT DEFINITIONS.  All constants in this file should begin
+ *  with 'STREAM' to indicate their membership in sensorStream.h
+ */
+#define STREAM_SUCCESS (0)
+#define STREAM_NO_SAMPLE (-1)
+#define STREAM_THREAD_FAILURE (-2)
+
+// The iRobot sends a frame every 15 ms.  A sample older than
+// STREAM_STALE_MS, three missed frames, is counted as stale.
+#define STREAM_PERIOD_MS 15
+#define STREAM_STALE_MS (3 * STREAM_PERIOD_MS)
+
+/**
+ * A count of what the reader thread and the loop have seen since
+ * streamStart().  The reader's counts are only written by the reader
+ * thread; the loop's are only written by streamLatest().
+ */
+typedef struct streamStatsTag {
+	unsigned int frames;       /**< Good frames published */
+	unsigned int badFrames;    /**< Frames with a bad checksum or IDs */
+	unsigned int resyncBytes;  /**< Bytes skipped looking for a header */
+	unsigned int overruns;     /**< Frames found already queued behind another */
+	unsigned int reads;        /**< Times the loop asked for the sample */
+	unsigned int staleReads;   /**< ...that were older than STREAM_STALE_MS */
+	unsigned int skipped;      /**< Frames the loop never saw */
+	int maxAgeMs;              /**< Oldest sample the loop was given */
+} streamStats;
+
+/**
+ * Function prototypes.  See sensorStream.c for details on
+ * this/these functions.
+ */
+int streamStart();
+void streamStop();
+int streamFd();
+int streamAck();
+int streamLatest(char * x, unsigned int * frame, int * ageMs);
+void streamGetStats(streamStats * stats);
+void streamPrintStats();
+
+#endif
@@ -0,0 +1,209 @@
+/**
+ * telemetry.c
+ *
+ * The queue of data packages waiting to go to the data service, and
+ * the thread that sends them.  See telemetry.h.
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+#include "telemetry.h"
+
+// The queue is a ring of capacity packages; the oldest is at head.
+static char queue[TELEM_MAX_CAPACITY][DATA_PACKAGE_SIZE];
+static int capacity = 0;
+static int head = 0;
+static int count = 0;
+static telemPolicy policy = TELEM_DROP_OLDEST;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queued = PTHREAD_COND_INITIALIZER;
+static pthread_t sender;
+static int running = 0;
+
+static serviceHandler * dsh = NULL;
+
+// Counts since telemStart(), protected by lock.
+static unsigned int numQueued = 0;
+static unsigned int numSent = 0;
+static unsigned int numDropped = 0;
+static unsigned int numFailed = 0;
+static unsigned int numBatches = 0;
+static int largestBatch = 0;
+
+
+/**
+ * telemSender
+ *
+ * The sender thread.  Wait for packages, take every one that is
+ * queued, and write them to the data service together.  The lock is
+ * not held while writing, so telemSend() never waits on the link.
+ *
+ * @param[in] arg unused.
+ *
+ * @returns NULL once telemStop() is called and the queue is empty.
+ */
+static void * telemSender(void * arg)
+{
+	static char batch[TELEM_MAX_CAPACITY][DATA_PACKAGE_SIZE];
+	int n = 0;
+	int i = 0;
+
+	pthread_mutex_lock(&lock);
+
+	while (running || count > 0) {
+		if (count == 0) {
+			pthread_cond_wait(&queued, &lock);
+			continue;
+		}
+
+		for (n = 0; count > 0; n++) {
+			memcpy(batch[n], queue[head], DATA_PACKAGE_SIZE);
+			head = (head + 1) % capacity;
+			count--;
+		}
+
+		pthread_mutex_unlock(&lock);
+
+		i = dsWriteMany(dsh, (char *)batch, n);
+
+		pthread_mutex_lock(&lock);
+
+		numBatches++;
+		if (n > largestBatch) largestBatch = n;
+		if (i == SERV_SUCCESS) {
+			numSent += n;
+		}
+		else {
+			numFailed += n;
+		}
+
+		// Printing can be slow on the serial console, so it is
+		// done here rather than in the main loop.
+		pthread_mutex_unlock(&lock);
+		for (i = 0; i < n; i++) {
+			printPackage(batch[i]);
+		}
+		pthread_mutex_lock(&lock);
+	}
+
+	pthread_mutex_unlock(&lock);
+
+	return NULL;
+}
+
+
+/**
+ * telemStart
+ *
+ * Start the sender thread for a data service collector.
+ *
+ * @param[in] sh the serviceHandler of the collector.
+ * @param[in] cap how many packages may wait to be sent, at most
+ * TELEM_MAX_CAPACITY.
+ * @param[in] p which package to drop when that many are waiting.
+ *
+ * @returns TELEM_SUCCESS, TELEM_BAD_CAPACITY or
+ * TELEM_CANNOT_CREATE_THREAD.
+ */
+int telemStart(serviceHandler * sh, int cap, telemPolicy p)
+{
+	if (cap < 1 || cap > TELEM_MAX_CAPACITY) return TELEM_BAD_CAPACITY;
+
+	dsh = sh;
+	capacity = cap;
+	policy = p;
+	head = 0;
+	count = 0;
+	numQueued = numSent = numDropped = numFailed = numBatches = 0;
+	largestBatch = 0;
+
+	running = 1;
+	if (pthread_create(&sender, NULL, telemSender, NULL) != 0) {
+		running = 0;
+		return TELEM_CANNOT_CREATE_THREAD;
+	}
+
+	return TELEM_SUCCESS;
+}
+
+
+/**
+ * telemSend
+ *
+ * Queue a data package to be sent.  Never waits for the link.
+ *
+ * @param[in] package a package made by packageData().
+ *
+ * @returns TELEM_SUCCESS, or TELEM_NOT_STARTED if there is no sender
+ * thread, in which case the package is counted as dropped.
+ */
+int telemSend(char * package)
+{
+	int tail = 0;
+
+	pthread_mutex_lock(&lock);
+
+	if (!running) {
+		numDropped++;
+		pthread_mutex_unlock(&lock);
+		return TELEM_NOT_STARTED;
+	}
+
+	numQueued++;
+
+	if (count == capacity) {
+		numDropped++;
+		if (policy == TELEM_DROP_NEWEST) {
+			pthread_mutex_unlock(&lock);
+			return TELEM_SUCCESS;
+		}
+		head = (head + 1) % capacity;
+		count--;
+	}
+
+	tail = (head + count) % capacity;
+	memcpy(queue[tail], package, DATA_PACKAGE_SIZE);
+	count++;
+
+	pthread_cond_signal(&queued);
+	pthread_mutex_unlock(&lock);
+
+	return TELEM_SUCCESS;
+}
+
+
+/**
+ * telemStop
+ *
+ * Stop the sender thread once it has tried to send what is queued.
+ * Packages queued after this are dropped.
+ */
+void telemStop()
+{
+	pthread_mutex_lock(&lock);
+	if (!running) {
+		pthread_mutex_unlock(&lock);
+		return;
+	}
+	running = 0;
+	pthread_cond_signal(&queued);
+	pthread_mutex_unlock(&lock);
+
+	pthread_join(sender, NULL);
+}
+
+
+/**
+ * telemPrintStats
+ *
+ * Print the counts kept since telemStart().
+ */
+void telemPrintStats()
+{
+	pthread_mutex_lock(&lock);
+	printf("Telemetry: %u queued, %u sent in %u writes (at most %d at once), %u dropped, %u failed\n",
+	       numQueued, numSent, numBatches, largestBatch, numDropped, numFailed);
+	pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,50 @@
+/**
+ * telemetry.h
+ *
+ * Sends the data packages describing each transition to the data
+ * service from a thread of its own, so that a slow or stalled link
+ * to the aggregator never holds up a responder.
+ *
+ * The main loop queues a package with telemSend(), which never
+ * blocks.  The sender thread takes everything queued and writes it
+ * in one go.  If the queue is full because the link is congested,
+ * a package is dropped: by default the oldest one, as the newest
+ * describes what the robot is doing now.
+ */
+
+#include "../communication/services.h"
+#include "netDataProtocol.h"
+
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+/**
+ *  CONSTANT DEFINITIONS.  All constants in this file should begin
+ *  with 'TELEM' to indicate their membership in telemetry.h
+ */
+#define TELEM_SUCCESS (0)
+#define TELEM_BAD_CAPACITY (-1)
+#define TELEM_CANNOT_CREATE_THREAD (-2)
+#define TELEM_NOT_STARTED (-3)
+
+// How many packages may wait to be sent.
+#define TELEM_DEFAULT_CAPACITY 32
+#define TELEM_MAX_CAPACITY 256
+
+// Which package to drop when the queue is full.
+typedef enum telemPolicyTag telemPolicy;
+enum telemPolicyTag {
+	TELEM_DROP_OLDEST,
+	TELEM_DROP_NEWEST,
+};
+
+/**
+ * Function prototypes.  See telemetry.c for details on
+ * this/these functions.
+ */
+int telemStart(serviceHandler * sh, int capacity, telemPolicy policy);
+int telemSend(char * package);
+void telemStop();
+void telemPrintStats();
+
+#endif
@@ -1,4 +1,5 @@
 #include "soar.h"
+#include "../communication/trace.h"
 
 /*
  * soar.c
@@ -45,10 +46,51 @@ int g_CMD_COUNT = 0;
  * @return int a command for the Roomba (negative is error)
  */
 int tickWME(char* wmeString)
+{
+    return tickSensing(wmeString, 0);
+}//tickWME
+
+/**
+ * tickRaw
+ *
+ * A tickWME() for Roomba sensings that arrive already packed (see
+ * SENSOR_BIT) so that there is no string to parse.
+ *
+ * @param sensorBits the sensors, one bit each
+ * @param now        the time stamp of the sensing (unused, as it is
+ *                   with the string)
+ * @return int a command for the Roomba (negative is error)
+ */
+int tickRaw(int sensorBits, int now)
+{
+    return tickSensing(NULL, sensorBits);
+}//tickRaw
+
+/**
+ * tickSensing
+ *
+ * The body of tickWME() and tickRaw().  The state is taken from
+ * wmeString unless it is NULL, in which case it is taken from
+ * sensorBits.
+ *
+ * @param wmeString  A char array that defines an agent's state, or NULL
+ * @param sensorBits the Roomba's sensors, one bit each, if wmeString
+ *                   is NULL
+ * @return int a command for the Roomba (negative is error)
+ */
+int tickSensing(char* wmeString, int sensorBits)
 {
     EpisodeWME* ep;
     int found;
-    if (wmeString[0] == ':')
+
+    trRecord(TR_TICK, 0, g_epMem->size, 0, 0);
+    trBegin(TR_PH_TICK);
+
+    if (wmeString == NULL)
+    {
+        ep = createEpisodeWME(roombaBitsToWME(sensorBits));
+    }
+    else if (wmeString[0] == ':')
     {
         ep = createEpisodeWME(stringToWMES(wmeString));
     }
@@ -60,6 +102,7 @@ int tickWME(char* wmeString)
     if(getINTValWME(ep, "reward", &found) != 0)
     {
         g_goalCount++;
+        trRecord(TR_GOAL, 0, g_goalCount, 0, 0);
     }
     
     addEpisodeWME(ep);
@@ -67,16 +110,20 @@ int tickWME(char* wmeString)
 	if(!g_statsMode) printf("Number of goals found: %i\n", g_goalCount);
 	if(!g_statsMode) printf("Current Score: %i\n", getINTValWME(ep, "score", &found));
     if(!g_statsMode) printf("++++++++++++++++++++++++++++++++++++++++++\n");
-    fflush(stdout);
+    if(!g_statsMode) fflush(stdout);
     
     // Select the next command to be sent to the roomba
     if(!g_statsMode) printf("Choosing next command\n");
+    trBegin(TR_PH_CHOOSE);
     chooseCommand(ep);
+    trEnd(TR_PH_CHOOSE);
     if(!g_statsMode) printf("Command selected\n");
     if(!g_statsMode) fflush(stdout);
+
+    trEnd(TR_PH_TICK);
     
     return ep->cmd;
-}//tickWME
+}//tickSensing
 
 /**
  * addEpisodeWME
@@ -113,28 +160,34 @@ int chooseCommand(EpisodeWME* ep)
     if(needSeed == TRUE)
     {
         needSeed = FALSE;
-        srand(time(NULL));
+        srand(g_randSeed != 0 ? g_randSeed : time(NULL));
     }//if
 
     // Determine the next command, possibility of random command
     if(g_epMem->size < 10 || g_goalCount < 1)
     {
         if(!g_statsMode) printf(" selecting random command \n");
-        fflush(stdout);
+        if(!g_statsMode) fflush(stdout);
         ep->cmd = ((rand() % g_CMD_COUNT) + CMD_NO_OP);
+        trRecord(TR_COMMAND, TR_BY_RANDOM, ep->cmd, 0, 0);
     }//if
     else
     {
         // loop on setCommand until a route is chosen 
         // that will lead to a successful action
         if(!g_statsMode) printf(" selecting command from Nux Soar \n");
-        fflush(stdout);
+        if(!g_statsMode) fflush(stdout);
         if(setCommand(ep) < 0)
         {
             if(!g_statsMode) printf("Failed to set a command, choosing random\n");
             ep->cmd = ((rand() % g_CMD_COUNT) + CMD_NO_OP);
+            trRecord(TR_COMMAND, TR_BY_RANDOM, ep->cmd, 0, 0);
         }//if
-        fflush(stdout);
+        else
+        {
+            trRecord(TR_COMMAND, TR_BY_VALUE, ep->cmd, 0, 0);
+        }//else
+        if(!g_statsMode) fflush(stdout);
     }//else
 
     return ep->cmd;
@@ -276,6 +329,7 @@ double findDiscountedCommandScore(int command)
 
     if(holder < 0) return -1.0;
 
+    trRecord(TR_MATCH, 0, topMatch, holder, 0);
     if(!g_statsMode) printf("\tState best matched at index: %d\n", holder);
 #if LOOK_AHEAD_N
     for(i = 1; i <= LOOK_AHEAD_N && i + holder <= lastRewardIdx; i++)
@@ -351,6 +405,83 @@ void endSoar()
     freeVector(g_epMem);
 }//endSoar
 
+/**
+ * countMemory
+ *
+ * Count the allocations and bytes held by episodic memory: the vector, and
+ * for each episode its struct, its vector of WMEs and each WME with its
+ * attribute name (and string value, if any).
+ *
+ * @param allocs set to the number of blocks allocated
+ * @param wmes set to the number of WMEs
+ * @return long the number of bytes in those blocks
+ */
+long countMemory(long* allocs, long* wmes)
+{
+    long bytes = sizeof(Vector) + g_epMem->capacity * sizeof(void*);
+    int i, j;
+
+    *allocs = 2;
+    *wmes = 0;
+    for(i = 0; i < g_epMem->size; i++)
+    {
+        EpisodeWME* ep = (EpisodeWME*)getEntry(g_epMem, i);
+        *allocs += 3;
+        bytes += sizeof(EpisodeWME) + sizeof(Vector)
+                 + ep->sensors->capacity * sizeof(void*);
+
+        for(j = 0; j < ep->sensors->size; j++)
+        {
+            WME* wme = (WME*)getEntry(ep->sensors, j);
+            *allocs += 2;
+            bytes += sizeof(WME) + strlen(wme->attr) + 1;
+            if(wme->type == WME_STRING)
+            {
+                (*allocs)++;
+                bytes += strlen(wme->value.sVal) + 1;
+            }
+        }//for
+        *wmes += ep->sensors->size;
+    }//for
+
+    return bytes;
+}//countMemory
+
+/**
+ * displayMemoryStats
+ *
+ * Print the entries, allocations and bytes held by episodic memory.
+ *
+ * @param out where to print it (e.g., stdout or a log file)
+ */
+void displayMemoryStats(FILE* out)
+{
+    long allocs, wmes;
+    long bytes = countMemory(&allocs, &wmes);
+
+    fprintf(out, "%-13s %10s %10s %10s %12s\n", "structure", "entries",
+            "WMEs", "allocs", "bytes");
+    fprintf(out, "%-13s %10ld %10ld %10ld %12ld\n", "epMem",
+            (long)g_epMem->size, wmes, allocs, bytes);
+    fflush(out);
+}//displayMemoryStats
+
+/**
+ * displayMemoryStatsShort
+ *
+ * Print the number of episodes and the kilobytes they hold on one line,
+ * with no newline.
+ *
+ * @param out where to print it (e.g., stdout or a log file)
+ */
+void displayMemoryStatsShort(FILE* out)
+{
+    long allocs, wmes;
+    long bytes = countMemory(&allocs, &wmes);
+
+    fprintf(out, "epMem %ld %ldKB", (long)g_epMem->size, bytes / 1024);
+}//displayMemoryStatsShort
+
 /**
  * interpretCommand
  *
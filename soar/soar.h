@@ -17,7 +17,7 @@
 #include <string.h>
 #include <math.h>
 
-#include "vector.h"
+#include "../vector/vector.h"
 #include "../communication/communication.h"
 #include "../wme/wme.h"
 
@@ -32,7 +32,11 @@
 #define MAX_STEPS           1000
 #define NUM_GOALS_TO_FIND   50
 
+// May be given with -D instead, e.g. by a parameter sweep (see
+// communication/sweep.c).
+#ifndef DISCOUNT
 #define DISCOUNT            (0.75)
+#endif
 
 #define LOOK_AHEAD_N        0
 
@@ -42,9 +46,12 @@ Vector* g_epMem;
 // Global variables for monitoring and connecting
 int g_connectToRoomba;
 int g_statsMode;
+unsigned int g_randSeed;	// Seed for rand(), or 0 to seed it from the clock
 
 // Tick and extra WME functions
 extern int   tickWME(char* wmeString); // DUPL
+extern int   tickRaw(int sensorBits, int now);
+int          tickSensing(char* wmeString, int sensorBits);
 int          addEpisodeWME(EpisodeWME* item); // DUPL
 
 // Function for determining next command
@@ -55,6 +62,9 @@ double       findDiscountedCommandScore(int command);
 int          findLastReward();
 void         initSoar(int numCommands);
 void         endSoar();
+long         countMemory(long* allocs, long* wmes);
+void         displayMemoryStats(FILE* out);
+void         displayMemoryStatsShort(FILE* out);
 char*        interpretCommand(int cmd);
 char*        interpretCommandShort(int cmd);
 
@@ -1,6 +1,6 @@
 #include <string.h>
 #include "eaters.h"
-#include "vector.h"
+#include "../vector/vector.h"
 #include "supervisor.h"
 
 int main()
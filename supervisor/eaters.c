@@ -51,7 +51,7 @@ void initWorld(int firstInit)
 #if DEBUGGING
         printf("Allocating memory1\n");
 #endif
-        srand(time(NULL)); 	
+        srand(g_randSeed != 0 ? g_randSeed : time(NULL));
 #if DEBUGGING
         printf("Allocating memory2\n");
 #endif
@@ -26,6 +26,8 @@
 #define FALSE		0
 
 int g_statsMode;
+unsigned int g_randSeed;	// Seed for rand(), or 0 to seed it from the clock
+extern int g_wallsConfig;	// The kind of interior walls (WALLTYPE_*)
 
 // Functions headers
 void initWorld(int firstInit);
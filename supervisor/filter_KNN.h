@@ -9,7 +9,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include "vector.h"
+#include "../vector/vector.h"
 
 //defines
 #define NUM_SENSES 10           // number of binary senses that the agent has
@@ -106,3 +106,25 @@ void insertConfusion(char * inputSense)
     }
 }
 
+/**
+ *insertConfusionBits does what insertConfusion does to a sense that has been packed one bit per
+ * sense, the first sense in the most significant bit (see SENSOR_BIT in communication.h).
+ */
+void insertConfusionBits(int * sensorBits)
+{
+    char senses[NUM_SENSES + 1];
+    int i=0;
+    for (i=0; i<NUM_SENSES; i++)
+    {
+        senses[i] = '0' + ((*sensorBits >> (NUM_SENSES - 1 - i)) & 1);
+    }
+    senses[NUM_SENSES] = '\0';
+
+    insertConfusion(senses);
+
+    *sensorBits = 0;
+    for (i=0; i<NUM_SENSES; i++)
+    {
+        *sensorBits = (*sensorBits << 1) | (senses[i] - '0');
+    }
+}
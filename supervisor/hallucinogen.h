@@ -8,5 +8,6 @@
 
 //prototypes
 extern void insertConfusion(char * inputSenes);   //main function to do all replacements
+extern void insertConfusionBits(int * sensorBits); //the same for a packed sense
 
 
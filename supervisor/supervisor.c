@@ -1,7 +1,10 @@
 //if we want to use the saccades filter, turn this on
 #define SACC_FILTER 0
 
+#include <pthread.h>
+#include <sys/time.h>
 #include "supervisor.h"
+#include "../communication/trace.h"
 
 /*
  * This file contains the code for the Supervisor. All the functions
@@ -124,6 +127,27 @@ int g_goalIdx[NUM_GOALS_TO_FIND];
 
 int g_CMD_COUNT = 0;
 
+// State for the pipelined tick (see tickPipelined())
+pthread_t g_workerThread;         // learns and plans while the robot moves
+int g_workerRunning = FALSE;      // TRUE between launch and join of the worker
+int g_pipeFastTicks = 0;          // ticks answered with just a plan lookup
+int g_pipeNoPlan    = 0;          // ticks answered with no plan available
+int g_pipeStalls    = 0;          // ticks that fell back to a synchronous tick
+double g_pipeWaitSecs = 0.0;      // total time spent waiting on the worker
+
+// The completed sequences at each level, one of each (see internSequence())
+SeqTable g_seqTables[MAX_LEVEL_DEPTH];
+
+// Plans made by initPlan() (see lookupPlan())
+PlanCacheEntry g_planCache[PLAN_CACHE_SIZE];
+int g_planCacheHits   = 0;        // plans handed out again by lookupPlan()
+int g_planCacheMisses = 0;        // plans lookupPlan() didn't have
+
+// Names of the kinds of structure counted by countMemory()
+char* g_memKindNames[MEM_NUM_KINDS] = { "epMem", "actions", "sequences",
+                                        "replacements", "seqTables",
+                                        "planCache" };
+
 
 /**
  * memTest
@@ -538,14 +562,51 @@ void replanTest()
  */
 int tick(char* sensorInput)
 {
-    int i;
+    return tickSensing(sensorInput, 0, 0);
+}//tick
+
+/**
+ * tickRaw
+ *
+ * A tick() for sensings that arrive already packed (see SENSOR_BIT) so
+ * that there is no string to parse.
+ *
+ * @param sensorBits the sensors, one bit each
+ * @param now        the time stamp of the sensing
+ * @return int a command for the Roomba (negative is error)
+ */
+int tickRaw(int sensorBits, int now)
+{
+    return tickSensing(NULL, sensorBits, now);
+}//tickRaw
+
+/**
+ * tickSensing
+ *
+ * The body of tick() and tickRaw().  The sensing is taken from
+ * sensorInput unless it is NULL, in which case it is taken from
+ * sensorBits and now.
+ *
+ * @param sensorInput a char string wth sensor data or NULL
+ * @param sensorBits  the sensors, one bit each, if sensorInput is NULL
+ * @param now         the time stamp, if sensorInput is NULL
+ * @return int a command for the Roomba (negative is error)
+ */
+int tickSensing(char* sensorInput, int sensorBits, int now)
+{
+    trRecord(TR_TICK, 0, ((Vector *)g_epMem->array[0])->size, 0, 0);
+    trBegin(TR_PH_TICK);
+
     // Create new Episode
-    Episode* ep = createEpisode(sensorInput);
+    Episode* ep = (sensorInput != NULL ? createEpisode(sensorInput)
+                                       : createEpisodeRaw(sensorBits, now));
 
     // Add new episode to the history
     addEpisode(ep);
 
+    trBegin(TR_PH_UPDATE);
         updateAll(0);
+    trEnd(TR_PH_UPDATE);
 #if DEBUGGING_UPDATEALL
     printf("updateAll complete\n");
     fflush(stdout);
@@ -557,8 +618,10 @@ int tick(char* sensorInput)
     if(episodeContainsGoal(ep, FALSE))
     {
         printf("GOAL %d FOUND!\n", g_goalCount);
+        trRecord(TR_GOAL, 0, g_goalCount, 0, 0);
        
         ep->cmd = CMD_SONG;
+        trRecord(TR_COMMAND, TR_BY_GOAL, ep->cmd, 0, 0);
 
         //If a a plan is in place, reward the agent and any outstanding replacements
         if (g_plan != NULL)
@@ -577,7 +640,9 @@ int tick(char* sensorInput)
     }
     else
     {
+        trBegin(TR_PH_CHOOSE);
         ep->cmd = chooseCommand();
+        trEnd(TR_PH_CHOOSE);
     }
 
 #if DEBUGGING
@@ -589,8 +654,261 @@ int tick(char* sensorInput)
     fflush(stdout);
 #endif
 
+    trEnd(TR_PH_TICK);
+
     return ep->cmd;
-}//tick
+}//tickSensing
+
+/**
+ * pipelineWorker
+ *
+ * The slow half of a pipelined tick.  This runs in its own thread while the
+ * command chosen by tickPipelined() is being carried out by the robot.  It
+ * learns from the most recent episode, replans if the current plan needs it and
+ * then does the replacement bookkeeping that chooseCommand() would otherwise
+ * do at the start of the next tick.
+ *
+ * @arg arg  non-NULL if updateAll() still needs to be called for the most
+ *           recent episode
+ * @return void* always NULL
+ */
+void* pipelineWorker(void* arg)
+{
+    if (arg != NULL)
+    {
+        trBegin(TR_PH_UPDATE);
+        updateAll(0);
+        trEnd(TR_PH_UPDATE);
+#if DEBUGGING_UPDATEALL
+        printf("updateAll complete\n");
+        fflush(stdout);
+#endif
+    }
+
+    //Have a plan ready for the next tick if at all possible.  (Like
+    //chooseCommand(), this does not free a plan that needs recalc.  See To-Do
+    //item #4.)
+    if ( (g_plan == NULL)
+         || planNeedsRecalc(g_plan) )
+    {
+        g_plan = initPlan(FALSE);
+    }
+    else
+    {
+        reapplyReplacements();
+    }
+
+    //Apply any replacement the agent is confident in to the steps that have
+    //not been taken yet
+    if (g_plan != NULL)
+    {
+        trBegin(TR_PH_REPLACE);
+        considerReplacement();
+        trEnd(TR_PH_REPLACE);
+    }
+
+    return NULL;
+}//pipelineWorker
+
+/**
+ * finishPipelinedTick
+ *
+ * Wait for the worker launched by the last call to tickPipelined() (if any)
+ * to finish.  Nothing may read or modify episodic memory or the plan until
+ * this has been called.  It must also be called before endSupervisor().
+ */
+void finishPipelinedTick()
+{
+    struct timeval start, end;
+
+    if (! g_workerRunning) return;
+
+    gettimeofday(&start, NULL);
+    pthread_join(g_workerThread, NULL);
+    gettimeofday(&end, NULL);
+
+    g_workerRunning = FALSE;
+    g_pipeWaitSecs += (end.tv_sec - start.tv_sec)
+                      + (end.tv_usec - start.tv_usec) / 1000000.0;
+}//finishPipelinedTick
+
+/**
+ * tickPipelined
+ *
+ * A replacement for tick() that answers the robot as soon as the next command
+ * is known.  The command is normally just the next step of the plan that the
+ * previous tick's worker left behind.  Learning, replanning and replacement
+ * bookkeeping are handed to pipelineWorker() which runs while the robot
+ * carries out the command.
+ *
+ * Consistency rule: the worker owns the episodic memory and the plan from the
+ * moment it is launched until the next tick joins it.  The plan it leaves is
+ * only used if it does not need recalc and its next step matches the new
+ * sensing (nextStepIsValid()).  If it does not match then the plan is
+ * invalid; this tick stalls and falls back to an ordinary synchronous tick
+ * (penalize, updateAll, replan) before the command is sent.  If there is no
+ * plan at all a semi-random command is sent right away and the worker tries
+ * again to make one.
+ *
+ * The agent decides as tick() would: a goal is learned from (updateAll())
+ * before it is rewarded, and steps taken from the plan are subject to the
+ * same random exploration (timeForRandomStep()).  What differs is when the
+ * replacement bookkeeping and replanning are done, so a run with and without
+ * pipelining may still differ where a replacement is applied.
+ *
+ * @param sensorInput a char string wth sensor data
+ * @return int a command for the Roomba (negative is error)
+ */
+int tickPipelined(char* sensorInput)
+{
+    return tickPipelinedSensing(sensorInput, 0, 0);
+}//tickPipelined
+
+/**
+ * tickPipelinedRaw
+ *
+ * tickPipelined() for sensings that arrive already packed.  See tickRaw().
+ *
+ * @param sensorBits the sensors, one bit each
+ * @param now        the time stamp of the sensing
+ * @return int a command for the Roomba (negative is error)
+ */
+int tickPipelinedRaw(int sensorBits, int now)
+{
+    return tickPipelinedSensing(NULL, sensorBits, now);
+}//tickPipelinedRaw
+
+/**
+ * tickPipelinedSensing
+ *
+ * The body of tickPipelined() and tickPipelinedRaw().  The sensing is
+ * taken as in tickSensing().
+ *
+ * @param sensorInput a char string wth sensor data or NULL
+ * @param sensorBits  the sensors, one bit each, if sensorInput is NULL
+ * @param now         the time stamp, if sensorInput is NULL
+ * @return int a command for the Roomba (negative is error)
+ */
+int tickPipelinedSensing(char* sensorInput, int sensorBits, int now)
+{
+    int needsUpdate = TRUE;     // does the worker still have to call updateAll()?
+
+    //Commit the previous tick's learning before touching memory
+    finishPipelinedTick();
+
+    trRecord(TR_TICK, 0, ((Vector *)g_epMem->array[0])->size, 0, 0);
+    trBegin(TR_PH_TICK);
+
+    // Create new Episode
+    Episode* ep = (sensorInput != NULL ? createEpisode(sensorInput)
+                                       : createEpisodeRaw(sensorBits, now));
+
+    // Add new episode to the history
+    addEpisode(ep);
+
+    if(episodeContainsGoal(ep, FALSE))
+    {
+        //As in tickSensing(), learn from the goal before rewarding.  Goals
+        //are rare enough that the robot can wait for it.
+        trBegin(TR_PH_UPDATE);
+        updateAll(0);
+        trEnd(TR_PH_UPDATE);
+        needsUpdate = FALSE;
+
+        printf("GOAL %d FOUND!\n", g_goalCount);
+        trRecord(TR_GOAL, 0, g_goalCount, 0, 0);
+       
+        ep->cmd = CMD_SONG;
+        trRecord(TR_COMMAND, TR_BY_GOAL, ep->cmd, 0, 0);
+
+        //If a a plan is in place, reward the agent and any outstanding
+        //replacements.  The plan is no longer needed.
+        if (g_plan != NULL)
+        {
+            rewardReplacements();
+            rewardAgent();
+            freePlan(g_plan);
+            g_plan = NULL;
+        }
+        g_pipeFastTicks++;
+    }
+    else if ( (g_plan != NULL)
+              && (! planNeedsRecalc(g_plan))
+              && nextStepIsValid() )
+    {
+        //If a level 0 sequence has just completed then the agent's
+        //confidence is increased due to the partial success
+        Route *currRoute = (Route *)g_plan->array[0];
+        if ((currRoute->currSeqIndex > 0) && (currRoute->currActIndex == 1))
+        {
+            rewardAgent();
+        }
+
+        //Wander off the plan now and then, as chooseCommand() does
+        ep->cmd = (timeForRandomStep() ? chooseCommand_SemiRandom()
+                                       : nextPlanCommand());
+        g_pipeFastTicks++;
+    }
+    else if (g_plan == NULL)
+    {
+        //The worker could not find a plan either
+        ep->cmd = chooseCommand_SemiRandom();
+        g_pipeNoPlan++;
+    }
+    else
+    {
+        //The plan is invalid so the robot has to wait for a new one
+        trBegin(TR_PH_UPDATE);
+        updateAll(0);
+        trEnd(TR_PH_UPDATE);
+        needsUpdate = FALSE;
+        trBegin(TR_PH_CHOOSE);
+        ep->cmd = chooseCommand();
+        trEnd(TR_PH_CHOOSE);
+        g_pipeStalls++;
+    }
+
+    //Learn and plan while the robot moves
+    if (pthread_create(&g_workerThread, NULL, pipelineWorker,
+                       needsUpdate ? (void *)ep : NULL) == 0)
+    {
+        g_workerRunning = TRUE;
+    }
+    else
+    {
+        pipelineWorker(needsUpdate ? (void *)ep : NULL);
+    }
+
+#if DEBUGGING
+    // Print out the parsed episode if not in statsMode
+    if(g_statsMode == 0)
+    {
+        displayEpisode(ep);
+    }
+    fflush(stdout);
+#endif
+
+    trEnd(TR_PH_TICK);
+
+    return ep->cmd;
+}//tickPipelinedSensing
+
+/**
+ * displayPipelineStats
+ *
+ * Print a one line summary of how well tickPipelined() has been overlapping
+ * the agent's thinking with the robot's moving.
+ *
+ * @arg out  where to print it (e.g., stdout or a log file)
+ */
+void displayPipelineStats(FILE* out)
+{
+    int total = g_pipeFastTicks + g_pipeNoPlan + g_pipeStalls;
+
+    fprintf(out, "Pipeline: %d ticks, %d from plan lookup, %d with no plan, %d stalled, %g sec waiting on worker\n",
+            total, g_pipeFastTicks, g_pipeNoPlan, g_pipeStalls, g_pipeWaitSecs);
+    fflush(out);
+}//displayPipelineStats
 
 /**
  * createEpisode
@@ -619,6 +937,28 @@ Episode* createEpisode(char* sensorData)
     return ep;
 }//createEpisode
 
+/**
+ * createEpisodeRaw
+ *
+ * createEpisode() for a sensing that is already packed.
+ *
+ * @arg sensorBits the sensors, one bit each (see SENSOR_BIT)
+ * @arg now        the time stamp of the sensing
+ * @return Episode* a pointer to the new episode
+ */
+Episode* createEpisodeRaw(int sensorBits, int now)
+{
+    Episode* ep = (Episode*) malloc(sizeof(Episode));
+    int retVal;
+
+    if((retVal = parseEpisodeRaw(ep, sensorBits, now)) != 0)
+    {
+        fprintf(stderr, "Error in parsing: sensor bits 0x%x\n", sensorBits);
+        exit(retVal);
+    }
+    return ep;
+}//createEpisodeRaw
+
 /**
  * parseEpisode
  *
@@ -635,10 +975,6 @@ Episode* createEpisode(char* sensorData)
  */
 int parseEpisode(Episode * parsedData, char* dataArr)
 {
-    printf("dataArr=%s\n", dataArr);
-    
-    // temporary timestamp
-    static int timeStamp = 0;
     int i; // index
 
     if(dataArr == NULL)
@@ -662,14 +998,10 @@ int parseEpisode(Episode * parsedData, char* dataArr)
         parsedData->sensors[i] = bit;       //** what is this? ->
     }
 
-    if(g_connectToRoomba == 1)
-    {
-        // Pull out the timestamp
-        parsedData->now = timeStamp++;
-    }else
+    // Alg for determining timestamp from string of chars
+    int time = 0;
+    if(g_connectToRoomba == 0)
     {
-        // Alg for determining timestamp from string of chars
-        int time = 0;
         for(i = NUM_SENSORS; dataArr[i] != '\0'; i++)
         {
             if(dataArr[i] != ' ')
@@ -681,10 +1013,74 @@ int parseEpisode(Episode * parsedData, char* dataArr)
                 break;
             }
         }
+    }
+
+    stampEpisode(parsedData, time);
+
+    return 0;
+}//parseEpisode
+
+/**
+ * parseEpisodeRaw
+ *
+ * parseEpisode() for a sensing that is already packed, e.g. one that
+ * came from the brainstem in binary mode.  Nothing needs converting;
+ * each sensor is one bit of sensorBits (see SENSOR_BIT).
+ *
+ * @arg parsedData A pointer to an Episode to be populated
+ * @arg sensorBits the sensors, one bit each
+ * @arg now        the time stamp of the sensing
+ * @return int an error code
+ */
+int parseEpisodeRaw(Episode * parsedData, int sensorBits, int now)
+{
+    int i; // index
+
+    // Only the low NUM_SENSORS bits may be set
+    if((sensorBits & ~((1 << NUM_SENSORS) - 1)) != 0)
+    {
+        return -1;
+    }
+
+    for(i = 0; i < NUM_SENSORS; i++)
+    {
+        parsedData->sensors[i] = SENSOR_BIT(sensorBits, i);
+    }
+
+    stampEpisode(parsedData, now);
+
+    return 0;
+}//parseEpisodeRaw
+
+/**
+ * stampEpisode
+ *
+ * Finish a newly parsed episode: give it its time stamp, note whether
+ * it is a goal and give its command a default value.  Shared by
+ * parseEpisode() and parseEpisodeRaw().
+ *
+ * @arg parsedData the episode, whose sensors have been set
+ * @arg now        the time stamp that came with the sensing (ignored
+ *                 when connected to the Roomba)
+ */
+void stampEpisode(Episode * parsedData, int now)
+{
+    // temporary timestamp
+    static int timeStamp = 0;
+
+    if(g_connectToRoomba == 1)
+    {
+        // Pull out the timestamp
+        parsedData->now = timeStamp++;
+    }else
+    {
         // Store the time
-        parsedData->now = time;
+        parsedData->now = now;
     }
 
+    trRecord(TR_SENSING, 0, trBits(parsedData->sensors, NUM_SENSORS),
+             parsedData->now, 0);
+
     // Found a goal so decrease chance of random move
     if(parsedData->sensors[SNSR_IR] == 1)
     {
@@ -694,9 +1090,7 @@ int parseEpisode(Episode * parsedData, char* dataArr)
 
     // Command gets a default value for now
     parsedData->cmd = CMD_ILLEGAL;
-
-    return 0;
-}//parseEpisode
+}//stampEpisode
 
 /**
  * updateAll                    *RECURSIVE*
@@ -792,7 +1186,7 @@ int updateAll(int level)
         newAction->containsStart = TRUE;
     }
     //containsStart is TRUE if the previous action contained a goal
-    else if (((Action *)actionList->array[actionList->size - 1])->containsGoal)
+    else if (actionLast(actionList)->containsGoal)
     {
         episodeContainsGoal(episodeList->array[episodeList->size - 1], level);
         newAction->containsStart = TRUE;
@@ -983,6 +1377,7 @@ int updateAll(int level)
                                 curr->outcome               = newAction->outcome;
                                 curr->length                        = newAction->length;
                                 curr->freq                                  = 1;
+                                invalidateRouteFields();
 
                                 //done with update
                                 matchComplete = TRUE;
@@ -1050,7 +1445,7 @@ int updateAll(int level)
 
                                 // allocate cousins list and add both peer
                                 // indetermiante actions into same cousins list
-                                curr->cousins = newVector();
+                                curr->cousins = newSmallVector();
                                 addAction(curr->cousins, curr, TRUE);
                                 addAction(curr->cousins, newAction, TRUE);
                                 newAction->cousins = curr->cousins;
@@ -1161,6 +1556,12 @@ int updateAll(int level)
 #endif
         addAction(actionList, newAction, FALSE);
 
+        // the new action links two sequences in the level below
+        if (level > 0)
+        {
+            addRouteAction(newAction);
+        }
+
         // set this flag so that we recursively update the next level
         // with this action
         updateExistingAction = newAction;
@@ -1205,9 +1606,9 @@ int updateAll(int level)
                         // reset the vector's size to 0
                         // This will allow updateAll to reuse the same vector
                         // without needing to free memory
-            Vector* duplicate = containsSequence(sequenceList, currSequence, TRUE);
+            Vector* duplicate = internSequence(currSequence);
             Vector *parentEpList = g_epMem->array[level + 1];
-                        if(duplicate != NULL)
+                        if(duplicate != currSequence)
                         {
                                 currSequence->size = 0;
                 // this duplicate sequence becomes the next episode in the
@@ -1240,8 +1641,9 @@ int updateAll(int level)
 #endif
                     addEntry(parentEpList, currSequence);
                 }
-                // create an vector to hold the next sequence
-                currSequence = newVector();
+                // create an vector to hold the next sequence (most are
+                // only a few actions long)
+                currSequence = newSmallVector();
                 addEntry(sequenceList, currSequence);
 
                         }//else
@@ -1708,7 +2110,7 @@ int chooseCommand_SemiRandom()
     //Find all the level 0 episodes whose sensor values match the most recent
     //sensing.  Mark the commands associated with those episodes as invalid
     Vector *epList = g_epMem->array[0];
-    Episode *lastEpisode = (Episode*)epList->array[epList->size - 1];
+    Episode *lastEpisode = episodeLast(epList);
     if (epList->size >= 2)
     {
         for(i = 0; i < (epList->size - 2); i++) // iterate over all but most recent
@@ -1740,6 +2142,7 @@ int chooseCommand_SemiRandom()
             printf("%d\n", index + CMD_NO_OP);
             fflush(stdout);
 #endif
+            trRecord(TR_COMMAND, TR_BY_RANDOM, index + CMD_NO_OP, 0, 0);
             return index + CMD_NO_OP;
         }
     }
@@ -1749,6 +2152,7 @@ int chooseCommand_SemiRandom()
     printf("%d\n", start + CMD_NO_OP);
     fflush(stdout);
 #endif
+    trRecord(TR_COMMAND, TR_BY_RANDOM, start + CMD_NO_OP, 0, 0);
     return start + CMD_NO_OP;
 
 }//chooseCommand_SemiRandom
@@ -2224,6 +2628,8 @@ Replacement *makeNewReplacement()
     //This will eventually be our return value
     Replacement *result = malloc(sizeof(Replacement));
     result->confidence  = INIT_REPL_CONFIDENCE;
+    result->applied     = NULL;
+    result->results     = NULL;
 
     //Search all levels starting at the bottom
     for(i = 0; i < MAX_LEVEL_DEPTH; i++)
@@ -2258,7 +2664,7 @@ Replacement *makeNewReplacement()
        
         //Preinit the return value
         result->level = i;
-        result->original    = newVector();
+        result->original    = newSmallVector();
         addEntry(result->original, act1);
         addEntry(result->original, act2);
 
@@ -2335,8 +2741,8 @@ Replacement *makeNewReplacement()
                 //the last action of the RHS subsequence must match
                 Vector *candRHS = (Vector *)candAct->epmem->array[candAct->outcome];
                 Vector *act2RHS = (Vector *)act2->epmem->array[act2->outcome];
-                Action *candRHSSubAct = (Action *)candRHS->array[candRHS->size - 1];
-                Action *act2RHSSubAct = (Action *)act2RHS->array[act2RHS->size - 1];
+                Action *candRHSSubAct = actionLast(candRHS);
+                Action *act2RHSSubAct = actionLast(act2RHS);
                 if (candRHSSubAct != act2RHSSubAct)
                 {
 #if DEBUGGING_FIND_REPL
@@ -2515,8 +2921,27 @@ int chooseCommand_WithPlan()
     //Before executing the next command in the plan, see if there is a
     //replacement rule that the agent is confident enough to apply to the
     //current plan and apply it.
+    trBegin(TR_PH_REPLACE);
     considerReplacement();
+    trEnd(TR_PH_REPLACE);
+
+    return nextPlanCommand();
 
+}//chooseCommand_WithPlan
+
+/**
+ * nextPlanCommand
+ *
+ * Extracts the cmd of the current action in the level 0 route of the plan and
+ * moves the plan forward past that action.  This is the plan lookup portion of
+ * chooseCommand_WithPlan() and does no learning or replanning of its own.
+ *
+ * CAVEAT:  g_plan should contain a valid plan that does not need recalc
+ *
+ * @return int the command prescribed by the current action
+ */
+int nextPlanCommand()
+{
     //Get the level 0 route from from the plan
     Route* level0Route = (Route *)g_plan->array[0];
 
@@ -2530,10 +2955,47 @@ int chooseCommand_WithPlan()
     updatePlan(0);
 
     //return the command prescribed by the current action
+    trRecord(TR_COMMAND, TR_BY_PLAN, nextStep->cmd, 0, 0);
     return nextStep->cmd;
 
-}//chooseCommand_WithPlan
+}//nextPlanCommand
+
+
+/**
+ * reapplyReplacements
+ *
+ * If the plan has just begun a new sequence then the active replacements need
+ * to be applied to the new current sequence.
+ *
+ * CAVEAT:  g_plan should contain a valid plan that does not need recalc
+ */
+void reapplyReplacements()
+{
+    int i,j;                    // iterators
 
+    Route *topRoute = getTopRoute(g_plan);
+    for(i = topRoute->level; i >= 0; i--)
+    {
+        //Has the route at this level just begun a new sequence?
+        Route *currRoute = (Route *)g_plan->array[0];
+        if ((currRoute->currSeqIndex > 0) && (currRoute->currActIndex <= 1))
+        {
+            //The modified sequence (if any) stays where it is in the route.
+            //It belongs to its Replacement so there is nothing to free.
+            currRoute->replSeq = NULL;
+           
+            //Reapply all active replacements at this level
+            for(j = 0; j < g_activeRepls->size; j++)
+            {
+                Replacement *currRepl = (Replacement *)g_activeRepls->array[j];
+                if (currRepl->level == i)
+                {
+                    applyReplacementToPlan(g_plan, currRepl);
+                }
+            }//for
+        }//if
+    }//for
+}//reapplyReplacements
 
 /**
  * chooseCommand
@@ -2598,32 +3060,7 @@ int chooseCommand()
 #endif
             //If a sequence has been completed then the active replacements need
             //to be applied to the new current sequence
-            Route *topRoute = getTopRoute(g_plan);
-            for(i = topRoute->level; i >= 0; i--)
-            {
-                //Has the route at this level just begun a new sequence?
-                Route *currRoute = (Route *)g_plan->array[0];
-                if ((currRoute->currSeqIndex > 0) && (currRoute->currActIndex <= 1))
-                {
-                    //MEMORY LEAK: If currRoute->replSeq is set, it points to
-                    //memory that needs to be deleted at some point.
-                    //Unfortunately, it can't be deleted now *and* the pointer
-                    //needs to be re-used for the current sequence.  It's not a
-                    //hard problem to solve but not trivial either. I'm letting
-                    //it go for the short term. -:AMN:, 23 Jan 2011
-                    currRoute->replSeq = NULL;
-                   
-                    //Reapply all active replacements at this level
-                    for(j = 0; j < g_activeRepls->size; j++)
-                    {
-                        Replacement *currRepl = (Replacement *)g_activeRepls->array[j];
-                        if (currRepl->level == i)
-                        {
-                            applyReplacementToPlan(g_plan, currRepl);
-                        }
-                    }//for
-                }//if
-            }//for
+            reapplyReplacements();
            
             //If a level 0 sequence has just completed then the agent's
             //confidence is increased due to the partial success
@@ -2670,29 +3107,12 @@ int chooseCommand()
         return chooseCommand_SemiRandom();
     }//if
 
-    //%%%TEMPORARY:  For Dustin and Ben
-    //  adding a % chance of random action depending upon how long it's been
-    //  since we've reached the goal
-    int randDelay = 100;
-    static int lastGoal = 0;
-    static int stepsSoFar = 0;
-    stepsSoFar++;
-    if (lastGoal < g_goalCount)
+    //The longer it has been since the last goal the more likely the agent
+    //is to wander off its plan
+    if (timeForRandomStep())
     {
-        stepsSoFar = 0;
-        lastGoal = g_goalCount;
+        return chooseCommand_SemiRandom();
     }
-    printf("stepsSoFar=%d\n", stepsSoFar);
-    if (stepsSoFar > randDelay)
-    {
-        int rNum = (rand() % 1000); // random number 0..999
-        if (stepsSoFar - randDelay > rNum)
-        {
-            return chooseCommand_SemiRandom();
-            stepsSoFar = 0;
-        }
-    }
-    
 
     //If we've reached this point then there is a working plan so the agent
     //should select the next step with that plan.
@@ -2700,6 +3120,43 @@ int chooseCommand()
 
 }//chooseCommand
 
+/**
+ * timeForRandomStep
+ *
+ * Decides whether the agent should take a semi-random step rather than the
+ * next step of its plan.  This is called once for each step taken while
+ * there is a plan, by chooseCommand() and by tickPipelined(), so that both
+ * explore alike.
+ *
+ * %%%TEMPORARY:  For Dustin and Ben
+ *  adding a % chance of random action depending upon how long it's been
+ *  since we've reached the goal
+ *
+ * @return TRUE if the agent should take a random step
+ */
+int timeForRandomStep()
+{
+    int randDelay = 100;
+    static int lastGoal = 0;
+    static int stepsSoFar = 0;
+    stepsSoFar++;
+    if (lastGoal < g_goalCount)
+    {
+        stepsSoFar = 0;
+        lastGoal = g_goalCount;
+    }
+    if (stepsSoFar > randDelay)
+    {
+        int rNum = (rand() % 1000); // random number 0..999
+        if (stepsSoFar - randDelay > rNum)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}//timeForRandomStep
+
 /**
  * displayRoute                 *RECURSIVE*
  *
@@ -3002,14 +3459,15 @@ void initRouteFromSequence(Route *route, Vector *seq)
 /**
  * freeRoute()
  *
- * This method frees the memory used by a route.
+ * This method frees the memory used by a route.  Its sequences are not
+ * freed: they belong to the episodic memory or, if a replacement made them, to
+ * the Replacement.
  *
  */
 void freeRoute(Route *r)
 {
     if (r == NULL) return;
     if (r->sequences != NULL) freeVector(r->sequences);
-    if (r->replSeq != NULL) free(r->replSeq);
     free(r);
 
 }//freeRoute
@@ -3229,6 +3687,7 @@ int findRoute(Route* newRoute, Vector *startSeq)
 
             //If the left-hand-side of this action doesn't match the
             //last sequence in the current candidate route then skip.
+            //(Sequences are interned so comparing pointers is enough.)
             Vector *lhsSeq = (Vector *)act->epmem->array[act->index];
             if (lhsSeq != lastSeq) continue;
 
@@ -3288,6 +3747,58 @@ int findRoute(Route* newRoute, Vector *startSeq)
     return PLAN_NOT_FOUND;
 }//findRoute
 
+/**
+ * readRoute
+ *
+ * Find a shortest route from a given start sequence to a goal at its level
+ * by following the distance-to-goal field (see addRouteAction()).  Each step
+ * of the route is the next sequence along, so unlike findRoute() there is no
+ * search and no limit on the number of candidates.
+ *
+ * @arg newRoute  is the Route struct to populate with this new route.
+ * @arg startSeq  must be the first sequence in the route
+ *
+ * @return SUCCESS, PLAN_NOT_FOUND if no goal can be reached from startSeq or
+ *         NOT_INTERNED if startSeq is not a completed sequence
+ */
+int readRoute(Route* newRoute, Vector *startSeq)
+{
+    Action *act = (Action *)startSeq->array[0];
+    int level = act->level;
+    assert(level+1 < MAX_LEVEL_DEPTH); // can't build plan without level+1 actions
+
+    SeqTable* table = &g_seqTables[level];
+    if (table->isStale)
+    {
+        rebuildRouteField(level);
+    }
+
+    SeqInfo* info = findSeqInfo(startSeq);
+    if (info == NULL) return NOT_INTERNED;
+    if (info->dist == NO_ROUTE) return PLAN_NOT_FOUND;
+
+    newRoute->level        = level;
+    newRoute->currSeqIndex = 0;
+    newRoute->currActIndex = 0;
+    newRoute->needsRecalc  = FALSE;
+
+    //Each step is strictly closer to a goal so the route can't loop
+    for( ; info != NULL; info = info->next)
+    {
+        addEntry(newRoute->sequences, info->seq);
+    }
+
+#if DEBUGGING_INITROUTE
+    printf("read route of length %d from the distance-to-goal field: ",
+           routeLength(newRoute));
+    displayRoute(newRoute, FALSE);
+    printf("\n");
+    fflush(stdout);
+#endif
+
+    return SUCCESS;
+}//readRoute
+
 /**
  * initPlan
  *
@@ -3310,29 +3821,71 @@ Vector* initPlan(int isReplan)
     fflush(stdout);
 #endif
        
-    //Try to figure out where I am.  I can't make plan without this.
-    Vector *startSeq = (Vector *)findInterimStart_NO_KNN();
+    //Try to figure out where I am.  I can't make plan without this.  Of the
+    //places that match best, start from the one closest to a goal.
+    trBegin(TR_PH_START);
+    Vector *cands[K_NEAREST];
+    Vector *startSeq = NULL;
+    int numCands = findInterimStartCandidates(cands);
+    if (numCands > 0)
+    {
+        startSeq = chooseStart(cands, numCands);
+    }
     if (startSeq == NULL)
     {
         //Try a partial match
         startSeq = findInterimStartPartialMatch_NO_KNN(&offset);
         if (startSeq == NULL)
         {
+            trEnd(TR_PH_START);
+            trRecord(TR_PLAN, TR_PLAN_NO_START, 0, 0, 0);
             return NULL;        // I give up
         }
     }//if
+    trEnd(TR_PH_START);
 
    
 
     //Figure out what level the startSeq is at
     Action *act = (Action *)startSeq->array[0];
     int level = act->level;
+
+    //Figure out which action in the level 0 route the plan will begin with
+    //(see below)
+    int startIndex = 0;
+    if (isReplan)
+    {
+        startIndex = (offset > -1) ? offset : 1;
+    }
+
+    //The same start gives the same plan until the level's epoch moves on.
+    //Only completed sequences are cached since a sequence that is still being
+    //built may have changed by next time.
+    int canCache = (findSeqInfo(startSeq) != NULL);
+    if (canCache)
+    {
+        Vector *cachedPlan = lookupPlan(startSeq, startIndex);
+        if (cachedPlan != NULL)
+        {
+            trRecord(TR_PLAN, TR_PLAN_CACHED, level,
+                     ((Route *)cachedPlan->array[level])->sequences->size, 0);
+            return cachedPlan;
+        }
+    }
+
+    trBegin(TR_PH_PLAN);
    
     //Initialize an empty plan.  This will eventually be our return value.
     Vector *resultPlan = newPlan();
 
-    //Try to initialize the route at the same level as the start sequence
-    int retVal = findRoute((Route *)resultPlan->array[level], startSeq);
+    //Try to initialize the route at the same level as the start sequence.
+    //It can be read off the distance-to-goal field unless the start sequence
+    //isn't a completed one, in which case search for it.
+    int retVal = readRoute((Route *)resultPlan->array[level], startSeq);
+    if (retVal == NOT_INTERNED)
+    {
+        retVal = findRoute((Route *)resultPlan->array[level], startSeq);
+    }
     if (retVal != SUCCESS)
     {
 #if DEBUGGING_INITPLAN
@@ -3343,6 +3896,8 @@ Vector* initPlan(int isReplan)
        
         //Give up if no route can be found
         freePlan(resultPlan);
+        trEnd(TR_PH_PLAN);
+        trRecord(TR_PLAN, TR_PLAN_NONE, level, 0, 0);
         return NULL;
     }//if
 
@@ -3395,6 +3950,14 @@ Vector* initPlan(int isReplan)
         }
     }//if
 
+    if (canCache)
+    {
+        storePlan(startSeq, startIndex, resultPlan);
+    }
+
+    trEnd(TR_PH_PLAN);
+    trRecord(TR_PLAN, TR_PLAN_MADE, level,
+             ((Route *)resultPlan->array[level])->sequences->size, 0);
 
     return resultPlan;
 }// initPlan
@@ -3409,7 +3972,7 @@ Vector* initPlan(int isReplan)
 Vector *newPlan()
 {
     int i;
-    Vector *newPlan = newVector(); // return value
+    Vector *newPlan = newSmallVector(); // return value
     for(i = 0; i < MAX_LEVEL_DEPTH; i++)
     {
         Route *r = (Route*)malloc(sizeof(Route));
@@ -3447,7 +4010,7 @@ void freePlan(Vector *plan)
     for(i = 0; i < plan->size; i++)
     {
         //get a pointer to the route
-        Route *r = (Route *)plan->array[i];
+        Route *r = routeAt(plan, i);
         freeRoute(r);
     }//for
 
@@ -3456,6 +4019,362 @@ void freePlan(Vector *plan)
 }//freePlan
 
 
+/**
+ * clonePlan()
+ *
+ * Copy a plan.  The sequences are shared but each Route and its list of
+ * sequences is new, so the copy can be followed and changed independently.
+ * Replacements are not copied: the copy must not have any (see
+ * applyReplacementToPlan()).
+ *
+ * @arg plan   the plan to copy
+ *
+ * @return the copy
+ */
+Vector *clonePlan(Vector *plan)
+{
+    int i;
+    Vector *copy = newSmallVector();
+
+    for(i = 0; i < plan->size; i++)
+    {
+        Route *r = routeAt(plan, i);
+        Route *c = (Route*)malloc(sizeof(Route));
+
+        assert(r->replSeq == NULL);
+        *c = *r;
+        c->sequences = cloneVector(r->sequences);
+
+        addEntry(copy, c);
+    }//for
+
+    return copy;
+}//clonePlan
+
+/**
+ * planCacheEntry()
+ *
+ * @return the entry of the plan cache that the given key belongs in
+ */
+PlanCacheEntry *planCacheEntry(Vector *startSeq, int offset)
+{
+    unsigned long key = ((unsigned long)startSeq >> 4) * 31 + offset;
+
+    return &g_planCache[(key ^ (key >> 8)) & (PLAN_CACHE_SIZE - 1)];
+}//planCacheEntry
+
+/**
+ * lookupPlan()
+ *
+ * Find a plan that initPlan() made earlier from the same start, if nothing
+ * has happened since that could change it.
+ *
+ * @arg startSeq  the (completed) sequence the plan starts from
+ * @arg offset    index of the first action of the plan in the level 0 route
+ *
+ * @return a copy of the plan or NULL if there isn't one
+ */
+Vector *lookupPlan(Vector *startSeq, int offset)
+{
+    PlanCacheEntry *entry = planCacheEntry(startSeq, offset);
+    int level = ((Action *)startSeq->array[0])->level;
+
+    if ((entry->plan != NULL)
+        && (entry->startSeq == startSeq)
+        && (entry->offset == offset)
+        && (entry->level == level)
+        && (entry->epoch == g_seqTables[level].epoch))
+    {
+        g_planCacheHits++;
+        return clonePlan(entry->plan);
+    }
+
+    g_planCacheMisses++;
+    return NULL;
+}//lookupPlan
+
+/**
+ * storePlan()
+ *
+ * Keep a copy of a new plan for lookupPlan(), in place of whatever plan was
+ * in its entry before.
+ *
+ * @arg startSeq  the (completed) sequence the plan starts from
+ * @arg offset    index of the first action of the plan in the level 0 route
+ * @arg plan      the plan
+ */
+void storePlan(Vector *startSeq, int offset, Vector *plan)
+{
+    PlanCacheEntry *entry = planCacheEntry(startSeq, offset);
+    int level = ((Action *)startSeq->array[0])->level;
+
+    freePlan(entry->plan);
+    entry->startSeq = startSeq;
+    entry->offset   = offset;
+    entry->level    = level;
+    entry->epoch    = g_seqTables[level].epoch;
+    entry->plan     = clonePlan(plan);
+}//storePlan
+
+/**
+ * freePlanCache()
+ *
+ * Empty the plan cache.
+ */
+void freePlanCache()
+{
+    int i;
+
+    for(i = 0; i < PLAN_CACHE_SIZE; i++)
+    {
+        freePlan(g_planCache[i].plan);
+        g_planCache[i].plan = NULL;
+    }
+}//freePlanCache
+
+/**
+ * displayPlanCacheStats
+ *
+ * Print how often initPlan() was able to reuse a plan.
+ *
+ * @arg out  where to print
+ */
+void displayPlanCacheStats(FILE* out)
+{
+    int total;
+
+    //A pipelined tick may still be looking plans up
+    finishPipelinedTick();
+
+    total = g_planCacheHits + g_planCacheMisses;
+
+    fprintf(out, "Plan cache: %d lookups, %d hits (%.1f%%), %d misses\n",
+            total, g_planCacheHits,
+            (total > 0 ? 100.0 * g_planCacheHits / total : 0.0),
+            g_planCacheMisses);
+    fflush(out);
+}//displayPlanCacheStats
+
+/**
+ * countVector
+ *
+ * Add a vector's blocks (the struct and its array, which are one block if
+ * the array is inline) to a count.  The vector's entries are not counted.
+ *
+ * @arg stats  the count
+ * @arg v      the vector (or NULL)
+ */
+void countVector(MemStats* stats, Vector* v)
+{
+    if (v == NULL) return;
+
+    stats->allocs += (VECTOR_IS_INLINE(v) ? 1 : 2);
+    stats->bytes  += sizeof(Vector) + v->capacity * sizeof(void*);
+}//countVector
+
+/**
+ * countMemory
+ *
+ * Count the entries, allocations and bytes held by each of the agent's
+ * structures at each level.  Anything shared is counted once, by the
+ * structure that owns it:
+ *  - g_epMem owns the level 0 Episodes.  Above level 0 it holds the
+ *    sequences of the level below, which g_sequences owns.
+ *  - g_actions owns the Actions, and a cousins list and its overallFreq are
+ *    counted with the first of the cousins.
+ *  - g_replacements owns each Replacement and the sequences it made (see
+ *    applyReplacementToSequence()), but not the Actions they refer to.
+ *  - g_seqTables owns the SeqInfos.  A cached plan is counted at the level
+ *    it starts from.
+ * Nothing else (e.g. the current plan) is counted.
+ *
+ * This walks every structure so it is meant for the occasional snapshot,
+ * not for every tick.  It waits for any pipelined tick to finish first.
+ *
+ * @arg stats  filled in with the counts, by kind (MEM_EPMEM etc.) and level
+ */
+void countMemory(MemStats stats[MEM_NUM_KINDS][MAX_LEVEL_DEPTH])
+{
+    int i, j, k;
+
+    memset(stats, 0, MEM_NUM_KINDS * MAX_LEVEL_DEPTH * sizeof(MemStats));
+
+    //A pipelined tick may still be changing memory
+    finishPipelinedTick();
+
+    for(i = 0; i < MAX_LEVEL_DEPTH; i++)
+    {
+        //Episodes (level 0) or the sequences of the level below
+        Vector* epList = (Vector*)g_epMem->array[i];
+        MemStats* s = &stats[MEM_EPMEM][i];
+        countVector(s, epList);
+        s->entries = epList->size;
+        if (i == 0)
+        {
+            s->allocs += epList->size;
+            s->bytes  += epList->size * sizeof(Episode);
+        }
+
+        //Actions and their cousins
+        Vector* actList = (Vector*)g_actions->array[i];
+        s = &stats[MEM_ACTIONS][i];
+        countVector(s, actList);
+        s->entries = actList->size;
+        for(j = 0; j < actList->size; j++)
+        {
+            Action* act = actionAt(actList, j);
+            s->allocs++;
+            s->bytes += sizeof(Action);
+
+            if ((act->cousins != NULL) && (act->cousins->array[0] == act))
+            {
+                countVector(s, act->cousins);
+                if (act->overallFreq != NULL)
+                {
+                    s->allocs++;
+                    s->bytes += sizeof(int);
+                }
+            }
+        }//for
+
+        //Sequences
+        Vector* seqList = (Vector*)g_sequences->array[i];
+        s = &stats[MEM_SEQUENCES][i];
+        countVector(s, seqList);
+        s->entries = seqList->size;
+        for(j = 0; j < seqList->size; j++)
+        {
+            countVector(s, (Vector*)seqList->array[j]);
+        }
+
+        //Replacements and the sequences made by applying them
+        Vector* replList = (Vector*)g_replacements->array[i];
+        s = &stats[MEM_REPLACEMENTS][i];
+        countVector(s, replList);
+        s->entries = replList->size;
+        for(j = 0; j < replList->size; j++)
+        {
+            Replacement* repl = (Replacement*)replList->array[j];
+            s->allocs++;
+            s->bytes += sizeof(Replacement);
+            countVector(s, repl->original);
+            countVector(s, repl->applied);
+            countVector(s, repl->results);
+            if (repl->results == NULL) continue;
+
+            for(k = 0; k < repl->results->size; k++)
+            {
+                countVector(s, (Vector*)repl->results->array[k]);
+            }
+        }//for
+
+        //Sequence table
+        SeqTable* table = &g_seqTables[i];
+        s = &stats[MEM_SEQ_TABLES][i];
+        s->entries = table->count;
+        if (table->infos != NULL)
+        {
+            s->allocs++;
+            s->bytes += table->capacity * sizeof(SeqInfo*);
+        }
+        for(j = 0; j < table->capacity; j++)
+        {
+            SeqInfo* info = table->infos[j];
+            if (info == NULL) continue;
+
+            s->allocs++;
+            s->bytes += sizeof(SeqInfo);
+            countVector(s, info->inActions);
+        }
+    }//for
+
+    //Plan cache
+    for(i = 0; i < PLAN_CACHE_SIZE; i++)
+    {
+        Vector* plan = g_planCache[i].plan;
+        if (plan == NULL) continue;
+
+        MemStats* s = &stats[MEM_PLAN_CACHE][g_planCache[i].level];
+        s->entries++;
+        countVector(s, plan);
+        for(j = 0; j < plan->size; j++)
+        {
+            Route* r = routeAt(plan, j);
+            if (r == NULL) continue;
+
+            s->allocs++;
+            s->bytes += sizeof(Route);
+            countVector(s, r->sequences);
+        }
+    }//for
+}//countMemory
+
+/**
+ * displayMemoryStats
+ *
+ * Print a table of the memory held by each of the agent's structures at each
+ * level (see countMemory()).
+ *
+ * @arg out  where to print it (e.g., stdout or a log file)
+ */
+void displayMemoryStats(FILE* out)
+{
+    MemStats stats[MEM_NUM_KINDS][MAX_LEVEL_DEPTH];
+    MemStats total = { 0, 0, 0 };
+    int i, j;
+
+    countMemory(stats);
+
+    fprintf(out, "%-13s %5s %10s %10s %12s\n",
+            "structure", "level", "entries", "allocs", "bytes");
+    for(i = 0; i < MEM_NUM_KINDS; i++)
+    {
+        for(j = 0; j < MAX_LEVEL_DEPTH; j++)
+        {
+            MemStats* s = &stats[i][j];
+            fprintf(out, "%-13s %5d %10ld %10ld %12ld\n",
+                    g_memKindNames[i], j, s->entries, s->allocs, s->bytes);
+            total.allocs += s->allocs;
+            total.bytes  += s->bytes;
+        }
+    }
+    fprintf(out, "%-13s %5s %10s %10ld %12ld\n",
+            "total", "", "", total.allocs, total.bytes);
+    fflush(out);
+}//displayMemoryStats
+
+/**
+ * displayMemoryStatsShort
+ *
+ * Print the entries at each level and the kilobytes held by each of the
+ * agent's structures (see countMemory()) on one line, with no newline.
+ *
+ * @arg out  where to print it (e.g., stdout or a log file)
+ */
+void displayMemoryStatsShort(FILE* out)
+{
+    MemStats stats[MEM_NUM_KINDS][MAX_LEVEL_DEPTH];
+    long totalBytes = 0;
+    int i, j;
+
+    countMemory(stats);
+
+    for(i = 0; i < MEM_NUM_KINDS; i++)
+    {
+        long bytes = 0;
+
+        fprintf(out, "%s ", g_memKindNames[i]);
+        for(j = 0; j < MAX_LEVEL_DEPTH; j++)
+        {
+            fprintf(out, "%s%ld", (j == 0 ? "" : "/"), stats[i][j].entries);
+            bytes += stats[i][j].bytes;
+        }
+        fprintf(out, " %ldKB, ", bytes / 1024);
+        totalBytes += bytes;
+    }
+    fprintf(out, "total %ldKB", totalBytes / 1024);
+}//displayMemoryStatsShort
+
 /**
  * planNeedsRecalc()
  *
@@ -3588,7 +4507,7 @@ int compareEpisodesLoose(Episode* ep1, Episode* ep2)
     static double threshold = INIT_THRESHOLD; // determines the need percent similar 
                                    //to accept the plan.
     int i;
-    int counter;
+    int counter = 0;
     
     // Iterate through the episodes' sensor data and count the differences.
     for(i = 0; i < NUM_SENSORS; i++)
@@ -3671,7 +4590,8 @@ Episode* containsEpisode(Vector* episodeList, Episode* ep, int ignoreSelf)
 * containsSequence
 *
 * Check a list of sequences for a previous occurence of a particular
-* sequence
+* sequence.  This compares seq with every sequence in the list; to find a
+* completed sequence at a level use internSequence() instead.
 *
 * @arg sequenceList A vector containing a series of sequences
 * @arg seq A vector containing our current sequence
@@ -3699,6 +4619,320 @@ Vector* containsSequence(Vector* sequenceList, Vector* seq, int ignoreSelf)
         return NULL;
 }//containsSequence
 
+/**
+ * hashSequence
+ *
+ * A rolling hash of the Action pointers in a sequence.  Sequences made of the
+ * same Actions in the same order hash the same.
+ *
+ * @arg seq  the sequence to hash
+ * @return the hash
+ */
+unsigned long hashSequence(Vector* seq)
+{
+    unsigned long hash = 14695981039346656037UL;
+    int i;
+
+    for(i = 0; i < seq->size; i++)
+    {
+        hash = (hash ^ (unsigned long)seq->array[i]) * 1099511628211UL;
+    }
+
+    //Actions are aligned so mix the high bits into the low ones that pick
+    //the slot
+    return hash ^ (hash >> 29);
+}//hashSequence
+
+/**
+ * growSeqTable
+ *
+ * Double the number of slots in a sequence table (or make the first ones) and
+ * put each sequence back in its slot.
+ *
+ * @arg table  the table to grow
+ */
+void growSeqTable(SeqTable* table)
+{
+    int oldCapacity = table->capacity;
+    SeqInfo** oldInfos = table->infos;
+    int i, slot;
+
+    table->capacity = (oldCapacity == 0 ? INIT_SEQ_TABLE_SIZE : oldCapacity * 2);
+    table->infos = (SeqInfo**)calloc(table->capacity, sizeof(SeqInfo*));
+
+    for(i = 0; i < oldCapacity; i++)
+    {
+        if (oldInfos[i] == NULL) continue;
+
+        slot = oldInfos[i]->hash & (table->capacity - 1);
+        while(table->infos[slot] != NULL)
+        {
+            slot = (slot + 1) & (table->capacity - 1);
+        }
+        table->infos[slot] = oldInfos[i];
+    }
+
+    free(oldInfos);
+}//growSeqTable
+
+/**
+ * internSequence
+ *
+ * Find the completed sequence equal to the given one at its level, adding
+ * the given one to the table if there isn't one yet.  This replaces a search
+ * of every sequence at the level (see containsSequence()) with a hash of this
+ * one.  A sequence must not be changed once it is interned.
+ *
+ * A new sequence that contains a goal is a goal in the distance-to-goal field
+ * for its level.
+ *
+ * @arg seq  a non-empty sequence
+ * @return the interned sequence, which is seq itself if it is new
+ */
+Vector* internSequence(Vector* seq)
+{
+    assert(seq->size > 0);
+
+    int level = ((Action*)seq->array[0])->level;
+    SeqTable* table = &g_seqTables[level];
+    unsigned long hash = hashSequence(seq);
+    SeqInfo* info;
+    int slot;
+
+    //Keep the table no more than 3/4 full
+    if ((table->count + 1) * 4 > table->capacity * 3)
+    {
+        growSeqTable(table);
+    }
+
+    slot = hash & (table->capacity - 1);
+    while(table->infos[slot] != NULL)
+    {
+        if ((table->infos[slot]->hash == hash)
+            && (compareSequences(table->infos[slot]->seq, seq)))
+        {
+            return table->infos[slot]->seq;
+        }
+
+        slot = (slot + 1) & (table->capacity - 1);
+    }
+
+    info = (SeqInfo*)malloc(sizeof(SeqInfo));
+    info->seq       = seq;
+    info->hash      = hash;
+    info->length    = sequenceLength(seq, level);
+    info->dist      = NO_ROUTE;
+    info->next      = NULL;
+    info->inActions = newSmallVector();
+
+    table->infos[slot] = info;
+    table->count++;
+
+    //There are no routes at the top level
+    if ((level + 1 < MAX_LEVEL_DEPTH) && (getGoalAction(seq) >= 0))
+    {
+        info->dist = info->length;
+        spreadRouteDist(info);
+        table->epoch++;
+    }
+
+    return seq;
+}//internSequence
+
+/**
+ * findSeqInfo
+ *
+ * @arg seq  a sequence
+ * @return what is known about seq or NULL if it has not been interned
+ */
+SeqInfo* findSeqInfo(Vector* seq)
+{
+    if (seq->size == 0) return NULL;
+
+    SeqTable* table = &g_seqTables[((Action*)seq->array[0])->level];
+    int slot;
+
+    if (table->count == 0) return NULL;
+
+    slot = hashSequence(seq) & (table->capacity - 1);
+    while(table->infos[slot] != NULL)
+    {
+        if (table->infos[slot]->seq == seq) return table->infos[slot];
+
+        slot = (slot + 1) & (table->capacity - 1);
+    }
+
+    return NULL;
+}//findSeqInfo
+
+/**
+ * freeSeqTables
+ *
+ * Empty the sequence tables.  The sequences themselves belong to g_sequences
+ * and are not freed.
+ */
+void freeSeqTables()
+{
+    int i, j;
+
+    for(i = 0; i < MAX_LEVEL_DEPTH; i++)
+    {
+        for(j = 0; j < g_seqTables[i].capacity; j++)
+        {
+            SeqInfo* info = g_seqTables[i].infos[j];
+            if (info == NULL) continue;
+
+            freeVector(info->inActions);
+            free(info);
+        }
+
+        free(g_seqTables[i].infos);
+        g_seqTables[i].infos = NULL;
+        g_seqTables[i].capacity = 0;
+        g_seqTables[i].count = 0;
+        g_seqTables[i].isStale = FALSE;
+    }
+}//freeSeqTables
+
+/**
+ * spreadRouteDist
+ *
+ * Called when a sequence has a new, shorter distance to a goal.  Any sequence
+ * that leads to it by a level+1 action may now have a shorter route as well,
+ * and so on back through the distance-to-goal field.
+ *
+ * @arg from  the sequence whose distance went down
+ */
+void spreadRouteDist(SeqInfo* from)
+{
+    Vector* todo = newVector();   // sequences whose distance went down
+    int i;
+
+    addEntry(todo, from);
+    while(todo->size > 0)
+    {
+        SeqInfo* info = (SeqInfo*)todo->array[--todo->size];
+
+        for(i = 0; i < info->inActions->size; i++)
+        {
+            Action* action = (Action*)info->inActions->array[i];
+            SeqInfo* lhs = findSeqInfo((Vector*)action->epmem->array[action->index]);
+            if (lhs == NULL) continue;
+
+            int dist = lhs->length + info->dist;
+            if ((lhs->dist == NO_ROUTE) || (dist < lhs->dist))
+            {
+                lhs->dist = dist;
+                lhs->next = info;
+                addEntry(todo, lhs);
+            }
+        }//for
+    }//while
+
+    freeVector(todo);
+}//spreadRouteDist
+
+/**
+ * addRouteAction
+ *
+ * Add a new level 1+ action to the distance-to-goal field of the level below.
+ * It leads from the sequence on its LHS to the one on its RHS, so the LHS is
+ * now no further from a goal than the RHS plus its own length.
+ *
+ * @arg action  the action that was added
+ */
+void addRouteAction(Action* action)
+{
+    SeqTable* table = &g_seqTables[action->level - 1];
+    SeqInfo* lhs = findSeqInfo((Vector*)action->epmem->array[action->index]);
+    SeqInfo* rhs = findSeqInfo((Vector*)action->epmem->array[action->outcome]);
+
+    //The episodes above level 0 are interned sequences so this shouldn't
+    //happen, but if it does start over
+    if ((lhs == NULL) || (rhs == NULL))
+    {
+        table->isStale = TRUE;
+        table->epoch++;
+        return;
+    }
+
+    addEntry(rhs->inActions, action);
+
+    if (rhs->dist == NO_ROUTE) return;
+    if ((lhs->dist == NO_ROUTE) || (lhs->length + rhs->dist < lhs->dist))
+    {
+        lhs->dist = lhs->length + rhs->dist;
+        lhs->next = rhs;
+        spreadRouteDist(lhs);
+        table->epoch++;
+    }
+}//addRouteAction
+
+/**
+ * rebuildRouteField
+ *
+ * Work out the distance-to-goal field of a level from scratch, starting
+ * from the sequences that contain a goal and working back along the level+1
+ * actions.
+ *
+ * @arg level  the level of the sequences in the field
+ */
+void rebuildRouteField(int level)
+{
+    SeqTable* table = &g_seqTables[level];
+    Vector* actionList = (Vector*)g_actions->array[level + 1];
+    int i;
+
+    for(i = 0; i < table->capacity; i++)
+    {
+        SeqInfo* info = table->infos[i];
+        if (info == NULL) continue;
+
+        info->length = sequenceLength(info->seq, level);
+        info->dist = NO_ROUTE;
+        info->next = NULL;
+        info->inActions->size = 0;
+    }
+
+    for(i = 0; i < actionList->size; i++)
+    {
+        Action* action = (Action*)actionList->array[i];
+        SeqInfo* rhs = findSeqInfo((Vector*)action->epmem->array[action->outcome]);
+        if (rhs != NULL) addEntry(rhs->inActions, action);
+    }
+
+    for(i = 0; i < table->capacity; i++)
+    {
+        SeqInfo* info = table->infos[i];
+        if ((info == NULL) || (getGoalAction(info->seq) < 0)) continue;
+
+        info->dist = info->length;
+        spreadRouteDist(info);
+    }
+
+    //Plans cached against the old field may no longer be the shortest
+    table->isStale = FALSE;
+    table->epoch++;
+}//rebuildRouteField
+
+/**
+ * invalidateRouteFields
+ *
+ * Called when an existing action is changed rather than a new one added.  The
+ * lengths of the sequences and the links between them may have changed in
+ * ways that can't be patched, so each field is rebuilt before it is next read.
+ */
+void invalidateRouteFields()
+{
+    int i;
+
+    for(i = 0; i < MAX_LEVEL_DEPTH; i++)
+    {
+        g_seqTables[i].isStale = TRUE;
+        g_seqTables[i].epoch++;
+    }
+}//invalidateRouteFields
+
 /**
 * compareSequences
 *
@@ -3821,7 +5055,7 @@ int episodeContainsGoal(void *entry, int level)
         //For a sequence, a goal is indicated by the "containsGoal" field being
         //TRUE on the last action in the sequence
         Vector *sequence = (Vector *)entry;
-        Action *action = (Action *)sequence->array[sequence->size - 1];
+        Action *action = actionLast(sequence);
         return action->containsGoal;
     }
 }//episodeContainsGoal
@@ -3869,11 +5103,17 @@ void initSupervisor(int numCommands)
         addEntry(g_replacements, temp);
 
         // pad sequence vector to avoid crash on first call of updateAll()
-        addEntry(g_sequences->array[i], newVector());
+        addEntry(g_sequences->array[i], newSmallVector());
     }
 
+    // start with empty sequence tables and plan cache
+    freeSeqTables();
+    freePlanCache();
+    g_planCacheHits = 0;
+    g_planCacheMisses = 0;
+
     // seed rand (sow some wild oats)
-    srand(time(NULL));
+    srand(g_randSeed != 0 ? g_randSeed : time(NULL));
 
 //<<<<<<< local
    
@@ -3894,6 +5134,12 @@ void endSupervisor()
     // temporaries for loop below
     Vector *actionList, *episodeList, *sequenceList, *replacementList;
 
+    //A pipelined tick may still be using memory
+    finishPipelinedTick();
+
+    freePlanCache();
+    freeSeqTables();
+
     //%%%TODO:  Added for now to avoid crashing.  Remove this when this method
     //%%%       is fixed
     if (g_epMem != NULL) return;
@@ -4212,11 +5458,12 @@ Replacement* findBestReplacement()
             //Extract this Replacement to prep for the loop below
             Replacement *candRepl = (Replacement*)replacements->array[j];
 
-            //%%%DEBUGGING
+#ifdef DEBUGGING_FIND_REPL
             printf("\tconsidering ");
             displayReplacement(candRepl);
             printf("...");
             fflush(stdout);
+#endif
 
             //Iterate over all remaining subsequences of the current sequence
             //that are the same lenght as the LHS of the replacment rule
@@ -4243,6 +5490,9 @@ Replacement* findBestReplacement()
                
             }//for
 
+            trRecord(TR_REPL, i, j, match != NULL,
+                     (int)(candRepl->confidence * 1000));
+
 #ifdef DEBUGGING_FIND_REPL
             if (match != NULL)
             {
@@ -4296,11 +5546,17 @@ Replacement* findBestReplacement()
  * sequence to produce a new sequence.  The original, given, sequence is not
  * modified.
  *
+ * The new sequence is made only the first time the replacement is applied to
+ * the given sequence.  After that the same one is handed out again (see
+ * Replacement.applied), so reapplying replacements each time a plan starts a
+ * new sequence takes no memory.  The new sequence belongs to the replacement
+ * and must not be changed or freed by the caller.
+ *
  * CAVEAT: This function depends on a Replacement replacing exactly 2 Actions.
  *
  * @arg    sequence    a sequence of actions over which to apply a replacement
  * @arg    replacement the Replacement to apply
- * @return Vector*     copy of original sequence with the replacement applied
+ * @return Vector*     original sequence with the replacement applied
  */
 Vector* applyReplacementToSequence(Vector* sequence, Replacement* replacement)
 {
@@ -4318,9 +5574,18 @@ Vector* applyReplacementToSequence(Vector* sequence, Replacement* replacement)
     //Don't bother doing replacements on sequences with insufficient actions
     //(currently hardcoded to two)
     if (sequence->size < 2) return sequence;
+
+    //Has this replacement already been applied to this sequence?
+    if (replacement->applied == NULL)
+    {
+        replacement->applied = newVector();
+        replacement->results = newVector();
+    }
+    i = findEntry(replacement->applied, sequence);
+    if (i != -1) return (Vector *)replacement->results->array[i];
    
     // initialize instance variables;
-    withReplacement = newVector();
+    withReplacement = newSmallVector();
 
     // iterate through original vector, adding elements to
     // withReplacement not applicable to replacement and substituting
@@ -4350,6 +5615,9 @@ Vector* applyReplacementToSequence(Vector* sequence, Replacement* replacement)
     fflush(stdout);
 #endif
 
+    //Remember the result for the next time
+    addEntry(replacement->applied, sequence);
+    addEntry(replacement->results, withReplacement);
 
     return withReplacement;
 }//applyReplacementToSequence
@@ -4389,13 +5657,8 @@ void applyReplacementToPlan(Vector *plan, Replacement *repl)
         replRoute->currActIndex = newSeq->size-1;
     }
 
-    // free the old replacement sequence if it exists
-    if (replRoute->replSeq != NULL)
-    {
-        free(replRoute->replSeq);
-    }
-
-    //Install the new route
+    //Install the new route.  Any earlier replacement sequence belongs to its
+    //Replacement so it is simply dropped.
     replRoute->replSeq = newSeq;
     replRoute->sequences->array[replRoute->currSeqIndex] = replRoute->replSeq;
    
@@ -4832,7 +6095,7 @@ Vector *findInterimStartPartialMatch_KNN(int *offset)
     startingOffset -= lastLevel1Ep->size;
     //If there is overlap between the two last level 0 sequence and last level 1
     //episode, adjust them accordingly
-    Action *lastAct = (Action *)lastLevel1Ep->array[lastLevel1Ep->size - 1];
+    Action *lastAct = actionLast(lastLevel1Ep);
     Episode *lastEp = (Episode *)lastAct->epmem->array[lastAct->index];
     if (lastEp->cmd != CMD_SONG)
     {
@@ -5014,16 +6277,39 @@ comparison = compareEpisodes(ep1, ep2, matchLen > 0);
  *         level.
  */
 Vector* findInterimStart_NO_KNN()
+{
+    Vector *cands[K_NEAREST];     // the best start sequences, best first
+
+    if (findInterimStartCandidates(cands) == 0) return NULL;
+
+    return cands[0];
+}//findInterimStart_NO_KNN
+
+/**
+ * findInterimStartCandidates
+ *
+ * Like findInterimStart_NO_KNN() but rather than just the best match this
+ * keeps up to K_NEAREST distinct start sequences from the level searched.
+ * They are ranked the way findInterimStart_NO_KNN() ranks them: the longest
+ * match first and of equal matches the most recent first.  So the first
+ * candidate is always the one findInterimStart_NO_KNN() returns.
+ *
+ * @arg cands  an array of K_NEAREST to fill with the start sequences
+ *
+ * @return the number of start sequences found (0 if the most recently
+ *         completed sequence is unique in every level)
+ */
+int findInterimStartCandidates(Vector **cands)
 {
     int level, i, j;              // loop iterators
     Vector *currLevelEpMem;       // the epmem list for the level being searched
     int lastIndex;                // the index of the last entry in currLevelEpMem
-    int bestMatchIndex = 0;       // position and
-    int bestMatchLen = 0;         // length of best match found
     int matchLen = 0;             // length of current match
+    int lens[K_NEAREST];          // the match length of each candidate
+    int numCands = 0;             // number of candidates so far
 
 #ifdef DEBUGGING_FINDINTERIMSTART
-    printf("Entering findInterimStart()\n");
+    printf("Entering findInterimStartCandidates()\n");
     fflush(stdout);
 #endif
    
@@ -5054,45 +6340,108 @@ Vector* findInterimStart_NO_KNN()
                 if (i - matchLen < 0) break;
             }
 
-            //See if we've found a new best match
-            if (matchLen > bestMatchLen)
+            if (matchLen == 0) continue;
+
+            //Skip it if it can't beat the candidates so far
+            if ((numCands == K_NEAREST) && (matchLen <= lens[K_NEAREST - 1])) continue;
+
+            //If it's a start that's already a candidate, keep the longer of
+            //the two matches (the more recent one if they're equal)
+            Vector *start = currLevelEpMem->array[i + 1];
+            for(j = 0; j < numCands; j++)
+            {
+                if (cands[j] == start) break;
+            }
+            if (j < numCands)
+            {
+                if (matchLen <= lens[j]) continue;
+
+                //Take out the shorter match so it can be put back in its
+                //new place below
+                for(numCands--; j < numCands; j++)
+                {
+                    cands[j] = cands[j + 1];
+                    lens[j]  = lens[j + 1];
+                }
+            }
+
+            //Insert it after the candidates with matches at least as long
+            if (numCands < K_NEAREST) numCands++;
+            for(j = numCands - 1; (j > 0) && (lens[j - 1] < matchLen); j--)
             {
-                bestMatchLen = matchLen;
-                bestMatchIndex = i;
+                cands[j] = cands[j - 1];
+                lens[j]  = lens[j - 1];
             }
+            cands[j] = start;
+            lens[j]  = matchLen;
+
+            trRecord(TR_MATCH, level, matchLen, i + 1, 0);
         }//for
 
         //If any match was found at this level, then stop searching
-        if (bestMatchLen > 0) break;
+        if (numCands > 0) break;
     }//for
 
-    //Check for no match found
-    if (bestMatchLen == 0)
-    {
 #ifdef DEBUGGING_FINDINTERIMSTART
+    if (numCands == 0)
+    {
         printf("findInterimStart failed: all new sequences are unique\n");
-        fflush(stdout);
-#endif
-        return NULL;
     }
-
-    //***If we reach this point, we've found a match.
-
-#ifdef DEBUGGING_FINDINTERIMSTART
-        printf("\tSearch Result of length %d at index %d in level %d:  ",
-               bestMatchLen, bestMatchIndex + 1, level);
-        fflush(stdout);
-        displaySequenceShort(currLevelEpMem->array[bestMatchIndex + 1]);
-        printf(" which comes after: ");
-        displaySequenceShort(currLevelEpMem->array[bestMatchIndex]);
-        printf(" and which matches: ");
-        displaySequenceShort(currLevelEpMem->array[currLevelEpMem->size - 1]);
+    for(i = 0; i < numCands; i++)
+    {
+        printf("\tCandidate %d with match of length %d in level %d:  ",
+               i, lens[i], level);
+        displaySequenceShort(cands[i]);
         printf("\n");
-        fflush(stdout);
+    }
+    fflush(stdout);
 #endif
-        return currLevelEpMem->array[bestMatchIndex + 1];
+
+    return numCands;
    
-}//findInterimStart_NO_KNN
+}//findInterimStartCandidates
+
+/**
+ * chooseStart
+ *
+ * Choose which of the candidate start sequences from
+ * findInterimStartCandidates() to plan from: the one with the shortest route
+ * to a goal.  The distance-to-goal field gives the length of each route
+ * without finding it, so the candidates are simply compared in order and the
+ * earliest of equally short routes wins.
+ *
+ * @arg cands     the candidate start sequences, best match first
+ * @arg numCands  how many there are (at least 1)
+ *
+ * @return the start sequence to plan from.  If none of them has a route this
+ *         is the best match.
+ */
+Vector* chooseStart(Vector **cands, int numCands)
+{
+    int level = ((Action *)cands[0]->array[0])->level;
+    Vector *best = cands[0];
+    int bestDist = NO_ROUTE;
+    int i;
+
+    if (g_seqTables[level].isStale)
+    {
+        rebuildRouteField(level);
+    }
+
+    for(i = 0; i < numCands; i++)
+    {
+        SeqInfo *info = findSeqInfo(cands[i]);
+        if ((info == NULL) || (info->dist == NO_ROUTE)) continue;
+
+        if ((bestDist == NO_ROUTE) || (info->dist < bestDist))
+        {
+            best = cands[i];
+            bestDist = info->dist;
+        }
+    }//for
+
+    return best;
+}//chooseStart
 
 
 /**
@@ -5149,7 +6498,7 @@ Vector *findInterimStartPartialMatch_NO_KNN(int *offset)
     startingOffset -= lastLevel1Ep->size;
     //If there is overlap between the two last level 0 sequence and last level 1
     //episode, adjust them accordingly
-    Action *lastAct = (Action *)lastLevel1Ep->array[lastLevel1Ep->size - 1];
+    Action *lastAct = actionLast(lastLevel1Ep);
     Episode *lastEp = (Episode *)lastAct->epmem->array[lastAct->index];
     if (lastEp->cmd != CMD_SONG)
     {
@@ -5219,6 +6568,8 @@ Vector *findInterimStartPartialMatch_NO_KNN(int *offset)
         return NULL;
     }
 
+    trRecord(TR_MATCH, 0, bestMatchLen, bestMatchIndex, 0);
+
     /*======================================================================
      * Step 2: Iterate backwards over all the level 1 episodes to figure out
      *         which one corresponds to the partial match found at level 0.
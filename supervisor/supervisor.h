@@ -19,7 +19,7 @@
 #include <time.h>
 #include <string.h>
 
-#include "vector.h"
+#include "../vector/vector.h"
 #include "../communication/communication.h"
 #include "knearest.h"
 
@@ -33,21 +33,31 @@
 #define LEVEL_NOT_POPULATED 2    // used by initRoute, updatePlan
 #define PLAN_NOT_FOUND      3    // used by initRoute
 #define PLAN_ON_OUTCOME     4    // used by updatePlan
+#define NOT_INTERNED        5    // used by readRoute
 
-// Matching defines
+// Matching defines.  Those here and below inside #ifndef may be given with
+// -D instead, e.g. by a parameter sweep (see communication/sweep.c).
 #define NUM_TO_MATCH         (15)
 #define NUM_GOALS_TO_FIND    (10)
+#ifndef DISCOUNT
 #define DISCOUNT             (1.0)
+#endif
 #define MAX_LEN_LHS          (1)
 #define MAX_LEVEL_DEPTH      (4)
 #define MIN_LEVEL0_MATCH_LEN (2) // do not set this to anything less than 2!
+#ifndef K_NEAREST
 #define K_NEAREST            (8)
+#endif
 #define MIN_NEIGHBORS        (1) //minimum number of neighbors required for match
 
 //Planning defines
 #define MAX_ROUTE_LEN        (50)
+#ifndef MAX_ROUTE_CANDS
 #define MAX_ROUTE_CANDS      (20) // maximum number of candidate routes to
-                                   // examine before giving up
+                                   // examine before giving up (only used by
+                                   // findRoute(), for sequences that aren't
+                                   // interned)
+#endif
 
 //Replacement defines
 #define MAX_CONFIDENCE       (1.0)
@@ -58,6 +68,24 @@
 #define MAX_REPL_RISK        (0.0)  // a more flexible limitation to repls per
                                     // plan (min=0.0)
 
+//Sequence table defines
+#define INIT_SEQ_TABLE_SIZE  (64)   // initial slots in a sequence table (a
+                                    // power of 2)
+#define NO_ROUTE             (-1)   // distance of a sequence with no route to
+                                    // a goal
+
+//Plan cache defines
+#define PLAN_CACHE_SIZE      (256)  // entries in the plan cache (a power of 2)
+
+//Memory accounting defines.  The kinds of structure countMemory() counts.
+#define MEM_EPMEM            (0)    // g_epMem
+#define MEM_ACTIONS          (1)    // g_actions
+#define MEM_SEQUENCES        (2)    // g_sequences
+#define MEM_REPLACEMENTS     (3)    // g_replacements
+#define MEM_SEQ_TABLES       (4)    // g_seqTables
+#define MEM_PLAN_CACHE       (5)    // g_planCache
+#define MEM_NUM_KINDS        (6)
+
 
 // Collecting data for stats
 #define STATS_MODE		0
@@ -103,7 +131,8 @@ typedef struct RouteStruct
                               // this route
     Vector* replSeq;          // If a replacement has been applied to the
                               // current sequence this contains a pointer to the
-                              // modified sequence
+                              // modified sequence.  It belongs to the
+                              // Replacement, not to the route.
     int currSeqIndex;         // The current sequence in this plan that is being executed
     int currActIndex;         // An index into the current sequence in this plan
                               // that indicates what action is currently being
@@ -118,8 +147,67 @@ typedef struct ReplacementStruct
     Action* replacement;      // single Action to replace original
     double  confidence;       // level of certainty in the reliablility of this
                               // replacment (0.0 ... 1.0)
+    Vector* applied;          // the sequences this has been applied to (or
+                              // NULL if none yet) ...
+    Vector* results;          // ... and the sequence each one became.  Every
+                              // plan that applies this replacement to the same
+                              // sequence shares the result.
 } Replacement;
 
+//Typed access to vectors of Episodes, Actions and Routes (see vector.h),
+//e.g. episodeAt(epList, i) in place of (Episode*)epList->array[i]
+VECTOR_OF(Episode, episode)
+VECTOR_OF(Action, action)
+VECTOR_OF(Route, route)
+
+//What is known about one completed sequence.  Besides the sequence itself
+//this holds its place in the distance-to-goal field for its level: the
+//sequences are the nodes and each level+1 action is an edge from the
+//sequence on its LHS to the sequence on its RHS.
+typedef struct SeqInfoStruct
+{
+    Vector* seq;              // the sequence
+    unsigned long hash;       // hashSequence() of the sequence
+    int length;               // sequenceLength() of the sequence
+    int dist;                 // length of a shortest route from the start of
+                              // this sequence to a goal or NO_ROUTE
+    struct SeqInfoStruct* next; // the next sequence along that route (NULL
+                              // if this sequence contains a goal)
+    Vector* inActions;        // level+1 actions whose RHS is this sequence
+} SeqInfo;
+
+//A hash table of the completed sequences at one level.  Each distinct
+//sequence is kept once (it is "interned") so two completed sequences at the
+//same level are equal if and only if they are the same pointer.
+typedef struct SeqTableStruct
+{
+    int capacity;             // number of slots (a power of 2)
+    int count;                // number of sequences in the table
+    SeqInfo** infos;          // the sequences, NULL for an empty slot
+    int isStale;              // TRUE if the distances must be rebuilt
+    int epoch;                // bumped whenever the distances may change
+} SeqTable;
+
+//A plan made by initPlan() and where it was made from.  It can be handed out
+//again for as long as the epoch of the start sequence's level stays the same.
+typedef struct PlanCacheEntryStruct
+{
+    Vector* startSeq;         // the sequence the plan starts from
+    int offset;               // index of the first action of the plan in
+                              // the level 0 route
+    int level;                // the level of startSeq
+    int epoch;                // the epoch of that level when the plan was made
+    Vector* plan;             // the plan
+} PlanCacheEntry;
+
+//The memory held by one kind of structure at one level (see countMemory())
+typedef struct MemStatsStruct
+{
+    long entries;             // number of things stored (episodes, actions...)
+    long allocs;              // number of blocks allocated to hold them
+    long bytes;               // total size of those blocks
+} MemStats;
+
 //Used to identify the agent's position as part of finding routes
 typedef struct StartStruct
 {
@@ -132,6 +220,7 @@ typedef struct StartStruct
 // Global variables for monitoring and connecting
 int g_connectToRoomba;
 int g_statsMode;
+unsigned int g_randSeed;	// Seed for rand(), or 0 to seed it from the clock
 
 // These vectors contain the entire episodic memory
 Vector* g_epMem;
@@ -154,26 +243,43 @@ int     g_lastUpdateLevel;// the highest level that was updated in the last
 extern char* interpretCommand(int cmd);
 extern void  simpleTest();
 extern int   tick(char* sensorInput);
+extern int   tickPipelined(char* sensorInput);
+extern int   tickPipelinedRaw(int sensorBits, int now);
+extern int   tickRaw(int sensorBits, int now);
+extern void  finishPipelinedTick();
 
 Action*      actionMatch(int action);
 int          addAction(Vector* actions, Action* item, int checkRedundant);
 void         addActionToRoute(int actionIdx);
+void         addRouteAction(Action* action);
 int          addActionToSequence(Vector* sequence,  Action* action);
 int          addEpisode(Episode* item);
 int          addSequenceAsEpisode(Vector* sequence);
 void         applyReplacementToPlan(Vector *plan, Replacement *repl);
 Vector*      applyReplacementToSequence(Vector* seq, Replacement* repl);
 int          chooseCommand();
+int          chooseCommand_SemiRandom();
+int          chooseCommand_WithPlan();
+Vector*      chooseStart(Vector **cands, int numCands);
+Vector*      clonePlan(Vector *plan);
 int          compareEpisodes(Episode* ep1, Episode* ep2, int compCmd);
 int          compareEpisodesLoose(Episode* ep1, Episode* ep2);
+void         considerReplacement();
 Vector*      containsSequence(Vector* sequenceList, Vector* seq, int ignoreSelf);
 Episode*     createEpisode(char* sensorData);
+void         countMemory(MemStats stats[MEM_NUM_KINDS][MAX_LEVEL_DEPTH]);
+void         countVector(MemStats* stats, Vector* v);
+Episode*     createEpisodeRaw(int sensorBits, int now);
 void         displayAction(Action* action);
 void         displayActions(Vector* actionList);
 void         displayEpisode(Episode* ep);
 void         displayEpisodeShort(Episode* ep);
 void         displayEpisodes(Vector* epList, int level);
+void         displayMemoryStats(FILE* out);
+void         displayMemoryStatsShort(FILE* out);
+void         displayPipelineStats(FILE* out);
 void         displayPlan();
+void         displayPlanCacheStats(FILE* out);
 void         displayRoute(Route *, int recurse);
 void         displaySequence(Vector* sequence);
 void         displaySequenceShort(Vector* sequence);
@@ -181,31 +287,51 @@ void         displaySequences(Vector* sequences);
 void         endSupervisor();
 Vector*      findInterimStart_KNN();
 Vector*      findInterimStart_NO_KNN();
+int          findInterimStartCandidates(Vector **cands);
 Vector*      findInterimStartPartialMatch_KNN(int *offset);
 Vector*      findInterimStartPartialMatch_NO_KNN(int *offset);
 Replacement* findBestReplacement();
+SeqInfo*     findSeqInfo(Vector* seq);
 int          findTopMatch(double* scoreTable, double* indvScore, int command);
 void         freePlan(Vector *plan);
+void         freePlanCache();
 void         freeRoute(Route *r);
+void         freeSeqTables();
 int          generateScoreTable(Vector* vector, double* score);
+unsigned long hashSequence(Vector* seq);
 Route*       getTopRoute(Vector *plan);
 Vector*      initPlan();
 void         initRouteFromSequence(Route *route, Vector *seq);
 void         initSupervisor();
+Vector*      internSequence(Vector* seq);
 char*        interpretCommandShort(int cmd);
 int          interpretSensorsShort(int *sensors);
+void         invalidateRouteFields();
+Vector*      lookupPlan(Vector *startSeq, int offset);
 Vector*      newPlan();
+int          nextPlanCommand();
 int          nextStepIsValid();
 int          parseEpisode(Episode* parsedData, char* dataArr);
+int          parseEpisodeRaw(Episode* parsedData, int sensorBits, int now);
 void         penalizeAgent();
 void         penalizeReplacements();
+PlanCacheEntry* planCacheEntry(Vector *startSeq, int offset);
 int          planNeedsRecalc(Vector *plan);
 int          planRoute(Episode* currEp);
+int          readRoute(Route* newRoute, Vector *startSeq);
+void         reapplyReplacements();
+void         rebuildRouteField(int level);
 void         rewardAgent();
 void         rewardReplacements();
 int          setCommand(Episode* ep);
 int          setCommand2(Episode* ep);
+void         spreadRouteDist(SeqInfo* from);
+void         stampEpisode(Episode* parsedData, int now);
+void         storePlan(Vector *startSeq, int offset, Vector *plan);
 int          takeNextStep(Episode* currEp);
+int          tickPipelinedSensing(char* sensorInput, int sensorBits, int now);
+int          tickSensing(char* sensorInput, int sensorBits, int now);
+int          timeForRandomStep();
 int          updateAll();
 
 #endif //_SUPERVISOR_H_
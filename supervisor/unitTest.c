@@ -34,8 +34,9 @@ int** g_world;
 int g_heading;
 int g_hitGoal;
 
-//keep track of number times goal is found
-int g_goalCount = 0;
+//keep track of number times goal is found.  (static so that the agents'
+//own g_goalCount doesn't collide with it when this is linked into a client)
+static int g_goalCount = 0;
 
 // extra vars for seeing how agents react to changes in a map
 int g_goalNumToSwitchOn = -1;
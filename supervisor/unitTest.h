@@ -45,6 +45,7 @@
 int g_statsMode;
 
 // Functions headers
+void loadMap(int mapNum);
 void loadWorld();
 void initWorld();
 void freeWorld();
@@ -0,0 +1,385 @@
+#include <string.h>
+
+#include "vector.h"
+
+/**
+ * newVector
+ *
+ * Allocates and initializes a vector
+ *
+ * CAVEAT: Caller is responsible for calling 'freeVector'
+ *
+ * @return Vector* Pointer to allocated vector
+ */
+Vector* newVector()
+{
+	Vector* result = (Vector*) malloc(sizeof(Vector));
+	result->array = (void**) malloc(VECTOR_INIT_CAPACITY * sizeof(void*));
+	result->capacity = VECTOR_INIT_CAPACITY;
+	result->size = 0;
+	return result;
+}// newVector
+
+/**
+ * newSmallVector
+ *
+ * Allocates and initializes a vector for a few entries, such as a
+ * sequence.  Its first VECTOR_INLINE_CAPACITY entries are kept in the
+ * same block as the struct, so it takes one allocation rather than two
+ * and its entries are next to it in memory.  It grows like any other
+ * vector.
+ *
+ * CAVEAT: Caller is responsible for calling 'freeVector'
+ *
+ * @return Vector* Pointer to allocated vector
+ */
+Vector* newSmallVector()
+{
+	Vector* result = (Vector*) malloc(sizeof(Vector)
+					  + VECTOR_INLINE_CAPACITY * sizeof(void*));
+	result->array = (void**) (result + 1);
+	result->capacity = VECTOR_INLINE_CAPACITY;
+	result->size = 0;
+	return result;
+}// newSmallVector
+
+/**
+ * freeVector
+ *
+ * Deallocates memory from vector
+ *
+ * @arg victim pointer to memory to be freed
+ */
+void freeVector(Vector* victim)
+{
+	if(victim == NULL)
+	{
+		return;
+	}
+
+	// Free the vector memory
+	if(!VECTOR_IS_INLINE(victim))
+	{
+		free(victim->array);
+	}
+	free(victim);
+}// freeVector
+
+/**
+ * reserveVector
+ *
+ * Make room for at least a given number of entries so that adding
+ * them won't have to grow the array again.  A vector never gets
+ * smaller this way; see shrinkVector().
+ *
+ * @arg vector pointer to vector
+ * @arg capacity the number of entries to make room for
+ * @return int status code (0 == success)
+ */
+int reserveVector(Vector* vector, int capacity)
+{
+	void** newArr;
+
+	assert(vector != NULL);
+	if(capacity <= vector->capacity)
+	{
+		return 0;
+	}
+
+	// An inline array can't be realloc'd; move the entries out of it
+	if(VECTOR_IS_INLINE(vector))
+	{
+		newArr = (void**) malloc(capacity * sizeof(void*));
+		if(newArr != NULL)
+		{
+			memcpy(newArr, vector->array, vector->size * sizeof(void*));
+		}
+	}
+	else
+	{
+		newArr = (void**) realloc(vector->array, capacity * sizeof(void*));
+	}
+
+	if(newArr == NULL)
+	{
+		return VECTOR_NO_MEMORY;
+	}
+
+	vector->array = newArr;
+	vector->capacity = capacity;
+
+	return 0;
+}// reserveVector
+
+/**
+ * shrinkVector
+ *
+ * Give back the room in the array that the entries don't use.  A
+ * vector whose entries are still inline is left as it is.
+ *
+ * @arg vector pointer to vector
+ * @return int status code (0 == success)
+ */
+int shrinkVector(Vector* vector)
+{
+	int capacity;
+	void** newArr;
+
+	assert(vector != NULL);
+	capacity = (vector->size > 0 ? vector->size : 1);
+	if(VECTOR_IS_INLINE(vector) || capacity == vector->capacity)
+	{
+		return 0;
+	}
+
+	newArr = (void**) realloc(vector->array, capacity * sizeof(void*));
+	if(newArr == NULL)
+	{
+		return VECTOR_NO_MEMORY;
+	}
+
+	vector->array = newArr;
+	vector->capacity = capacity;
+
+	return 0;
+}// shrinkVector
+
+/**
+ * addEntry
+ *
+ * Add new entry to vector and increase capacity if necessary
+ *
+ * @arg vector pointer to vector
+ * @arg item pointer to item to add to array
+ * @return int status code (0 == success)
+ */
+int addEntry(Vector* vector, void* item)
+{
+	// Make sure we aren't adding to a null vector
+	assert(vector != NULL);
+	// If the vector is full double the size of the array
+	if(vector->size == vector->capacity)
+	{
+		int retVal = reserveVector(vector, vector->capacity * 2);
+		if(retVal != 0)
+		{
+			return retVal;
+		}
+	}
+
+	// Add new element
+	vector->array[vector->size] = item;
+	vector->size++;
+
+	return 0;
+}// addEntry
+
+/**
+ * addEntries
+ *
+ * Add several entries to the end of a vector at once, growing it at
+ * most once.
+ *
+ * @arg vector pointer to vector
+ * @arg items the entries to add
+ * @arg count how many there are
+ * @return int status code (0 == success)
+ */
+int addEntries(Vector* vector, void** items, int count)
+{
+	assert(vector != NULL);
+	assert(count >= 0);
+
+	if(vector->size + count > vector->capacity)
+	{
+		// Keep the growth geometric so repeated calls stay cheap
+		int capacity = vector->capacity * 2;
+		if(capacity < vector->size + count)
+		{
+			capacity = vector->size + count;
+		}
+
+		// The entries may be the vector's own (see addVector())
+		int ownEntries = (items == vector->array);
+		int retVal = reserveVector(vector, capacity);
+		if(retVal != 0)
+		{
+			return retVal;
+		}
+		if(ownEntries)
+		{
+			items = vector->array;
+		}
+	}
+
+	memcpy(vector->array + vector->size, items, count * sizeof(void*));
+	vector->size += count;
+
+	return 0;
+}// addEntries
+
+/**
+ * removeEntryByIndex
+ *
+ * Remove an entry from vector at a given index.  The entries after it
+ * move down, so they stay in order.
+ *
+ * @arg vector pointer to vector
+ * @arg index of the item to remove
+ *
+ * @return int status code (0 == success)
+ */
+int removeEntryByIndex(Vector* vector, int index)
+{
+	// Make sure we aren't adding to a null vector
+	assert(vector != NULL);
+
+    //check for invalid index
+    if ((index < 0) || (index >= vector->size))
+    {
+        return VECTOR_BAD_INDEX;
+    }
+
+    //Copy all the subsequent entries down to fill the "hole" left
+    //by the missing one
+    (vector->size)--;
+    memmove(vector->array + index, vector->array + index + 1,
+            (vector->size - index) * sizeof(void*));
+
+    return 0;                   // success
+}//removeEntryByIndex
+
+/**
+ * swapRemoveEntry
+ *
+ * Remove an entry from vector at a given index by moving the last entry
+ * into its place.  This takes constant time but does not keep the
+ * entries in order.
+ *
+ * @arg vector pointer to vector
+ * @arg index of the item to remove
+ *
+ * @return int status code (0 == success)
+ */
+int swapRemoveEntry(Vector* vector, int index)
+{
+	assert(vector != NULL);
+
+    //check for invalid index
+    if ((index < 0) || (index >= vector->size))
+    {
+        return VECTOR_BAD_INDEX;
+    }
+
+    (vector->size)--;
+    vector->array[index] = vector->array[vector->size];
+
+    return 0;                   // success
+}//swapRemoveEntry
+
+/**
+ * removeEntry
+ *
+ * Remove the last occurrence of an entry from vector.  The search starts
+ * from the end, where recently added entries are.
+ *
+ * @arg vector pointer to vector
+ * @arg item pointer to item to remove from the array
+ *
+ * @return int status code (0 == success)
+ */
+int removeEntry(Vector* vector, void* item)
+{
+    int i;                      // for-loops!
+
+	// Make sure we aren't adding to a null vector
+	assert(vector != NULL);
+
+    //Find the entry
+    for(i = vector->size - 1; i >= 0; i--)
+    {
+        if (item == vector->array[i])
+        {
+            return removeEntryByIndex(vector, i);
+        }
+    }
+
+    //Detect item not found
+    return VECTOR_NOT_FOUND;
+
+}// removeEntry
+
+/**
+ * getEntry
+ *
+ * Get the entry of a vector at a given index
+ *
+ * @arg vector pointer to vector
+ * @arg index index of item to retrieve
+ * @return void* pointer to the entry at given index
+ */
+void* getEntry(Vector* vector, int index)
+{
+	assert(index >= 0 && index < vector->size);
+	return vector->array[index];
+}// getEntry
+
+/**
+ * findEntry
+ *
+ * Get the index of a given entry in a vector
+ *
+ * @arg vector pointer to vector
+ * @arg entry  entry to find
+ * @return the index of that entry (or -1 if not found)
+ */
+int findEntry(Vector* vector, void *entry)
+{
+    int i;
+    for(i = 0; i < vector->size; i++)
+    {
+        if (vector->array[i] == entry) return i;
+    }
+
+    return VECTOR_NOT_FOUND;
+}// findentry
+
+/**
+ * cloneVector
+ *
+ * creates a new vector that is a duplicate of a given vector.  A short
+ * vector is cloned into a small one (see newSmallVector()).
+ *
+ * CAVEAT:  the new vector is a shallow copy!
+ * CAVEAT:  this method allocates memory that the caller is responsible for
+ *
+ * @arg vector is the vector to clone
+ * @return the copy
+ */
+Vector *cloneVector(Vector *vector)
+{
+    Vector *result = (vector->size <= VECTOR_INLINE_CAPACITY
+                      ? newSmallVector() : newVector());
+
+    addEntries(result, vector->array, vector->size);
+
+    return result;
+}//cloneVector
+
+/**
+ * addVector
+ *
+ * Copy the contents of one vector to another.  Note:  the source vector is
+ * unaffected by this operation.
+ *
+ * @arg target pointer to vector to add entries to
+ * @arg source pointer to vector to add entries from
+ * @return int status code (0 == success)
+ */
+int addVector(Vector* target, Vector* source)
+{
+	assert(target != NULL);
+    assert(source != NULL);
+
+	return addEntries(target, source->array, source->size);
+}// addVector
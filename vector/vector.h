@@ -0,0 +1,74 @@
+#ifndef _VECTOR_H_
+#define _VECTOR_H_
+
+#include <stdlib.h>
+#include <assert.h>
+
+/*
+	This is a simple implementation of the c++ vector class
+	It will store resizable arrays of void* and will be the
+	'guts' for vectors for specific structs (types)
+
+	It is shared by all of the agents (supervisor/, mccallum/, soar/)
+	and by wme/.  vectorBench.c measures it.
+*/
+
+typedef struct VectorStruct
+{
+	int capacity;
+	size_t size;
+	void ** array;
+} Vector;
+
+// The capacity of a vector made by newVector()
+#define VECTOR_INIT_CAPACITY	16
+
+// The capacity of a vector made by newSmallVector().  Its array is
+// allocated along with the struct until it grows past this.
+#define VECTOR_INLINE_CAPACITY	4
+
+// Is the vector's array still the one allocated with the struct?
+#define VECTOR_IS_INLINE(v)	((v)->array == (void **)((v) + 1))
+
+// Error codes
+#define VECTOR_NOT_FOUND	(-1)
+#define VECTOR_BAD_INDEX	(-2)
+#define VECTOR_NO_MEMORY	(-3)
+
+// Function declarations ( see vector.c)
+int     addEntries (Vector* vector, void** items, int count);
+int     addEntry   (Vector* vector, void* item);
+int     addVector  (Vector* target, Vector* source);
+Vector* cloneVector(Vector* vector);
+int     findEntry  (Vector* vector, void* entry);
+void    freeVector (Vector* victim);
+void*   getEntry   (Vector* vector, int index);
+Vector* newSmallVector();
+Vector* newVector  ();
+int     removeEntry(Vector* vector, void* item);
+int     removeEntryByIndex(Vector* vector, int index);
+int     reserveVector(Vector* vector, int capacity);
+int     shrinkVector(Vector* vector);
+int     swapRemoveEntry(Vector* vector, int index);
+
+/*
+	VECTOR_OF(T, name) defines functions for using a vector that
+	holds only T*s without casting every access:
+
+		T*  nameAt(Vector* v, int i)    the ith entry
+		T*  nameLast(Vector* v)         the last entry
+		int namePush(Vector* v, T* item) addEntry()
+
+	For example VECTOR_OF(Route, route) in supervisor.h defines
+	routeAt(), routeLast() and routePush().  Like v->array[i], nameAt()
+	does not check the index.
+*/
+#define VECTOR_OF(T, name)						\
+	static inline T* name##At(Vector* v, int i)			\
+	{ return (T*)v->array[i]; }					\
+	static inline T* name##Last(Vector* v)				\
+	{ return (T*)v->array[v->size - 1]; }				\
+	static inline int name##Push(Vector* v, T* item)		\
+	{ return addEntry(v, (void*)item); }
+
+#endif // _VECTOR_H_
@@ -0,0 +1,369 @@
+/**
+ * vectorBench.c
+ *
+ * Measure the operations of vector.c that replaced the ones each agent
+ * used to carry its own copy of, against the code they replaced:
+ *
+ *  - growing a vector entry by entry (malloc, copy and free against
+ *    realloc),
+ *  - making, filling and freeing many short vectors such as sequences
+ *    (newVector() against newSmallVector()),
+ *  - cloning a vector and appending one to another (an addEntry() per
+ *    entry against addEntries()),
+ *  - removing entries (shifting the rest down one at a time against
+ *    memmove() and against swapRemoveEntry()), and
+ *  - reading entries (getEntry() against a VECTOR_OF accessor).
+ *
+ * The old code is copied here as it was so that the two can be timed
+ * side by side.
+ *
+ * Usage: vectorBench.out [-n entries]
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "vector.h"
+
+#define DEFAULT_ENTRIES 1000000
+
+// The old newVector()'s capacity
+#define OLD_INIT_CAPACITY 64
+
+// The length of the short vectors, typical of a level 0 sequence
+#define SHORT_LENGTH 3
+
+// Removing from the middle is quadratic the old way; remove fewer.
+#define REMOVE_DIVISOR 50
+
+typedef struct ItemStruct
+{
+  long value;
+} Item;
+
+VECTOR_OF(Item, item)
+
+static Item * items;
+static int numEntries = DEFAULT_ENTRIES;
+
+// Folded into the output so the loops can't be optimized away.
+static long checksum = 0;
+
+
+/**
+ * elapsedNs
+ *
+ * @returns the nanoseconds from start to now.
+ */
+static double elapsedNs(struct timespec * start)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (now.tv_sec - start->tv_sec) * 1e9 + (now.tv_nsec - start->tv_nsec);
+}
+
+/**
+ * report
+ *
+ * Print one line of results.
+ */
+static void report(char * what, double oldNs, double newNs, int n)
+{
+  printf("%-28s %10.2f %10.2f %9.1fx\n", what, oldNs / n, newNs / n,
+	 oldNs / newNs);
+}
+
+/**
+ * oldNewVector, oldAddEntry, oldRemoveEntryByIndex, oldCloneVector,
+ * oldFreeVector
+ *
+ * The code vector.c replaced.
+ */
+static Vector * oldNewVector()
+{
+  Vector * result = (Vector *)malloc(sizeof(Vector));
+  result->array = (void **)malloc(OLD_INIT_CAPACITY * sizeof(void *));
+  result->capacity = OLD_INIT_CAPACITY;
+  result->size = 0;
+  return result;
+}
+
+static int oldAddEntry(Vector * vector, void * item)
+{
+  if(vector->size == vector->capacity)
+    {
+      void ** tempArr = (void **)malloc(vector->capacity * 2 * sizeof(void *));
+      int i;
+      for(i = 0; i < vector->size; i++)
+	{
+	  tempArr[i] = vector->array[i];
+	}
+      free(vector->array);
+      vector->array = tempArr;
+      vector->capacity = vector->capacity * 2;
+    }
+
+  vector->array[vector->size] = item;
+  vector->size++;
+
+  return 0;
+}
+
+static int oldRemoveEntryByIndex(Vector * vector, int index)
+{
+  int i;
+
+  if((index < 0) || (index >= vector->size)) return -2;
+
+  (vector->size)--;
+  for(i = index; i < vector->size; i++)
+    {
+      vector->array[i] = vector->array[i+1];
+    }
+
+  return 0;
+}
+
+static Vector * oldCloneVector(Vector * vector)
+{
+  Vector * result = oldNewVector();
+  int i;
+
+  for(i = 0; i < vector->size; i++)
+    {
+      oldAddEntry(result, vector->array[i]);
+    }
+
+  return result;
+}
+
+static void oldFreeVector(Vector * victim)
+{
+  free(victim->array);
+  free(victim);
+}
+
+/**
+ * benchGrow
+ *
+ * Add numEntries entries, one at a time, to an empty vector.
+ */
+static void benchGrow()
+{
+  struct timespec start;
+  double oldNs, newNs;
+  Vector * v;
+  int i;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  v = oldNewVector();
+  for(i = 0; i < numEntries; i++) oldAddEntry(v, &items[i]);
+  checksum += v->size;
+  oldFreeVector(v);
+  oldNs = elapsedNs(&start);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  v = newVector();
+  for(i = 0; i < numEntries; i++) addEntry(v, &items[i]);
+  checksum -= v->size;
+  freeVector(v);
+  newNs = elapsedNs(&start);
+
+  report("addEntry (grow)", oldNs, newNs, numEntries);
+
+  // With the room reserved first there is nothing to grow
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  v = newVector();
+  reserveVector(v, numEntries);
+  for(i = 0; i < numEntries; i++) addEntry(v, &items[i]);
+  checksum -= v->size;
+  freeVector(v);
+  newNs = elapsedNs(&start);
+
+  report("addEntry (reserved)", oldNs, newNs, numEntries);
+}
+
+/**
+ * benchShort
+ *
+ * Make, fill and free numEntries / SHORT_LENGTH vectors of
+ * SHORT_LENGTH entries each.
+ */
+static void benchShort()
+{
+  struct timespec start;
+  double oldNs, newNs;
+  int n = numEntries / SHORT_LENGTH;
+  Vector * v;
+  int i, j;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(i = 0; i < n; i++)
+    {
+      v = oldNewVector();
+      for(j = 0; j < SHORT_LENGTH; j++) oldAddEntry(v, &items[i]);
+      checksum += v->size;
+      oldFreeVector(v);
+    }
+  oldNs = elapsedNs(&start);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(i = 0; i < n; i++)
+    {
+      v = newSmallVector();
+      for(j = 0; j < SHORT_LENGTH; j++) addEntry(v, &items[i]);
+      checksum -= v->size;
+      freeVector(v);
+    }
+  newNs = elapsedNs(&start);
+
+  report("short vector", oldNs, newNs, n);
+}
+
+/**
+ * benchCopy
+ *
+ * Clone a vector of numEntries entries, and append it to another.
+ */
+static void benchCopy()
+{
+  struct timespec start;
+  double oldNs, newNs;
+  Vector * source = newVector();
+  Vector * copy;
+  int i;
+
+  for(i = 0; i < numEntries; i++) addEntry(source, &items[i]);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  copy = oldCloneVector(source);
+  checksum += copy->size;
+  oldFreeVector(copy);
+  oldNs = elapsedNs(&start);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  copy = cloneVector(source);
+  checksum -= copy->size;
+  freeVector(copy);
+  newNs = elapsedNs(&start);
+
+  report("cloneVector", oldNs, newNs, numEntries);
+
+  // The old addVector() was an oldAddEntry() per entry
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  copy = oldNewVector();
+  oldAddEntry(copy, &items[0]);
+  for(i = 0; i < source->size; i++) oldAddEntry(copy, source->array[i]);
+  checksum += copy->size;
+  oldFreeVector(copy);
+  oldNs = elapsedNs(&start);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  copy = newVector();
+  addEntry(copy, &items[0]);
+  addVector(copy, source);
+  checksum -= copy->size;
+  freeVector(copy);
+  newNs = elapsedNs(&start);
+
+  report("addVector", oldNs, newNs, numEntries);
+
+  freeVector(source);
+}
+
+/**
+ * benchRemove
+ *
+ * Remove numEntries / REMOVE_DIVISOR entries, one at a time, from the
+ * middle of a vector that long.
+ */
+static void benchRemove()
+{
+  struct timespec start;
+  double oldNs, newNs;
+  int n = numEntries / REMOVE_DIVISOR;
+  Vector * v = newVector();
+  int i;
+
+  for(i = 0; i < n; i++) addEntry(v, &items[i]);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  while(v->size > 0) oldRemoveEntryByIndex(v, v->size / 2);
+  oldNs = elapsedNs(&start);
+
+  for(i = 0; i < n; i++) addEntry(v, &items[i]);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  while(v->size > 0) removeEntryByIndex(v, v->size / 2);
+  newNs = elapsedNs(&start);
+
+  report("removeEntryByIndex", oldNs, newNs, n);
+
+  for(i = 0; i < n; i++) addEntry(v, &items[i]);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  while(v->size > 0) swapRemoveEntry(v, v->size / 2);
+  newNs = elapsedNs(&start);
+
+  report("swapRemoveEntry", oldNs, newNs, n);
+
+  freeVector(v);
+}
+
+/**
+ * benchRead
+ *
+ * Read every entry of a vector numEntries long.
+ */
+static void benchRead()
+{
+  struct timespec start;
+  double oldNs, newNs;
+  Vector * v = newVector();
+  int i;
+
+  for(i = 0; i < numEntries; i++) addEntry(v, &items[i]);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(i = 0; i < v->size; i++) checksum += ((Item *)getEntry(v, i))->value;
+  oldNs = elapsedNs(&start);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(i = 0; i < v->size; i++) checksum -= itemAt(v, i)->value;
+  newNs = elapsedNs(&start);
+
+  report("getEntry / itemAt", oldNs, newNs, numEntries);
+
+  freeVector(v);
+}
+
+int main(int argc, char * argv[])
+{
+  int opt;
+  int i;
+
+  while((opt = getopt(argc, argv, "n:")) != -1)
+    {
+      if(opt == 'n' && atoi(optarg) >= REMOVE_DIVISOR) numEntries = atoi(optarg);
+      else
+	{
+	  fprintf(stderr, "Usage: %s [-n entries]\n", argv[0]);
+	  return 1;
+	}
+    }
+
+  items = (Item *)malloc(numEntries * sizeof(Item));
+  for(i = 0; i < numEntries; i++) items[i].value = i;
+
+  printf("%d entries, ns per entry (or per vector)\n", numEntries);
+  printf("%-28s %10s %10s %10s\n", "", "old", "new", "speedup");
+  benchGrow();
+  benchShort();
+  benchCopy();
+  benchRemove();
+  benchRead();
+  printf("(checksum %ld)\n", checksum);
+
+  return 0;
+}
@@ -512,8 +512,8 @@ int getNumMatches(EpisodeWME* ep1, EpisodeWME* ep2, int compareCMD)
 Vector* roombaSensorsToWME(char* dataArr)
 {
     int i;
-    Vector* wmeVec = newVector();
-    // set the episodes sensor values to the sensor data
+    int sensorBits = 0;
+    // pack the sensor data the way roombaBitsToWME() expects it
     for(i = 0; i < NUM_SENSORS; i++)
     {
         // convert char to int and return error if not 0/1
@@ -524,10 +524,38 @@ Vector* roombaSensorsToWME(char* dataArr)
             return NULL;     
         }
 
+        sensorBits = (sensorBits << 1) | bit;
+    }//for
+    return roombaBitsToWME(sensorBits);
+}//roombaSensorsToWME
+
+/**
+ * roombaBitsToWME
+ *
+ * roombaSensorsToWME() for Roomba sensor data that is already packed,
+ * one bit per sensor (see SENSOR_BIT).
+ *
+ * @param sensorBits the sensors, one bit each
+ * @return Vector* A vector of WMEs created from the Roomba data
+ *                 NULL if error
+ */
+Vector* roombaBitsToWME(int sensorBits)
+{
+    int i;
+
+    // Only the low NUM_SENSORS bits may be set
+    if((sensorBits & ~((1 << NUM_SENSORS) - 1)) != 0)
+    {
+        return NULL;
+    }
+
+    Vector* wmeVec = newVector();
+    for(i = 0; i < NUM_SENSORS; i++)
+    {
         // Create the WME for the current sensor
         WME* wme = (WME*)malloc(sizeof(WME));
         wme->type = WME_INT;
-        wme->value.iVal = bit; 
+        wme->value.iVal = SENSOR_BIT(sensorBits, i);
         // Here we will set the IR bit attr name to 'reward' to be consistent
         // with how we expect to mark S/F from other state definitions.
         // All other sensor attr names will be named by their index
@@ -578,7 +606,7 @@ Vector* roombaSensorsToWME(char* dataArr)
         addEntry(wmeVec, wme);
     }//for
     return wmeVec;
-}//roombaSensorsToWME
+}//roombaBitsToWME
 
 /**
  * stringToWMES
@@ -19,7 +19,7 @@
 #include <string.h>
 #include <math.h>
 
-#include "../supervisor/vector.h"
+#include "../vector/vector.h"
 #include "../communication/communication.h"
 
 //Used for passing arbitrary information as agent's state
@@ -64,6 +64,7 @@ double       getDOUBLEValWME(EpisodeWME* ep, char* attr, int* found);
 int          getINTValWME(EpisodeWME* ep, char* attr, int* found);
 char*        getSTRINGValWME(EpisodeWME* ep, char* attr, int* found);
 int          getNumMatches(EpisodeWME* ep1, EpisodeWME* ep2, int compareCMD);
+Vector*      roombaBitsToWME(int sensorBits);
 Vector*      roombaSensorsToWME(char* dataArr);
 Vector*		 stringToWMES(char* senseString);
 